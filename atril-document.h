@@ -54,6 +54,7 @@
 #include <libdocument/ev-page.h>
 #include <libdocument/ev-render-context.h>
 #include <libdocument/ev-selection.h>
+#include <libdocument/ev-text-index.h>
 #include <libdocument/ev-transition-effect.h>
 #include <libdocument/ev-version.h>
 #include <libdocument/ev-macros.h>
@@ -0,0 +1,902 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * Copyright (C) 2024 Atril Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Random access to the entries of ZIP and TAR archives, so that comic
+ * books in those formats can be read without spawning an external command
+ * for every page. The archive is indexed once when it's opened, and every
+ * entry is streamed from its offset when it's read. Other formats (RAR, 7z,
+ * compressed TAR) can be added to the formats table below; until then
+ * comics_archive_open() returns NULL for them and the comics backend falls
+ * back to the external commands.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <zlib.h>
+
+#include "comics-archive.h"
+#include "ev-document.h"
+
+#define COMICS_ARCHIVE_BUFFER_SIZE 65536
+
+typedef struct {
+	gchar   *name;
+	goffset  offset;
+	goffset  compressed_size;
+	goffset  size;
+	guint32  crc;
+	guint16  method;
+	gboolean readable;
+} ComicsArchiveEntry;
+
+typedef struct {
+	const gchar *name;
+
+	/* Returns FALSE without setting @error if the file isn't in this format */
+	gboolean (* index)      (ComicsArchive         *archive,
+				 GError               **error);
+	gboolean (* read_entry) (ComicsArchive         *archive,
+				 ComicsArchiveEntry    *entry,
+				 ComicsArchiveReadFunc  func,
+				 gpointer               user_data,
+				 GError               **error);
+} ComicsArchiveFormat;
+
+struct _ComicsArchive {
+	gint                       fd;
+	goffset                    size;
+	const ComicsArchiveFormat *format;
+	GPtrArray                 *entries;
+	GHashTable                *entries_by_name;
+};
+
+static void
+comics_archive_entry_free (ComicsArchiveEntry *entry)
+{
+	g_free (entry->name);
+	g_slice_free (ComicsArchiveEntry, entry);
+}
+
+static void
+set_corrupted_error (GError **error)
+{
+	g_set_error_literal (error,
+			     EV_DOCUMENT_ERROR,
+			     EV_DOCUMENT_ERROR_INVALID,
+			     _("File corrupted"));
+}
+
+static guint16
+get_le16 (const guchar *p)
+{
+	return (guint16) p[0] | ((guint16) p[1] << 8);
+}
+
+static guint32
+get_le32 (const guchar *p)
+{
+	return (guint32) p[0] | ((guint32) p[1] << 8) |
+		((guint32) p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+static guint64
+get_le64 (const guchar *p)
+{
+	return (guint64) get_le32 (p) | ((guint64) get_le32 (p + 4) << 32);
+}
+
+static gboolean
+comics_archive_pread (ComicsArchive *archive,
+		      goffset        offset,
+		      gpointer       buffer,
+		      gsize          length,
+		      GError       **error)
+{
+	guchar *p = buffer;
+
+	while (length > 0) {
+		gssize bytes;
+
+		bytes = pread (archive->fd, p, length, (off_t) offset);
+		if (bytes < 0) {
+			gint errsv = errno;
+
+			if (errsv == EINTR)
+				continue;
+
+			g_set_error_literal (error,
+					     G_IO_ERROR,
+					     g_io_error_from_errno (errsv),
+					     g_strerror (errsv));
+			return FALSE;
+		}
+		if (bytes == 0) {
+			set_corrupted_error (error);
+			return FALSE;
+		}
+
+		p += bytes;
+		offset += bytes;
+		length -= bytes;
+	}
+
+	return TRUE;
+}
+
+/* Names not in UTF-8 are assumed to be in the archive's legacy encoding */
+static gchar *
+comics_archive_entry_name (const gchar *raw,
+			   gsize        length,
+			   const gchar *charset)
+{
+	gchar *name;
+
+	if (g_utf8_validate (raw, length, NULL))
+		return g_strndup (raw, length);
+
+	name = g_convert (raw, length, "UTF-8", charset, NULL, NULL, NULL);
+	if (name)
+		return name;
+
+	return g_utf8_make_valid (raw, length);
+}
+
+static void
+comics_archive_add_entry (ComicsArchive      *archive,
+			  ComicsArchiveEntry *entry)
+{
+	g_ptr_array_add (archive->entries, entry);
+	if (!g_hash_table_contains (archive->entries_by_name, entry->name))
+		g_hash_table_insert (archive->entries_by_name, entry->name, entry);
+}
+
+/* Streams @length bytes at @offset to @func, updating @crc if not %NULL.
+ * @stopped is set when @func stops reading before the end.
+ */
+static gboolean
+comics_archive_copy (ComicsArchive         *archive,
+		     goffset                offset,
+		     goffset                length,
+		     ComicsArchiveReadFunc  func,
+		     gpointer               user_data,
+		     guint32               *crc,
+		     gboolean              *stopped,
+		     GError               **error)
+{
+	guchar *buffer;
+	gboolean retval = TRUE;
+
+	buffer = g_malloc (COMICS_ARCHIVE_BUFFER_SIZE);
+
+	while (length > 0) {
+		gsize chunk = MIN (length, COMICS_ARCHIVE_BUFFER_SIZE);
+
+		if (!comics_archive_pread (archive, offset, buffer, chunk, error)) {
+			retval = FALSE;
+			break;
+		}
+
+		if (crc)
+			*crc = crc32 (*crc, buffer, chunk);
+
+		offset += chunk;
+		length -= chunk;
+
+		if (!func (buffer, chunk, user_data)) {
+			*stopped = TRUE;
+			break;
+		}
+	}
+
+	g_free (buffer);
+
+	return retval;
+}
+
+/* ZIP */
+
+#define ZIP_LOCAL_HEADER_SIGNATURE   0x04034b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define ZIP_END_SIGNATURE            0x06054b50
+#define ZIP64_LOCATOR_SIGNATURE      0x07064b50
+#define ZIP64_END_SIGNATURE          0x06064b50
+
+#define ZIP_LOCAL_HEADER_SIZE        30
+#define ZIP_CENTRAL_HEADER_SIZE      46
+#define ZIP_END_SIZE                 22
+#define ZIP64_LOCATOR_SIZE           20
+#define ZIP64_END_SIZE               56
+#define ZIP_MAX_COMMENT_SIZE         0xffff
+
+#define ZIP_FLAG_ENCRYPTED           (1 << 0)
+#define ZIP_FLAG_UTF8                (1 << 11)
+
+#define ZIP_METHOD_STORED            0
+#define ZIP_METHOD_DEFLATED          8
+
+static void
+zip_parse_zip64_extra (const guchar       *extra,
+		       gsize               length,
+		       ComicsArchiveEntry *entry)
+{
+	const guchar *end = extra + length;
+
+	while (extra + 4 <= end) {
+		guint16       id = get_le16 (extra);
+		guint16       size = get_le16 (extra + 2);
+		const guchar *p = extra + 4;
+		const guchar *field_end = p + size;
+
+		if (field_end > end)
+			return;
+
+		if (id == 0x0001) {
+			/* Only the fields that overflowed are present, in this order */
+			if (entry->size == 0xffffffff && p + 8 <= field_end) {
+				entry->size = get_le64 (p);
+				p += 8;
+			}
+			if (entry->compressed_size == 0xffffffff && p + 8 <= field_end) {
+				entry->compressed_size = get_le64 (p);
+				p += 8;
+			}
+			if (entry->offset == 0xffffffff && p + 8 <= field_end)
+				entry->offset = get_le64 (p);
+
+			return;
+		}
+
+		extra = field_end;
+	}
+}
+
+static gboolean
+zip_index (ComicsArchive *archive,
+	   GError       **error)
+{
+	guchar   signature[4];
+	guchar  *tail = NULL, *central = NULL;
+	guchar  *end = NULL, *p;
+	gsize    tail_size;
+	guint64  n_entries, i;
+	goffset  central_offset, central_size;
+	gboolean retval = FALSE;
+
+	if (archive->size < ZIP_END_SIZE ||
+	    !comics_archive_pread (archive, 0, signature, sizeof (signature), NULL))
+		return FALSE;
+
+	if (get_le32 (signature) != ZIP_LOCAL_HEADER_SIGNATURE &&
+	    get_le32 (signature) != ZIP_END_SIGNATURE)
+		return FALSE;
+
+	/* The end of central directory record is followed by a comment
+	 * of up to 64 KiB, look for it backwards from the end of the file.
+	 */
+	tail_size = MIN (archive->size, ZIP_END_SIZE + ZIP_MAX_COMMENT_SIZE);
+	tail = g_malloc (tail_size);
+	if (!comics_archive_pread (archive, archive->size - tail_size, tail, tail_size, error))
+		goto out;
+
+	for (p = tail + tail_size - ZIP_END_SIZE; p >= tail; p--) {
+		if (get_le32 (p) == ZIP_END_SIGNATURE) {
+			end = p;
+			break;
+		}
+	}
+	if (!end) {
+		set_corrupted_error (error);
+		goto out;
+	}
+
+	n_entries = get_le16 (end + 10);
+	central_size = get_le32 (end + 12);
+	central_offset = get_le32 (end + 16);
+
+	if ((n_entries == 0xffff || central_size == 0xffffffff || central_offset == 0xffffffff) &&
+	    end - tail >= ZIP64_LOCATOR_SIZE &&
+	    get_le32 (end - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+		guchar  zip64_end[ZIP64_END_SIZE];
+		guint64 zip64_offset;
+
+		zip64_offset = get_le64 (end - ZIP64_LOCATOR_SIZE + 8);
+		if (zip64_offset > (guint64) archive->size - ZIP64_END_SIZE ||
+		    !comics_archive_pread (archive, zip64_offset, zip64_end, ZIP64_END_SIZE, error))
+			goto out;
+
+		if (get_le32 (zip64_end) != ZIP64_END_SIGNATURE) {
+			set_corrupted_error (error);
+			goto out;
+		}
+
+		n_entries = get_le64 (zip64_end + 32);
+		central_size = get_le64 (zip64_end + 40);
+		central_offset = get_le64 (zip64_end + 48);
+	}
+
+	if (central_offset < 0 || central_size < 0 ||
+	    central_offset > archive->size - central_size) {
+		set_corrupted_error (error);
+		goto out;
+	}
+
+	central = g_malloc (central_size);
+	if (!comics_archive_pread (archive, central_offset, central, central_size, error))
+		goto out;
+
+	for (p = central, i = 0; i < n_entries; i++) {
+		ComicsArchiveEntry *entry;
+		guint16 flags, name_length, extra_length, comment_length;
+
+		if (p + ZIP_CENTRAL_HEADER_SIZE > central + central_size ||
+		    get_le32 (p) != ZIP_CENTRAL_HEADER_SIGNATURE) {
+			set_corrupted_error (error);
+			goto out;
+		}
+
+		flags = get_le16 (p + 8);
+		name_length = get_le16 (p + 28);
+		extra_length = get_le16 (p + 30);
+		comment_length = get_le16 (p + 32);
+
+		if (p + ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length >
+		    central + central_size) {
+			set_corrupted_error (error);
+			goto out;
+		}
+
+		/* Skip directories */
+		if (name_length == 0 || p[ZIP_CENTRAL_HEADER_SIZE + name_length - 1] == '/') {
+			p += ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+			continue;
+		}
+
+		entry = g_slice_new0 (ComicsArchiveEntry);
+		entry->method = get_le16 (p + 10);
+		entry->crc = get_le32 (p + 16);
+		entry->compressed_size = get_le32 (p + 20);
+		entry->size = get_le32 (p + 24);
+		entry->offset = get_le32 (p + 42);
+		zip_parse_zip64_extra (p + ZIP_CENTRAL_HEADER_SIZE + name_length,
+				       extra_length, entry);
+
+		if (flags & ZIP_FLAG_UTF8)
+			entry->name = g_utf8_make_valid ((const gchar *) p + ZIP_CENTRAL_HEADER_SIZE,
+							 name_length);
+		else
+			entry->name = comics_archive_entry_name ((const gchar *) p + ZIP_CENTRAL_HEADER_SIZE,
+								 name_length, "CP437");
+
+		entry->readable = !(flags & ZIP_FLAG_ENCRYPTED) &&
+			(entry->method == ZIP_METHOD_STORED ||
+			 entry->method == ZIP_METHOD_DEFLATED) &&
+			entry->offset >= 0 && entry->offset < archive->size;
+
+		comics_archive_add_entry (archive, entry);
+
+		p += ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+	}
+
+	retval = TRUE;
+ out:
+	g_free (tail);
+	g_free (central);
+
+	return retval;
+}
+
+static gboolean
+zip_inflate (ComicsArchive         *archive,
+	     goffset                offset,
+	     goffset                length,
+	     ComicsArchiveReadFunc  func,
+	     gpointer               user_data,
+	     guint32               *crc,
+	     gboolean              *stopped,
+	     GError               **error)
+{
+	z_stream  stream;
+	guchar   *in, *out;
+	gboolean  retval = TRUE;
+	gint      status = Z_OK;
+
+	memset (&stream, 0, sizeof (stream));
+	if (inflateInit2 (&stream, -MAX_WBITS) != Z_OK) {
+		set_corrupted_error (error);
+		return FALSE;
+	}
+
+	in = g_malloc (COMICS_ARCHIVE_BUFFER_SIZE);
+	out = g_malloc (COMICS_ARCHIVE_BUFFER_SIZE);
+
+	while (status != Z_STREAM_END) {
+		gsize produced;
+
+		if (stream.avail_in == 0) {
+			gsize chunk = MIN (length, COMICS_ARCHIVE_BUFFER_SIZE);
+
+			if (chunk == 0) {
+				set_corrupted_error (error);
+				retval = FALSE;
+				break;
+			}
+
+			if (!comics_archive_pread (archive, offset, in, chunk, error)) {
+				retval = FALSE;
+				break;
+			}
+
+			offset += chunk;
+			length -= chunk;
+			stream.next_in = in;
+			stream.avail_in = chunk;
+		}
+
+		stream.next_out = out;
+		stream.avail_out = COMICS_ARCHIVE_BUFFER_SIZE;
+
+		status = inflate (&stream, Z_NO_FLUSH);
+		if (status != Z_OK && status != Z_STREAM_END) {
+			set_corrupted_error (error);
+			retval = FALSE;
+			break;
+		}
+
+		produced = COMICS_ARCHIVE_BUFFER_SIZE - stream.avail_out;
+		if (produced == 0)
+			continue;
+
+		*crc = crc32 (*crc, out, produced);
+
+		if (!func (out, produced, user_data)) {
+			*stopped = TRUE;
+			break;
+		}
+	}
+
+	inflateEnd (&stream);
+	g_free (in);
+	g_free (out);
+
+	return retval;
+}
+
+static gboolean
+zip_read_entry (ComicsArchive         *archive,
+		ComicsArchiveEntry    *entry,
+		ComicsArchiveReadFunc  func,
+		gpointer               user_data,
+		GError               **error)
+{
+	guchar  header[ZIP_LOCAL_HEADER_SIZE];
+	goffset data_offset;
+	guint32  crc = crc32 (0, NULL, 0);
+	gboolean stopped = FALSE;
+
+	if (!comics_archive_pread (archive, entry->offset, header, ZIP_LOCAL_HEADER_SIZE, error))
+		return FALSE;
+
+	if (get_le32 (header) != ZIP_LOCAL_HEADER_SIGNATURE) {
+		set_corrupted_error (error);
+		return FALSE;
+	}
+
+	data_offset = entry->offset + ZIP_LOCAL_HEADER_SIZE +
+		get_le16 (header + 26) + get_le16 (header + 28);
+	if (data_offset > archive->size - entry->compressed_size) {
+		set_corrupted_error (error);
+		return FALSE;
+	}
+
+	if (entry->method == ZIP_METHOD_STORED) {
+		if (!comics_archive_copy (archive, data_offset, entry->compressed_size,
+					  func, user_data, &crc, &stopped, error))
+			return FALSE;
+	} else {
+		if (!zip_inflate (archive, data_offset, entry->compressed_size,
+				  func, user_data, &crc, &stopped, error))
+			return FALSE;
+	}
+
+	/* The CRC of a partially read entry can't be checked */
+	if (!stopped && crc != entry->crc) {
+		set_corrupted_error (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* TAR */
+
+#define TAR_BLOCK_SIZE       512
+#define TAR_MAX_LONG_NAME    65536
+
+static gboolean
+tar_header_is_valid (const guchar *header)
+{
+	guint64 checksum = 0, stored = 0;
+	gint    i;
+
+	for (i = 0; i < TAR_BLOCK_SIZE; i++)
+		checksum += (i >= 148 && i < 156) ? ' ' : header[i];
+
+	for (i = 148; i < 156 && (header[i] == ' ' || header[i] == '\0'); i++);
+	for (; i < 156 && header[i] >= '0' && header[i] <= '7'; i++)
+		stored = stored * 8 + (header[i] - '0');
+
+	return checksum == stored;
+}
+
+static gboolean
+tar_header_is_end (const guchar *header)
+{
+	gint i;
+
+	for (i = 0; i < TAR_BLOCK_SIZE; i++) {
+		if (header[i] != '\0')
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static goffset
+tar_parse_number (const guchar *field,
+		  gsize         length)
+{
+	guint64 value = 0;
+	gsize   i;
+
+	/* GNU base-256 encoding for sizes that don't fit in octal */
+	if (field[0] & 0x80) {
+		value = field[0] & 0x3f;
+		for (i = 1; i < length; i++)
+			value = (value << 8) | field[i];
+
+		return (goffset) MIN (value, G_MAXINT64);
+	}
+
+	for (i = 0; i < length && (field[i] == ' ' || field[i] == '\0'); i++);
+	for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+		value = value * 8 + (field[i] - '0');
+
+	return (goffset) value;
+}
+
+/* Returns the path of a pax extended header, if any */
+static gchar *
+tar_parse_pax_path (const gchar *data,
+		    gsize        length)
+{
+	const gchar *p = data;
+	const gchar *end = data + length;
+
+	while (p < end) {
+		const gchar *record = p;
+		const gchar *key;
+		gchar       *endptr;
+		guint64      record_length;
+
+		record_length = g_ascii_strtoull (p, &endptr, 10);
+		if (endptr == p || *endptr != ' ' ||
+		    record_length == 0 || record_length > (guint64) (end - record))
+			return NULL;
+
+		key = endptr + 1;
+		p = record + record_length;
+
+		if (p - key > 5 && strncmp (key, "path=", 5) == 0 && p[-1] == '\n')
+			return comics_archive_entry_name (key + 5, p - key - 6, "ISO-8859-1");
+	}
+
+	return NULL;
+}
+
+static gboolean
+tar_index (ComicsArchive *archive,
+	   GError       **error)
+{
+	guchar  header[TAR_BLOCK_SIZE];
+	goffset offset = 0;
+	gchar  *long_name = NULL;
+
+	if (archive->size < TAR_BLOCK_SIZE ||
+	    !comics_archive_pread (archive, 0, header, TAR_BLOCK_SIZE, NULL) ||
+	    !tar_header_is_valid (header))
+		return FALSE;
+
+	while (offset <= archive->size - TAR_BLOCK_SIZE) {
+		ComicsArchiveEntry *entry;
+		goffset             size, data_offset;
+		gchar               type;
+
+		if (!comics_archive_pread (archive, offset, header, TAR_BLOCK_SIZE, error))
+			goto error;
+
+		if (tar_header_is_end (header))
+			break;
+
+		if (!tar_header_is_valid (header)) {
+			set_corrupted_error (error);
+			goto error;
+		}
+
+		size = tar_parse_number (header + 124, 12);
+		type = header[156];
+		data_offset = offset + TAR_BLOCK_SIZE;
+
+		if (size < 0 || size > archive->size - data_offset) {
+			set_corrupted_error (error);
+			goto error;
+		}
+
+		switch (type) {
+		case 'L':
+		case 'x': {
+			gchar *data;
+
+			if (size > TAR_MAX_LONG_NAME) {
+				set_corrupted_error (error);
+				goto error;
+			}
+
+			data = g_malloc (size + 1);
+			if (!comics_archive_pread (archive, data_offset, data, size, error)) {
+				g_free (data);
+				goto error;
+			}
+			data[size] = '\0';
+
+			g_free (long_name);
+			if (type == 'L')
+				long_name = comics_archive_entry_name (data, strnlen (data, size), "ISO-8859-1");
+			else
+				long_name = tar_parse_pax_path (data, size);
+			g_free (data);
+		}
+			break;
+		case '0':
+		case '7':
+		case '\0':
+			entry = g_slice_new0 (ComicsArchiveEntry);
+
+			if (long_name) {
+				entry->name = long_name;
+				long_name = NULL;
+			} else {
+				const gchar *name = (const gchar *) header;
+				const gchar *prefix = (const gchar *) header + 345;
+				gchar       *path;
+
+				if (memcmp (header + 257, "ustar", 5) == 0 && prefix[0] != '\0')
+					path = g_strdup_printf ("%.*s/%.*s",
+								(gint) strnlen (prefix, 155), prefix,
+								(gint) strnlen (name, 100), name);
+				else
+					path = g_strndup (name, strnlen (name, 100));
+
+				entry->name = comics_archive_entry_name (path, strlen (path), "ISO-8859-1");
+				g_free (path);
+			}
+
+			entry->offset = data_offset;
+			entry->compressed_size = size;
+			entry->size = size;
+			entry->method = ZIP_METHOD_STORED;
+			entry->readable = TRUE;
+
+			comics_archive_add_entry (archive, entry);
+			break;
+		default:
+			/* Directories, links and other special files */
+			g_free (long_name);
+			long_name = NULL;
+			break;
+		}
+
+		offset = data_offset + ((size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE) * TAR_BLOCK_SIZE;
+	}
+
+	g_free (long_name);
+
+	return TRUE;
+ error:
+	g_free (long_name);
+
+	return FALSE;
+}
+
+static gboolean
+tar_read_entry (ComicsArchive         *archive,
+		ComicsArchiveEntry    *entry,
+		ComicsArchiveReadFunc  func,
+		gpointer               user_data,
+		GError               **error)
+{
+	gboolean stopped = FALSE;
+
+	return comics_archive_copy (archive, entry->offset, entry->size,
+				    func, user_data, NULL, &stopped, error);
+}
+
+static const ComicsArchiveFormat comics_archive_formats[] = {
+	{ "zip", zip_index, zip_read_entry },
+	{ "tar", tar_index, tar_read_entry }
+};
+
+/**
+ * comics_archive_open:
+ * @filename: the archive file
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Opens @filename and indexes its entries, if it's in a format that
+ * can be read in-process.
+ *
+ * Returns: a new #ComicsArchive, or %NULL if the format isn't supported,
+ * in which case @error is not set, or on error.
+ */
+ComicsArchive *
+comics_archive_open (const gchar *filename,
+		     GError     **error)
+{
+	ComicsArchive *archive;
+	struct stat    st;
+	guint          i;
+
+	archive = g_new0 (ComicsArchive, 1);
+	archive->fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+	if (archive->fd < 0 || fstat (archive->fd, &st) < 0) {
+		gint errsv = errno;
+
+		g_set_error (error,
+			     G_IO_ERROR,
+			     g_io_error_from_errno (errsv),
+			     "%s", g_strerror (errsv));
+		comics_archive_free (archive);
+
+		return NULL;
+	}
+	archive->size = st.st_size;
+
+	for (i = 0; i < G_N_ELEMENTS (comics_archive_formats); i++) {
+		const ComicsArchiveFormat *format = &comics_archive_formats[i];
+		GError                    *err = NULL;
+
+		archive->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) comics_archive_entry_free);
+		archive->entries_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+
+		if (format->index (archive, &err)) {
+			archive->format = format;
+
+			return archive;
+		}
+
+		g_ptr_array_free (archive->entries, TRUE);
+		archive->entries = NULL;
+		g_hash_table_destroy (archive->entries_by_name);
+		archive->entries_by_name = NULL;
+
+		if (err) {
+			g_propagate_error (error, err);
+			break;
+		}
+	}
+
+	comics_archive_free (archive);
+
+	return NULL;
+}
+
+void
+comics_archive_free (ComicsArchive *archive)
+{
+	if (!archive)
+		return;
+
+	if (archive->entries_by_name)
+		g_hash_table_destroy (archive->entries_by_name);
+	if (archive->entries)
+		g_ptr_array_free (archive->entries, TRUE);
+	if (archive->fd >= 0)
+		close (archive->fd);
+
+	g_free (archive);
+}
+
+const gchar *
+comics_archive_get_format_name (ComicsArchive *archive)
+{
+	return archive->format->name;
+}
+
+/**
+ * comics_archive_get_entry_names:
+ * @archive: a #ComicsArchive
+ *
+ * Returns: (transfer container): the names of the files in @archive, in
+ * the order they are stored. The names are owned by @archive.
+ */
+GPtrArray *
+comics_archive_get_entry_names (ComicsArchive *archive)
+{
+	GPtrArray *names;
+	guint      i;
+
+	names = g_ptr_array_sized_new (archive->entries->len);
+	for (i = 0; i < archive->entries->len; i++) {
+		ComicsArchiveEntry *entry = g_ptr_array_index (archive->entries, i);
+
+		g_ptr_array_add (names, entry->name);
+	}
+
+	return names;
+}
+
+gboolean
+comics_archive_can_read_entry (ComicsArchive *archive,
+			       const gchar   *name)
+{
+	ComicsArchiveEntry *entry;
+
+	entry = g_hash_table_lookup (archive->entries_by_name, name);
+
+	return entry && entry->readable;
+}
+
+/**
+ * comics_archive_read_entry:
+ * @archive: a #ComicsArchive
+ * @name: the name of an entry in @archive
+ * @func: function called with the uncompressed contents of the entry
+ * @user_data: data to pass to @func
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Streams the contents of the entry @name to @func, until the whole entry
+ * has been read or @func returns %FALSE. This function doesn't change the
+ * state of @archive, so entries can be read from several threads at once.
+ *
+ * Returns: %TRUE on success, or %FALSE on error
+ */
+gboolean
+comics_archive_read_entry (ComicsArchive         *archive,
+			   const gchar           *name,
+			   ComicsArchiveReadFunc  func,
+			   gpointer               user_data,
+			   GError               **error)
+{
+	ComicsArchiveEntry *entry;
+
+	entry = g_hash_table_lookup (archive->entries_by_name, name);
+	if (!entry || !entry->readable) {
+		set_corrupted_error (error);
+		return FALSE;
+	}
+
+	return archive->format->read_entry (archive, entry, func, user_data, error);
+}
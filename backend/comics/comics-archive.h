@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * Copyright (C) 2024 Atril Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __COMICS_ARCHIVE_H__
+#define __COMICS_ARCHIVE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ComicsArchive ComicsArchive;
+
+/* Called with consecutive chunks of an entry's contents,
+ * return FALSE to stop reading the entry.
+ */
+typedef gboolean (* ComicsArchiveReadFunc) (const guchar *data,
+					     gsize         length,
+					     gpointer      user_data);
+
+ComicsArchive *comics_archive_open             (const gchar           *filename,
+						GError               **error);
+void           comics_archive_free             (ComicsArchive         *archive);
+const gchar   *comics_archive_get_format_name  (ComicsArchive         *archive);
+GPtrArray     *comics_archive_get_entry_names  (ComicsArchive         *archive);
+gboolean       comics_archive_can_read_entry   (ComicsArchive         *archive,
+						const gchar           *name);
+gboolean       comics_archive_read_entry       (ComicsArchive         *archive,
+						const gchar           *name,
+						ComicsArchiveReadFunc  func,
+						gpointer               user_data,
+						GError               **error);
+
+G_END_DECLS
+
+#endif /* __COMICS_ARCHIVE_H__ */
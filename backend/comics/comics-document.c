@@ -32,6 +32,7 @@
 
 #include <sys/wait.h>
 
+#include "comics-archive.h"
 #include "comics-document.h"
 #include "ev-document-misc.h"
 #include "ev-document-thumbnails.h"
@@ -61,6 +62,7 @@ struct _ComicsDocument
 	EvDocument parent_instance;
 
 	gchar    *archive, *dir;
+	ComicsArchive *reader;
 	GPtrArray *page_names;
 	gchar    *selected_command, *alternative_command;
 	gchar    *extract_command, *list_command, *decompress_tmp;
@@ -125,6 +127,23 @@ static void       render_pixbuf_size_prepared_cb (GdkPixbufLoader *loader,
 						  gpointer data);
 static char**     extract_argv                   (EvDocument *document,
 						  gint page);
+static gboolean   is_supported_image             (GSList      *supported_extensions,
+						  const gchar *filename);
+
+/* Page sizes are read from the first bytes of the image when its header
+ * is known, otherwise from a GdkPixbufLoader fed with the whole image
+ * until it knows the size.
+ */
+typedef struct {
+	GdkPixbufLoader *loader;
+	GByteArray      *header;
+	gboolean         got_size;
+	gint             width;
+	gint             height;
+} ComicsPageSize;
+
+#define COMICS_PAGE_HEADER_MIN_SIZE 64
+#define COMICS_PAGE_HEADER_MAX_SIZE (1024 * 1024)
 
 EV_BACKEND_REGISTER_WITH_CODE (ComicsDocument, comics_document,
 	{
@@ -509,6 +528,187 @@ sort_page_names (gconstpointer a,
 	return compare;
 }
 
+static gboolean
+is_supported_image (GSList      *supported_extensions,
+		    const gchar *filename)
+{
+	gchar    *suffix;
+	gboolean  retval;
+
+	suffix = g_strrstr (filename, ".");
+	if (!suffix)
+		return FALSE;
+
+	suffix = g_ascii_strdown (suffix + 1, -1);
+	retval = g_slist_find_custom (supported_extensions, suffix,
+				      (GCompareFunc) strcmp) != NULL;
+	g_free (suffix);
+
+	return retval;
+}
+
+static gboolean
+comics_document_load_with_reader (ComicsDocument *comics_document)
+{
+	GSList    *supported_extensions;
+	GPtrArray *names, *page_names;
+	GError    *err = NULL;
+	guint      i;
+
+	comics_document->reader = comics_archive_open (comics_document->archive, &err);
+	if (!comics_document->reader) {
+		if (err) {
+			g_debug ("Can't read comic book archive in-process: %s", err->message);
+			g_error_free (err);
+		}
+
+		return FALSE;
+	}
+
+	page_names = g_ptr_array_new_with_free_func (g_free);
+
+	supported_extensions = get_supported_image_extensions ();
+	names = comics_archive_get_entry_names (comics_document->reader);
+	for (i = 0; i < names->len; i++) {
+		const gchar *name = g_ptr_array_index (names, i);
+
+		if (!is_supported_image (supported_extensions, name))
+			continue;
+
+		if (!comics_archive_can_read_entry (comics_document->reader, name)) {
+			g_debug ("Can't read “%s” from comic book archive in-process", name);
+			g_ptr_array_free (page_names, TRUE);
+			page_names = NULL;
+			break;
+		}
+
+		g_ptr_array_add (page_names, g_strdup (name));
+	}
+	g_ptr_array_free (names, TRUE);
+	g_slist_foreach (supported_extensions, (GFunc) g_free, NULL);
+	g_slist_free (supported_extensions);
+
+	if (!page_names || page_names->len == 0) {
+		if (page_names)
+			g_ptr_array_free (page_names, TRUE);
+		comics_archive_free (comics_document->reader);
+		comics_document->reader = NULL;
+
+		return FALSE;
+	}
+
+	g_ptr_array_set_free_func (page_names, NULL);
+	comics_document->page_names = page_names;
+	g_ptr_array_sort (comics_document->page_names, sort_page_names);
+
+	return TRUE;
+}
+
+static gboolean
+comics_page_load_write (const guchar    *data,
+			gsize            length,
+			GdkPixbufLoader *loader)
+{
+	return gdk_pixbuf_loader_write (loader, data, length, NULL);
+}
+
+static void
+comics_page_size_init (ComicsPageSize *size)
+{
+	size->loader = NULL;
+	size->header = g_byte_array_new ();
+	size->got_size = FALSE;
+	size->width = 0;
+	size->height = 0;
+}
+
+static gboolean
+comics_page_size_feed_loader (ComicsPageSize *size,
+			      const guchar   *data,
+			      gsize           length)
+{
+	if (!size->loader) {
+		size->loader = gdk_pixbuf_loader_new ();
+		g_signal_connect (size->loader, "area-prepared",
+				  G_CALLBACK (get_page_size_area_prepared_cb),
+				  &size->got_size);
+	}
+
+	if (!gdk_pixbuf_loader_write (size->loader, data, length, NULL))
+		return FALSE;
+
+	return !size->got_size;
+}
+
+/* Returns FALSE once the size is known */
+static gboolean
+comics_page_size_write (const guchar   *data,
+			gsize           length,
+			ComicsPageSize *size)
+{
+	GByteArray *header;
+	gboolean    retval;
+
+	if (!size->header)
+		return comics_page_size_feed_loader (size, data, length);
+
+	g_byte_array_append (size->header, data, length);
+	if (ev_document_misc_get_image_size_from_data (size->header->data,
+						       size->header->len,
+						       &size->width,
+						       &size->height)) {
+		size->got_size = TRUE;
+		return FALSE;
+	}
+
+	/* Only JPEG headers can be longer, because of EXIF data */
+	if (size->header->len < COMICS_PAGE_HEADER_MIN_SIZE ||
+	    (size->header->data[0] == 0xff && size->header->len < COMICS_PAGE_HEADER_MAX_SIZE))
+		return TRUE;
+
+	header = size->header;
+	size->header = NULL;
+	retval = comics_page_size_feed_loader (size, header->data, header->len);
+	g_byte_array_free (header, TRUE);
+
+	return retval;
+}
+
+static void
+comics_page_size_finish (ComicsPageSize *size,
+			 double         *width,
+			 double         *height)
+{
+	GByteArray *header = size->header;
+	GdkPixbuf  *pixbuf;
+
+	/* The image ended before its size was found in the header */
+	size->header = NULL;
+	if (header && !size->got_size)
+		comics_page_size_feed_loader (size, header->data, header->len);
+	if (header)
+		g_byte_array_free (header, TRUE);
+
+	if (size->loader) {
+		gdk_pixbuf_loader_close (size->loader, NULL);
+		pixbuf = gdk_pixbuf_loader_get_pixbuf (size->loader);
+		size->got_size = pixbuf != NULL;
+		if (pixbuf) {
+			size->width = gdk_pixbuf_get_width (pixbuf);
+			size->height = gdk_pixbuf_get_height (pixbuf);
+		}
+		g_clear_object (&size->loader);
+	}
+
+	if (!size->got_size)
+		return;
+
+	if (width)
+		*width = size->width;
+	if (height)
+		*height = size->height;
+}
+
 static gboolean
 comics_document_load (EvDocument *document,
 		      const char *uri,
@@ -541,6 +741,13 @@ comics_document_load (EvDocument *document,
 		return FALSE;
 	}
 
+	/* Read ZIP and TAR archives in-process, the external commands are
+	 * only used for other formats or if some page can't be read */
+	if (comics_document_load_with_reader (comics_document)) {
+		g_free (mime_type);
+		return TRUE;
+	}
+
 	if (!comics_check_decompress_command (mime_type, comics_document,
 	error)) {
 		g_free (mime_type);
@@ -595,16 +802,10 @@ comics_document_load (EvDocument *document,
 		} else {
 			cb_file = cb_files[i];
 		}
-		gchar *suffix = g_strrstr (cb_file, ".");
-		if (!suffix)
-			continue;
-		suffix = g_ascii_strdown (suffix + 1, -1);
-		if (g_slist_find_custom (supported_extensions, suffix,
-					 (GCompareFunc) strcmp) != NULL) {
+		if (is_supported_image (supported_extensions, cb_file)) {
                         g_ptr_array_add (comics_document->page_names,
                                          g_strstrip (g_strdup (cb_file)));
 		}
-		g_free (suffix);
 	}
 	g_strfreev (cb_files);
 	g_slist_foreach (supported_extensions, (GFunc) g_free, NULL);
@@ -652,18 +853,26 @@ comics_document_get_page_size (EvDocument *document,
 			       double     *width,
 			       double     *height)
 {
-	GdkPixbufLoader *loader;
 	char **argv;
 	guchar buf[1024];
-	gboolean success, got_size = FALSE;
+	gboolean success;
 	gint outpipe = -1;
 	GPid child_pid;
 	gssize bytes;
 	GdkPixbuf *pixbuf;
 	gchar *filename;
+	gint w, h;
+	ComicsPageSize size;
 	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
 
-	if (!comics_document->decompress_tmp) {
+	if (comics_document->reader) {
+		comics_page_size_init (&size);
+		comics_archive_read_entry (comics_document->reader,
+					   comics_document->page_names->pdata[page->index],
+					   (ComicsArchiveReadFunc) comics_page_size_write,
+					   &size, NULL);
+		comics_page_size_finish (&size, width, height);
+	} else if (!comics_document->decompress_tmp) {
 		argv = extract_argv (document, page->index);
 		success = g_spawn_async_with_pipes (NULL, argv, NULL,
 						    G_SPAWN_SEARCH_PATH |
@@ -674,37 +883,24 @@ comics_document_get_page_size (EvDocument *document,
 		g_strfreev (argv);
 		g_return_if_fail (success == TRUE);
 
-		loader = gdk_pixbuf_loader_new ();
-		g_signal_connect (loader, "area-prepared",
-				  G_CALLBACK (get_page_size_area_prepared_cb),
-				  &got_size);
-
-		while (outpipe >= 0) {
+		comics_page_size_init (&size);
+		do {
 			bytes = read (outpipe, buf, 1024);
+		} while (bytes > 0 && comics_page_size_write (buf, bytes, &size));
+		close (outpipe);
 
-			if (bytes > 0)
-			gdk_pixbuf_loader_write (loader, buf, bytes, NULL);
-			if (bytes <= 0 || got_size) {
-				close (outpipe);
-				outpipe = -1;
-				gdk_pixbuf_loader_close (loader, NULL);
-			}
-		}
-		pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
-		if (pixbuf) {
-			if (width)
-				*width = gdk_pixbuf_get_width (pixbuf);
-			if (height)
-				*height = gdk_pixbuf_get_height (pixbuf);
-		}
+		comics_page_size_finish (&size, width, height);
 		g_spawn_close_pid (child_pid);
-		g_object_unref (loader);
 	} else {
 		filename = g_build_filename (comics_document->dir,
                                              (char *) comics_document->page_names->pdata[page->index],
 					     NULL);
-		pixbuf = gdk_pixbuf_new_from_file (filename, NULL);
-		if (pixbuf) {
+		if (ev_document_misc_get_image_size_from_file (filename, &w, &h)) {
+			if (width)
+				*width = w;
+			if (height)
+				*height = h;
+		} else if ((pixbuf = gdk_pixbuf_new_from_file (filename, NULL))) {
 			if (width)
 				*width = gdk_pixbuf_get_width (pixbuf);
 			if (height)
@@ -739,7 +935,23 @@ comics_document_render_pixbuf (EvDocument      *document,
 	gchar *filename;
 	ComicsDocument *comics_document = COMICS_DOCUMENT (document);
 
-	if (!comics_document->decompress_tmp) {
+	if (comics_document->reader) {
+		loader = gdk_pixbuf_loader_new ();
+		g_signal_connect (loader, "size-prepared",
+				  G_CALLBACK (render_pixbuf_size_prepared_cb),
+				  &rc->scale);
+
+		comics_archive_read_entry (comics_document->reader,
+					   comics_document->page_names->pdata[rc->page->index],
+					   (ComicsArchiveReadFunc) comics_page_load_write,
+					   loader, NULL);
+		gdk_pixbuf_loader_close (loader, NULL);
+
+		tmp_pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+		rotated_pixbuf = tmp_pixbuf ?
+			gdk_pixbuf_rotate_simple (tmp_pixbuf, 360 - rc->rotation) : NULL;
+		g_object_unref (loader);
+	} else if (!comics_document->decompress_tmp) {
 		argv = extract_argv (document, rc->page->index);
 		success = g_spawn_async_with_pipes (NULL, argv, NULL,
 						    G_SPAWN_SEARCH_PATH |
@@ -802,6 +1014,9 @@ comics_document_render (EvDocument      *document,
 	cairo_surface_t *surface;
 
 	pixbuf = comics_document_render_pixbuf (document, rc);
+	if (!pixbuf)
+		return NULL;
+
 	surface = ev_document_misc_surface_from_pixbuf (pixbuf);
 	g_object_unref (pixbuf);
 
@@ -865,6 +1080,8 @@ comics_document_finalize (GObject *object)
 		g_free (comics_document->dir);
 	}
 
+	comics_archive_free (comics_document->reader);
+
 	if (comics_document->page_names) {
                 g_ptr_array_foreach (comics_document->page_names, (GFunc) g_free, NULL);
                 g_ptr_array_free (comics_document->page_names, TRUE);
@@ -892,6 +1109,8 @@ comics_document_class_init (ComicsDocumentClass *klass)
 	ev_document_class->get_n_pages = comics_document_get_n_pages;
 	ev_document_class->get_page_size = comics_document_get_page_size;
 	ev_document_class->render = comics_document_render;
+	ev_document_class->concurrency = EV_DOCUMENT_CONCURRENCY_DOCUMENTS |
+					 EV_DOCUMENT_CONCURRENCY_FONTCONFIG;
 }
 
 static void
@@ -934,6 +1153,8 @@ comics_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document,
 	GdkPixbuf *thumbnail;
 
 	thumbnail = comics_document_render_pixbuf (EV_DOCUMENT (document), rc);
+	if (!thumbnail)
+		return NULL;
 
 	if (border) {
 	      GdkPixbuf *tmp_pixbuf = thumbnail;
@@ -35,6 +35,9 @@ struct _DjvuDocument {
 
 	gchar            *uri;
 
+	/* Recently decoded pages, most recently used first */
+	GQueue           *pages;
+
         /* PS exporter */
         gchar		 *ps_filename;
         GString 	 *opts;
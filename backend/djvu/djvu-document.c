@@ -39,6 +39,26 @@
 
 #define SCALE_FACTOR 0.2
 
+/* Number of decoded pages kept alive between renders: enough for the
+ * pages in view in dual mode, the MAX_PRELOADED_PAGES the view renders
+ * on each side of them, the pages decoded ahead and the one being
+ * rendered. DJVU_DECODE_CACHE_SIZE is the size in bytes of the ddjvu
+ * context cache holding their decoded chunks.
+ */
+#define DJVU_VISIBLE_PAGES 2
+#define DJVU_PRELOADED_PAGES 3
+#define DJVU_DECODE_AHEAD_PAGES 2
+#define DJVU_PAGE_CACHE_SIZE (DJVU_VISIBLE_PAGES + 2 * DJVU_PRELOADED_PAGES + \
+			      DJVU_DECODE_AHEAD_PAGES + 1)
+#define DJVU_DECODE_CACHE_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+	gint          index;
+	ddjvu_page_t *d_page;
+	/* Rendered at least once, rather than only decoded ahead */
+	gboolean      requested;
+} DjvuCachedPage;
+
 enum {
 	PROP_0,
 	PROP_TITLE
@@ -308,6 +328,118 @@ djvu_document_get_page_size (EvDocument   *document,
 				width, height);
 }
 
+static void
+djvu_cached_page_free (DjvuCachedPage *cached)
+{
+	ddjvu_page_release (cached->d_page);
+	g_slice_free (DjvuCachedPage, cached);
+}
+
+static DjvuCachedPage *
+djvu_document_find_cached_page (DjvuDocument *djvu_document,
+				gint          index)
+{
+	GList *l;
+
+	for (l = djvu_document->pages->head; l; l = g_list_next (l)) {
+		DjvuCachedPage *cached = (DjvuCachedPage *)l->data;
+
+		if (cached->index == index)
+			return cached;
+	}
+
+	return NULL;
+}
+
+/* Returns the ddjvu page for index, reusing a recently decoded one when
+ * possible, and blocks until it is decoded. The page is owned by the
+ * document and becomes the most recently used one.
+ */
+static ddjvu_page_t *
+djvu_document_get_page (DjvuDocument *djvu_document,
+			gint          index)
+{
+	DjvuCachedPage *cached;
+
+	cached = djvu_document_find_cached_page (djvu_document, index);
+	if (cached) {
+		g_queue_remove (djvu_document->pages, cached);
+	} else {
+		cached = g_slice_new (DjvuCachedPage);
+		cached->index = index;
+		cached->d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, index);
+
+		while (g_queue_get_length (djvu_document->pages) >= DJVU_PAGE_CACHE_SIZE)
+			djvu_cached_page_free (g_queue_pop_tail (djvu_document->pages));
+	}
+
+	cached->requested = TRUE;
+	g_queue_push_head (djvu_document->pages, cached);
+
+	while (!ddjvu_page_decoding_done (cached->d_page))
+		djvu_handle_events (djvu_document, TRUE, NULL);
+
+	return cached->d_page;
+}
+
+/* Starts decoding the DJVU_DECODE_AHEAD_PAGES pages past index in the
+ * ddjvu threads, so that they are ready when they are rendered. The
+ * view renders the pages in view and then the ones around them in
+ * either order, so the direction isn't that of the last two requests:
+ * pages are decoded ahead only when index extends the range of the
+ * pages rendered so far, past the end it extends.
+ */
+static void
+djvu_document_decode_ahead (DjvuDocument *djvu_document,
+			    gint          index)
+{
+	gint   n_pages = ddjvu_document_get_pagenum (djvu_document->d_document);
+	gint   first = G_MAXINT, last = -1;
+	gint   step, i;
+	GList *l;
+
+	/* The head is the page being rendered */
+	for (l = djvu_document->pages->head->next; l; l = g_list_next (l)) {
+		DjvuCachedPage *cached = (DjvuCachedPage *)l->data;
+
+		if (!cached->requested)
+			continue;
+
+		first = MIN (first, cached->index);
+		last = MAX (last, cached->index);
+	}
+
+	if (index > last)
+		step = 1;
+	else if (index < first)
+		step = -1;
+	else
+		return;
+
+	for (i = 1; i <= DJVU_DECODE_AHEAD_PAGES; i++) {
+		gint            next = index + i * step;
+		DjvuCachedPage *cached;
+
+		if (next < 0 || next >= n_pages)
+			break;
+
+		if (djvu_document_find_cached_page (djvu_document, next))
+			continue;
+
+		/* Never evict the page being rendered, it stays the most
+		 * recently used one */
+		while (g_queue_get_length (djvu_document->pages) >= DJVU_PAGE_CACHE_SIZE)
+			djvu_cached_page_free (g_queue_pop_tail (djvu_document->pages));
+
+		cached = g_slice_new (DjvuCachedPage);
+		cached->index = next;
+		cached->d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, next);
+		cached->requested = FALSE;
+		g_queue_insert_after (djvu_document->pages,
+				      djvu_document->pages->head, cached);
+	}
+}
+
 static cairo_surface_t *
 djvu_document_render (EvDocument      *document,
 		      EvRenderContext *rc)
@@ -321,11 +453,10 @@ djvu_document_render (EvDocument      *document,
 	ddjvu_page_t *d_page;
 	ddjvu_page_rotation_t rotation;
 	double page_width, page_height, tmp;
+	cairo_rectangle_int_t clip;
 
-	d_page = ddjvu_page_create_by_pageno (djvu_document->d_document, rc->page->index);
-
-	while (!ddjvu_page_decoding_done (d_page))
-		djvu_handle_events(djvu_document, TRUE, NULL);
+	d_page = djvu_document_get_page (djvu_document, rc->page->index);
+	djvu_document_decode_ahead (djvu_document, rc->page->index);
 
 	page_width = ddjvu_page_get_width (d_page) * rc->scale * SCALE_FACTOR + 0.5;
 	page_height = ddjvu_page_get_height (d_page) * rc->scale * SCALE_FACTOR + 0.5;
@@ -353,17 +484,24 @@ djvu_document_render (EvDocument      *document,
 			rotation = DDJVU_ROTATE_0;
 	}
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-					      page_width, page_height);
-	rowstride = cairo_image_surface_get_stride (surface);
-	pixels = (gchar *)cairo_image_surface_get_data (surface);
-
 	prect.x = 0;
 	prect.y = 0;
 	prect.w = page_width;
 	prect.h = page_height;
 	rrect = prect;
 
+	if (ev_render_context_get_clip (rc, &clip)) {
+		rrect.x = clip.x;
+		rrect.y = clip.y;
+		rrect.w = clip.width;
+		rrect.h = clip.height;
+	}
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					      rrect.w, rrect.h);
+	rowstride = cairo_image_surface_get_stride (surface);
+	pixels = (gchar *)cairo_image_surface_get_data (surface);
+
 	ddjvu_page_set_rotation (d_page, rotation);
 
 	ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
@@ -383,6 +521,8 @@ djvu_document_finalize (GObject *object)
 {
 	DjvuDocument *djvu_document = DJVU_DOCUMENT (object);
 
+	g_queue_free_full (djvu_document->pages, (GDestroyNotify)djvu_cached_page_free);
+
 	if (djvu_document->d_document)
 	    ddjvu_document_release (djvu_document->d_document);
 
@@ -413,6 +553,9 @@ djvu_document_class_init (DjvuDocumentClass *klass)
 	ev_document_class->get_n_pages = djvu_document_get_n_pages;
 	ev_document_class->get_page_size = djvu_document_get_page_size;
 	ev_document_class->render = djvu_document_render;
+	ev_document_class->concurrency = EV_DOCUMENT_CONCURRENCY_DOCUMENTS |
+					 EV_DOCUMENT_CONCURRENCY_FONTCONFIG;
+	ev_document_class->render_clip = TRUE;
 }
 
 static gchar *
@@ -502,6 +645,7 @@ djvu_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document,
 	gdouble page_width, page_height;
 	gint thumb_width, thumb_height;
 	guchar *pixels;
+	DjvuCachedPage *cached;
 
 	g_return_val_if_fail (djvu_document->d_document, NULL);
 
@@ -516,14 +660,29 @@ djvu_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document,
 	gdk_pixbuf_fill (pixbuf, 0xffffffff);
 	pixels = gdk_pixbuf_get_pixels (pixbuf);
 
-	while (ddjvu_thumbnail_status (djvu_document->d_document, rc->page->index, 1) < DDJVU_JOB_OK)
-		djvu_handle_events(djvu_document, TRUE, NULL);
-
-	ddjvu_thumbnail_render (djvu_document->d_document, rc->page->index,
-				&thumb_width, &thumb_height,
-				djvu_document->thumbs_format,
-				gdk_pixbuf_get_rowstride (pixbuf),
-				(gchar *)pixels);
+	/* A page decoded for rendering is scaled down rather than decoded
+	 * again for the thumbnail. Thumbnails don't add pages to the cache,
+	 * the sidebar would push out the pages in view. */
+	cached = djvu_document_find_cached_page (djvu_document, rc->page->index);
+	if (cached && ddjvu_page_decoding_status (cached->d_page) == DDJVU_JOB_OK) {
+		ddjvu_rect_t rect = { 0, 0, thumb_width, thumb_height };
+
+		ddjvu_page_set_rotation (cached->d_page, DDJVU_ROTATE_0);
+		ddjvu_page_render (cached->d_page, DDJVU_RENDER_COLOR,
+				   &rect, &rect,
+				   djvu_document->thumbs_format,
+				   gdk_pixbuf_get_rowstride (pixbuf),
+				   (gchar *)pixels);
+	} else {
+		while (ddjvu_thumbnail_status (djvu_document->d_document, rc->page->index, 1) < DDJVU_JOB_OK)
+			djvu_handle_events(djvu_document, TRUE, NULL);
+
+		ddjvu_thumbnail_render (djvu_document->d_document, rc->page->index,
+					&thumb_width, &thumb_height,
+					djvu_document->thumbs_format,
+					gdk_pixbuf_get_rowstride (pixbuf),
+					(gchar *)pixels);
+	}
 
 	rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf, 360 - rc->rotation);
 	g_object_unref (pixbuf);
@@ -617,6 +776,7 @@ djvu_document_init (DjvuDocument *djvu_document)
 	guint masks[4] = { 0xff0000, 0xff00, 0xff, 0xff000000 };
 
 	djvu_document->d_context = ddjvu_context_create ("Atril");
+	ddjvu_cache_set_size (djvu_document->d_context, DJVU_DECODE_CACHE_SIZE);
 	djvu_document->d_format = ddjvu_format_create (DDJVU_FORMAT_RGBMASK32, 4, masks);
 	ddjvu_format_set_row_order (djvu_document->d_format, 1);
 
@@ -627,6 +787,8 @@ djvu_document_init (DjvuDocument *djvu_document)
 	djvu_document->opts = g_string_new ("");
 
 	djvu_document->d_document = NULL;
+
+	djvu_document->pages = g_queue_new ();
 }
 
 static GList *
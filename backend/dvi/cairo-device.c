@@ -233,7 +233,16 @@ dvi_cairo_create_image (void *device_data,
 			Uint  height,
 			Uint  bpp)
 {
-	return cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	cairo_surface_t *surface;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+
+	/* The glyph is written directly to the surface data until
+	 * dvi_cairo_image_done() marks it dirty, so flush only once here.
+	 */
+	cairo_surface_flush (surface);
+
+	return surface;
 }
 
 static void
@@ -254,11 +263,28 @@ dvi_cairo_put_pixel (void *image, int x, int y, Ulong color)
 	rowstride = cairo_image_surface_get_stride (surface);
 	p = (guint32*) (cairo_image_surface_get_data (surface) + y * rowstride + x * 4);
 
-        /* per cairo docs, must flush before modifying outside of cairo */
-        cairo_surface_flush(surface);
 	*p = color;
 }
 
+static void
+dvi_cairo_put_pixels (void        *image,
+		      int          x,
+		      int          y,
+		      int          count,
+		      const Ulong *colors)
+{
+	cairo_surface_t *surface;
+	guint32         *p;
+	int              i;
+
+	surface = (cairo_surface_t *) image;
+
+	p = (guint32*) (cairo_image_surface_get_data (surface) +
+			y * cairo_image_surface_get_stride (surface) + x * 4);
+	for (i = 0; i < count; i++)
+		p[i] = colors[i];
+}
+
 static void
 dvi_cairo_image_done (void *ptr)
 {
@@ -286,6 +312,7 @@ mdvi_cairo_device_init (DviDevice *device)
 	device->create_image = dvi_cairo_create_image;
 	device->free_image = dvi_cairo_free_image;
 	device->put_pixel = dvi_cairo_put_pixel;
+	device->put_pixels = dvi_cairo_put_pixels;
         device->image_done = dvi_cairo_image_done;
 	device->set_color = dvi_cairo_set_color;
 #ifdef HAVE_SPECTRE
@@ -916,6 +916,18 @@ void	mdvi_shrink_glyph(DviContext *dvi, DviFont *font,
 		bitmap_print(stderr, newmap);
 }
 
+static void put_glyph_row(DviDevice *dev, void *image, int y, int w, Ulong *row)
+{
+	int	x;
+
+	if(dev->put_pixels) {
+		dev->put_pixels(image, 0, y, w, row);
+		return;
+	}
+	for(x = 0; x < w; x++)
+		dev->put_pixel(image, x, y, row[x]);
+}
+
 void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	DviFontChar *pk, DviGlyph *dest)
 {
@@ -931,6 +943,7 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	Ulong	*pixels;
 	int	npixels;
 	Ulong	colortab[2];
+	Ulong	*row;
 	int	hs, vs;
 	DviDevice *dev;
 
@@ -988,6 +1001,9 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 	dest->w = w;
 	dest->h = h;
 
+	/* each row is sampled into `row' and handed to the device at once */
+	row = xnalloc(Ulong, w);
+
 	y = 0;
 	old_ptr = map->data;
 	rows_left = glyph->h;
@@ -1007,24 +1023,26 @@ void	mdvi_shrink_glyph_grey(DviContext *dvi, DviFont *font,
 			if(npixels - 1 != samplemax)
 				sampleval = ((npixels-1) * sampleval) / samplemax;
 			ASSERT(sampleval < npixels);
-			dev->put_pixel(image, x, y, pixels[sampleval]);
+			row[x] = pixels[sampleval];
 			cols_left -= cols;
 			cols = hs;
 			x++;
 		}
 		for(; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
+			row[x] = pixels[0];
+		put_glyph_row(dev, image, y, w, row);
 		old_ptr = bm_offset(old_ptr, rows * map->stride);
 		rows_left -= rows;
 		rows = vs;
 		y++;
 	}
 
-	for(; y < h; y++) {
-		for(x = 0; x < w; x++)
-			dev->put_pixel(image, x, y, pixels[0]);
-	}
+	for(x = 0; x < w; x++)
+		row[x] = pixels[0];
+	for(; y < h; y++)
+		put_glyph_row(dev, image, y, w, row);
 
+	mdvi_free(row);
         dev->image_done(image);
 	DEBUG((DBG_BITMAPS, "shrink_glyph_grey: (%dw,%dh,%dx,%dy) -> (%dw,%dh,%dx,%dy)\n",
 		glyph->w, glyph->h, glyph->x, glyph->y,
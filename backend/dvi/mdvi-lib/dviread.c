@@ -557,17 +557,15 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 		case MDVI_SET_YDPI:
 			np.vdpi = va_arg(ap, Uint);
 			break;
+		/* grey glyphs are cached per shrink factor, see font.c */
 		case MDVI_SET_SHRINK:
 			np.hshrink = np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_XSHRINK:
 			np.hshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_YSHRINK:
 			np.vshrink = va_arg(ap, Uint);
-			reset_font = MDVI_FONTSEL_GREY|MDVI_FONTSEL_BITMAP;
 			break;
 		case MDVI_SET_ORIENTATION:
 			np.orientation = va_arg(ap, DviOrientation);
@@ -633,11 +631,13 @@ int mdvi_configure(DviContext *dvi, DviParamCode option, ...)
 		np.conv = dvi->dviconv;
 		if(np.hshrink)
 			np.conv /= np.hshrink;
+		reset_font |= MDVI_FONTSEL_BITMAP;
 	}
 	if(np.vshrink != dvi->params.vshrink) {
 		np.vconv = dvi->dvivconv;
 		if(np.vshrink)
 			np.vconv /= np.vshrink;
+		reset_font |= MDVI_FONTSEL_BITMAP;
 	}
 
 	if(reset_font) {
@@ -886,6 +886,7 @@ DviContext *mdvi_init_context(DviParams *par, DviPageSpec *spec, const char *fil
 	dvi->device.free_image   = dummy_free_image;
 	dvi->device.dev_destroy  = dummy_dev_destroy;
 	dvi->device.put_pixel    = dummy_dev_putpixel;
+	dvi->device.put_pixels   = NULL;
 	dvi->device.refresh      = dummy_dev_refresh;
 	dvi->device.set_color    = dummy_dev_set_color;
 	dvi->device.device_data  = NULL;
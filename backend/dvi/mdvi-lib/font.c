@@ -18,6 +18,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mdvi.h"
 #include "private.h"
@@ -343,6 +344,82 @@ static int load_one_glyph(DviContext *dvi, DviFont *font, int code)
 	return 0;
 }
 
+/*
+ * The grey glyph cache of a character holds the anti-aliased glyphs
+ * for the last MDVI_GREY_CACHE_SIZE combinations of shrink factors and
+ * colors, most recently used first. `ch->grey' always points to one of
+ * them.
+ */
+static int grey_cache_lookup(DviContext *dvi, DviFontChar *ch)
+{
+	DviGreyGlyph *cache = ch->grey_cache;
+	DviGreyGlyph entry;
+	int	i;
+
+	if(cache == NULL)
+		return 0;
+	for(i = 0; i < MDVI_GREY_CACHE_SIZE; i++) {
+		if(cache[i].glyph.data == NULL)
+			return 0;
+		if(cache[i].hshrink == dvi->params.hshrink &&
+		   cache[i].vshrink == dvi->params.vshrink &&
+		   cache[i].fg == dvi->curr_fg &&
+		   cache[i].bg == dvi->curr_bg)
+			break;
+	}
+	if(i == MDVI_GREY_CACHE_SIZE)
+		return 0;
+
+	/* move it to the front */
+	entry = cache[i];
+	memmove(&cache[1], &cache[0], i * sizeof(DviGreyGlyph));
+	cache[0] = entry;
+
+	ch->grey = entry.glyph;
+	ch->fg = entry.fg;
+	ch->bg = entry.bg;
+	return 1;
+}
+
+static void grey_cache_insert(DviContext *dvi, DviFontChar *ch)
+{
+	DviGreyGlyph *cache;
+	DviGreyGlyph *last;
+
+	if(!MDVI_GLYPH_NONEMPTY(ch->grey.data))
+		return;
+	if(ch->grey_cache == NULL)
+		ch->grey_cache = xnalloc(DviGreyGlyph, MDVI_GREY_CACHE_SIZE);
+	cache = ch->grey_cache;
+
+	/* drop the least recently used glyph */
+	last = &cache[MDVI_GREY_CACHE_SIZE - 1];
+	if(last->glyph.data && dvi->device.free_image)
+		dvi->device.free_image(last->glyph.data);
+	memmove(&cache[1], &cache[0],
+		(MDVI_GREY_CACHE_SIZE - 1) * sizeof(DviGreyGlyph));
+
+	cache[0].hshrink = dvi->params.hshrink;
+	cache[0].vshrink = dvi->params.vshrink;
+	cache[0].fg = ch->fg;
+	cache[0].bg = ch->bg;
+	cache[0].glyph = ch->grey;
+}
+
+static void grey_cache_clear(DviDevice *dev, DviFontChar *ch)
+{
+	int	i;
+
+	if(ch->grey_cache == NULL)
+		return;
+	for(i = 0; i < MDVI_GREY_CACHE_SIZE; i++) {
+		if(ch->grey_cache[i].glyph.data && dev->free_image)
+			dev->free_image(ch->grey_cache[i].glyph.data);
+	}
+	mdvi_free(ch->grey_cache);
+	ch->grey_cache = NULL;
+}
+
 DviFontChar *font_get_glyph(DviContext *dvi, DviFont *font, int code)
 {
 	DviFontChar *ch;
@@ -368,9 +445,13 @@ again:
 
 	/* Got the glyph. If we also have the right scaled glyph, do no more */
 	if(!ch->width || !ch->height ||
-	   font->finfo->getglyph == NULL ||
-	   (dvi->params.hshrink == 1 && dvi->params.vshrink == 1))
+	   font->finfo->getglyph == NULL)
+		return ch;
+	if(dvi->params.hshrink == 1 && dvi->params.vshrink == 1) {
+		/* don't leave a glyph of another shrink factor around */
+		ch->grey.data = NULL;
 		return ch;
+	}
 
 	/* If the glyph is empty, we just need to shrink the box */
 	if(ch->missing || MDVI_GLYPH_ISEMPTY(ch->glyph.data)) {
@@ -378,18 +459,11 @@ again:
 			mdvi_shrink_box(dvi, font, ch, &ch->shrunk);
 		return ch;
 	} else if(MDVI_ENABLED(dvi, MDVI_PARAM_ANTIALIASED)) {
-		if(ch->grey.data &&
-		   !MDVI_GLYPH_ISEMPTY(ch->grey.data) &&
-		   ch->fg == dvi->curr_fg &&
-		   ch->bg == dvi->curr_bg)
+		if(grey_cache_lookup(dvi, ch))
 		   	return ch;
-		if(ch->grey.data &&
-		   !MDVI_GLYPH_ISEMPTY(ch->grey.data)) {
-			if(dvi->device.free_image)
-				dvi->device.free_image(ch->grey.data);
-			ch->grey.data = NULL;
-		}
+		ch->grey.data = NULL;
 		font->finfo->shrink1(dvi, font, ch, &ch->grey);
+		grey_cache_insert(dvi, ch);
 	} else if(!ch->shrunk.data)
 		font->finfo->shrink0(dvi, font, ch, &ch->shrunk);
 
@@ -406,10 +480,7 @@ void	font_reset_one_glyph(DviDevice *dev, DviFontChar *ch, int what)
 		ch->shrunk.data = NULL;
 	}
 	if(what & MDVI_FONTSEL_GREY) {
-		if(MDVI_GLYPH_NONEMPTY(ch->grey.data)) {
-			if(dev->free_image)
-				dev->free_image(ch->grey.data);
-		}
+		grey_cache_clear(dev, ch);
 		ch->grey.data = NULL;
 	}
 	if(what & MDVI_FONTSEL_GLYPH) {
@@ -338,6 +338,7 @@ static int gf_load_font(DviParams *unused, DviFont *font)
 		ch->glyph.data = NULL;
 		ch->shrunk.data = NULL;
 		ch->grey.data = NULL;
+		ch->grey_cache = NULL;
 		ch->flags = 0;
 		ch->loaded = 0;
 	}
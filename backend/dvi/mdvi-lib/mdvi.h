@@ -99,6 +99,8 @@ typedef void *(*DviCreateImage)	__PROTO((void *device_data,
 				         Uint bpp));
 typedef void (*DviFreeImage)	__PROTO((void *image));
 typedef void (*DviPutPixel)	__PROTO((void *image, int x, int y, Ulong color));
+typedef void (*DviPutPixels)	__PROTO((void *image, int x, int y,
+					 int count, const Ulong *colors));
 typedef void (*DviImageDone)    __PROTO((void *image));
 typedef void (*DviDevDestroy)   __PROTO((void *data));
 typedef void (*DviRefresh)      __PROTO((DviContext *dvi, void *device_data));
@@ -115,6 +117,7 @@ struct _DviDevice {
 	DviCreateImage	create_image;
 	DviFreeImage	free_image;
 	DviPutPixel	put_pixel;
+	DviPutPixels	put_pixels;	/* optional, a whole row at once */
         DviImageDone    image_done;
 	DviDevDestroy	dev_destroy;
 	DviRefresh	refresh;
@@ -155,6 +158,21 @@ struct _DviGlyph {
 	void	*data;	/* bitmap or XImage */
 };
 
+/*
+ * Anti-aliased glyphs are kept for the last few shrink factors and
+ * colors they were drawn with, so that switching between zoom levels
+ * (or between the view and its thumbnails) doesn't resample them.
+ */
+#define MDVI_GREY_CACHE_SIZE	4
+
+typedef struct {
+	Uint	hshrink;
+	Uint	vshrink;
+	Ulong	fg;
+	Ulong	bg;
+	DviGlyph glyph;
+} DviGreyGlyph;
+
 typedef void (*DviFontShrinkFunc)
 	__PROTO((DviContext *, DviFont *, DviFontChar *, DviGlyph *));
 typedef int (*DviFontLoadFunc) __PROTO((DviParams *, DviFont *));
@@ -200,7 +218,8 @@ struct _DviFontChar {
 	/* data for shrunk bitimaps */
 	DviGlyph glyph;
 	DviGlyph shrunk;
-	DviGlyph grey;
+	DviGlyph grey;		/* one of grey_cache, not owned */
+	DviGreyGlyph *grey_cache;
 };
 
 struct _DviFontRef {
@@ -131,6 +131,7 @@ int	get_tfm_chars(DviParams *params, DviFont *font, TFMInfo *info, int loaded)
 		ch->code        = n;
 		ch->glyph.data  = NULL;
 		ch->grey.data   = NULL;
+		ch->grey_cache  = NULL;
 		ch->shrunk.data = NULL;
 		ch->loaded      = loaded;
 	}
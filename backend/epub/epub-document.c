@@ -37,6 +37,7 @@
 #include <glib/gstdio.h>
 
 #include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
 
 /*For strcasestr(),strstr()*/
 #include <string.h>
@@ -72,20 +73,53 @@ struct _EpubDocument
     EvDocument parent_instance;
     /*Stores the path to the source archive*/
     gchar* archivename ;
-    /*Stores the path of the directory where we unzipped the epub*/
-    gchar* tmp_archive_dir ;
+    /*Identifies the document in the URIs its entries are served at*/
+    gchar* id ;
+    /*EPUB_URI_SCHEME "://" id, the base of those URIs*/
+    gchar* uri_base ;
     /*Stores the contentlist in a sorted manner*/
     GList* contentList ;
-    /* A variable to hold our epubDocument for unzipping*/
+    /* The archive, kept open to read the entries on demand*/
     unzFile epubDocument ;
-    /*The (sub)directory that actually houses the document*/
+    /*Serializes the reads of the archive, from the views and the find jobs*/
+    GMutex archive_lock ;
+    /*Path in the archive -> unz64_file_pos of the entry*/
+    GHashTable *entries ;
+    /*The path of the package document in the archive*/
+    gchar* contentpath ;
+    /*The (sub)directory of the archive that actually houses the document*/
     gchar* documentdir;
+    /*Paths of the content documents, and of those needing MathJax*/
+    GHashTable *content_pages ;
+    GHashTable *mathml_pages ;
+    /*Whether the content documents get our night stylesheet, and use it*/
+    gboolean add_night_sheet ;
+    gboolean night_mode ;
     /*Stores the table of contents*/
     GList *index;
     /*Document title, for the sidebar links*/
     gchar *docTitle;
 };
 
+/* The entries of the archives are served to WebKit under this scheme,
+ * as EPUB_URI_SCHEME://<document id>/<path in the archive>, so that
+ * nothing needs to be extracted at load time */
+#define EPUB_URI_SCHEME "epub"
+
+#define EPUB_NIGHT_SHEET "atrilnightstyle.css"
+#define EPUB_MATHJAX_URI "file:///usr/share/javascript/mathjax/MathJax.js?config=TeX-AMS-MML_SVG"
+
+/* Document id -> GWeakRef to the EpubDocument */
+G_LOCK_DEFINE_STATIC (epub_documents);
+static GHashTable *epub_documents = NULL;
+static guint       epub_documents_last_id = 0;
+
+static gchar *epub_document_uri_to_path (EpubDocument *epub_document,
+                                         const gchar  *uri);
+static gchar *epub_document_read_entry  (EpubDocument *epub_document,
+                                         const gchar  *path,
+                                         gsize        *length);
+
 static void       epub_document_document_thumbnails_iface_init (EvDocumentThumbnailsInterface *iface);
 static void       epub_document_document_find_iface_init       (EvDocumentFindInterface       *iface);
 static void       epub_document_document_links_iface_init      (EvDocumentLinksInterface      *iface);
@@ -179,8 +213,20 @@ epub_document_check_hits(EvDocumentFind *document_find,
                          const gchar    *text,
                          gboolean        case_sensitive)
 {
-    gchar *filepath = g_filename_from_uri((gchar*)page->backend_page,NULL,NULL);
-    htmlDocPtr htmldoc =  xmlParseFile(filepath);
+    EpubDocument *epub_document = EPUB_DOCUMENT (document_find);
+    gchar *filepath = epub_document_uri_to_path (epub_document, (gchar*)page->backend_page);
+    gchar *data = NULL;
+    gsize length = 0;
+
+    if (filepath != NULL)
+        data = epub_document_read_entry (epub_document, filepath, &length);
+    if (data == NULL) {
+        g_free(filepath);
+        return 0;
+    }
+
+    htmlDocPtr htmldoc = xmlReadMemory (data, length, filepath, NULL, 0);
+    g_free (data);
     if (htmldoc == NULL) {
         g_free(filepath);
         return 0;
@@ -379,45 +425,13 @@ epub_document_get_n_pages (EvDocument *document)
     return g_list_length(epub_document->contentList);
 }
 
-/**
- * epub_remove_temporary_dir : Removes a directory recursively.
- * This function is same as comics_remove_temporary_dir
- * Returns:
- * 0 if it was successfully deleted,
- * -1 if an error occurred
- */
-static int
-epub_remove_temporary_dir (gchar *path_name)
-{
-    GDir  *content_dir;
-    const gchar *filename;
-    gchar *filename_with_path;
-
-    if (g_file_test (path_name, G_FILE_TEST_IS_DIR)) {
-        content_dir = g_dir_open  (path_name, 0, NULL);
-        filename  = g_dir_read_name (content_dir);
-        while (filename) {
-            filename_with_path =
-                g_build_filename (path_name,
-                                  filename, NULL);
-            epub_remove_temporary_dir (filename_with_path);
-            g_free (filename_with_path);
-            filename = g_dir_read_name (content_dir);
-        }
-        g_dir_close (content_dir);
-    }
-    /* Note from g_remove() documentation: on Windows, it is in general not
-     * possible to remove a file that is open to some process, or mapped
-     * into memory.*/
-    return (g_remove (path_name));
-}
-
 static gboolean
 check_mime_type             (const gchar* uri,
                              GError** error);
 
 static gboolean
-open_xml_document           (const gchar* filename);
+open_xml_document           (EpubDocument *epub_document,
+                             const gchar* path);
 
 static gboolean
 set_xml_root_node           (xmlChar* rootname);
@@ -432,6 +446,12 @@ xml_parse_children_of_node  (xmlNodePtr parent,
                              xmlChar* attributename,
                              xmlChar* attributevalue);
 
+static xmlNodePtr
+xml_find_child_node         (xmlNodePtr parent,
+                             xmlChar* parserfor,
+                             xmlChar* attributename,
+                             xmlChar* attributevalue);
+
 static gboolean
 xml_check_attribute_value   (xmlNode* node,
                              xmlChar * attributename,
@@ -455,12 +475,24 @@ static xmlNodePtr   xmlretval ;
 
 /*
 **Functions to parse the xml files.
-**Open a XML document for reading
+**Open a XML document of the archive for reading
 */
 static gboolean
-open_xml_document ( const gchar* filename )
+open_xml_document ( EpubDocument *epub_document, const gchar* path )
 {
-    xmldocument = xmlParseFile(filename);
+    gchar *data;
+    gsize length;
+
+    xmldocument = NULL;
+
+    data = epub_document_read_entry (epub_document, path, &length);
+    if ( data == NULL )
+    {
+        return FALSE ;
+    }
+
+    xmldocument = xmlReadMemory (data, length, path, NULL, 0);
+    g_free (data);
 
     if ( xmldocument == NULL )
     {
@@ -579,6 +611,38 @@ xml_parse_children_of_node(xmlNodePtr parent,
     }
 }
 
+/*
+ * Same search as xml_parse_children_of_node(), returning the node rather
+ * than setting the globals, for the content documents transformed while
+ * they are served, on the main thread, while a load or get_info may be
+ * using the globals on a job thread.
+ */
+static xmlNodePtr
+xml_find_child_node(xmlNodePtr parent,
+                    xmlChar* parserfor,
+                    xmlChar* attributename,
+                    xmlChar* attributevalue)
+{
+    xmlNodePtr child, found;
+
+    for ( child = parent->xmlChildrenNode ; child != NULL ; child = child->next )
+    {
+        if ( !xmlStrcmp(child->name,parserfor) )
+        {
+            if ( xml_check_attribute_value(child,attributename,attributevalue) == TRUE )
+                return child ;
+
+            /*No need to parse children node*/
+            continue ;
+        }
+
+        if ( ( found = xml_find_child_node(child,parserfor,attributename,attributevalue) ) != NULL )
+            return found ;
+    }
+
+    return NULL ;
+}
+
 static void
 xml_free_doc()
 {
@@ -670,91 +734,383 @@ check_mime_type(const gchar* uri,GError** error)
     return FALSE;
 }
 
-static gboolean
-extract_one_file(EpubDocument* epub_document,GError ** error)
+/* Resolves the "." and ".." segments of a path in the archive */
+static gchar*
+epub_document_normalize_path(const gchar *path)
 {
-    GFile * outfile ;
-    gsize writesize = 0;
-    GString * gfilepath ;
-    unz_file_info64 info ;
-    gchar* directory;
-    GString* dir_create;
-    GFileOutputStream * outstream ;
-
-    if ( unzOpenCurrentFile(epub_document->epubDocument) != UNZ_OK )
-    {
-            return FALSE ;
+    gchar **segments = g_strsplit(path, "/", -1);
+    GPtrArray *kept = g_ptr_array_new();
+    gchar *normalized;
+    guint i;
+
+    for (i = 0; segments[i] != NULL; i++) {
+        if (*segments[i] == '\0' || !strcmp(segments[i], "."))
+            continue;
+
+        if (!strcmp(segments[i], "..")) {
+            if (kept->len > 0)
+                g_ptr_array_remove_index(kept, kept->len - 1);
+            continue;
+        }
+
+        g_ptr_array_add(kept, segments[i]);
     }
+    g_ptr_array_add(kept, NULL);
+
+    normalized = g_strjoinv("/", (gchar**)kept->pdata);
+    g_ptr_array_free(kept, TRUE);
+    g_strfreev(segments);
+
+    return normalized;
+}
 
-    gboolean result = TRUE;
+/* The directory of a path in the archive, "" for the top directory */
+static gchar*
+epub_document_get_dirname(const gchar *path)
+{
+    const gchar *slash = g_strrstr(path, "/");
 
-    gpointer currentfilename = g_malloc0(512);
-    unzGetCurrentFileInfo64(epub_document->epubDocument,&info,currentfilename,512,NULL,0,NULL,0) ;
-    directory = g_strrstr(currentfilename,"/") ;
+    if (slash == NULL)
+        return g_strdup("");
 
-    if ( directory != NULL )
-        directory++;
+    return g_strndup(path, slash - path);
+}
 
-    gfilepath = g_string_new(epub_document->tmp_archive_dir) ;
-    g_string_append_printf(gfilepath,"/%s",(gchar*)currentfilename);
+/* The path in the archive of @href, without its fragment, relative to
+ * the directory @dir of the archive */
+static gchar*
+epub_document_resolve_path(const gchar *dir, const gchar *href)
+{
+    gsize length = strcspn(href, "#");
+    gchar *escaped = g_strndup(href, length);
+    gchar *relative = g_uri_unescape_string(escaped, NULL);
+    gchar *joined, *path;
 
-    /*if we encounter a directory, make a directory inside our temporary folder.*/
-    if (directory != NULL && *directory == '\0')
-    {
-        g_mkdir(gfilepath->str,0777);
-        goto out;
-    }
-    else if (directory != NULL && *directory != '\0' ) {
-        gchar* createdir = currentfilename;
-        /*Since a substring can't be longer than the parent string, allocating space equal to the parent's size should suffice*/
-        gchar *createdirname = g_malloc0(strlen(currentfilename));
-        /* Add the name of the directory and subdirectories,if any to a buffer and then create it */
-        gchar *createdirnametemp = createdirname;
-        while ( createdir != directory ) {
-            (*createdirnametemp) = (*createdir);
-            createdirnametemp++;
-            createdir++;
+    if (relative == NULL)
+        relative = g_strdup(escaped);
+    g_free(escaped);
+
+    if (dir != NULL && *dir != '\0')
+        joined = g_strdup_printf("%s/%s", dir, relative);
+    else
+        joined = g_strdup(relative);
+    g_free(relative);
+
+    path = epub_document_normalize_path(joined);
+    g_free(joined);
+
+    return path;
+}
+
+/* The URI @href, relative to the directory @dir of the archive, is served at */
+static gchar*
+epub_document_make_uri(EpubDocument *epub_document,
+                       const gchar  *dir,
+                       const gchar  *href)
+{
+    const gchar *fragment = strchr(href, '#');
+    gchar *path = epub_document_resolve_path(dir, href);
+    gchar *escaped = g_uri_escape_string(path, "/", FALSE);
+    gchar *uri;
+
+    uri = g_strdup_printf("%s/%s%s", epub_document->uri_base, escaped,
+                          fragment != NULL ? fragment : "");
+    g_free(escaped);
+    g_free(path);
+
+    return uri;
+}
+
+static gchar*
+epub_document_uri_to_path(EpubDocument *epub_document,
+                          const gchar  *uri)
+{
+    gsize base_length = strlen(epub_document->uri_base);
+    gchar *escaped, *path;
+
+    if (!g_str_has_prefix(uri, epub_document->uri_base) || uri[base_length] != '/')
+        return NULL;
+
+    uri += base_length + 1;
+    escaped = g_strndup(uri, strcspn(uri, "?#"));
+    path = g_uri_unescape_string(escaped, NULL);
+    g_free(escaped);
+
+    return path;
+}
+
+/* Reads the entry of the archive at @path, NUL terminated */
+static gchar*
+epub_document_read_entry(EpubDocument *epub_document,
+                         const gchar  *path,
+                         gsize        *length)
+{
+    unz64_file_pos *position;
+    unz_file_info64 info;
+    gchar *data = NULL;
+    ZPOS64_T size = 0;
+
+    position = g_hash_table_lookup(epub_document->entries, path);
+    if (position == NULL)
+        return NULL;
+
+    g_mutex_lock(&epub_document->archive_lock);
+
+    if (unzGoToFilePos64(epub_document->epubDocument, position) == UNZ_OK &&
+        unzGetCurrentFileInfo64(epub_document->epubDocument, &info, NULL, 0, NULL, 0, NULL, 0) == UNZ_OK &&
+        info.uncompressed_size < G_MAXSIZE &&
+        unzOpenCurrentFile(epub_document->epubDocument) == UNZ_OK) {
+        data = g_try_malloc(info.uncompressed_size + 1);
+
+        while (data != NULL && size < info.uncompressed_size) {
+            int read = unzReadCurrentFile(epub_document->epubDocument, data + size,
+                                          MIN(info.uncompressed_size - size, G_MAXINT));
+            if (read <= 0)
+                break;
+            size += read;
+        }
+        unzCloseCurrentFile(epub_document->epubDocument);
+
+        if (data != NULL && size < info.uncompressed_size) {
+            g_free(data);
+            data = NULL;
         }
-        (*createdirnametemp) = '\0';
+    }
+
+    g_mutex_unlock(&epub_document->archive_lock);
+
+    if (data == NULL)
+        return NULL;
+
+    data[size] = '\0';
+    if (length)
+        *length = size;
+
+    return data;
+}
 
-        dir_create = g_string_new(epub_document->tmp_archive_dir);
-        g_string_append_printf(dir_create,"/%s",createdirname);
-        g_free(createdirname);
+static const gchar epub_night_style[] =
+    "body {color:rgb(255,255,255);\
+    background-color:rgb(0,0,0);\
+    text-align:justify;\
+    line-spacing:1.8;\
+    margin-top:0px;\
+    margin-bottom:4px;\
+    margin-right:50px;\
+    margin-left:50px;\
+    text-indent:3em;}\
+    h1, h2, h3, h4, h5, h6\
+    {color:white;\
+    text-align:center;\
+    font-style:italic;\
+    font-weight:bold;}";
 
-        g_mkdir_with_parents(dir_create->str,0777);
-        g_string_free(dir_create,TRUE);
+static void
+change_to_night_sheet(xmlNodePtr head)
+{
+    gchar *class = NULL;
+    xmlNodePtr day, night;
+
+    day = xml_find_child_node(head,(xmlChar*)"link",(xmlChar*)"rel",(xmlChar*)"stylesheet");
+    if ( (class = (gchar*)xml_get_data_from_node(day,XML_ATTRIBUTE,(xmlChar*)"class")) == NULL) {
+        xmlSetProp(day,(xmlChar*)"class",(xmlChar*)"day");
     }
+    g_free(class);
+    xmlSetProp(day,(xmlChar*)"rel",(xmlChar*)"alternate stylesheet");
+    night = xml_find_child_node(head,(xmlChar*)"link",(xmlChar*)"class",(xmlChar*)"night");
+    xmlSetProp(night,(xmlChar*)"rel",(xmlChar*)"stylesheet");
+}
 
-    outfile = g_file_new_for_path(gfilepath->str);
-    outstream = g_file_create(outfile,G_FILE_CREATE_PRIVATE,NULL,error);
-    gpointer buffer = g_malloc0(512);
-    while ( (writesize = unzReadCurrentFile(epub_document->epubDocument,buffer,512) ) != 0 )
-    {
-        if ( g_output_stream_write((GOutputStream*)outstream,buffer,writesize,NULL,error) == -1 )
-        {
-            result = FALSE;
-            break;
-        }
+static void
+add_night_sheet(xmlNodePtr head,const gchar *sheeturi)
+{
+    xmlNodePtr link = xmlNewTextChild (head, NULL, (xmlChar*) "link", NULL);
+    xmlNewProp (link, (xmlChar*) "href", (xmlChar*) sheeturi);
+    xmlNewProp (link, (xmlChar*) "rel", (xmlChar*) "alternate stylesheet");
+    xmlNewProp (link, (xmlChar*) "class", (xmlChar*) "night");
+}
+
+static void
+add_mathjax_script_node(xmlNodePtr head)
+{
+    xmlNodePtr script = xmlNewTextChild (head,NULL,(xmlChar*)"script",(xmlChar*)"");
+    xmlNewProp(script,(xmlChar*)"type",(xmlChar*)"text/javascript");
+    xmlNewProp(script,(xmlChar*)"src",(xmlChar*)EPUB_MATHJAX_URI);
+}
+
+/*
+ * Content documents are changed as they are served: the night
+ * stylesheet is added and switched to, and MathJax is added to the
+ * documents using MathML. Returns NULL when there is nothing to change.
+ */
+static gchar*
+epub_document_transform_page(EpubDocument *epub_document,
+                             const gchar  *path,
+                             const gchar  *data,
+                             gsize        *length)
+{
+    gboolean mathml = g_hash_table_contains(epub_document->mathml_pages, path);
+    xmlDocPtr document;
+    xmlNodePtr root, head;
+    xmlChar *buffer = NULL;
+    gchar *transformed = NULL;
+    int size = 0;
+
+    if (!g_hash_table_contains(epub_document->content_pages, path) ||
+        (!epub_document->add_night_sheet && !epub_document->night_mode && !mathml))
+        return NULL;
+
+    /* This runs on the main thread, so it keeps away from the parser
+     * globals and works on its own document */
+    document = xmlReadMemory(data, *length, path, NULL, 0);
+    if (document == NULL)
+        return NULL;
+
+    root = xmlDocGetRootElement(document);
+    head = root ? xml_find_child_node(root,(xmlChar*)"head",NULL,NULL) : NULL;
+    if (head == NULL) {
+        xmlFreeDoc(document);
+        return NULL;
+    }
+
+    if (epub_document->add_night_sheet) {
+        gchar *sheeturi = epub_document_make_uri(epub_document, epub_document->documentdir,
+                                                 EPUB_NIGHT_SHEET);
+        add_night_sheet(head, sheeturi);
+        g_free(sheeturi);
+    }
+
+    if (epub_document->night_mode)
+        change_to_night_sheet(head);
+
+    if (mathml)
+        add_mathjax_script_node(head);
+
+    xmlDocDumpFormatMemory(document, &buffer, &size, 0);
+    xmlFreeDoc(document);
+
+    if (buffer == NULL)
+        return NULL;
+
+    transformed = g_strndup((gchar*)buffer, size);
+    *length = size;
+    xmlFree(buffer);
+
+    return transformed;
+}
+
+/* The contents served for @path, changed for the view if needed */
+static gchar*
+epub_document_get_resource(EpubDocument *epub_document,
+                           const gchar  *path,
+                           gsize        *length)
+{
+    gchar *data, *transformed;
+
+    data = epub_document_read_entry(epub_document, path, length);
+
+    if (data == NULL) {
+        gchar *sheetpath;
+        gboolean is_sheet;
+
+        if (!epub_document->add_night_sheet)
+            return NULL;
+
+        sheetpath = epub_document_resolve_path(epub_document->documentdir, EPUB_NIGHT_SHEET);
+        is_sheet = !strcmp(path, sheetpath);
+        g_free(sheetpath);
+        if (!is_sheet)
+            return NULL;
+
+        *length = strlen(epub_night_style);
+        return g_strdup(epub_night_style);
+    }
+
+    transformed = epub_document_transform_page(epub_document, path, data, length);
+    if (transformed != NULL) {
+        g_free(data);
+        data = transformed;
+    }
+
+    return data;
+}
+
+static void
+epub_document_uri_scheme_request_cb(WebKitURISchemeRequest *request,
+                                    gpointer                user_data)
+{
+    const gchar *uri = webkit_uri_scheme_request_get_uri(request);
+    const gchar *host = uri + strlen(EPUB_URI_SCHEME "://");
+    EpubDocument *epub_document = NULL;
+    gchar *id, *path = NULL, *data = NULL;
+    gsize length = 0;
+
+    id = g_strndup(host, strcspn(host, "/"));
+    G_LOCK(epub_documents);
+    if (epub_documents != NULL) {
+        GWeakRef *ref = g_hash_table_lookup(epub_documents, id);
+
+        if (ref != NULL)
+            epub_document = g_weak_ref_get(ref);
+    }
+    G_UNLOCK(epub_documents);
+    g_free(id);
+
+    if (epub_document != NULL) {
+        path = epub_document_uri_to_path(epub_document, uri);
+        if (path != NULL)
+            data = epub_document_get_resource(epub_document, path, &length);
+        g_object_unref(epub_document);
+    }
+
+    if (data == NULL) {
+        GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                    _("“%s” was not found in the ePub archive"), uri);
+        webkit_uri_scheme_request_finish_error(request, error);
+        g_error_free(error);
+        g_free(path);
+        return;
     }
-    g_free(buffer);
-    g_output_stream_close((GOutputStream*)outstream,NULL,error);
-    g_object_unref(outfile) ;
-    g_object_unref(outstream) ;
 
-out:
-    unzCloseCurrentFile (epub_document->epubDocument) ;
-    g_string_free(gfilepath,TRUE);
-    g_free(currentfilename);
-    return result;
+    gchar *content_type = g_content_type_guess(path, (const guchar*)data, length, NULL);
+    gchar *mime_type = g_content_type_get_mime_type(content_type);
+    GInputStream *stream = g_memory_input_stream_new_from_data(data, length, g_free);
+
+    webkit_uri_scheme_request_finish(request, stream, length, mime_type);
+
+    g_object_unref(stream);
+    g_free(mime_type);
+    g_free(content_type);
+    g_free(path);
 }
 
 static gboolean
-extract_epub_from_container (const gchar* uri,
-                             EpubDocument *epub_document,
-                             GError ** error)
+epub_document_register_uri_scheme(gpointer user_data)
 {
+    WebKitWebContext *context = webkit_web_context_get_default();
+
+    webkit_web_context_register_uri_scheme(context, EPUB_URI_SCHEME,
+                                           epub_document_uri_scheme_request_cb,
+                                           NULL, NULL);
+    /* Like the extracted files used to be, so that MathJax can be loaded */
+    webkit_security_manager_register_uri_scheme_as_local(webkit_web_context_get_security_manager(context),
+                                                         EPUB_URI_SCHEME);
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Opens the archive and records where its entries are, without reading
+ * them. The archive stays open for the lifetime of the document.
+ */
+static gboolean
+open_epub_archive (const gchar* uri,
+                   EpubDocument *epub_document,
+                   GError ** error)
+{
+    static gsize scheme_registered = 0;
     GError *err = NULL;
-    epub_document->archivename = g_filename_from_uri(uri,NULL,error);
+    epub_document->archivename = g_filename_from_uri(uri,NULL,&err);
 
     if ( !epub_document->archivename )
     {
@@ -770,100 +1126,76 @@ extract_epub_from_container (const gchar* uri,
         return FALSE;
     }
 
-    gchar *epubfilename = g_strrstr(epub_document->archivename,"/");
-    if ( *epubfilename == '/' )
-        epubfilename++ ;
-
-    GString *temporary_sub_directory = g_string_new(epubfilename);
-    g_string_append(temporary_sub_directory,"XXXXXX") ;
-    epub_document->tmp_archive_dir = ev_mkdtemp(temporary_sub_directory->str, error);
-    g_string_free(temporary_sub_directory, TRUE);
-
-    if (!epub_document->tmp_archive_dir) {
-        return FALSE;
-    }
-
     epub_document->epubDocument = unzOpen64(epub_document->archivename);
     if ( epub_document->epubDocument == NULL )
     {
-        if (err)    {
-            g_propagate_error (error, err);
-        }
-        else    {
-            g_set_error_literal (error,
-                         EV_DOCUMENT_ERROR,
-                         EV_DOCUMENT_ERROR_INVALID,
-                         _("could not open archive"));
-        }
+        g_set_error_literal (error,
+                     EV_DOCUMENT_ERROR,
+                     EV_DOCUMENT_ERROR_INVALID,
+                     _("could not open archive"));
         return FALSE;
     }
 
-    gboolean result = FALSE;
-
     if ( unzGoToFirstFile(epub_document->epubDocument) != UNZ_OK )
     {
-        if (err) {
-            g_propagate_error (error, err);
-        }
-        else    {
+        g_set_error_literal (error,
+                     EV_DOCUMENT_ERROR,
+                     EV_DOCUMENT_ERROR_INVALID,
+                     _("could not extract archive"));
+        return FALSE;
+    }
+
+    do
+    {
+        gchar currentfilename[512];
+        unz_file_info64 info;
+        unz64_file_pos *position;
+
+        if ( unzGetCurrentFileInfo64(epub_document->epubDocument,&info,currentfilename,
+                                     sizeof (currentfilename),NULL,0,NULL,0) != UNZ_OK )
+        {
             g_set_error_literal (error,
                          EV_DOCUMENT_ERROR,
                          EV_DOCUMENT_ERROR_INVALID,
                          _("could not extract archive"));
+            return FALSE;
         }
-        goto out;
+
+        /*Directories have no contents*/
+        if ( g_str_has_suffix(currentfilename,"/") )
+            continue;
+
+        position = g_new (unz64_file_pos, 1);
+        unzGetFilePos64(epub_document->epubDocument, position);
+        g_hash_table_insert(epub_document->entries, g_strdup(currentfilename), position);
     }
+    while ( unzGoToNextFile(epub_document->epubDocument) == UNZ_OK );
 
-    while ( TRUE )
-    {
-        if ( extract_one_file(epub_document,&err) == FALSE )
-        {
-            if (err) {
-                g_propagate_error (error, err);
-            }
-            else    {
-                g_set_error_literal (error,
-                             EV_DOCUMENT_ERROR,
-                             EV_DOCUMENT_ERROR_INVALID,
-                             _("could not extract archive"));
-            }
-            goto out;
-        }
+    G_LOCK(epub_documents);
+    if (epub_documents == NULL)
+        epub_documents = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_free);
+    epub_document->id = g_strdup_printf("%u", ++epub_documents_last_id);
+    GWeakRef *ref = g_new0(GWeakRef, 1);
+    g_weak_ref_init(ref, epub_document);
+    g_hash_table_insert(epub_documents, g_strdup(epub_document->id), ref);
+    G_UNLOCK(epub_documents);
 
-        if ( unzGoToNextFile(epub_document->epubDocument) == UNZ_END_OF_LIST_OF_FILE ) {
-            result = TRUE;
-            break;
-        }
+    epub_document->uri_base = g_strdup_printf(EPUB_URI_SCHEME "://%s", epub_document->id);
+
+    /* Documents are loaded in a thread, WebKit is used from the main one */
+    if (g_once_init_enter(&scheme_registered)) {
+        g_main_context_invoke(NULL, epub_document_register_uri_scheme, NULL);
+        g_once_init_leave(&scheme_registered, 1);
     }
 
-out:
-    unzClose(epub_document->epubDocument);
-    return result;
+    return TRUE;
 }
 
 static gchar*
-get_uri_to_content(const gchar* uri,GError ** error,EpubDocument *epub_document)
+get_path_to_content(EpubDocument *epub_document,GError ** error)
 {
-    gchar* tmp_archive_dir = epub_document->tmp_archive_dir;
-    GError *err = NULL ;
-
-    gchar *containerpath = g_filename_from_uri(uri,NULL,&err);
-    if ( !containerpath )
-    {
-        if (err) {
-            g_propagate_error (error,err);
-        }
-        else    {
-            g_set_error_literal (error,
-                                 EV_DOCUMENT_ERROR,
-                                 EV_DOCUMENT_ERROR_INVALID,
-                                 _("could not retrieve container file"));
-        }
-        return NULL ;
-    }
-
-    gboolean result = open_xml_document(containerpath);
-    g_free (containerpath);
+    gboolean result = open_xml_document(epub_document,"META-INF/container.xml");
     if ( result == FALSE )
     {
         g_set_error_literal(error,
@@ -903,49 +1235,13 @@ get_uri_to_content(const gchar* uri,GError ** error,EpubDocument *epub_document)
         return NULL ;
     }
 
-    gchar* documentfolder = g_strrstr((gchar*)relativepath,"/");
-    if (documentfolder != NULL) {
-        gchar* copybuffer = (gchar*)relativepath ;
-        gchar* directorybuffer = g_malloc0(sizeof(gchar*)*100);
-        gchar* writer = directorybuffer;
+    gchar *contentpath = epub_document_normalize_path((gchar*)relativepath);
+    xmlFree (relativepath);
 
-        while(copybuffer != documentfolder) {
-            (*writer) = (*copybuffer);
-            writer++;copybuffer++;
-        }
-        *writer = '\0';
+    epub_document->documentdir = epub_document_get_dirname(contentpath);
 
-        GString *documentdir = g_string_new(tmp_archive_dir);
-        g_string_append_printf(documentdir,"/%s",directorybuffer);
-        g_free(directorybuffer);
-        epub_document->documentdir = g_string_free(documentdir,FALSE);
-    }
-    else
-    {
-        epub_document->documentdir = g_strdup(tmp_archive_dir);
-    }
-
-    GString *absolutepath = g_string_new(tmp_archive_dir);
-    g_string_append_printf(absolutepath,"/%s",relativepath);
-    g_free (relativepath);
-
-    gchar *content_uri = g_filename_to_uri(absolutepath->str,NULL,&err);
-    g_string_free(absolutepath,TRUE);
-    if ( !content_uri )  {
-        if (err) {
-            g_propagate_error (error,err);
-        }
-        else
-        {
-            g_set_error_literal (error,
-                                 EV_DOCUMENT_ERROR,
-                                 EV_DOCUMENT_ERROR_INVALID,
-                                 _("could not retrieve container file"));
-        }
-        return NULL ;
-    }
     xml_free_doc();
-    return content_uri ;
+    return contentpath ;
 }
 
 static gboolean
@@ -961,14 +1257,13 @@ link_present_on_page(const gchar* link,const gchar *page_uri)
 }
 
 static GList*
-setup_document_content_list(const gchar* content_uri, GError** error,gchar *documentdir)
+setup_document_content_list(EpubDocument *epub_document, const gchar* contentpath, GError** error)
 {
-    GError *err = NULL;
     gint indexcounter = 1;
     xmlNodePtr manifest,spine,itemrefptr,itemptr;
     gboolean errorflag = FALSE;
 
-    if ( open_xml_document(content_uri) == FALSE )
+    if ( open_xml_document(epub_document, contentpath) == FALSE )
     {
         g_set_error_literal(error,
                             EV_DOCUMENT_ERROR,
@@ -1028,7 +1323,7 @@ setup_document_content_list(const gchar* content_uri, GError** error,gchar *docu
         }
         if ( xmlStrcmp(itemrefptr->name,(xmlChar*)"itemref") == 0)
         {
-            contentListNode *newnode = g_malloc0(sizeof(newnode));
+            contentListNode *newnode = g_new0(contentListNode, 1);
             newnode->key = (gchar*)xml_get_data_from_node(itemrefptr,XML_ATTRIBUTE,(xmlChar*)"idref");
             if ( newnode->key == NULL )
             {
@@ -1051,15 +1346,8 @@ setup_document_content_list(const gchar* content_uri, GError** error,gchar *docu
                 break;
             }
 
-            GString* absolutepath = g_string_new(documentdir);
             gchar *relativepath = (gchar*)xml_get_data_from_node(itemptr,XML_ATTRIBUTE,(xmlChar*)"href");
-            g_string_append_printf(absolutepath,"/%s",relativepath);
-            g_free (relativepath);
-
-            newnode->value = g_filename_to_uri(absolutepath->str,NULL,&err);
-            g_string_free(absolutepath,TRUE);
-
-            if ( newnode->value == NULL )
+            if ( relativepath == NULL )
             {
                 g_free (newnode->key);
                 g_free (newnode);
@@ -1067,6 +1355,11 @@ setup_document_content_list(const gchar* content_uri, GError** error,gchar *docu
                 break;
             }
 
+            newnode->value = epub_document_make_uri(epub_document,epub_document->documentdir,relativepath);
+            g_hash_table_add(epub_document->content_pages,
+                             epub_document_resolve_path(epub_document->documentdir,relativepath));
+            g_free (relativepath);
+
             newnode->index = indexcounter++ ;
 
             newlist = g_list_prepend(newlist, newnode);
@@ -1077,17 +1370,10 @@ setup_document_content_list(const gchar* content_uri, GError** error,gchar *docu
 
     if ( errorflag )
     {
-        if ( err )
-        {
-            g_propagate_error(error,err);
-        }
-        else
-        {
-            g_set_error_literal(error,
-                                EV_DOCUMENT_ERROR,
-                                EV_DOCUMENT_ERROR_INVALID,
-                                _("Could not set up document tree for loading, some files missing"));
-        }
+        g_set_error_literal(error,
+                            EV_DOCUMENT_ERROR,
+                            EV_DOCUMENT_ERROR_INVALID,
+                            _("Could not set up document tree for loading, some files missing"));
         /*free any nodes that were set up and return empty*/
         g_list_free_full(newlist, (GDestroyNotify)free_tree_nodes);
         return NULL;
@@ -1123,11 +1409,9 @@ free_link_nodes(gpointer data)
 }
 
 static gchar*
-get_toc_file_name(gchar *containeruri)
+get_toc_file_name(EpubDocument *epub_document,const gchar *contentpath)
 {
-    gchar *containerfilename = g_filename_from_uri(containeruri,NULL,NULL);
-    open_xml_document(containerfilename);
-    g_free (containerfilename);
+    open_xml_document(epub_document,contentpath);
 
     set_xml_root_node(NULL);
 
@@ -1151,9 +1435,9 @@ get_toc_file_name(gchar *containeruri)
 }
 
 static gchar*
-epub_document_get_nav_file(gchar* containeruri)
+epub_document_get_nav_file(EpubDocument *epub_document,const gchar* contentpath)
 {
-    open_xml_document(containeruri);
+    open_xml_document(epub_document,contentpath);
     set_xml_root_node(NULL);
     xmlNodePtr manifest = xml_get_pointer_to_node((xmlChar*)"manifest",NULL,NULL);
     xmlretval = NULL;
@@ -1166,7 +1450,7 @@ epub_document_get_nav_file(gchar* containeruri)
 }
 
 static GList*
-get_child_list(xmlNodePtr ol,gchar* documentdir)
+get_child_list(EpubDocument *epub_document,xmlNodePtr ol,const gchar* documentdir)
 {
     GList *childlist = NULL;
     xmlNodePtr li = ol->xmlChildrenNode;
@@ -1182,15 +1466,13 @@ get_child_list(xmlNodePtr ol,gchar* documentdir)
             if ( !xmlStrcmp(children->name,(xmlChar*)"a")) {
                 newlinknode->linktext = (gchar*)xml_get_data_from_node(children,XML_KEYWORD,NULL);
                 gchar* filename = (gchar*)xml_get_data_from_node(children,XML_ATTRIBUTE,(xmlChar*)"href");
-                gchar *filepath = g_strdup_printf("%s/%s",documentdir,filename);
-                newlinknode->pagelink = g_filename_to_uri(filepath,NULL,NULL);
+                newlinknode->pagelink = epub_document_make_uri(epub_document,documentdir,filename);
                 g_free(filename);
-                g_free(filepath);
                 newlinknode->children = NULL;
                 childlist = g_list_prepend(childlist,newlinknode);
             }
             else if ( !xmlStrcmp(children->name,(xmlChar*)"ol")){
-                newlinknode->children = get_child_list(children,documentdir);
+                newlinknode->children = get_child_list(epub_document,children,documentdir);
             }
 
             children = children->next;
@@ -1204,10 +1486,10 @@ get_child_list(xmlNodePtr ol,gchar* documentdir)
 
 /* For an epub3 style navfile */
 static GList*
-setup_index_from_navfile(gchar *tocpath)
+setup_index_from_navfile(EpubDocument *epub_document,const gchar *tocpath)
 {
     GList *index = NULL;
-    open_xml_document(tocpath);
+    open_xml_document(epub_document,tocpath);
     set_xml_root_node(NULL);
     xmlNodePtr nav = xml_get_pointer_to_node((xmlChar*)"nav",(xmlChar*)"type",(xmlChar*)"toc");
 
@@ -1218,52 +1500,43 @@ setup_index_from_navfile(gchar *tocpath)
 
     xmlretval=NULL;
     xml_parse_children_of_node(nav,(xmlChar*)"ol", NULL,NULL);
-    gchar *navdirend = g_strrstr(tocpath,"/");
-    gchar *navdir = g_malloc0(strlen(tocpath));
-    gchar *reader = tocpath;
-    gchar *writer = navdir;
-
-    while (reader != navdirend) {
-        (*writer) = (*reader) ;
-        writer++;reader++;
-    }
-    index = get_child_list(xmlretval,navdir);
+    gchar *navdir = epub_document_get_dirname(tocpath);
+    index = get_child_list(epub_document,xmlretval,navdir);
     g_free(navdir);
     xml_free_doc();
     return index;
 }
 
 static GList*
-setup_document_index(EpubDocument *epub_document,gchar *containeruri)
+setup_document_index(EpubDocument *epub_document,const gchar *contentpath)
 {
-    GString *tocpath = g_string_new(epub_document->documentdir);
-    gchar *tocfilename = get_toc_file_name(containeruri);
+    gchar *tocfilename = get_toc_file_name(epub_document,contentpath);
+    gchar *tocpath, *tocdir;
     GList *index = NULL;
 
     if (tocfilename == NULL) {
-        tocfilename = epub_document_get_nav_file(containeruri);
+        tocfilename = epub_document_get_nav_file(epub_document,contentpath);
 
         //Apparently, sometimes authors don't even care to add a TOC!! Guess standards are just guidelines.
 
         if (tocfilename == NULL) {
             //We didn't even find a nav file.The document has no TOC.
-            g_string_free(tocpath,TRUE);
             return NULL;
         }
 
-        g_string_append_printf (tocpath,"/%s",tocfilename);
-        index = setup_index_from_navfile(tocpath->str);
-        g_string_free(tocpath,TRUE);
+        tocpath = epub_document_resolve_path(epub_document->documentdir,tocfilename);
+        index = setup_index_from_navfile(epub_document,tocpath);
+        g_free(tocpath);
         g_free (tocfilename);
         return index;
     }
 
-    g_string_append_printf (tocpath,"/%s",tocfilename);
+    tocpath = epub_document_resolve_path(epub_document->documentdir,tocfilename);
     g_free (tocfilename);
 
-    GString *pagelink;
-    open_xml_document(tocpath->str);
-    g_string_free(tocpath,TRUE);
+    open_xml_document(epub_document,tocpath);
+    tocdir = epub_document_get_dirname(tocpath);
+    g_free(tocpath);
     set_xml_root_node((xmlChar*)"ncx");
 
     xmlNodePtr docTitle = xml_get_pointer_to_node((xmlChar*)"docTitle",NULL,NULL);
@@ -1287,8 +1560,6 @@ setup_document_index(EpubDocument *epub_document,gchar *containeruri)
             xml_parse_children_of_node(navPoint,(xmlChar*)"navLabel",NULL,NULL);
             xmlNodePtr navLabel = xmlretval;
             xmlretval = NULL;
-            gchar *fragment=NULL,*end=NULL;
-            GString *uri = NULL;
 
             xml_parse_children_of_node(navLabel,(xmlChar*)"text",NULL,NULL);
             linknode *newnode = g_new0(linknode,1);
@@ -1299,30 +1570,10 @@ setup_document_index(EpubDocument *epub_document,gchar *containeruri)
             }
             xmlretval = NULL;
             xml_parse_children_of_node(navPoint,(xmlChar*)"content",NULL,NULL);
-            pagelink = g_string_new(epub_document->documentdir);
-            newnode->pagelink = (gchar*)xml_get_data_from_node(xmlretval,XML_ATTRIBUTE,(xmlChar*)"src");
-            g_string_append_printf(pagelink,"/%s",newnode->pagelink);
-            xmlFree(newnode->pagelink);
-
-            gchar *escaped = g_strdup(pagelink->str);
+            gchar *src = (gchar*)xml_get_data_from_node(xmlretval,XML_ATTRIBUTE,(xmlChar*)"src");
+            newnode->pagelink = epub_document_make_uri(epub_document,tocdir,src ? src : "");
+            xmlFree(src);
 
-            //unescaping any special characters
-            pagelink->str = g_uri_unescape_string (escaped,NULL);
-            g_free(escaped);
-
-            if ((end = g_strrstr(pagelink->str,"#")) != NULL) {
-                fragment = g_strdup(g_strrstr(pagelink->str,"#"));
-                *end = '\0';
-            }
-            uri = g_string_new(g_filename_to_uri(pagelink->str,NULL,NULL));
-            g_string_free(pagelink,TRUE);
-
-            if (fragment) {
-                g_string_append(uri,fragment);
-            }
-
-            newnode->pagelink = g_strdup(uri->str);
-            g_string_free(uri,TRUE);
             index = g_list_prepend(index,newnode);
         }
 
@@ -1331,6 +1582,7 @@ setup_document_index(EpubDocument *epub_document,gchar *containeruri)
     }
 
     xml_free_doc();
+    g_free(tocdir);
 
     return g_list_reverse(index);
 }
@@ -1339,27 +1591,9 @@ static EvDocumentInfo*
 epub_document_get_info(EvDocument *document)
 {
     EpubDocument *epub_document = EPUB_DOCUMENT(document);
-    GError *error = NULL ;
-    gchar* infofile ;
     xmlNodePtr metanode ;
     GString* buffer ;
 
-    GString* containerpath = g_string_new(epub_document->tmp_archive_dir);
-    g_string_append_printf(containerpath,"/META-INF/container.xml");
-    gchar* containeruri = g_filename_to_uri(containerpath->str,NULL,&error);
-    g_string_free (containerpath, TRUE);
-    if ( error )
-    {
-        return NULL ;
-    }
-
-    gchar* uri = get_uri_to_content (containeruri,&error,epub_document);
-    g_free (containeruri);
-    if ( error )
-    {
-        return NULL ;
-    }
-
     EvDocumentInfo* epubinfo = g_new0 (EvDocumentInfo, 1);
 
     epubinfo->fields_mask = EV_DOCUMENT_INFO_TITLE |
@@ -1373,16 +1607,11 @@ epub_document_get_info(EvDocument *document)
                 EV_DOCUMENT_INFO_PERMISSIONS |
                 EV_DOCUMENT_INFO_N_PAGES ;
 
-    infofile = g_filename_from_uri(uri,NULL,&error);
-    g_free (uri);
-    if ( error )
+    if ( open_xml_document(epub_document,epub_document->contentpath) == FALSE )
     {
         return epubinfo;
     }
 
-    open_xml_document(infofile);
-    g_free (infofile);
-
     set_xml_root_node((xmlChar*)"package");
 
     metanode = xml_get_pointer_to_node((xmlChar*)"title",NULL,NULL);
@@ -1440,61 +1669,18 @@ epub_document_get_page(EvDocument *document,
     return page ;
 }
 
-static void
-change_to_night_sheet(contentListNode *nodedata,gpointer user_data)
-{
-    gchar *filename = g_filename_from_uri(nodedata->value,NULL,NULL);
-    open_xml_document(filename);
-    set_xml_root_node(NULL);
-    xmlNodePtr head =xml_get_pointer_to_node((xmlChar*)"head",NULL,NULL);
-    gchar *class = NULL;
-    xmlretval = NULL;
-    xml_parse_children_of_node(head,(xmlChar*)"link",(xmlChar*)"rel",(xmlChar*)"stylesheet");
-
-    xmlNodePtr day = xmlretval;
-    if ( (class = (gchar*)xml_get_data_from_node(day,XML_ATTRIBUTE,(xmlChar*)"class")) == NULL) {
-        xmlSetProp(day,(xmlChar*)"class",(xmlChar*)"day");
-    }
-    g_free(class);
-    xmlSetProp(day,(xmlChar*)"rel",(xmlChar*)"alternate stylesheet");
-    xmlretval = NULL;
-    xml_parse_children_of_node(head,(xmlChar*)"link",(xmlChar*)"class",(xmlChar*)"night");
-    xmlSetProp(xmlretval,(xmlChar*)"rel",(xmlChar*)"stylesheet");
-    xmlSaveFormatFile (filename, xmldocument, 0);
-    xml_free_doc();
-    g_free(filename);
-}
-
-static void
-change_to_day_sheet(contentListNode *nodedata,gpointer user_data)
-{
-    gchar *filename = g_filename_from_uri(nodedata->value,NULL,NULL);
-    open_xml_document(filename);
-    set_xml_root_node(NULL);
-    xmlNodePtr head =xml_get_pointer_to_node((xmlChar*)"head",NULL,NULL);
-
-    xmlretval = NULL;
-    xml_parse_children_of_node(head,(xmlChar*)"link",(xmlChar*)"rel",(xmlChar*)"stylesheet");
-
-    xmlNodePtr day = xmlretval;
-    xmlSetProp(day,(xmlChar*)"rel",(xmlChar*)"alternate stylesheet");
-
-    xmlretval = NULL;
-    xml_parse_children_of_node(head,(xmlChar*)"link",(xmlChar*)"class",(xmlChar*)"day");
-    xmlSetProp(xmlretval,(xmlChar*)"rel",(xmlChar*)"stylesheet");
-    xmlSaveFormatFile (filename, xmldocument, 0);
-    xml_free_doc();
-    g_free(filename);
-}
-
 static gchar*
-epub_document_get_alternate_stylesheet(gchar *docuri)
+epub_document_get_alternate_stylesheet(EpubDocument *epub_document,const gchar *path)
 {
-    gchar *filename = g_filename_from_uri(docuri,NULL,NULL);
-    open_xml_document(filename);
-    g_free(filename);
+    gchar *sheet = NULL;
 
-    set_xml_root_node(NULL);
+    if (open_xml_document(epub_document,path) == FALSE)
+        return NULL;
+
+    if (set_xml_root_node(NULL) == FALSE) {
+        xmldocument = NULL;
+        return NULL;
+    }
 
     xmlNodePtr head= xml_get_pointer_to_node((xmlChar*)"head",NULL,NULL);
 
@@ -1503,29 +1689,10 @@ epub_document_get_alternate_stylesheet(gchar *docuri)
     xml_parse_children_of_node(head,(xmlChar*)"link",(xmlChar*)"class",(xmlChar*)"night");
 
     if (xmlretval != NULL) {
-        return (gchar*)xml_get_data_from_node(xmlretval,XML_ATTRIBUTE,(xmlChar*)"href");
+        sheet = (gchar*)xml_get_data_from_node(xmlretval,XML_ATTRIBUTE,(xmlChar*)"href");
     }
     xml_free_doc();
-    return NULL;
-}
-
-static void
-add_night_sheet(contentListNode *listdata,gchar *sheet)
-{
-    gchar *sheeturi = g_filename_to_uri(sheet,NULL,NULL);
-    open_xml_document(listdata->value);
-
-    set_xml_root_node(NULL);
-    xmlNodePtr head = xml_get_pointer_to_node((xmlChar*)"head",NULL,NULL);
-
-    xmlNodePtr link = xmlNewTextChild (head, NULL, (xmlChar*) "link", NULL);
-    xmlNewProp (link, (xmlChar*) "href", (xmlChar*) sheeturi);
-    xmlNewProp (link, (xmlChar*) "rel", (xmlChar*) "alternate stylesheet");
-    xmlNewProp (link, (xmlChar*) "class", (xmlChar*) "night");
-
-    xmlSaveFormatFile (listdata->value, xmldocument, 0);
-    xml_free_doc();
-    g_free(sheeturi);
+    return sheet;
 }
 
 static void
@@ -1540,40 +1707,15 @@ epub_document_check_add_night_sheet(EvDocument *document)
      * Odds are, if this one has it, all others have it too.
      */
     contentListNode *node = epub_document->contentList->data;
-    gchar* stylesheetfilename = epub_document_get_alternate_stylesheet((gchar*)node->value) ;
-
-    if (stylesheetfilename == NULL) {
-        gchar *style = "body {color:rgb(255,255,255);\
-                        background-color:rgb(0,0,0);\
-                        text-align:justify;\
-                        line-spacing:1.8;\
-                        margin-top:0px;\
-                        margin-bottom:4px;\
-                        margin-right:50px;\
-                        margin-left:50px;\
-                        text-indent:3em;}\
-                        h1, h2, h3, h4, h5, h6\
-                        {color:white;\
-                        text-align:center;\
-                        font-style:italic;\
-                        font-weight:bold;}";
-
-        gchar *csspath = g_strdup_printf("%s/atrilnightstyle.css",epub_document->documentdir);
-
-        GFile *styles = g_file_new_for_path (csspath);
-        GOutputStream *outstream = (GOutputStream*)g_file_create(styles,G_FILE_CREATE_PRIVATE,NULL,NULL);
-        if ( g_output_stream_write((GOutputStream*)outstream,style,strlen(style),NULL,NULL) == -1 )
-        {
-            return ;
-        }
-        g_output_stream_close((GOutputStream*)outstream,NULL,NULL);
-        g_object_unref(styles) ;
-        g_object_unref(outstream) ;
-        //add this stylesheet to each document, for later.
-        g_list_foreach(epub_document->contentList,(GFunc)add_night_sheet,csspath);
-        g_free(csspath);
-    }
+    gchar *path = epub_document_uri_to_path(epub_document,node->value);
+    gchar* stylesheetfilename = path ? epub_document_get_alternate_stylesheet(epub_document,path) : NULL;
+
+    /* Our stylesheet is added to each document as it is served */
+    if (stylesheetfilename == NULL)
+        epub_document->add_night_sheet = TRUE;
+
     g_free(stylesheetfilename);
+    g_free(path);
 }
 
 static void
@@ -1582,16 +1724,15 @@ epub_document_toggle_night_mode(EvDocument *document,gboolean night)
     EpubDocument *epub_document = EPUB_DOCUMENT(document);
 
     g_return_if_fail(EPUB_IS_DOCUMENT(epub_document));
-    if (night)
-        g_list_foreach(epub_document->contentList,(GFunc)change_to_night_sheet,NULL);
-    else
-        g_list_foreach(epub_document->contentList,(GFunc)change_to_day_sheet,NULL);
+
+    /* Applied to the documents as they are served, the views reload */
+    epub_document->night_mode = night;
 }
 
 static gchar*
-epub_document_set_document_title(gchar *containeruri)
+epub_document_set_document_title(EpubDocument *epub_document,const gchar *contentpath)
 {
-    open_xml_document(containeruri);
+    open_xml_document(epub_document,contentpath);
     gchar *doctitle;
     set_xml_root_node(NULL);
 
@@ -1633,50 +1774,18 @@ epub_document_set_index_pages(GList *index,GList *contentList)
     g_list_foreach(index,(GFunc)page_set_function,contentList);
 }
 
+/* Finds the content documents using MathML, MathJax is added to them
+ * as they are served */
 static void
-add_mathjax_script_node_to_file(gchar *filename, gchar *data)
+epub_document_add_mathJax(EpubDocument *epub_document,const gchar* contentpath)
 {
-    xmlDocPtr mathdocument = xmlParseFile (filename);
-    xmlNodePtr mathroot = xmlDocGetRootElement(mathdocument);
-
-    if (mathroot == NULL)
+    if (open_xml_document(epub_document,contentpath) == FALSE)
         return;
 
-    xmlNodePtr head = mathroot->children;
-
-    while(head != NULL) {
-        if (!xmlStrcmp(head->name,(xmlChar*)"head")) {
-            break;
-        }
-        head = head->next;
-    }
-
-    if (xmlStrcmp(head->name,(xmlChar*)"head")) {
-        return ;
-    }
-
-    xmlNodePtr script = xmlNewTextChild (head,NULL,(xmlChar*)"script",(xmlChar*)"");
-    xmlNewProp(script,(xmlChar*)"type",(xmlChar*)"text/javascript");
-    xmlNewProp(script,(xmlChar*)"src",(xmlChar*)data);
-
-    xmlSaveFormatFile(filename, mathdocument, 0);
-    xmlFreeDoc (mathdocument);
-}
-
-static void
-epub_document_add_mathJax(gchar* containeruri,gchar* documentdir)
-{
-    gchar *containerfilename= g_filename_from_uri(containeruri,NULL,NULL);
-    GString *mathjaxdir = g_string_new("/usr/share/javascript/mathjax");
-
-    gchar *mathjaxref = g_filename_to_uri(mathjaxdir->str,NULL,NULL);
-    gchar *nodedata = g_strdup_printf("%s/MathJax.js?config=TeX-AMS-MML_SVG",mathjaxref);
-
-    open_xml_document(containerfilename);
     set_xml_root_node(NULL);
     xmlNodePtr manifest = xml_get_pointer_to_node((xmlChar*)"manifest",NULL,NULL);
 
-    xmlNodePtr item = manifest->xmlChildrenNode;
+    xmlNodePtr item = manifest ? manifest->xmlChildrenNode : NULL;
 
     while (item != NULL) {
         if (xmlStrcmp(item->name,(xmlChar*)"item")) {
@@ -1689,20 +1798,16 @@ epub_document_add_mathJax(gchar* containeruri,gchar* documentdir)
         if (mathml != NULL &&
             !xmlStrcmp(mathml, (xmlChar*)"mathml") ) {
             gchar *href = (gchar*)xml_get_data_from_node(item, XML_ATTRIBUTE, (xmlChar*)"href");
-            gchar *filename = g_strdup_printf("%s/%s",documentdir,href);
 
-            add_mathjax_script_node_to_file(filename,nodedata);
+            if (href != NULL)
+                g_hash_table_add(epub_document->mathml_pages,
+                                 epub_document_resolve_path(epub_document->documentdir,href));
             g_free(href);
-            g_free(filename);
         }
         g_free(mathml);
         item = item->next;
     }
     xml_free_doc();
-    g_free(mathjaxref);
-    g_free(containerfilename);
-    g_free(nodedata);
-    g_string_free(mathjaxdir,TRUE);
 }
 
 static gboolean
@@ -1720,45 +1825,29 @@ epub_document_load (EvDocument* document,
         return FALSE;
     }
 
-    extract_epub_from_container (uri,epub_document,&err);
-
-    if ( err )
+    if ( open_epub_archive (uri,epub_document,&err) == FALSE )
     {
         g_propagate_error( error,err );
         return FALSE;
     }
 
-    /*FIXME : can this be different, ever?*/
-    GString *containerpath = g_string_new(epub_document->tmp_archive_dir);
-    g_string_append_printf(containerpath,"/META-INF/container.xml");
-    gchar *containeruri = g_filename_to_uri(containerpath->str,NULL,&err);
-    g_string_free (containerpath, TRUE);
-
-    if ( err )
-    {
-        g_propagate_error(error,err);
-        return FALSE;
-    }
-
-    gchar *contentOpfUri = get_uri_to_content (containeruri,&err,epub_document);
-    g_free (containeruri);
+    epub_document->contentpath = get_path_to_content (epub_document,&err);
 
-    if ( contentOpfUri == NULL )
+    if ( epub_document->contentpath == NULL )
     {
         g_propagate_error(error,err);
         return FALSE;
     }
 
-    epub_document->docTitle = epub_document_set_document_title(contentOpfUri);
-    epub_document->index = setup_document_index(epub_document,contentOpfUri);
+    epub_document->docTitle = epub_document_set_document_title(epub_document,epub_document->contentpath);
+    epub_document->index = setup_document_index(epub_document,epub_document->contentpath);
 
-    epub_document->contentList = setup_document_content_list (contentOpfUri,&err,epub_document->documentdir);
+    epub_document->contentList = setup_document_content_list (epub_document,epub_document->contentpath,&err);
 
     if (epub_document->index != NULL && epub_document->contentList != NULL)
         epub_document_set_index_pages(epub_document->index, epub_document->contentList);
 
-    epub_document_add_mathJax(contentOpfUri,epub_document->documentdir);
-    g_free (contentOpfUri);
+    epub_document_add_mathJax(epub_document,epub_document->contentpath);
 
     if ( epub_document->contentList == NULL )
     {
@@ -1773,11 +1862,14 @@ static void
 epub_document_init (EpubDocument *epub_document)
 {
     epub_document->archivename = NULL ;
-    epub_document->tmp_archive_dir = NULL ;
     epub_document->contentList = NULL ;
     epub_document->documentdir = NULL;
     epub_document->index = NULL;
     epub_document->docTitle = NULL;
+    epub_document->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    epub_document->content_pages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    epub_document->mathml_pages = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_mutex_init (&epub_document->archive_lock);
 }
 
 static void
@@ -1785,10 +1877,21 @@ epub_document_finalize (GObject *object)
 {
     EpubDocument *epub_document = EPUB_DOCUMENT (object);
 
+    if (epub_document->id) {
+        G_LOCK (epub_documents);
+        GWeakRef *ref = g_hash_table_lookup (epub_documents, epub_document->id);
+        if (ref)
+            g_weak_ref_clear (ref);
+        g_hash_table_remove (epub_documents, epub_document->id);
+        G_UNLOCK (epub_documents);
+
+        g_free (epub_document->id);
+        epub_document->id = NULL;
+    }
+
     if (epub_document->epubDocument != NULL) {
-        if (epub_remove_temporary_dir (epub_document->tmp_archive_dir) == -1)
-            g_warning (_("There was an error deleting “%s”."),
-                       epub_document->tmp_archive_dir);
+        unzClose (epub_document->epubDocument);
+        epub_document->epubDocument = NULL;
     }
 
     if ( epub_document->contentList ) {
@@ -1801,10 +1904,10 @@ epub_document_finalize (GObject *object)
         epub_document->index = NULL;
     }
 
-    if ( epub_document->tmp_archive_dir) {
-        g_free (epub_document->tmp_archive_dir);
-        epub_document->tmp_archive_dir = NULL;
-    }
+    g_clear_pointer (&epub_document->entries, g_hash_table_destroy);
+    g_clear_pointer (&epub_document->content_pages, g_hash_table_destroy);
+    g_clear_pointer (&epub_document->mathml_pages, g_hash_table_destroy);
+    g_mutex_clear (&epub_document->archive_lock);
 
     if (epub_document->docTitle) {
         g_free(epub_document->docTitle);
@@ -1814,6 +1917,14 @@ epub_document_finalize (GObject *object)
         g_free (epub_document->archivename);
         epub_document->archivename = NULL;
     }
+    if ( epub_document->uri_base) {
+        g_free (epub_document->uri_base);
+        epub_document->uri_base = NULL;
+    }
+    if ( epub_document->contentpath) {
+        g_free (epub_document->contentpath);
+        epub_document->contentpath = NULL;
+    }
     if ( epub_document->documentdir) {
         g_free (epub_document->documentdir);
         epub_document->documentdir = NULL;
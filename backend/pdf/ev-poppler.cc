@@ -344,10 +344,18 @@ pdf_page_render (PopplerPage     *page,
 {
 	cairo_surface_t *surface;
 	cairo_t *cr;
+	cairo_rectangle_int_t clip;
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
+	if (ev_render_context_get_clip (rc, &clip)) {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      clip.width, clip.height);
+		cr = cairo_create (surface);
+		cairo_translate (cr, -clip.x, -clip.y);
+	} else {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      width, height);
+		cr = cairo_create (surface);
+	}
 
 	switch (rc->rotation) {
 	        case 90:
@@ -829,6 +837,12 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	ev_document_class->get_info = pdf_document_get_info;
 	ev_document_class->get_backend_info = pdf_document_get_backend_info;
 	ev_document_class->support_synctex = pdf_document_support_synctex;
+	/* Pages of one document share the poppler output device, so only
+	 * different documents can be used at the same time.
+	 */
+	ev_document_class->concurrency = (EvDocumentConcurrency) (EV_DOCUMENT_CONCURRENCY_DOCUMENTS |
+								  EV_DOCUMENT_CONCURRENCY_FONTCONFIG);
+	ev_document_class->render_clip = TRUE;
 }
 
 /* EvDocumentSecurity */
@@ -1425,10 +1439,8 @@ make_thumbnail_for_page (PopplerPage     *poppler_page,
 	GdkPixbuf *pixbuf;
 	cairo_surface_t *surface;
 
-	ev_document_fc_mutex_lock ();
 	surface = pdf_page_render (poppler_page, width, height, rc);
-	ev_document_fc_mutex_unlock ();
-	
+
 	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
 	cairo_surface_destroy (surface);
 
@@ -2041,15 +2053,12 @@ pdf_document_text_get_text_layout (EvDocumentText  *selection,
 }
 
 static PangoAttrList *
-pdf_document_text_get_text_attrs (EvDocumentText *document_text,
-                                  EvPage         *page)
+pdf_document_text_attrs_from_poppler (PopplerPage *poppler_page)
 {
 	GList         *backend_attrs_list,  *l;
 	PangoAttrList *attrs_list;
 
-	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), NULL);
-
-	backend_attrs_list = poppler_page_get_text_attributes (POPPLER_PAGE (page->backend_page));
+	backend_attrs_list = poppler_page_get_text_attributes (poppler_page);
 	if (!backend_attrs_list)
 		return NULL;
 
@@ -2092,6 +2101,45 @@ pdf_document_text_get_text_attrs (EvDocumentText *document_text,
 	return attrs_list;
 }
 
+static PangoAttrList *
+pdf_document_text_get_text_attrs (EvDocumentText *document_text,
+                                  EvPage         *page)
+{
+	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), NULL);
+
+	return pdf_document_text_attrs_from_poppler (POPPLER_PAGE (page->backend_page));
+}
+
+/* The text, the layout and the attributes all come from the text
+ * analysis that poppler keeps with the page, so it's done once here
+ * for the three of them, and the text mapping is derived from the
+ * layout instead of walking the page again for a selection region */
+static gboolean
+pdf_document_text_get_text_data (EvDocumentText *document_text,
+				 EvPage         *page,
+				 gchar         **text,
+				 EvRectangle   **areas,
+				 guint          *n_areas,
+				 PangoAttrList **attrs)
+{
+	PopplerPage *poppler_page;
+	gboolean     retval = TRUE;
+
+	g_return_val_if_fail (POPPLER_IS_PAGE (page->backend_page), FALSE);
+
+	poppler_page = POPPLER_PAGE (page->backend_page);
+
+	if (text)
+		*text = poppler_page_get_text (poppler_page);
+	if (areas)
+		retval = poppler_page_get_text_layout (poppler_page,
+						       (PopplerRectangle **)areas, n_areas);
+	if (attrs)
+		*attrs = pdf_document_text_attrs_from_poppler (poppler_page);
+
+	return retval;
+}
+
 static void
 pdf_document_text_iface_init (EvDocumentTextInterface *iface)
 {
@@ -2099,6 +2147,7 @@ pdf_document_text_iface_init (EvDocumentTextInterface *iface)
         iface->get_text = pdf_document_text_get_text;
         iface->get_text_layout = pdf_document_text_get_text_layout;
         iface->get_text_attrs = pdf_document_text_get_text_attrs;
+        iface->get_text_data = pdf_document_text_get_text_data;
 }
 
 /* Page Transitions */
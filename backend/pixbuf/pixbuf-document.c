@@ -35,6 +35,9 @@ struct _PixbufDocument
 	EvDocument parent_instance;
 
 	GdkPixbuf *pixbuf;
+	GMutex     pixbuf_mutex;
+	gint       width;
+	gint       height;
 
 	gchar *uri;
 };
@@ -57,25 +60,66 @@ pixbuf_document_load (EvDocument  *document,
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
 
 	gchar *filename;
-	GdkPixbuf *pixbuf;
+	GdkPixbuf *pixbuf = NULL;
+	gint width, height;
 
 	/* FIXME: We could actually load uris  */
 	filename = g_filename_from_uri (uri, NULL, error);
 	if (!filename)
 		return FALSE;
 
-	pixbuf = gdk_pixbuf_new_from_file (filename, error);
-
-	if (!pixbuf)
-		return FALSE;
+	/* Only read the image header when its size can be found there,
+	 * the image is decoded when it's first rendered. The header must
+	 * still be accepted by a loader, otherwise the whole image is
+	 * decoded to report why it can't be.
+	 */
+	if (!ev_document_misc_get_image_size_from_file (filename, &width, &height) ||
+	    !gdk_pixbuf_get_file_info (filename, NULL, NULL)) {
+		pixbuf = gdk_pixbuf_new_from_file (filename, error);
+		if (!pixbuf) {
+			g_free (filename);
+			return FALSE;
+		}
+
+		width = gdk_pixbuf_get_width (pixbuf);
+		height = gdk_pixbuf_get_height (pixbuf);
+	}
+	g_free (filename);
 
+	g_clear_object (&pixbuf_document->pixbuf);
 	pixbuf_document->pixbuf = pixbuf;
+	pixbuf_document->width = width;
+	pixbuf_document->height = height;
 	g_free (pixbuf_document->uri);
 	pixbuf_document->uri = g_strdup (uri);
 
 	return TRUE;
 }
 
+static GdkPixbuf *
+pixbuf_document_get_pixbuf (PixbufDocument *pixbuf_document)
+{
+	GdkPixbuf *pixbuf;
+
+	g_mutex_lock (&pixbuf_document->pixbuf_mutex);
+	if (!pixbuf_document->pixbuf) {
+		gchar  *filename;
+		GError *error = NULL;
+
+		filename = g_filename_from_uri (pixbuf_document->uri, NULL, NULL);
+		pixbuf_document->pixbuf = gdk_pixbuf_new_from_file (filename, &error);
+		if (!pixbuf_document->pixbuf) {
+			g_warning ("Error loading image %s: %s", filename, error->message);
+			g_error_free (error);
+		}
+		g_free (filename);
+	}
+	pixbuf = pixbuf_document->pixbuf ? g_object_ref (pixbuf_document->pixbuf) : NULL;
+	g_mutex_unlock (&pixbuf_document->pixbuf_mutex);
+
+	return pixbuf;
+}
+
 static gboolean
 pixbuf_document_save (EvDocument  *document,
 		      const char  *uri,
@@ -100,8 +144,8 @@ pixbuf_document_get_page_size (EvDocument   *document,
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
 
-	*width = gdk_pixbuf_get_width (pixbuf_document->pixbuf);
-	*height = gdk_pixbuf_get_height (pixbuf_document->pixbuf);
+	*width = pixbuf_document->width;
+	*height = pixbuf_document->height;
 }
 
 static cairo_surface_t *
@@ -109,14 +153,19 @@ pixbuf_document_render (EvDocument      *document,
 			EvRenderContext *rc)
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
-	GdkPixbuf *scaled_pixbuf, *rotated_pixbuf;
+	GdkPixbuf *pixbuf, *scaled_pixbuf, *rotated_pixbuf;
 	cairo_surface_t *surface;
 
+	pixbuf = pixbuf_document_get_pixbuf (pixbuf_document);
+	if (!pixbuf)
+		return NULL;
+
 	scaled_pixbuf = gdk_pixbuf_scale_simple (
-		pixbuf_document->pixbuf,
-		(gdk_pixbuf_get_width (pixbuf_document->pixbuf) * rc->scale) + 0.5,
-		(gdk_pixbuf_get_height (pixbuf_document->pixbuf) * rc->scale) + 0.5,
+		pixbuf,
+		(gdk_pixbuf_get_width (pixbuf) * rc->scale) + 0.5,
+		(gdk_pixbuf_get_height (pixbuf) * rc->scale) + 0.5,
 		GDK_INTERP_BILINEAR);
+	g_object_unref (pixbuf);
 
         rotated_pixbuf = gdk_pixbuf_rotate_simple (scaled_pixbuf, 360 - rc->rotation);
         g_object_unref (scaled_pixbuf);
@@ -132,7 +181,8 @@ pixbuf_document_finalize (GObject *object)
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (object);
 
-	g_object_unref (pixbuf_document->pixbuf);
+	g_clear_object (&pixbuf_document->pixbuf);
+	g_mutex_clear (&pixbuf_document->pixbuf_mutex);
 	g_free (pixbuf_document->uri);
 
 	G_OBJECT_CLASS (pixbuf_document_parent_class)->finalize (object);
@@ -151,6 +201,8 @@ pixbuf_document_class_init (PixbufDocumentClass *klass)
 	ev_document_class->get_n_pages = pixbuf_document_get_n_pages;
 	ev_document_class->get_page_size = pixbuf_document_get_page_size;
 	ev_document_class->render = pixbuf_document_render;
+	ev_document_class->concurrency = EV_DOCUMENT_CONCURRENCY_PAGES |
+					 EV_DOCUMENT_CONCURRENCY_FONTCONFIG;
 }
 
 static GdkPixbuf *
@@ -159,15 +211,20 @@ pixbuf_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document,
 					  gboolean              border)
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
-	GdkPixbuf *pixbuf, *rotated_pixbuf;
+	GdkPixbuf *source_pixbuf, *pixbuf, *rotated_pixbuf;
 	gint width, height;
 
-	width = (gint) (gdk_pixbuf_get_width (pixbuf_document->pixbuf) * rc->scale);
-	height = (gint) (gdk_pixbuf_get_height (pixbuf_document->pixbuf) * rc->scale);
+	source_pixbuf = pixbuf_document_get_pixbuf (pixbuf_document);
+	if (!source_pixbuf)
+		return NULL;
+
+	width = (gint) (gdk_pixbuf_get_width (source_pixbuf) * rc->scale);
+	height = (gint) (gdk_pixbuf_get_height (source_pixbuf) * rc->scale);
 
-	pixbuf = gdk_pixbuf_scale_simple (pixbuf_document->pixbuf,
+	pixbuf = gdk_pixbuf_scale_simple (source_pixbuf,
 					  width, height,
 					  GDK_INTERP_BILINEAR);
+	g_object_unref (source_pixbuf);
 
 	rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf, 360 - rc->rotation);
         g_object_unref (pixbuf);
@@ -182,8 +239,8 @@ pixbuf_document_thumbnails_get_dimensions (EvDocumentThumbnails *document,
 					   gint                 *height)
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
-	gint p_width = gdk_pixbuf_get_width (pixbuf_document->pixbuf);
-	gint p_height = gdk_pixbuf_get_height (pixbuf_document->pixbuf);
+	gint p_width = pixbuf_document->width;
+	gint p_height = pixbuf_document->height;
 
 	if (rc->rotation == 90 || rc->rotation == 270) {
 		*width = (gint) (p_height * rc->scale);
@@ -204,4 +261,5 @@ pixbuf_document_document_thumbnails_iface_init (EvDocumentThumbnailsInterface *i
 static void
 pixbuf_document_init (PixbufDocument *pixbuf_document)
 {
+	g_mutex_init (&pixbuf_document->pixbuf_mutex);
 }
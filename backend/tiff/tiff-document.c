@@ -24,6 +24,7 @@
 
 #include <config.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -210,195 +211,534 @@ tiff_document_get_page_size (EvDocument *document,
 	pop_handlers ();
 }
 
-static cairo_surface_t *
-tiff_document_render (EvDocument      *document,
-		      EvRenderContext *rc)
+/* libtiff packs pixels as ABGR and cairo as ARGB, so only the R and B
+ * bytes need to be swapped. The loop has no branches nor byte accesses
+ * so that compilers can vectorize it.
+ */
+static void
+tiff_document_rgba_to_argb (guint32 *pixels,
+			    gsize    n_pixels)
 {
-	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
-	int width, height;
-	float x_res, y_res;
-	gint rowstride, bytes;
-	guchar *pixels = NULL;
-	guchar *p;
-	int orientation;
-	cairo_surface_t *surface;
-	cairo_surface_t *rotated_surface;
-	static const cairo_user_data_key_t key;
+	gsize i;
 
-	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
-	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
+	for (i = 0; i < n_pixels; i++) {
+		guint32 p = pixels[i];
 
-	push_handlers ();
-	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
-		pop_handlers ();
-		g_warning("Failed to select page %d", rc->page->index);
-		return NULL;
+		pixels[i] = (p & 0xff00ff00) | ((p & 0xff) << 16) | ((p >> 16) & 0xff);
 	}
+}
 
-	if (!TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &width)) {
-		pop_handlers ();
-		g_warning("Failed to read image width");
-		return NULL;
-	}
+/* Strips larger than this many pixels are read one scanline at a time
+ * when subsampling, instead of being decoded whole into a band.
+ */
+#define TIFF_MAX_BAND_PIXELS (4 * 1024 * 1024)
 
-	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &height)) {
-		pop_handlers ();
-		g_warning("Failed to read image height");
-		return NULL;
+/* Whether the current image of @tiff can be read with TIFFReadScanline()
+ * and converted by tiff_document_scanline_to_rgba(): contiguous 8-bit
+ * RGB, JPEG YCbCr and grayscale, and bilevel images, stored top to bottom.
+ */
+static gboolean
+tiff_document_can_read_scanlines (TIFF *tiff,
+				  gint  orientation)
+{
+	guint16 photometric, bits_per_sample, samples_per_pixel, planar_config;
+	guint16 compression;
+
+	if (TIFFIsTiled (tiff) || orientation != ORIENTATION_TOPLEFT)
+		return FALSE;
+
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+		return FALSE;
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_PLANARCONFIG, &planar_config);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_COMPRESSION, &compression);
+
+	if (planar_config != PLANARCONFIG_CONTIG)
+		return FALSE;
+
+	switch (photometric) {
+	case PHOTOMETRIC_RGB:
+		return bits_per_sample == 8 && samples_per_pixel >= 3;
+	case PHOTOMETRIC_YCBCR:
+		if (compression != COMPRESSION_JPEG ||
+		    bits_per_sample != 8 || samples_per_pixel != 3)
+			return FALSE;
+
+		/* Let the JPEG codec convert to RGB, like TIFFRGBAImage does */
+		return TIFFSetField (tiff, TIFFTAG_JPEGCOLORMODE, JPEGCOLORMODE_RGB);
+	case PHOTOMETRIC_MINISBLACK:
+	case PHOTOMETRIC_MINISWHITE:
+		return (bits_per_sample == 8 && samples_per_pixel >= 1) ||
+		       (bits_per_sample == 1 && samples_per_pixel == 1);
+	default:
+		return FALSE;
 	}
+}
 
-	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_ORIENTATION, &orientation)) {
-		orientation = ORIENTATION_TOPLEFT;
+/* Converts a scanline of an image accepted by
+ * tiff_document_can_read_scanlines() to the ABGR layout of TIFFRGBAImage.
+ */
+static void
+tiff_document_scanline_to_rgba (TIFF          *tiff,
+				const guchar  *line,
+				guint32       *row,
+				guint32        width)
+{
+	guint16 photometric, bits_per_sample, samples_per_pixel;
+	guint32 x;
+
+	TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+
+	for (x = 0; x < width; x++) {
+		guint32 r, g, b;
+
+		if (photometric == PHOTOMETRIC_RGB || photometric == PHOTOMETRIC_YCBCR) {
+			const guchar *p = line + (gsize) x * samples_per_pixel;
+
+			r = p[0];
+			g = p[1];
+			b = p[2];
+		} else {
+			if (bits_per_sample == 1)
+				r = (line[x / 8] & (0x80 >> (x % 8))) ? 0xff : 0;
+			else
+				r = line[(gsize) x * samples_per_pixel];
+
+			if (photometric == PHOTOMETRIC_MINISWHITE)
+				r = 0xff - r;
+			g = b = r;
+		}
+
+		row[x] = 0xff000000 | b << 16 | g << 8 | r;
 	}
+}
 
-	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
+/* Selects the smallest reduced-resolution image of the current page
+ * that is still at least @target_width pixels wide, if the page has
+ * any in its SubIFDs. The page itself is selected otherwise.
+ */
+static void
+tiff_document_select_reduced_image (TiffDocument *tiff_document,
+				    gint          page,
+				    guint32       width,
+				    guint32       target_width)
+{
+	TIFF    *tiff = tiff_document->tiff;
+	guint16  n_subifds;
+	toff_t  *subifds;
+	toff_t  *offsets;
+	toff_t   best_offset = 0;
+	guint32  best_width = width;
+	gint     i;
+
+	if (!TIFFGetField (tiff, TIFFTAG_SUBIFD, &n_subifds, &subifds) || n_subifds == 0)
+		return;
 
-	pop_handlers ();
+	/* The array belongs to the current directory */
+	offsets = g_new (toff_t, n_subifds);
+	memcpy (offsets, subifds, n_subifds * sizeof (toff_t));
 
-	/* Sanity check the doc */
-	if (width <= 0 || height <= 0) {
-		g_warning("Invalid width or height.");
-		return NULL;
+	for (i = 0; i < n_subifds; i++) {
+		guint32 subfile_type = 0;
+		guint32 w;
+
+		if (!TIFFSetSubDirectory (tiff, offsets[i]))
+			continue;
+
+		TIFFGetField (tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+		if (!(subfile_type & FILETYPE_REDUCEDIMAGE))
+			continue;
+
+		if (TIFFGetField (tiff, TIFFTAG_IMAGEWIDTH, &w) &&
+		    w >= target_width && w < best_width) {
+			best_offset = offsets[i];
+			best_width = w;
+		}
 	}
 
-	rowstride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
-	if (rowstride / 4 != width) {
-		g_warning("Overflow while rendering document.");
+	if (best_offset == 0 || !TIFFSetSubDirectory (tiff, best_offset))
+		TIFFSetDirectory (tiff, page);
+
+	g_free (offsets);
+}
+
+/* Reads the rows @y_start to @y_end of the current image of @tiff into
+ * a surface @factor times smaller than them, averaging every @factor x
+ * @factor block of pixels. @y_start must be a multiple of @factor. The
+ * image is decoded one strip or one row of tiles at a time, so only the
+ * output surface has to fit in memory, and the strips outside the rows
+ * aren't decoded at all.
+ */
+static cairo_surface_t *
+tiff_document_read_image (TIFF    *tiff,
+			  guint32  width,
+			  guint32  height,
+			  guint32  y_start,
+			  guint32  y_end,
+			  gint     orientation,
+			  guint32  factor)
+{
+	TIFFRGBAImage    img;
+	char             emsg[1024];
+	gboolean         scanlines = FALSE;
+	guchar          *line = NULL;
+	cairo_surface_t *surface;
+	guchar          *data;
+	gint             rowstride;
+	guint32          out_width, out_height;
+	guint32          band_height = 0;
+	guint32         *band = NULL;
+	guint32         *sums = NULL;
+	guint32          y, n_rows;
+	gboolean         retval = TRUE;
+
+	g_assert (y_start % factor == 0 && y_start < y_end && y_end <= height);
+
+	out_width = (width + factor - 1) / factor;
+	out_height = (y_end - y_start + factor - 1) / factor;
+
+	rowstride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, out_width);
+	if (rowstride / 4 != out_width || out_height >= INT_MAX / rowstride) {
 		/* overflow, or cairo was changed in an unsupported way */
+		g_warning ("Overflow while rendering document.");
 		return NULL;
 	}
 
-	if (height >= INT_MAX / rowstride) {
-		g_warning("Overflow while rendering document.");
-		/* overflow */
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, out_width, out_height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		g_warning ("Failed to allocate memory for rendering.");
+		cairo_surface_destroy (surface);
 		return NULL;
 	}
 
-	bytes = height * rowstride;
+	if (TIFFIsTiled (tiff))
+		TIFFGetField (tiff, TIFFTAG_TILELENGTH, &band_height);
+	else
+		TIFFGetFieldDefaulted (tiff, TIFFTAG_ROWSPERSTRIP, &band_height);
+	band_height = CLAMP (band_height, 1, height);
+
+	/* Reading less than a strip with TIFFRGBAImageGet() would decode it
+	 * again for every band. Large strips, like the single strip holding
+	 * a whole page, are read by scanline instead when possible.
+	 */
+	if (factor > 1 && (gsize) width * band_height > TIFF_MAX_BAND_PIXELS &&
+	    tiff_document_can_read_scanlines (tiff, orientation)) {
+		scanlines = TRUE;
+		band_height = 1;
+	}
 
-	pixels = g_try_malloc (bytes);
-	if (!pixels) {
-		g_warning("Failed to allocate memory for rendering.");
+	if (factor > 1 && (gsize) width * band_height >= G_MAXSIZE / 4) {
+		g_warning ("Overflow while rendering document.");
+		cairo_surface_destroy (surface);
 		return NULL;
 	}
 
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32 *)pixels,
-					orientation, 0)) {
+	if (!scanlines) {
+		if (!TIFFRGBAImageOK (tiff, emsg) || !TIFFRGBAImageBegin (&img, tiff, 0, emsg)) {
+			g_warning ("Failed to read TIFF image: %s", emsg);
+			cairo_surface_destroy (surface);
+			return NULL;
+		}
+		img.req_orientation = orientation;
+	}
+
+	cairo_surface_flush (surface);
+	data = cairo_image_surface_get_data (surface);
+
+	if (factor > 1) {
+		band = g_try_malloc ((gsize) width * band_height * 4);
+		sums = g_try_new0 (guint32, (gsize) out_width * 3);
+		if (scanlines)
+			line = g_try_malloc (TIFFScanlineSize (tiff));
+		if (!band || !sums || (scanlines && !line)) {
+			g_warning ("Failed to allocate memory for rendering.");
+			retval = FALSE;
+		}
+	}
+
+	/* Bands follow the strips, so that none is decoded twice */
+	for (y = y_start; retval && y < y_end; y += n_rows) {
+		guint32 r;
+
+		n_rows = MIN (band_height - y % band_height, y_end - y);
+
+		if (scanlines) {
+			retval = TIFFReadScanline (tiff, line, y, 0) == 1;
+			if (retval)
+				tiff_document_scanline_to_rgba (tiff, line, band, width);
+		} else {
+			img.row_offset = y;
+		}
+
+		/* Full resolution bands are decoded in place */
+		if (factor == 1) {
+			guint32 *pixels = (guint32 *) (data + (gsize) (y - y_start) * rowstride);
+
+			retval = TIFFRGBAImageGet (&img, pixels, width, n_rows);
+			tiff_document_rgba_to_argb (pixels, (gsize) width * n_rows);
+			continue;
+		}
+
+		if (!scanlines)
+			retval = TIFFRGBAImageGet (&img, band, width, n_rows);
+		if (!retval)
+			break;
+
+		for (r = 0; r < n_rows; r++) {
+			const guint32 *row = band + (gsize) r * width;
+			guint32        in_y = y + r;
+			guint32        x;
+
+			for (x = 0; x < width; x++) {
+				guint32 *sum = sums + (x / factor) * 3;
+
+				sum[0] += TIFFGetR (row[x]);
+				sum[1] += TIFFGetG (row[x]);
+				sum[2] += TIFFGetB (row[x]);
+			}
+
+			if ((in_y + 1) % factor == 0 || in_y + 1 == y_end) {
+				guint32 *out = (guint32 *) (data + (gsize) ((in_y - y_start) / factor) * rowstride);
+				guint32  block_height = in_y % factor + 1;
+				guint32  ox;
+
+				for (ox = 0; ox < out_width; ox++) {
+					guint32  block_width = MIN (factor, width - ox * factor);
+					guint32  n = block_width * block_height;
+					guint32 *sum = sums + ox * 3;
+
+					out[ox] = 0xff000000 |
+						(sum[0] / n) << 16 |
+						(sum[1] / n) << 8 |
+						(sum[2] / n);
+				}
+				memset (sums, 0, (gsize) out_width * 3 * sizeof (guint32));
+			}
+		}
+	}
+
+	if (!scanlines)
+		TIFFRGBAImageEnd (&img);
+	g_free (band);
+	g_free (sums);
+	g_free (line);
+
+	if (!retval) {
 		g_warning ("Failed to read TIFF image.");
-		g_free (pixels);
+		cairo_surface_destroy (surface);
 		return NULL;
 	}
 
-	surface = cairo_image_surface_create_for_data (pixels,
-						       CAIRO_FORMAT_RGB24,
-						       width, height,
-						       rowstride);
-	cairo_surface_set_user_data (surface, &key,
-				     pixels, (cairo_destroy_func_t)g_free);
-	pop_handlers ();
+	cairo_surface_mark_dirty (surface);
 
-	/* Convert the format returned by libtiff to
-	* what cairo expects
-	*/
-	p = pixels;
-	while (p < pixels + bytes) {
-		guint32 *pixel = (guint32*)p;
-		guint8 r = TIFFGetR(*pixel);
-		guint8 g = TIFFGetG(*pixel);
-		guint8 b = TIFFGetB(*pixel);
-		guint8 a = TIFFGetA(*pixel);
+	return surface;
+}
+
+/* The rows of the unrotated page, @width x @height at the render scale,
+ * that @clip of the page rotated by @rotation covers */
+static void
+tiff_document_get_clip_rows (cairo_rectangle_int_t *clip,
+			     gint                   width,
+			     gint                   height,
+			     gint                   rotation,
+			     gint                  *y_start,
+			     gint                  *y_end)
+{
+	switch (rotation) {
+	case 90:
+		*y_start = height - clip->x - clip->width;
+		*y_end = height - clip->x;
+		break;
+	case 180:
+		*y_start = height - clip->y - clip->height;
+		*y_end = height - clip->y;
+		break;
+	case 270:
+		*y_start = clip->x;
+		*y_end = clip->x + clip->width;
+		break;
+	default:
+		*y_start = clip->y;
+		*y_end = clip->y + clip->height;
+	}
+
+	*y_start = CLAMP (*y_start, 0, height);
+	*y_end = CLAMP (*y_end, *y_start, height);
+}
 
-		*pixel = (a << 24) | (r << 16) | (g << 8) | b;
+/* Paints @surface, the rows of the image from @y_offset on, into a
+ * surface of the size of @clip, like ev_document_misc_surface_rotate_and_scale()
+ * would scale the whole image to @width x @height and rotate it */
+static cairo_surface_t *
+tiff_document_paint_clip (cairo_surface_t       *surface,
+			  gint                   y_offset,
+			  gdouble                x_scale,
+			  gdouble                y_scale,
+			  gint                   width,
+			  gint                   height,
+			  gint                   rotation,
+			  cairo_rectangle_int_t *clip)
+{
+	cairo_surface_t *clip_surface;
+	cairo_t         *cr;
+	gint             rotated_width = width;
+	gint             rotated_height = height;
+
+	if (rotation == 90 || rotation == 270) {
+		rotated_width = height;
+		rotated_height = width;
+	}
 
-		p += 4;
+	clip_surface = cairo_surface_create_similar (surface,
+						     cairo_surface_get_content (surface),
+						     clip->width, clip->height);
+
+	cr = cairo_create (clip_surface);
+	cairo_translate (cr, -clip->x, -clip->y);
+	switch (rotation) {
+	case 90:
+		cairo_translate (cr, rotated_width, 0);
+		break;
+	case 180:
+		cairo_translate (cr, rotated_width, rotated_height);
+		break;
+	case 270:
+		cairo_translate (cr, 0, rotated_height);
+		break;
 	}
+	cairo_rotate (cr, rotation * G_PI / 180.0);
+	cairo_scale (cr, x_scale, y_scale);
 
-	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
-								     (width * rc->scale) + 0.5,
-								     (height * rc->scale * (x_res / y_res)) + 0.5,
-								     rc->rotation);
-	cairo_surface_destroy (surface);
+	cairo_set_source_surface (cr, surface, 0, y_offset);
+	cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BILINEAR);
+	cairo_paint (cr);
+	cairo_destroy (cr);
 
-	return rotated_surface;
+	return clip_surface;
 }
 
-static GdkPixbuf *
-tiff_document_render_pixbuf (EvDocument      *document,
-			     EvRenderContext *rc)
+static cairo_surface_t *
+tiff_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
 {
 	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
-	int width, height;
+	guint32 width, height;
+	guint32 image_width, image_height;
+	gint target_width, target_height;
+	guint32 factor;
+	guint32 y_start, y_end;
 	float x_res, y_res;
-	gint rowstride, bytes;
-	guchar *pixels = NULL;
-	GdkPixbuf *pixbuf;
-	GdkPixbuf *scaled_pixbuf;
-	GdkPixbuf *rotated_pixbuf;
+	guint16 orientation;
+	cairo_rectangle_int_t clip;
+	gboolean has_clip;
+	cairo_surface_t *surface;
+	cairo_surface_t *rotated_surface;
+
+	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
+	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
 
 	push_handlers ();
 	if (TIFFSetDirectory (tiff_document->tiff, rc->page->index) != 1) {
 		pop_handlers ();
+		g_warning("Failed to select page %d", rc->page->index);
 		return NULL;
 	}
 
 	if (!TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &width)) {
 		pop_handlers ();
+		g_warning("Failed to read image width");
 		return NULL;
 	}
 
 	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &height)) {
 		pop_handlers ();
+		g_warning("Failed to read image height");
 		return NULL;
 	}
 
 	tiff_document_get_resolution (tiff_document, &x_res, &y_res);
 
-	pop_handlers ();
-
 	/* Sanity check the doc */
-	if (width <= 0 || height <= 0)
-		return NULL;
-
-	if (width >= INT_MAX / 4)
-		/* overflow */
+	if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX) {
+		pop_handlers ();
+		g_warning("Invalid width or height.");
 		return NULL;
+	}
 
-	rowstride = width * 4;
-
-	if (height >= INT_MAX / rowstride)
-		/* overflow */
-		return NULL;
-	bytes = height * rowstride;
+	target_width = MAX ((width * rc->scale) + 0.5, 1);
+	target_height = MAX ((height * rc->scale * (x_res / y_res)) + 0.5, 1);
+
+	/* Small scales are read from a pyramid level when there is one,
+	 * and subsampled otherwise.
+	 */
+	image_width = width;
+	image_height = height;
+	if (target_width < width) {
+		tiff_document_select_reduced_image (tiff_document, rc->page->index,
+						    width, target_width);
+		TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGEWIDTH, &image_width);
+		TIFFGetField (tiff_document->tiff, TIFFTAG_IMAGELENGTH, &image_height);
+		if (image_width == 0 || image_height == 0) {
+			TIFFSetDirectory (tiff_document->tiff, rc->page->index);
+			image_width = width;
+			image_height = height;
+		}
+	}
 
-	pixels = g_try_malloc (bytes);
-	if (!pixels)
-		return NULL;
+	if (! TIFFGetField (tiff_document->tiff, TIFFTAG_ORIENTATION, &orientation)) {
+		orientation = ORIENTATION_TOPLEFT;
+	}
 
-	if (!TIFFReadRGBAImageOriented (tiff_document->tiff,
-					width, height,
-					(uint32 *)pixels,
-					ORIENTATION_TOPLEFT, 0)) {
-		g_free (pixels);
-		return NULL;
+	factor = MAX (1, MIN (image_width / target_width,
+			      image_height / target_height));
+
+	/* Only the strips holding the rows in the clip are read, with a
+	 * row of margin for the interpolation */
+	y_start = 0;
+	y_end = image_height;
+	has_clip = ev_render_context_get_clip (rc, &clip);
+	if (has_clip) {
+		gint clip_start, clip_end;
+
+		tiff_document_get_clip_rows (&clip, target_width, target_height,
+					     rc->rotation, &clip_start, &clip_end);
+		y_start = (guint32) ((gdouble) clip_start * image_height / target_height);
+		y_end = (guint32) ((gdouble) clip_end * image_height / target_height + 0.5);
+		y_start = MAX ((gint64) y_start - (gint64) factor, 0);
+		y_start -= y_start % factor;
+		y_end = CLAMP (y_end + factor, y_start + 1, image_height);
 	}
 
-	pixbuf = gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB, TRUE, 8,
-					   width, height, rowstride,
-					   (GdkPixbufDestroyNotify) g_free, NULL);
+	surface = tiff_document_read_image (tiff_document->tiff,
+					    image_width, image_height,
+					    y_start, y_end,
+					    orientation, factor);
 	pop_handlers ();
 
-	scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-						 width * rc->scale,
-						 height * rc->scale * (x_res / y_res),
-						 GDK_INTERP_BILINEAR);
-	g_object_unref (pixbuf);
+	if (!surface)
+		return NULL;
 
-	rotated_pixbuf = gdk_pixbuf_rotate_simple (scaled_pixbuf, 360 - rc->rotation);
-	g_object_unref (scaled_pixbuf);
+	if (has_clip) {
+		guint32 out_width = (image_width + factor - 1) / factor;
+		guint32 out_height = (image_height + factor - 1) / factor;
 
-	return rotated_pixbuf;
+		rotated_surface = tiff_document_paint_clip (surface, y_start / factor,
+							    (gdouble) target_width / out_width,
+							    (gdouble) target_height / out_height,
+							    target_width, target_height,
+							    rc->rotation, &clip);
+	} else {
+		rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
+									     target_width,
+									     target_height,
+									     rc->rotation);
+	}
+	cairo_surface_destroy (surface);
+
+	return rotated_surface;
 }
 
 static gchar *
@@ -443,6 +783,9 @@ tiff_document_class_init (TiffDocumentClass *klass)
 	ev_document_class->get_page_size = tiff_document_get_page_size;
 	ev_document_class->render = tiff_document_render;
 	ev_document_class->get_page_label = tiff_document_get_page_label;
+	/* libtiff error handlers are process-wide */
+	ev_document_class->concurrency = EV_DOCUMENT_CONCURRENCY_FONTCONFIG;
+	ev_document_class->render_clip = TRUE;
 }
 
 static GdkPixbuf *
@@ -450,9 +793,15 @@ tiff_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document,
 					EvRenderContext      *rc,
 					gboolean              border)
 {
+	cairo_surface_t *surface;
 	GdkPixbuf *pixbuf;
 
-	pixbuf = tiff_document_render_pixbuf (EV_DOCUMENT (document), rc);
+	surface = tiff_document_render (EV_DOCUMENT (document), rc);
+	if (!surface)
+		return NULL;
+
+	pixbuf = ev_document_misc_pixbuf_from_surface (surface);
+	cairo_surface_destroy (surface);
 
 	if (border) {
 		GdkPixbuf *tmp_pixbuf = pixbuf;
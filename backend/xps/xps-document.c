@@ -208,6 +208,7 @@ xps_document_render (EvDocument      *document,
 	guint            width, height;
 	cairo_surface_t *surface;
 	cairo_t         *cr;
+	cairo_rectangle_int_t clip;
 	GError          *error = NULL;
 
 	xps_page = GXPS_PAGE (rc->page->backend_page);
@@ -221,9 +222,16 @@ xps_document_render (EvDocument      *document,
 		height = (guint) ((page_height * rc->scale) + 0.5);
 	}
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
+	if (ev_render_context_get_clip (rc, &clip)) {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      clip.width, clip.height);
+		cr = cairo_create (surface);
+		cairo_translate (cr, -clip.x, -clip.y);
+	} else {
+		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+						      width, height);
+		cr = cairo_create (surface);
+	}
 
 	cairo_set_source_rgb (cr, 1., 1., 1.);
 	cairo_paint (cr);
@@ -272,6 +280,8 @@ xps_document_class_init (XPSDocumentClass *klass)
 	ev_document_class->get_info = xps_document_get_info;
 	ev_document_class->get_backend_info = xps_document_get_backend_info;
 	ev_document_class->render = xps_document_render;
+	ev_document_class->concurrency = EV_DOCUMENT_CONCURRENCY_DOCUMENTS;
+	ev_document_class->render_clip = TRUE;
 }
 
 /* EvDocumentLinks */
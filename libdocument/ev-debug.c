@@ -44,6 +44,8 @@
 static EvDebugSection ev_debug = EV_NO_DEBUG;
 static EvProfileSection ev_profile = EV_NO_PROFILE;
 
+/* Jobs are profiled from several scheduler threads */
+G_LOCK_DEFINE_STATIC (timers);
 static GHashTable *timers = NULL;
 
 static void
@@ -136,13 +138,16 @@ ev_profiler_start (EvProfileSection section,
 		name = g_strdup_vprintf (format, args);
 		va_end (args);
 
+		G_LOCK (timers);
 		timer = g_hash_table_lookup (timers, name);
 		if (!timer) {
 			timer = g_timer_new ();
-			g_hash_table_insert (timers, g_strdup (name), timer);
+			g_hash_table_insert (timers, name, timer);
 		} else {
 			g_timer_start (timer);
+			g_free (name);
 		}
+		G_UNLOCK (timers);
 	}
 }
 
@@ -163,14 +168,47 @@ ev_profiler_stop (EvProfileSection section,
 		name = g_strdup_vprintf (format, args);
 		va_end (args);
 
+		G_LOCK (timers);
 		timer = g_hash_table_lookup (timers, name);
-		if (!timer)
+		if (!timer) {
+			G_UNLOCK (timers);
+			g_free (name);
 			return;
+		}
 
 		g_timer_stop (timer);
 		seconds = g_timer_elapsed (timer, NULL);
+		/* Names often contain a pointer, don't keep them around */
+		g_hash_table_remove (timers, name);
+		G_UNLOCK (timers);
+
 		g_print ("[ %s ] %f s elapsed\n", name, seconds);
 		fflush (stdout);
+		g_free (name);
+	}
+}
+
+/* Drops a timer that won't be stopped, without printing it */
+void
+ev_profiler_cancel (EvProfileSection section,
+		    const gchar     *format, ...)
+{
+	if (G_UNLIKELY (ev_profile & section)) {
+		gchar  *name;
+		va_list args;
+
+		if (!format)
+			return;
+
+		va_start (args, format);
+		name = g_strdup_vprintf (format, args);
+		va_end (args);
+
+		G_LOCK (timers);
+		g_hash_table_remove (timers, name);
+		G_UNLOCK (timers);
+
+		g_free (name);
 	}
 }
 
@@ -51,14 +51,17 @@
 #define ev_debug_message(section, format, args...) G_STMT_START { } G_STMT_END
 #define ev_profiler_start(format, args...) G_STMT_START { } G_STMT_END
 #define ev_profiler_stop(format, args...) G_STMT_START { } G_STMT_END
+#define ev_profiler_cancel(format, args...) G_STMT_START { } G_STMT_END
 #elif defined(G_HAVE_ISO_VARARGS)
 #define ev_debug_message(...) G_STMT_START { } G_STMT_END
 #define ev_profiler_start(...) G_STMT_START { } G_STMT_END
 #define ev_profiler_stop(...) G_STMT_START { } G_STMT_END
+#define ev_profiler_cancel(...) G_STMT_START { } G_STMT_END
 #else /* no varargs macros */
 static void ev_debug_message(EvDebugSection section, const gchar *file, gint line, const gchar *function, const gchar *format, ...) {}
 static void ev_profiler_start(EvProfileSection section,	const gchar *format, ...) {}
 static void ev_profiler_stop(EvProfileSection section, const gchar *format, ...) {}
+static void ev_profiler_cancel(EvProfileSection section, const gchar *format, ...) {}
 #endif
 
 #else /* ENABLE_DEBUG */
@@ -99,6 +102,8 @@ void ev_profiler_start (EvProfileSection section,
 			const gchar     *format, ...) G_GNUC_PRINTF(2, 3);
 void ev_profiler_stop  (EvProfileSection section,
 			const gchar     *format, ...) G_GNUC_PRINTF(2, 3);
+void ev_profiler_cancel (EvProfileSection section,
+			 const gchar     *format, ...) G_GNUC_PRINTF(2, 3);
 
 G_END_DECLS
 
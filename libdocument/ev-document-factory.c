@@ -205,6 +205,25 @@ free_uncompressed_uri (gchar *uri_unc)
  */
 EvDocument *
 ev_document_factory_get_document (const char *uri, GError **error)
+{
+	return ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_factory_get_document_full:
+ * @uri: an URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Like ev_document_factory_get_document(), but the document is loaded
+ * with ev_document_load_full() using @flags.
+ *
+ * Returns: (transfer full): a new #EvDocument, or %NULL.
+ */
+EvDocument *
+ev_document_factory_get_document_full (const char          *uri,
+				       EvDocumentLoadFlags  flags,
+				       GError             **error)
 {
 	EvDocument *document;
 	int result;
@@ -231,7 +250,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 			return NULL;
 		}
 
-		result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+		result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 
 		if (result == FALSE || err) {
 			if (err &&
@@ -273,7 +292,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 		return NULL;
 	}
 
-	result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+	result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
@@ -297,6 +316,53 @@ ev_document_factory_get_document (const char *uri, GError **error)
 	return document;
 }
 
+/**
+ * ev_document_factory_new_document:
+ * @uri: an URI
+ * @fast: whether to use fast MIME type detection
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Creates a #EvDocument for the document at @uri without loading it, so
+ * that the caller can take the locks the backend needs, see
+ * ev_document_get_concurrency(). A compressed document is uncompressed
+ * first, the document must then be loaded from the URI stored in its
+ * "uri-uncompressed" data if it is set.
+ *
+ * Returns: (transfer full): a new #EvDocument, or %NULL.
+ */
+EvDocument *
+ev_document_factory_new_document (const char *uri,
+				  gboolean    fast,
+				  GError    **error)
+{
+	EvDocument *document;
+	EvCompressionType compression;
+	gchar *uri_unc;
+	GError *err = NULL;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	document = get_document_from_uri (uri, fast, &compression, error);
+	if (document == NULL)
+		return NULL;
+
+	uri_unc = ev_file_uncompress (uri, compression, &err);
+	if (uri_unc) {
+		g_object_set_data_full (G_OBJECT (document),
+					"uri-uncompressed",
+					uri_unc,
+					(GDestroyNotify) free_uncompressed_uri);
+	} else if (err != NULL) {
+		/* Error uncompressing file */
+		g_propagate_error (error, err);
+
+		g_object_unref (document);
+		return NULL;
+	}
+
+	return document;
+}
+
 static void
 file_filter_add_mime_types (EvTypeInfo *info, GtkFileFilter *filter)
 {
@@ -32,6 +32,12 @@
 G_BEGIN_DECLS
 
 EvDocument* ev_document_factory_get_document (const char *uri, GError **error);
+EvDocument* ev_document_factory_get_document_full (const char          *uri,
+						   EvDocumentLoadFlags  flags,
+						   GError             **error);
+EvDocument* ev_document_factory_new_document (const char *uri,
+					      gboolean    fast,
+					      GError    **error);
 void 	    ev_document_factory_add_filters  (GtkWidget *chooser, EvDocument *document);
 
 G_END_DECLS
@@ -22,8 +22,10 @@
 
 #include <string.h>
 #include <math.h>
+#include <stdio.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 
@@ -404,3 +406,228 @@ ev_document_misc_get_pointer_position (GtkWidget *widget,
         if (y)
                 *y -= allocation.y;
 }
+
+#define IMAGE_HEADER_CHUNK_SIZE 4096
+#define IMAGE_HEADER_MAX_SIZE   (1024 * 1024)
+
+#define GET_BE16(p) ((guint) (p)[0] << 8 | (p)[1])
+#define GET_BE32(p) ((guint32) (p)[0] << 24 | (guint32) (p)[1] << 16 | (guint32) (p)[2] << 8 | (p)[3])
+#define GET_LE16(p) ((guint) (p)[1] << 8 | (p)[0])
+#define GET_LE24(p) ((guint32) (p)[2] << 16 | (guint32) (p)[1] << 8 | (p)[0])
+#define GET_LE32(p) ((guint32) (p)[3] << 24 | (guint32) (p)[2] << 16 | (guint32) (p)[1] << 8 | (p)[0])
+
+static gboolean
+is_jpeg (const guchar *data,
+	 gsize         length)
+{
+	return length >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff;
+}
+
+static gboolean
+get_jpeg_size (const guchar *data,
+	       gsize         length,
+	       gint         *width,
+	       gint         *height)
+{
+	gsize pos = 2;
+
+	while (pos + 4 <= length) {
+		guchar marker;
+
+		if (data[pos] != 0xff)
+			return FALSE;
+
+		/* Markers may be preceded by any number of fill bytes */
+		while (pos + 1 < length && data[pos + 1] == 0xff)
+			pos++;
+		if (pos + 4 > length)
+			return FALSE;
+
+		marker = data[pos + 1];
+		if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7)) {
+			pos += 2;
+			continue;
+		}
+
+		/* Start of scan or end of image without a frame header */
+		if (marker == 0xd9 || marker == 0xda)
+			return FALSE;
+
+		/* SOFn, except DHT, JPG and DAC that share the range */
+		if (marker >= 0xc0 && marker <= 0xcf &&
+		    marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+			if (pos + 9 > length)
+				return FALSE;
+
+			*height = GET_BE16 (data + pos + 5);
+			*width = GET_BE16 (data + pos + 7);
+
+			/* A height of 0 is defined later by a DNL marker */
+			return *width > 0 && *height > 0;
+		}
+
+		pos += 2 + GET_BE16 (data + pos + 2);
+	}
+
+	return FALSE;
+}
+
+static gboolean
+get_webp_size (const guchar *data,
+	       gsize         length,
+	       gint         *width,
+	       gint         *height)
+{
+	if (length < 30)
+		return FALSE;
+
+	if (memcmp (data + 12, "VP8 ", 4) == 0) {
+		if (data[23] != 0x9d || data[24] != 0x01 || data[25] != 0x2a)
+			return FALSE;
+		*width = GET_LE16 (data + 26) & 0x3fff;
+		*height = GET_LE16 (data + 28) & 0x3fff;
+	} else if (memcmp (data + 12, "VP8L", 4) == 0) {
+		guint32 bits;
+
+		if (data[20] != 0x2f)
+			return FALSE;
+		bits = GET_LE32 (data + 21);
+		*width = (bits & 0x3fff) + 1;
+		*height = ((bits >> 14) & 0x3fff) + 1;
+	} else if (memcmp (data + 12, "VP8X", 4) == 0) {
+		*width = GET_LE24 (data + 24) + 1;
+		*height = GET_LE24 (data + 27) + 1;
+	} else {
+		return FALSE;
+	}
+
+	return *width > 0 && *height > 0;
+}
+
+static gboolean
+get_bmp_size (const guchar *data,
+	      gsize         length,
+	      gint         *width,
+	      gint         *height)
+{
+	guint32 header_size;
+
+	if (length < 26)
+		return FALSE;
+
+	header_size = GET_LE32 (data + 14);
+	if (header_size == 12) {
+		/* OS/2 1.x BITMAPCOREHEADER */
+		*width = GET_LE16 (data + 18);
+		*height = GET_LE16 (data + 20);
+	} else if (header_size >= 40) {
+		/* Bottom-up bitmaps have a negative height */
+		*width = (gint32) GET_LE32 (data + 18);
+		*height = ABS ((gint32) GET_LE32 (data + 22));
+	} else {
+		return FALSE;
+	}
+
+	return *width > 0 && *height > 0;
+}
+
+/**
+ * ev_document_misc_get_image_size_from_data:
+ * @data: (array length=length): the first bytes of an image file
+ * @length: the length of @data
+ * @width: (out): return location for the image width
+ * @height: (out): return location for the image height
+ *
+ * Reads the size of a JPEG, PNG, GIF, WebP or BMP image from its header,
+ * without decoding the image.
+ *
+ * Returns: %TRUE if the size was found in @data, %FALSE if the format is
+ * not known or @data doesn't contain the whole header
+ */
+gboolean
+ev_document_misc_get_image_size_from_data (const guchar *data,
+					   gsize         length,
+					   gint         *width,
+					   gint         *height)
+{
+	gint w = 0, h = 0;
+	gboolean retval = FALSE;
+
+	if (is_jpeg (data, length)) {
+		retval = get_jpeg_size (data, length, &w, &h);
+	} else if (length >= 24 && memcmp (data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+		if (memcmp (data + 12, "IHDR", 4) == 0) {
+			w = GET_BE32 (data + 16);
+			h = GET_BE32 (data + 20);
+			retval = w > 0 && h > 0;
+		}
+	} else if (length >= 10 && (memcmp (data, "GIF87a", 6) == 0 ||
+				    memcmp (data, "GIF89a", 6) == 0)) {
+		w = GET_LE16 (data + 6);
+		h = GET_LE16 (data + 8);
+		retval = w > 0 && h > 0;
+	} else if (length >= 12 && memcmp (data, "RIFF", 4) == 0 &&
+		   memcmp (data + 8, "WEBP", 4) == 0) {
+		retval = get_webp_size (data, length, &w, &h);
+	} else if (length >= 2 && data[0] == 'B' && data[1] == 'M') {
+		retval = get_bmp_size (data, length, &w, &h);
+	}
+
+	if (!retval)
+		return FALSE;
+
+	if (width)
+		*width = w;
+	if (height)
+		*height = h;
+
+	return TRUE;
+}
+
+/**
+ * ev_document_misc_get_image_size_from_file:
+ * @filename: the path of an image file
+ * @width: (out): return location for the image width
+ * @height: (out): return location for the image height
+ *
+ * Like ev_document_misc_get_image_size_from_data(), reading only as much
+ * of @filename as needed to find the image size.
+ *
+ * Returns: %TRUE if the size was found
+ */
+gboolean
+ev_document_misc_get_image_size_from_file (const gchar *filename,
+					   gint        *width,
+					   gint        *height)
+{
+	FILE    *file;
+	guchar  *data = NULL;
+	gsize    length = 0;
+	gsize    size = 0;
+	gboolean retval = FALSE;
+
+	file = g_fopen (filename, "rb");
+	if (!file)
+		return FALSE;
+
+	/* Only JPEG files may need more than the first chunk, they can
+	 * have large EXIF segments before the frame header.
+	 */
+	while (size < IMAGE_HEADER_MAX_SIZE) {
+		gsize bytes;
+
+		size = size ? size * 4 : IMAGE_HEADER_CHUNK_SIZE;
+		data = g_realloc (data, size);
+		bytes = fread (data + length, 1, size - length, file);
+		length += bytes;
+
+		retval = ev_document_misc_get_image_size_from_data (data, length, width, height);
+		if (retval || length < size || !is_jpeg (data, length))
+			break;
+	}
+
+	g_free (data);
+	fclose (file);
+
+	return retval;
+}
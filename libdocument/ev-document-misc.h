@@ -65,6 +65,14 @@ gdouble          ev_document_misc_get_monitor_dpi (GdkMonitor *monitor);
 
 gchar           *ev_document_misc_format_date (gint64 utime);
 
+gboolean         ev_document_misc_get_image_size_from_data (const guchar *data,
+							    gsize         length,
+							    gint         *width,
+							    gint         *height);
+gboolean         ev_document_misc_get_image_size_from_file (const gchar  *filename,
+							    gint         *width,
+							    gint         *height);
+
 void             ev_document_misc_get_pointer_position (GtkWidget *widget,
 							gint      *x,
 							gint      *y);
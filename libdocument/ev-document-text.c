@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include "ev-document-text.h"
 
 G_DEFINE_INTERFACE (EvDocumentText, ev_document_text, 0)
@@ -79,3 +81,101 @@ ev_document_text_get_text_attrs (EvDocumentText *document_text,
 
 	return iface->get_text_attrs (document_text, page);
 }
+
+/* The union of the character areas, each one grown to the pixels it
+ * touches so that neighbouring characters leave no gaps between them */
+static cairo_region_t *
+ev_document_text_mapping_from_layout (EvRectangle *areas,
+				      guint        n_areas)
+{
+	cairo_rectangle_int_t *rects;
+	cairo_region_t        *retval;
+	guint                  i, n = 0;
+
+	rects = g_new (cairo_rectangle_int_t, MAX (n_areas, 1));
+	for (i = 0; i < n_areas; i++) {
+		cairo_rectangle_int_t *rect = &rects[n];
+		gint                   x2, y2;
+
+		rect->x = (gint) floor (areas[i].x1);
+		rect->y = (gint) floor (areas[i].y1);
+		x2 = (gint) ceil (areas[i].x2);
+		y2 = (gint) ceil (areas[i].y2);
+		rect->width = x2 - rect->x;
+		rect->height = y2 - rect->y;
+		if (rect->width > 0 && rect->height > 0)
+			n++;
+	}
+
+	/* Building the region at once is linear, unlike adding the
+	 * rectangles one by one */
+	retval = cairo_region_create_rectangles (rects, n);
+	g_free (rects);
+
+	return retval;
+}
+
+/**
+ * ev_document_text_get_text_data:
+ * @document_text: an #EvDocumentText
+ * @page: an #EvPage
+ * @text: (out) (allow-none): return location for the text, or %NULL
+ * @areas: (out) (allow-none): return location for the area of every
+ *   character of the text, or %NULL
+ * @n_areas: (out) (allow-none): return location for the number of areas
+ * @mapping: (out) (allow-none): return location for the region covered
+ *   by text, or %NULL
+ * @attrs: (out) (allow-none): return location for the text attributes,
+ *   or %NULL
+ *
+ * Gets the requested text data of @page. Backends implementing
+ * get_text_data analyze the page text once for all of it, and the
+ * text mapping is then derived from the character areas. Otherwise
+ * every item is asked for separately.
+ */
+void
+ev_document_text_get_text_data (EvDocumentText  *document_text,
+				EvPage          *page,
+				gchar          **text,
+				EvRectangle    **areas,
+				guint           *n_areas,
+				cairo_region_t **mapping,
+				PangoAttrList  **attrs)
+{
+	EvDocumentTextInterface *iface = EV_DOCUMENT_TEXT_GET_IFACE (document_text);
+	EvRectangle             *layout = NULL;
+	guint                    layout_length = 0;
+
+	if (!iface->get_text_data) {
+		if (text)
+			*text = ev_document_text_get_text (document_text, page);
+		if (areas && !ev_document_text_get_text_layout (document_text, page, areas, n_areas)) {
+			*areas = NULL;
+			*n_areas = 0;
+		}
+		if (mapping)
+			*mapping = ev_document_text_get_text_mapping (document_text, page);
+		if (attrs)
+			*attrs = ev_document_text_get_text_attrs (document_text, page);
+
+		return;
+	}
+
+	if (!iface->get_text_data (document_text, page, text,
+				   areas || mapping ? &layout : NULL,
+				   &layout_length, attrs)) {
+		g_free (layout);
+		layout = NULL;
+		layout_length = 0;
+	}
+
+	if (mapping)
+		*mapping = ev_document_text_mapping_from_layout (layout, layout_length);
+
+	if (areas) {
+		*areas = layout;
+		*n_areas = layout_length;
+	} else {
+		g_free (layout);
+	}
+}
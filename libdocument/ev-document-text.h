@@ -59,6 +59,12 @@ struct _EvDocumentTextInterface
 					      guint            *n_areas);
 	PangoAttrList  *(* get_text_attrs)   (EvDocumentText   *document_text,
 					      EvPage           *page);
+	gboolean        (* get_text_data)    (EvDocumentText   *document_text,
+					      EvPage           *page,
+					      gchar           **text,
+					      EvRectangle     **areas,
+					      guint            *n_areas,
+					      PangoAttrList   **attrs);
 };
 
 GType           ev_document_text_get_type         (void) G_GNUC_CONST;
@@ -73,6 +79,13 @@ cairo_region_t *ev_document_text_get_text_mapping (EvDocumentText  *document_tex
 						   EvPage          *page);
 PangoAttrList  *ev_document_text_get_text_attrs   (EvDocumentText  *document_text,
 						   EvPage          *page);
+void            ev_document_text_get_text_data    (EvDocumentText  *document_text,
+						   EvPage          *page,
+						   gchar          **text,
+						   EvRectangle    **areas,
+						   guint           *n_areas,
+						   cairo_region_t **mapping,
+						   PangoAttrList  **attrs);
 G_END_DECLS
 
 #endif /* EV_DOCUMENT_TEXT_H */
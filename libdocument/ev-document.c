@@ -54,7 +54,10 @@ struct _EvDocumentPrivate
 
 	gchar         **page_labels;
 	EvPageSize     *page_sizes;
+	gint            n_cached_pages;
+	GMutex          cache_mutex;
 	EvDocumentInfo *info;
+	GRWLock         lock;
 #ifdef ENABLE_SYNCTEX
 	synctex_scanner_p synctex_scanner;
 #endif
@@ -72,6 +75,11 @@ static EvDocumentInfo *_ev_document_get_info        (EvDocument *document);
 static gboolean        _ev_document_support_synctex (EvDocument *document);
 #endif
 
+/* Number of pages measured by ev_document_load_full() in incremental mode,
+ * enough to lay out the first screen of most documents.
+ */
+#define EV_DOCUMENT_N_INITIAL_PAGES 32
+
 static GMutex ev_doc_mutex;
 static GMutex ev_fc_mutex;
 
@@ -101,30 +109,46 @@ ev_document_impl_get_info (EvDocument *document)
 }
 
 static void
-ev_document_finalize (GObject *object)
+ev_document_clear_page_cache (EvDocument *document)
 {
-	EvDocument *document = EV_DOCUMENT (object);
+	EvDocumentPrivate *priv = document->priv;
 
-	if (document->priv->uri) {
-		g_free (document->priv->uri);
-		document->priv->uri = NULL;
-	}
+	g_mutex_lock (&priv->cache_mutex);
 
-	if (document->priv->page_sizes) {
-		g_free (document->priv->page_sizes);
-		document->priv->page_sizes = NULL;
+	if (priv->page_sizes) {
+		g_free (priv->page_sizes);
+		priv->page_sizes = NULL;
 	}
 
-	if (document->priv->page_labels) {
+	if (priv->page_labels) {
 		gint i;
 
-		for (i = 0; i < document->priv->n_pages; i++) {
-			g_free (document->priv->page_labels[i]);
+		for (i = 0; i < priv->n_pages; i++) {
+			g_free (priv->page_labels[i]);
 		}
-		g_free (document->priv->page_labels);
-		document->priv->page_labels = NULL;
+		g_free (priv->page_labels);
+		priv->page_labels = NULL;
+	}
+
+	priv->n_cached_pages = 0;
+	priv->uniform = TRUE;
+	priv->max_label = 0;
+
+	g_mutex_unlock (&priv->cache_mutex);
+}
+
+static void
+ev_document_finalize (GObject *object)
+{
+	EvDocument *document = EV_DOCUMENT (object);
+
+	if (document->priv->uri) {
+		g_free (document->priv->uri);
+		document->priv->uri = NULL;
 	}
 
+	ev_document_clear_page_cache (document);
+
 	if (document->priv->info) {
 		ev_document_info_free (document->priv->info);
 		document->priv->info = NULL;
@@ -135,6 +159,9 @@ ev_document_finalize (GObject *object)
 		document->priv->synctex_scanner = NULL;
 	}
 #endif
+	g_rw_lock_clear (&document->priv->lock);
+	g_mutex_clear (&document->priv->cache_mutex);
+
 	G_OBJECT_CLASS (ev_document_parent_class)->finalize (object);
 }
 
@@ -142,6 +169,8 @@ static void
 ev_document_init (EvDocument *document)
 {
 	document->priv = ev_document_get_instance_private (document);
+	g_rw_lock_init (&document->priv->lock);
+	g_mutex_init (&document->priv->cache_mutex);
 #ifdef ENABLE_SYNCTEX
 	document->synctex_version = SYNCTEX_VERSION_STRING;
 #endif
@@ -159,10 +188,19 @@ ev_document_class_init (EvDocumentClass *klass)
 	klass->get_page = ev_document_impl_get_page;
 	klass->get_info = ev_document_impl_get_info;
 	klass->get_backend_info = NULL;
+	klass->concurrency = EV_DOCUMENT_CONCURRENCY_NONE;
+	klass->render_clip = FALSE;
 
 	g_object_class->finalize = ev_document_finalize;
 }
 
+/**
+ * ev_document_doc_mutex_lock:
+ *
+ * Locks the process-wide document mutex. This only excludes documents of
+ * backends that don't declare any concurrency; use ev_document_lock() to
+ * lock a given document whatever its backend.
+ */
 void
 ev_document_doc_mutex_lock (void)
 {
@@ -199,6 +237,201 @@ ev_document_fc_mutex_trylock (void)
 	return g_mutex_trylock (&ev_fc_mutex);
 }
 
+/**
+ * ev_document_get_concurrency:
+ * @document: a #EvDocument
+ *
+ * Returns: the #EvDocumentConcurrency declared by the backend of @document
+ */
+EvDocumentConcurrency
+ev_document_get_concurrency (EvDocument *document)
+{
+	EvDocumentConcurrency concurrency;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), EV_DOCUMENT_CONCURRENCY_NONE);
+
+	concurrency = EV_DOCUMENT_GET_CLASS (document)->concurrency;
+	if (concurrency & EV_DOCUMENT_CONCURRENCY_PAGES)
+		concurrency |= EV_DOCUMENT_CONCURRENCY_DOCUMENTS;
+
+	return concurrency;
+}
+
+/**
+ * ev_document_lock:
+ * @document: a #EvDocument
+ *
+ * Takes exclusive access to @document. Backends that don't declare
+ * %EV_DOCUMENT_CONCURRENCY_DOCUMENTS share the process-wide document
+ * mutex, so this also excludes every other document of such backends.
+ */
+void
+ev_document_lock (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_DOCUMENTS)
+		g_rw_lock_writer_lock (&document->priv->lock);
+	else
+		g_mutex_lock (&ev_doc_mutex);
+}
+
+void
+ev_document_unlock (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_DOCUMENTS)
+		g_rw_lock_writer_unlock (&document->priv->lock);
+	else
+		g_mutex_unlock (&ev_doc_mutex);
+}
+
+gboolean
+ev_document_trylock (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_DOCUMENTS)
+		return g_rw_lock_writer_trylock (&document->priv->lock);
+
+	return g_mutex_trylock (&ev_doc_mutex);
+}
+
+/**
+ * ev_document_lock_shared:
+ * @document: a #EvDocument
+ *
+ * Locks @document for a page operation: rendering, thumbnailing, finding
+ * text or extracting it. When the backend declares
+ * %EV_DOCUMENT_CONCURRENCY_PAGES, page operations only exclude
+ * ev_document_lock() and may run concurrently with each other; otherwise
+ * this is the same as ev_document_lock().
+ */
+void
+ev_document_lock_shared (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_PAGES)
+		g_rw_lock_reader_lock (&document->priv->lock);
+	else
+		ev_document_lock (document);
+}
+
+void
+ev_document_unlock_shared (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_PAGES)
+		g_rw_lock_reader_unlock (&document->priv->lock);
+	else
+		ev_document_unlock (document);
+}
+
+gboolean
+ev_document_trylock_shared (EvDocument *document)
+{
+	if (ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_PAGES)
+		return g_rw_lock_reader_trylock (&document->priv->lock);
+
+	return ev_document_trylock (document);
+}
+
+/**
+ * ev_document_render_lock:
+ * @document: a #EvDocument
+ *
+ * Takes the process-wide fontconfig mutex unless the backend of
+ * @document declares %EV_DOCUMENT_CONCURRENCY_FONTCONFIG. Must be called
+ * with @document already locked.
+ */
+void
+ev_document_render_lock (EvDocument *document)
+{
+	if (!(ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_FONTCONFIG))
+		g_mutex_lock (&ev_fc_mutex);
+}
+
+void
+ev_document_render_unlock (EvDocument *document)
+{
+	if (!(ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_FONTCONFIG))
+		g_mutex_unlock (&ev_fc_mutex);
+}
+
+/* Must be called with the document locked, for one page after another */
+static gboolean
+ev_document_cache_page (EvDocument *document,
+			gint        i)
+{
+	EvDocumentPrivate *priv = document->priv;
+	EvPage            *page;
+	gdouble            page_width = 0;
+	gdouble            page_height = 0;
+	EvPageSize        *page_size;
+	gchar             *page_label;
+	gboolean           changed = FALSE;
+
+	page = ev_document_get_page (document, i);
+	_ev_document_get_page_size (document, page, &page_width, &page_height);
+	page_label = _ev_document_get_page_label (document, page);
+	g_object_unref (page);
+
+	g_mutex_lock (&priv->cache_mutex);
+
+	if (i == 0) {
+		priv->uniform_width = page_width;
+		priv->uniform_height = page_height;
+		priv->max_width = priv->uniform_width;
+		priv->max_height = priv->uniform_height;
+		priv->min_width = priv->uniform_width;
+		priv->min_height = priv->uniform_height;
+	} else if (priv->uniform_width != page_width ||
+		   priv->uniform_height != page_height) {
+		/* Pages not measured yet are assumed to be
+		 * the size of the first one.
+		 */
+		changed = TRUE;
+
+		if (priv->uniform) {
+			/* It's a different page size.  Backfill the array. */
+			int j;
+
+			priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
+
+			for (j = 0; j < priv->n_pages; j++) {
+				page_size = &(priv->page_sizes[j]);
+				page_size->width = priv->uniform_width;
+				page_size->height = priv->uniform_height;
+			}
+			priv->uniform = FALSE;
+		}
+	}
+	if (!priv->uniform) {
+		page_size = &(priv->page_sizes[i]);
+
+		page_size->width = page_width;
+		page_size->height = page_height;
+
+		if (page_width > priv->max_width)
+			priv->max_width = page_width;
+		if (page_width < priv->min_width)
+			priv->min_width = page_width;
+
+		if (page_height > priv->max_height)
+			priv->max_height = page_height;
+		if (page_height < priv->min_height)
+			priv->min_height = page_height;
+	}
+
+	if (page_label) {
+		if (!priv->page_labels)
+			priv->page_labels = g_new0 (gchar *, priv->n_pages);
+
+		priv->page_labels[i] = page_label;
+		priv->max_label = MAX (priv->max_label,
+				       g_utf8_strlen (page_label, 256));
+	}
+
+	priv->n_cached_pages = i + 1;
+
+	g_mutex_unlock (&priv->cache_mutex);
+
+	return changed;
+}
+
 /**
  * ev_document_load:
  * @document: a #EvDocument
@@ -220,6 +453,29 @@ gboolean
 ev_document_load (EvDocument  *document,
 		  const char  *uri,
 		  GError     **error)
+{
+	return ev_document_load_full (document, uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_load_full:
+ * @document: a #EvDocument
+ * @uri: the document's URI
+ * @flags: flags from #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Loads @document from @uri like ev_document_load(). With
+ * %EV_DOCUMENT_LOAD_FLAG_INCREMENTAL only the first pages are measured,
+ * the sizes and labels of the remaining pages are estimated until they
+ * are measured with ev_document_cache_pages().
+ *
+ * Returns: %TRUE on success, or %FALSE on failure.
+ */
+gboolean
+ev_document_load_full (EvDocument         *document,
+		       const char         *uri,
+		       EvDocumentLoadFlags flags,
+		       GError            **error)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
 	gboolean retval;
@@ -248,99 +504,49 @@ ev_document_load (EvDocument  *document,
 					     "Internal error in backend");
 		}
 	} else {
-		gint i;
+		gint i, n_pages;
 		EvDocumentPrivate *priv = document->priv;
 
 		/* Cache some info about the document to avoid
 		 * going to the backends since it requires locks
 		 */
 
+		g_free (priv->uri);
 		priv->uri = g_strdup (uri);
 
+		ev_document_clear_page_cache (document);
 		priv->n_pages = _ev_document_get_n_pages (document);
 
-		for (i = 0; i < priv->n_pages; i++) {
-
+		if (document->iswebdocument == TRUE) {
 			/*
 			 * Since there is no sense of paging in an ePub,it makes no sense to have pages sizes.
 			 * We are however geeneralising the scenario by considering epub as a type of web document.
 			 * FIXME: Labels, or bookmarks though, can be done.
 			 */
-
-			EvPage     *page = ev_document_get_page (document, i);
-			gdouble     page_width = 0;
-			gdouble     page_height = 0;
-			EvPageSize *page_size;
-			gchar      *page_label;
-
-			if ( document->iswebdocument == FALSE ) {
-				_ev_document_get_page_size (document, page, &page_width, &page_height);
-			}
-			else {
+			if (priv->n_pages > 0) {
 				//Fixed page sized to resolve the X-windowing system error.
-				page_width = 800;
-				page_height= 600;
-			}
-
-			if (i == 0) {
-				priv->uniform_width = page_width;
-				priv->uniform_height = page_height;
+				priv->uniform_width = 800;
+				priv->uniform_height = 600;
 				priv->max_width = priv->uniform_width;
 				priv->max_height = priv->uniform_height;
 				priv->min_width = priv->uniform_width;
 				priv->min_height = priv->uniform_height;
-				if (document->iswebdocument == TRUE ) {
-					priv->page_sizes = g_new0 (EvPageSize, 1);
-					priv->page_sizes->width = priv->uniform_width;
-					priv->page_sizes->height = priv->uniform_height;
-					priv->uniform = TRUE ;
-					break;
-				}
-			} else if (priv->uniform &&
-				   (priv->uniform_width != page_width ||
-				    priv->uniform_height != page_height)) {
-				/* It's a different page size.  Backfill the array. */
-				int j;
-
-				priv->page_sizes = g_new0 (EvPageSize, priv->n_pages);
-
-				for (j = 0; j < i; j++) {
-					page_size = &(priv->page_sizes[j]);
-					page_size->width = priv->uniform_width;
-					page_size->height = priv->uniform_height;
-				}
-				priv->uniform = FALSE;
-			}
-			if (!priv->uniform) {
-				page_size = &(priv->page_sizes[i]);
-
-				page_size->width = page_width;
-				page_size->height = page_height;
-
-				if (page_width > priv->max_width)
-					priv->max_width = page_width;
-				if (page_width < priv->min_width)
-					priv->min_width = page_width;
-
-				if (page_height > priv->max_height)
-					priv->max_height = page_height;
-				if (page_height < priv->min_height)
-					priv->min_height = page_height;
-			}
-
-			page_label = _ev_document_get_page_label (document, page);
-			if (page_label) {
-				if (!priv->page_labels)
-					priv->page_labels = g_new0 (gchar *, priv->n_pages);
-
-				priv->page_labels[i] = page_label;
-				priv->max_label = MAX (priv->max_label,
-						       g_utf8_strlen (page_label, 256));
+				priv->page_sizes = g_new0 (EvPageSize, 1);
+				priv->page_sizes->width = priv->uniform_width;
+				priv->page_sizes->height = priv->uniform_height;
 			}
+			priv->n_cached_pages = priv->n_pages;
+		} else {
+			n_pages = priv->n_pages;
+			if (flags & EV_DOCUMENT_LOAD_FLAG_INCREMENTAL)
+				n_pages = MIN (n_pages, EV_DOCUMENT_N_INITIAL_PAGES);
 
-			g_object_unref (page);
+			for (i = 0; i < n_pages; i++)
+				ev_document_cache_page (document, i);
 		}
 
+		if (priv->info)
+			ev_document_info_free (priv->info);
 		priv->info = _ev_document_get_info (document);
 #ifdef ENABLE_SYNCTEX
 		if (_ev_document_support_synctex (document)) {
@@ -359,6 +565,85 @@ ev_document_load (EvDocument  *document,
 	return retval;
 }
 
+/**
+ * ev_document_cache_pages:
+ * @document: a #EvDocument
+ * @n_pages: the maximum number of pages to measure
+ *
+ * Measures the size and label of the next @n_pages pages of a document
+ * loaded with %EV_DOCUMENT_LOAD_FLAG_INCREMENTAL. The document must be
+ * locked with ev_document_lock().
+ *
+ * Returns: %TRUE if the size of any of the measured pages differs from
+ * the size estimated for it so far.
+ */
+gboolean
+ev_document_cache_pages (EvDocument *document,
+			 gint        n_pages)
+{
+	gint     i, first, last;
+	gboolean changed = FALSE;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	first = ev_document_get_n_cached_pages (document);
+	last = MIN (first + n_pages, document->priv->n_pages);
+
+	for (i = first; i < last; i++)
+		changed |= ev_document_cache_page (document, i);
+
+	return changed;
+}
+
+/**
+ * ev_document_complete_page_cache:
+ * @document: a #EvDocument
+ *
+ * Measures the size and label of all the pages of @document that haven't
+ * been measured yet, for the callers that can't do with estimated sizes.
+ * The document must not be locked, it is locked while measuring.
+ */
+void
+ev_document_complete_page_cache (EvDocument *document)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (ev_document_is_page_cache_complete (document))
+		return;
+
+	ev_document_lock (document);
+	ev_document_cache_pages (document, document->priv->n_pages);
+	ev_document_unlock (document);
+}
+
+/**
+ * ev_document_get_n_cached_pages:
+ * @document: a #EvDocument
+ *
+ * Returns: the number of pages whose size and label have been measured
+ */
+gint
+ev_document_get_n_cached_pages (EvDocument *document)
+{
+	gint n_cached_pages;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), 0);
+
+	g_mutex_lock (&document->priv->cache_mutex);
+	n_cached_pages = document->priv->n_cached_pages;
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return n_cached_pages;
+}
+
+gboolean
+ev_document_is_page_cache_complete (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
+
+	return ev_document_get_n_cached_pages (document) >= document->priv->n_pages;
+}
+
 /**
  * ev_document_save:
  * @document:
@@ -538,6 +823,8 @@ ev_document_get_page_size (EvDocument *document,
 {
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 	g_return_if_fail (page_index >= 0 || page_index < document->priv->n_pages);
+
+	g_mutex_lock (&document->priv->cache_mutex);
 	if (document->iswebdocument == TRUE ) {
 		if (width)
 			*width = document->priv->uniform_width;
@@ -553,6 +840,7 @@ ev_document_get_page_size (EvDocument *document,
 				document->priv->uniform_height :
 				document->priv->page_sizes[page_index].height;
 	}
+	g_mutex_unlock (&document->priv->cache_mutex);
 }
 
 static gchar *
@@ -569,12 +857,18 @@ gchar *
 ev_document_get_page_label (EvDocument *document,
 			    gint        page_index)
 {
+	gchar *label;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
 	g_return_val_if_fail (page_index >= 0 || page_index < document->priv->n_pages, NULL);
 
-	return (document->priv->page_labels && document->priv->page_labels[page_index]) ?
+	g_mutex_lock (&document->priv->cache_mutex);
+	label = (document->priv->page_labels && document->priv->page_labels[page_index]) ?
 		g_strdup (document->priv->page_labels[page_index]) :
 		g_strdup_printf ("%d", page_index + 1);
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return label;
 }
 
 static EvDocumentInfo *
@@ -614,6 +908,22 @@ ev_document_render (EvDocument      *document,
 	return klass->render (document, rc);
 }
 
+/**
+ * ev_document_can_render_clip:
+ * @document: a #EvDocument
+ *
+ * Returns: %TRUE if the backend of @document renders only the clip set
+ *   with ev_render_context_set_clip(), returning a surface of its size,
+ *   rather than the whole page
+ */
+gboolean
+ev_document_can_render_clip (EvDocument *document)
+{
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	return EV_DOCUMENT_GET_CLASS (document)->render_clip;
+}
+
 const gchar *
 ev_document_get_uri (EvDocument *document)
 {
@@ -631,12 +941,21 @@ ev_document_get_title (EvDocument *document)
 		document->priv->info->title : NULL;
 }
 
+/* The page size and label getters below only report the pages measured so
+ * far for documents loaded incrementally, see ev_document_cache_pages().
+ */
 gboolean
 ev_document_is_page_size_uniform (EvDocument *document)
 {
+	gboolean uniform;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), TRUE);
 
-	return document->priv->uniform;
+	g_mutex_lock (&document->priv->cache_mutex);
+	uniform = document->priv->uniform;
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return uniform;
 }
 
 void
@@ -646,10 +965,12 @@ ev_document_get_max_page_size (EvDocument *document,
 {
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 
+	g_mutex_lock (&document->priv->cache_mutex);
 	if (width)
 		*width = document->priv->max_width;
 	if (height)
 		*height = document->priv->max_height;
+	g_mutex_unlock (&document->priv->cache_mutex);
 }
 
 void
@@ -659,34 +980,54 @@ ev_document_get_min_page_size (EvDocument *document,
 {
 	g_return_if_fail (EV_IS_DOCUMENT (document));
 
+	g_mutex_lock (&document->priv->cache_mutex);
 	if (width)
 		*width = document->priv->min_width;
 	if (height)
 		*height = document->priv->min_height;
+	g_mutex_unlock (&document->priv->cache_mutex);
 }
 
 gboolean
 ev_document_check_dimensions (EvDocument *document)
 {
+	gboolean retval;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
-	return (document->priv->max_width > 0 && document->priv->max_height > 0);
+	g_mutex_lock (&document->priv->cache_mutex);
+	retval = (document->priv->max_width > 0 && document->priv->max_height > 0);
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return retval;
 }
 
 gint
 ev_document_get_max_label_len (EvDocument *document)
 {
+	gint max_label;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), -1);
 
-	return document->priv->max_label;
+	g_mutex_lock (&document->priv->cache_mutex);
+	max_label = document->priv->max_label;
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return max_label;
 }
 
 gboolean
 ev_document_has_text_page_labels (EvDocument *document)
 {
+	gboolean retval;
+
 	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
 
-	return document->priv->page_labels != NULL;
+	g_mutex_lock (&document->priv->cache_mutex);
+	retval = document->priv->page_labels != NULL;
+	g_mutex_unlock (&document->priv->cache_mutex);
+
+	return retval;
 }
 
 gboolean
@@ -703,10 +1044,16 @@ ev_document_find_page_by_label (EvDocument  *document,
 	g_return_val_if_fail (page_label != NULL, FALSE);
 	g_return_val_if_fail (page_index != NULL, FALSE);
 
+	/* The labels of the pages not measured yet aren't known */
+	ev_document_complete_page_cache (document);
+
+	g_mutex_lock (&priv->cache_mutex);
+
         /* First, look for a literal label match */
 	for (i = 0; priv->page_labels && i < priv->n_pages; i ++) {
 		if (priv->page_labels[i] != NULL &&
 		    ! strcmp (page_label, priv->page_labels[i])) {
+			g_mutex_unlock (&priv->cache_mutex);
 			*page_index = i;
 			return TRUE;
 		}
@@ -716,11 +1063,14 @@ ev_document_find_page_by_label (EvDocument  *document,
 	for (i = 0; priv->page_labels && i < priv->n_pages; i++) {
 		if (priv->page_labels[i] != NULL &&
 		    ! strcasecmp (page_label, priv->page_labels[i])) {
+			g_mutex_unlock (&priv->cache_mutex);
 			*page_index = i;
 			return TRUE;
 		}
 	}
 
+	g_mutex_unlock (&priv->cache_mutex);
+
 	/* Next, parse the label, and see if the number fits */
 	value = strtol (page_label, &endptr, 10);
 	if (endptr[0] == '\0') {
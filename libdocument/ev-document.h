@@ -59,6 +59,35 @@ typedef enum
         EV_DOCUMENT_ERROR_ENCRYPTED
 } EvDocumentError;
 
+/* Declared by backends in EvDocumentClass::concurrency.
+ *
+ * NONE:       the backend library keeps process-wide state, every call
+ *             holds the process-wide document mutex.
+ * DOCUMENTS:  different documents can be used from different threads
+ *             at the same time, calls on one document are serialized.
+ * PAGES:      pages of one document can be rendered, thumbnailed,
+ *             searched and have their text extracted concurrently.
+ *             Implies DOCUMENTS.
+ * FONTCONFIG: rendering doesn't need the process-wide fontconfig mutex.
+ */
+typedef enum
+{
+	EV_DOCUMENT_CONCURRENCY_NONE       = 0,
+	EV_DOCUMENT_CONCURRENCY_DOCUMENTS  = 1 << 0,
+	EV_DOCUMENT_CONCURRENCY_PAGES      = 1 << 1,
+	EV_DOCUMENT_CONCURRENCY_FONTCONFIG = 1 << 2
+} EvDocumentConcurrency;
+
+/* INCREMENTAL: only the first pages are measured while loading, the
+ *              rest are estimated until ev_document_cache_pages()
+ *              has been called for them.
+ */
+typedef enum
+{
+	EV_DOCUMENT_LOAD_FLAG_NONE        = 0,
+	EV_DOCUMENT_LOAD_FLAG_INCREMENTAL = 1 << 0
+} EvDocumentLoadFlags;
+
 typedef struct {
         double x;
         double y;
@@ -117,6 +146,10 @@ struct _EvDocumentClass
 
 	void              (* toggle_night_mode)  (EvDocument      *document,gboolean night);
 	void              (*check_add_night_sheet)(EvDocument      *document);
+
+	EvDocumentConcurrency concurrency;
+	/* Whether render honours the clip of the render context */
+	gboolean              render_clip;
 };
 
 GType            ev_document_get_type             (void) G_GNUC_CONST;
@@ -128,6 +161,17 @@ void             ev_document_doc_mutex_lock       (void);
 void             ev_document_doc_mutex_unlock     (void);
 gboolean         ev_document_doc_mutex_trylock    (void);
 
+/* Per-document locking */
+EvDocumentConcurrency ev_document_get_concurrency (EvDocument      *document);
+void             ev_document_lock                 (EvDocument      *document);
+void             ev_document_unlock               (EvDocument      *document);
+gboolean         ev_document_trylock              (EvDocument      *document);
+void             ev_document_lock_shared          (EvDocument      *document);
+void             ev_document_unlock_shared        (EvDocument      *document);
+gboolean         ev_document_trylock_shared       (EvDocument      *document);
+void             ev_document_render_lock          (EvDocument      *document);
+void             ev_document_render_unlock        (EvDocument      *document);
+
 /* FontConfig mutex */
 GMutex          *ev_document_get_fc_mutex         (void);
 void             ev_document_fc_mutex_lock        (void);
@@ -140,6 +184,10 @@ gboolean         ev_document_get_backend_info     (EvDocument      *document,
 gboolean         ev_document_load                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
+gboolean         ev_document_load_full            (EvDocument      *document,
+						   const char      *uri,
+						   EvDocumentLoadFlags flags,
+						   GError         **error);
 gboolean         ev_document_save                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
@@ -154,6 +202,7 @@ gchar           *ev_document_get_page_label       (EvDocument      *document,
 						   gint             page_index);
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
+gboolean         ev_document_can_render_clip      (EvDocument      *document);
 const gchar     *ev_document_get_uri              (EvDocument      *document);
 const gchar     *ev_document_get_title            (EvDocument      *document);
 gboolean         ev_document_is_page_size_uniform (EvDocument      *document);
@@ -170,6 +219,11 @@ gboolean         ev_document_find_page_by_label   (EvDocument      *document,
 						   const gchar     *page_label,
 						   gint            *page_index);
 gboolean	 ev_document_has_synctex 	  (EvDocument      *document);
+gboolean         ev_document_cache_pages          (EvDocument      *document,
+						   gint             n_pages);
+gint             ev_document_get_n_cached_pages   (EvDocument      *document);
+gboolean         ev_document_is_page_cache_complete (EvDocument    *document);
+void             ev_document_complete_page_cache  (EvDocument      *document);
 
 EvSourceLink    *ev_document_synctex_backward_search
                                                   (EvDocument      *document,
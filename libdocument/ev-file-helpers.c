@@ -21,6 +21,7 @@
 
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -304,6 +305,136 @@ ev_file_is_temp (GFile *file)
 	return retval;
 }
 
+typedef struct {
+	gchar  *path;
+	gint64  mtime;
+	goffset size;
+} EvCacheEntry;
+
+static void
+ev_cache_entry_free (EvCacheEntry *entry)
+{
+	g_free (entry->path);
+	g_slice_free (EvCacheEntry, entry);
+}
+
+static gint
+ev_cache_entry_compare_age (gconstpointer a,
+			    gconstpointer b)
+{
+	const EvCacheEntry *ea = *(EvCacheEntry * const *) a;
+	const EvCacheEntry *eb = *(EvCacheEntry * const *) b;
+
+	return ea->mtime < eb->mtime ? -1 : ea->mtime > eb->mtime ? 1 : 0;
+}
+
+/* Returns the size of the files in @path, removing them too if @remove */
+static goffset
+ev_cache_entry_walk (const gchar *path,
+		     gboolean     remove)
+{
+	GStatBuf     buf;
+	GDir        *dir;
+	const gchar *name;
+	goffset      size = 0;
+
+	if (g_lstat (path, &buf) != 0)
+		return 0;
+
+	if (!S_ISDIR (buf.st_mode)) {
+		if (remove)
+			g_unlink (path);
+		return buf.st_size;
+	}
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir))) {
+			gchar *child = g_build_filename (path, name, NULL);
+
+			size += ev_cache_entry_walk (child, remove);
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+
+	if (remove)
+		g_rmdir (path);
+
+	return size;
+}
+
+/**
+ * ev_cache_dir_prune:
+ * @path: a cache directory
+ * @max_age: the age in seconds after which entries are removed, or 0
+ * @max_size: the total size in bytes of the entries kept, or 0
+ *
+ * Removes the entries of @path, files or directories, that were not
+ * modified for @max_age seconds, then the least recently modified ones
+ * until the rest take at most @max_size bytes. Caches keep the
+ * modification time of their entries as the time of their last use.
+ */
+void
+ev_cache_dir_prune (const gchar *path,
+		    gint64       max_age,
+		    goffset      max_size)
+{
+	GDir        *dir;
+	GPtrArray   *entries;
+	const gchar *name;
+	gint64       now;
+	goffset      total_size = 0;
+	guint        i;
+
+	g_return_if_fail (path != NULL);
+
+	dir = g_dir_open (path, 0, NULL);
+	if (!dir)
+		return;
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	entries = g_ptr_array_new_with_free_func ((GDestroyNotify) ev_cache_entry_free);
+
+	while ((name = g_dir_read_name (dir))) {
+		EvCacheEntry *entry;
+		GStatBuf      buf;
+		gchar        *child;
+
+		child = g_build_filename (path, name, NULL);
+		if (g_lstat (child, &buf) != 0) {
+			g_free (child);
+			continue;
+		}
+
+		if (max_age > 0 && now - buf.st_mtime > max_age) {
+			ev_cache_entry_walk (child, TRUE);
+			g_free (child);
+			continue;
+		}
+
+		entry = g_slice_new (EvCacheEntry);
+		entry->path = child;
+		entry->mtime = buf.st_mtime;
+		entry->size = ev_cache_entry_walk (child, FALSE);
+		total_size += entry->size;
+		g_ptr_array_add (entries, entry);
+	}
+	g_dir_close (dir);
+
+	if (max_size > 0 && total_size > max_size) {
+		g_ptr_array_sort (entries, ev_cache_entry_compare_age);
+		for (i = 0; i < entries->len && total_size > max_size; i++) {
+			EvCacheEntry *entry = g_ptr_array_index (entries, i);
+
+			ev_cache_entry_walk (entry->path, TRUE);
+			total_size -= entry->size;
+		}
+	}
+
+	g_ptr_array_unref (entries);
+}
+
 /**
  * ev_xfer_uri_simple:
  * @from: the source URI
@@ -51,6 +51,9 @@ void         ev_tmp_filename_unlink   (const gchar       *filename);
 void         ev_tmp_file_unlink       (GFile             *file);
 void         ev_tmp_uri_unlink        (const gchar       *uri);
 gboolean     ev_file_is_temp          (GFile             *file);
+void         ev_cache_dir_prune       (const gchar       *path,
+				       gint64             max_age,
+				       goffset            max_size);
 gboolean     ev_xfer_uri_simple       (const char        *from,
 				       const char        *to,
 				       GError           **error);
@@ -18,17 +18,239 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <math.h>
+#include <string.h>
+
 #include "ev-mapping-list.h"
 
+/* Lists shorter than this are searched linearly */
+#define EV_MAPPING_INDEX_MIN_LENGTH 32
+#define EV_MAPPING_INDEX_NODE_SIZE  16
+#define EV_MAPPING_INDEX_MAX_LEVELS 16
+
+/* A packed R-tree over the mapping areas. The leaves are the mapping
+ * areas ordered in tiles (sort-tile-recursive), and every node of the
+ * level above is the bounding box of EV_MAPPING_INDEX_NODE_SIZE
+ * consecutive nodes of the level below it. All the levels are stored in
+ * a single array, leaves first.
+ */
+typedef struct {
+	EvMapping   **mappings;   /* In list order */
+	guint        *leaves;     /* Position in @mappings of every leaf */
+	guint         n_mappings;
+	EvRectangle  *boxes;
+	guint         level_start[EV_MAPPING_INDEX_MAX_LEVELS + 1];
+	guint         n_levels;
+} EvMappingIndex;
+
 struct _EvMappingList {
-	guint          page;
-	GList         *list;
-	GDestroyNotify data_destroy_func;
-	volatile gint  ref_count;
+	guint           page;
+	GList          *list;
+	GDestroyNotify  data_destroy_func;
+	volatile gint   ref_count;
+	EvMappingIndex *index;
+	gboolean        index_checked;
 };
 
 G_DEFINE_BOXED_TYPE (EvMappingList, ev_mapping_list, ev_mapping_list_ref, ev_mapping_list_unref)
 
+static void
+ev_mapping_index_free (EvMappingIndex *index)
+{
+	g_free (index->mappings);
+	g_free (index->leaves);
+	g_free (index->boxes);
+	g_free (index);
+}
+
+/* Leaves are sorted by the center of their mapping, user_data is the
+ * array of mappings of the index.
+ */
+static gint
+compare_leaves_x (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+	EvMapping  **mappings = user_data;
+	EvRectangle *ra = &mappings[*(const guint *) a]->area;
+	EvRectangle *rb = &mappings[*(const guint *) b]->area;
+	gdouble      ca = ra->x1 + ra->x2;
+	gdouble      cb = rb->x1 + rb->x2;
+
+	return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static gint
+compare_leaves_y (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+	EvMapping  **mappings = user_data;
+	EvRectangle *ra = &mappings[*(const guint *) a]->area;
+	EvRectangle *rb = &mappings[*(const guint *) b]->area;
+	gdouble      ca = ra->y1 + ra->y2;
+	gdouble      cb = rb->y1 + rb->y2;
+
+	return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+/* Merge sort of @n_leaves leaves using @tmp, of the same length, as
+ * scratch space. qsort() can't pass the mappings to @compare and
+ * g_qsort_with_data() is deprecated.
+ */
+static void
+sort_leaves (guint            *leaves,
+	     guint            *tmp,
+	     guint             n_leaves,
+	     GCompareDataFunc  compare,
+	     EvMapping       **mappings)
+{
+	guint middle, i, j, n;
+
+	if (n_leaves < 2)
+		return;
+
+	middle = n_leaves / 2;
+	sort_leaves (leaves, tmp, middle, compare, mappings);
+	sort_leaves (leaves + middle, tmp, n_leaves - middle, compare, mappings);
+
+	/* The leaves left in the second half are already in place */
+	for (i = 0, j = middle, n = 0; i < middle; n++) {
+		if (j < n_leaves && compare (&leaves[j], &leaves[i], mappings) < 0)
+			tmp[n] = leaves[j++];
+		else
+			tmp[n] = leaves[i++];
+	}
+	memcpy (leaves, tmp, n * sizeof (guint));
+}
+
+static EvMappingIndex *
+ev_mapping_index_new (GList *list,
+		      guint  n_mappings)
+{
+	EvMappingIndex *index;
+	GList          *l;
+	guint           n_boxes, n, level;
+	guint           slice_size, i;
+	guint          *tmp;
+
+	index = g_new0 (EvMappingIndex, 1);
+	index->mappings = g_new (EvMapping *, n_mappings);
+	index->leaves = g_new (guint, n_mappings);
+	index->n_mappings = n_mappings;
+
+	for (l = list, i = 0; l; l = g_list_next (l), i++) {
+		index->mappings[i] = l->data;
+		index->leaves[i] = i;
+	}
+
+	/* Sort the leaves in vertical slices of horizontal tiles, so that
+	 * the nodes built from consecutive leaves are compact.
+	 */
+	slice_size = EV_MAPPING_INDEX_NODE_SIZE *
+		(guint) ceil (sqrt ((gdouble) n_mappings / EV_MAPPING_INDEX_NODE_SIZE));
+
+	tmp = g_new (guint, n_mappings);
+	sort_leaves (index->leaves, tmp, n_mappings,
+		     compare_leaves_x, index->mappings);
+	for (i = 0; i < n_mappings; i += slice_size)
+		sort_leaves (index->leaves + i, tmp, MIN (slice_size, n_mappings - i),
+			     compare_leaves_y, index->mappings);
+	g_free (tmp);
+
+	n_boxes = 0;
+	n = n_mappings;
+	do {
+		index->level_start[index->n_levels++] = n_boxes;
+		n_boxes += n;
+		n = (n + EV_MAPPING_INDEX_NODE_SIZE - 1) / EV_MAPPING_INDEX_NODE_SIZE;
+	} while (n_boxes - index->level_start[index->n_levels - 1] > 1 &&
+		 index->n_levels < EV_MAPPING_INDEX_MAX_LEVELS);
+	index->level_start[index->n_levels] = n_boxes;
+
+	index->boxes = g_new (EvRectangle, n_boxes);
+	for (i = 0; i < n_mappings; i++)
+		index->boxes[i] = index->mappings[index->leaves[i]]->area;
+
+	for (level = 1; level < index->n_levels; level++) {
+		guint child_start = index->level_start[level - 1];
+		guint child_end = index->level_start[level];
+
+		for (i = index->level_start[level]; i < index->level_start[level + 1]; i++) {
+			guint        child = child_start + (i - child_end) * EV_MAPPING_INDEX_NODE_SIZE;
+			guint        last = MIN (child + EV_MAPPING_INDEX_NODE_SIZE, child_end);
+			EvRectangle *box = &index->boxes[i];
+
+			*box = index->boxes[child];
+			for (child++; child < last; child++) {
+				EvRectangle *r = &index->boxes[child];
+
+				box->x1 = MIN (box->x1, r->x1);
+				box->y1 = MIN (box->y1, r->y1);
+				box->x2 = MAX (box->x2, r->x2);
+				box->y2 = MAX (box->y2, r->y2);
+			}
+		}
+	}
+
+	return index;
+}
+
+static inline gboolean
+rectangle_contains (const EvRectangle *r,
+		    gdouble            x,
+		    gdouble            y)
+{
+	return x >= r->x1 && y >= r->y1 && x <= r->x2 && y <= r->y2;
+}
+
+/* Returns the first mapping in list order that contains the point,
+ * like the linear search does.
+ */
+static EvMapping *
+ev_mapping_index_get (EvMappingIndex *index,
+		      gdouble         x,
+		      gdouble         y)
+{
+	guint stack[EV_MAPPING_INDEX_MAX_LEVELS * EV_MAPPING_INDEX_NODE_SIZE];
+	guint levels[EV_MAPPING_INDEX_MAX_LEVELS * EV_MAPPING_INDEX_NODE_SIZE];
+	guint n_stack = 0;
+	guint best = G_MAXUINT;
+	guint root = index->level_start[index->n_levels - 1];
+	guint i;
+
+	for (i = root; i < index->level_start[index->n_levels]; i++) {
+		stack[n_stack] = i;
+		levels[n_stack++] = index->n_levels - 1;
+	}
+
+	while (n_stack > 0) {
+		guint node, level, child, last;
+
+		n_stack--;
+		node = stack[n_stack];
+		level = levels[n_stack];
+
+		if (!rectangle_contains (&index->boxes[node], x, y))
+			continue;
+
+		if (level == 0) {
+			best = MIN (best, index->leaves[node]);
+			continue;
+		}
+
+		child = index->level_start[level - 1] +
+			(node - index->level_start[level]) * EV_MAPPING_INDEX_NODE_SIZE;
+		last = MIN (child + EV_MAPPING_INDEX_NODE_SIZE, index->level_start[level]);
+		for (; child < last; child++) {
+			stack[n_stack] = child;
+			levels[n_stack++] = level - 1;
+		}
+	}
+
+	return best != G_MAXUINT ? index->mappings[best] : NULL;
+}
+
 /**
  * ev_mapping_list_find:
  * @mapping_list: an #EvMappingList
@@ -90,6 +312,9 @@ ev_mapping_list_nth (EvMappingList *mapping_list,
 {
         g_return_val_if_fail (mapping_list != NULL, NULL);
 
+        if (mapping_list->index)
+                return n < mapping_list->index->n_mappings ? mapping_list->index->mappings[n] : NULL;
+
         return (EvMapping *)g_list_nth_data (mapping_list->list, n);
 }
 
@@ -108,6 +333,12 @@ ev_mapping_list_get (EvMappingList *mapping_list,
 {
 	GList *list;
 
+	if (!mapping_list->index_checked)
+		ev_mapping_list_build_index (mapping_list);
+
+	if (mapping_list->index)
+		return ev_mapping_index_get (mapping_list->index, x, y);
+
 	for (list = mapping_list->list; list; list = list->next) {
 		EvMapping *mapping = list->data;
 
@@ -172,6 +403,9 @@ ev_mapping_list_remove (EvMappingList *mapping_list,
     mapping_list->list = g_list_remove (mapping_list->list, mapping);
     mapping_list->data_destroy_func (mapping->data);
     g_free (mapping);
+
+    g_clear_pointer (&mapping_list->index, ev_mapping_index_free);
+    mapping_list->index_checked = FALSE;
 }
 
 guint
@@ -210,10 +444,38 @@ ev_mapping_list_new (guint          page,
 	mapping_list->list = list;
 	mapping_list->data_destroy_func = data_destroy_func;
 	mapping_list->ref_count = 1;
+	mapping_list->index = NULL;
+	mapping_list->index_checked = FALSE;
+
+	ev_mapping_list_build_index (mapping_list);
 
 	return mapping_list;
 }
 
+/**
+ * ev_mapping_list_build_index:
+ * @mapping_list: an #EvMappingList
+ *
+ * Builds the spatial index used by ev_mapping_list_get() when
+ * @mapping_list is long enough to need one. This is done when the list
+ * is created and after a mapping is removed, so the areas of the
+ * mappings must not change while they are in the list.
+ */
+void
+ev_mapping_list_build_index (EvMappingList *mapping_list)
+{
+	guint length;
+
+	g_return_if_fail (mapping_list != NULL);
+
+	g_clear_pointer (&mapping_list->index, ev_mapping_index_free);
+	mapping_list->index_checked = TRUE;
+
+	length = g_list_length (mapping_list->list);
+	if (length >= EV_MAPPING_INDEX_MIN_LENGTH)
+		mapping_list->index = ev_mapping_index_new (mapping_list->list, length);
+}
+
 EvMappingList *
 ev_mapping_list_ref (EvMappingList *mapping_list)
 {
@@ -244,6 +506,7 @@ ev_mapping_list_unref (EvMappingList *mapping_list)
 				(GFunc)mapping_list_free_foreach,
 				mapping_list->data_destroy_func);
 		g_list_free (mapping_list->list);
+		g_clear_pointer (&mapping_list->index, ev_mapping_index_free);
 		g_slice_free (EvMappingList, mapping_list);
 	}
 }
@@ -58,6 +58,7 @@ gpointer       ev_mapping_list_get_data    (EvMappingList *mapping_list,
 EvMapping     *ev_mapping_list_nth         (EvMappingList *mapping_list,
                                             guint          n);
 guint          ev_mapping_list_length      (EvMappingList *mapping_list);
+void           ev_mapping_list_build_index (EvMappingList *mapping_list);
 
 G_END_DECLS
 
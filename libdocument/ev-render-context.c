@@ -95,3 +95,42 @@ ev_render_context_set_scale (EvRenderContext *rc,
 	rc->scale = scale;
 }
 
+/**
+ * ev_render_context_set_clip:
+ * @rc: an #EvRenderContext
+ * @clip: (allow-none): the area to render, or %NULL for the whole page
+ *
+ * Restricts rendering to @clip, in pixels of the page once scaled and
+ * rotated. Backends honouring it return a surface of the size of @clip
+ * showing that area of the page; the others render the whole page.
+ */
+void
+ev_render_context_set_clip (EvRenderContext             *rc,
+			    const cairo_rectangle_int_t *clip)
+{
+	g_return_if_fail (rc != NULL);
+
+	rc->has_clip = clip != NULL;
+	if (clip)
+		rc->clip = *clip;
+}
+
+/**
+ * ev_render_context_get_clip:
+ * @rc: an #EvRenderContext
+ * @clip: (out): return location for the area to render
+ *
+ * Returns: %TRUE if only @clip has to be rendered, see
+ *   ev_render_context_set_clip()
+ */
+gboolean
+ev_render_context_get_clip (EvRenderContext       *rc,
+			    cairo_rectangle_int_t *clip)
+{
+	g_return_val_if_fail (rc != NULL, FALSE);
+
+	if (rc->has_clip && clip)
+		*clip = rc->clip;
+
+	return rc->has_clip;
+}
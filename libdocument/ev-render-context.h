@@ -25,6 +25,7 @@
 #define EV_RENDER_CONTEXT_H
 
 #include <glib-object.h>
+#include <cairo.h>
 
 #include "ev-page.h"
 
@@ -50,6 +51,10 @@ struct _EvRenderContext
 	EvPage *page;
 	gint    rotation;
 	gdouble scale;
+
+	/* Area of the rendered page to render, when has_clip is set */
+	gboolean              has_clip;
+	cairo_rectangle_int_t clip;
 };
 
 GType            ev_render_context_get_type        (void) G_GNUC_CONST;
@@ -62,6 +67,10 @@ void             ev_render_context_set_rotation    (EvRenderContext *rc,
 						    gint             rotation);
 void             ev_render_context_set_scale       (EvRenderContext *rc,
 						    gdouble          scale);
+void             ev_render_context_set_clip        (EvRenderContext *rc,
+						    const cairo_rectangle_int_t *clip);
+gboolean         ev_render_context_get_clip        (EvRenderContext *rc,
+						    cairo_rectangle_int_t *clip);
 
 G_END_DECLS
 
@@ -0,0 +1,605 @@
+/* ev-text-index.c
+ *  this file is part of atril, a mate document viewer
+ *
+ * Atril is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atril is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "ev-file-helpers.h"
+#include "ev-text-index.h"
+
+/* The index maps every trigram of the page text to the pages containing
+ * it. The text is normalized (NFKC, case folded) and reduced to its
+ * letters and digits, so that line breaks, hyphenation and punctuation
+ * don't hide a match: the pages containing all the trigrams of a search
+ * string are a superset of the pages where the backend will find it.
+ *
+ * On disk, and once built, the index is:
+ *
+ *   header        (EV_TEXT_INDEX_HEADER_SIZE bytes)
+ *   entries       n_trigrams × { guint32 trigram, guint32 offset }
+ *                 sorted by trigram, offset into the postings
+ *   postings      page numbers of every trigram, in increasing order,
+ *                 delta and varint encoded
+ *
+ * with all the integers in little endian.
+ */
+#define EV_TEXT_INDEX_MAGIC       "ATRILTIX"
+#define EV_TEXT_INDEX_VERSION     1
+#define EV_TEXT_INDEX_HEADER_SIZE 40
+#define EV_TEXT_INDEX_ENTRY_SIZE  8
+
+/* Indexes not used for this long are removed from the cache, then the
+ * least recently used ones while the cache is larger than the limit */
+#define EV_TEXT_INDEX_CACHE_MAX_AGE  (60 * 24 * 60 * 60)
+#define EV_TEXT_INDEX_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
+struct _EvTextIndex {
+	volatile gint  ref_count;
+	gint           n_pages;
+
+	/* While building: trigram -> GArray of pages */
+	GHashTable    *postings;
+	gint           last_page;
+
+	/* Built or loaded */
+	GBytes        *bytes;
+	const guint8  *entries;
+	guint32        n_trigrams;
+	const guint8  *data;
+	gsize          data_length;
+};
+
+G_LOCK_DEFINE_STATIC (ev_text_index_freeze);
+
+G_DEFINE_BOXED_TYPE (EvTextIndex, ev_text_index, ev_text_index_ref, ev_text_index_unref)
+
+static inline guint32
+read_le32 (const guint8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static inline guint64
+read_le64 (const guint8 *p)
+{
+	return read_le32 (p) | ((guint64)read_le32 (p + 4) << 32);
+}
+
+static void
+append_le32 (GByteArray *array,
+	     guint32     value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (array, (const guint8 *)&value, 4);
+}
+
+static void
+append_le64 (GByteArray *array,
+	     guint64     value)
+{
+	value = GUINT64_TO_LE (value);
+	g_byte_array_append (array, (const guint8 *)&value, 8);
+}
+
+static void
+append_varint (GByteArray *array,
+	       guint32     value)
+{
+	guint8 byte;
+
+	while (value >= 0x80) {
+		byte = (value & 0x7f) | 0x80;
+		g_byte_array_append (array, &byte, 1);
+		value >>= 7;
+	}
+	byte = value;
+	g_byte_array_append (array, &byte, 1);
+}
+
+/* Letters and digits of @text, normalized and case folded */
+static gunichar *
+ev_text_index_normalize (const gchar *text,
+			 glong       *length)
+{
+	gchar       *valid;
+	gchar       *normalized;
+	gchar       *folded;
+	const gchar *p;
+	gunichar    *chars;
+	glong        n = 0;
+
+	valid = g_utf8_make_valid (text, -1);
+	normalized = g_utf8_normalize (valid, -1, G_NORMALIZE_ALL);
+	g_free (valid);
+	folded = g_utf8_casefold (normalized, -1);
+	g_free (normalized);
+
+	chars = g_new (gunichar, g_utf8_strlen (folded, -1) + 1);
+	for (p = folded; *p; p = g_utf8_next_char (p)) {
+		gunichar c = g_utf8_get_char (p);
+
+		if (g_unichar_isalnum (c))
+			chars[n++] = c;
+	}
+	g_free (folded);
+
+	*length = n;
+
+	return chars;
+}
+
+static inline guint32
+trigram_hash (const gunichar *chars)
+{
+	guint32 hash = 2166136261u;
+
+	hash = (hash ^ chars[0]) * 16777619u;
+	hash = (hash ^ chars[1]) * 16777619u;
+	hash = (hash ^ chars[2]) * 16777619u;
+
+	return hash;
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+		  gconstpointer b)
+{
+	guint32 ta = *(const guint32 *)a;
+	guint32 tb = *(const guint32 *)b;
+
+	return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+static void
+ev_text_index_set_bytes (EvTextIndex *index,
+			 GBytes      *bytes)
+{
+	const guint8 *contents;
+	gsize         length;
+	gsize         entries_size;
+
+	contents = g_bytes_get_data (bytes, &length);
+	entries_size = (gsize)read_le32 (contents + 32) * EV_TEXT_INDEX_ENTRY_SIZE;
+
+	index->bytes = bytes;
+	index->n_trigrams = read_le32 (contents + 32);
+	index->entries = contents + EV_TEXT_INDEX_HEADER_SIZE;
+	index->data = index->entries + entries_size;
+	index->data_length = length - EV_TEXT_INDEX_HEADER_SIZE - entries_size;
+}
+
+/* Serializes the pages added so far, no more pages can be added after this */
+static void
+ev_text_index_freeze (EvTextIndex *index)
+{
+	GByteArray    *array;
+	GByteArray    *postings;
+	GHashTableIter iter;
+	gpointer       key;
+	guint32       *trigrams;
+	guint          n_trigrams, i;
+
+	G_LOCK (ev_text_index_freeze);
+
+	if (index->bytes) {
+		G_UNLOCK (ev_text_index_freeze);
+		return;
+	}
+
+	n_trigrams = g_hash_table_size (index->postings);
+	trigrams = g_new (guint32, MAX (n_trigrams, 1));
+	i = 0;
+	g_hash_table_iter_init (&iter, index->postings);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		trigrams[i++] = GPOINTER_TO_UINT (key);
+	qsort (trigrams, n_trigrams, sizeof (guint32), compare_trigrams);
+
+	array = g_byte_array_new ();
+	g_byte_array_append (array, (const guint8 *)EV_TEXT_INDEX_MAGIC, 8);
+	append_le32 (array, EV_TEXT_INDEX_VERSION);
+	append_le32 (array, index->n_pages);
+	append_le64 (array, 0);
+	append_le64 (array, 0);
+	append_le32 (array, n_trigrams);
+	append_le32 (array, 0);
+
+	postings = g_byte_array_new ();
+	for (i = 0; i < n_trigrams; i++) {
+		GArray *pages;
+		guint32 last = 0;
+		guint   j;
+
+		pages = g_hash_table_lookup (index->postings, GUINT_TO_POINTER (trigrams[i]));
+
+		append_le32 (array, trigrams[i]);
+		append_le32 (array, postings->len);
+
+		for (j = 0; j < pages->len; j++) {
+			guint32 page = g_array_index (pages, guint32, j);
+
+			append_varint (postings, page - last);
+			last = page;
+		}
+	}
+	g_byte_array_append (array, postings->data, postings->len);
+	g_byte_array_free (postings, TRUE);
+	g_free (trigrams);
+
+	g_clear_pointer (&index->postings, g_hash_table_destroy);
+	ev_text_index_set_bytes (index, g_byte_array_free_to_bytes (array));
+
+	G_UNLOCK (ev_text_index_freeze);
+}
+
+static gchar *
+ev_text_index_get_cache_dir (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "atril", "text-index", NULL);
+}
+
+static gchar *
+ev_text_index_get_filename (const gchar *uri)
+{
+	gchar *checksum;
+	gchar *cache_dir;
+	gchar *filename;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+	cache_dir = ev_text_index_get_cache_dir ();
+	filename = g_build_filename (cache_dir, checksum, NULL);
+	g_free (cache_dir);
+	g_free (checksum);
+
+	return filename;
+}
+
+/* Pruned once per process, when the first index is saved */
+static gpointer
+ev_text_index_prune_cache (gpointer data)
+{
+	gchar *cache_dir;
+
+	cache_dir = ev_text_index_get_cache_dir ();
+	ev_cache_dir_prune (cache_dir, EV_TEXT_INDEX_CACHE_MAX_AGE,
+			    EV_TEXT_INDEX_CACHE_MAX_SIZE);
+	g_free (cache_dir);
+
+	return NULL;
+}
+
+/**
+ * ev_text_index_new:
+ * @n_pages: the number of pages of the document
+ *
+ * Creates an empty index, pages are added with ev_text_index_add_page().
+ *
+ * Returns: a new #EvTextIndex
+ */
+EvTextIndex *
+ev_text_index_new (gint n_pages)
+{
+	EvTextIndex *index;
+
+	index = g_slice_new0 (EvTextIndex);
+	index->ref_count = 1;
+	index->n_pages = n_pages;
+	index->last_page = -1;
+	index->postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						 NULL, (GDestroyNotify)g_array_unref);
+
+	return index;
+}
+
+/**
+ * ev_text_index_load:
+ * @uri: the URI of the document
+ * @size: the size of the document file
+ * @mtime: the modification time of the document file
+ * @n_pages: the number of pages of the document
+ *
+ * Loads the index saved for @uri with ev_text_index_save(), if it was
+ * saved for the same version of the file.
+ *
+ * Returns: the #EvTextIndex, or %NULL if there isn't a valid one
+ */
+EvTextIndex *
+ev_text_index_load (const gchar *uri,
+		    guint64      size,
+		    guint64      mtime,
+		    gint         n_pages)
+{
+	EvTextIndex  *index;
+	GMappedFile  *mapped;
+	GBytes       *bytes;
+	const guint8 *contents;
+	gsize         length;
+	gchar        *filename;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	filename = ev_text_index_get_filename (uri);
+	mapped = g_mapped_file_new (filename, FALSE, NULL);
+	if (!mapped) {
+		g_free (filename);
+		return NULL;
+	}
+
+	/* The modification time tells the cache pruning when it was used */
+	g_utime (filename, NULL);
+	g_free (filename);
+
+	bytes = g_mapped_file_get_bytes (mapped);
+	g_mapped_file_unref (mapped);
+
+	contents = g_bytes_get_data (bytes, &length);
+	if (length < EV_TEXT_INDEX_HEADER_SIZE ||
+	    memcmp (contents, EV_TEXT_INDEX_MAGIC, 8) != 0 ||
+	    read_le32 (contents + 8) != EV_TEXT_INDEX_VERSION ||
+	    read_le32 (contents + 12) != (guint32)n_pages ||
+	    read_le64 (contents + 16) != size ||
+	    read_le64 (contents + 24) != mtime ||
+	    (length - EV_TEXT_INDEX_HEADER_SIZE) / EV_TEXT_INDEX_ENTRY_SIZE < read_le32 (contents + 32)) {
+		g_bytes_unref (bytes);
+		return NULL;
+	}
+
+	index = g_slice_new0 (EvTextIndex);
+	index->ref_count = 1;
+	index->n_pages = n_pages;
+	ev_text_index_set_bytes (index, bytes);
+
+	return index;
+}
+
+EvTextIndex *
+ev_text_index_ref (EvTextIndex *index)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (index->ref_count > 0, index);
+
+	g_atomic_int_add (&index->ref_count, 1);
+
+	return index;
+}
+
+void
+ev_text_index_unref (EvTextIndex *index)
+{
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (index->ref_count > 0);
+
+	if (g_atomic_int_add (&index->ref_count, -1) - 1 == 0) {
+		g_clear_pointer (&index->postings, g_hash_table_destroy);
+		g_clear_pointer (&index->bytes, g_bytes_unref);
+		g_slice_free (EvTextIndex, index);
+	}
+}
+
+/**
+ * ev_text_index_add_page:
+ * @index: an #EvTextIndex
+ * @page: the page index
+ * @text: the text of the page
+ *
+ * Adds the text of @page to @index. Pages must be added in increasing
+ * order, and before the index is saved or searched.
+ */
+void
+ev_text_index_add_page (EvTextIndex *index,
+			gint         page,
+			const gchar *text)
+{
+	gunichar *chars;
+	glong     length, i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (index->postings != NULL);
+	g_return_if_fail (page > index->last_page && page < index->n_pages);
+
+	index->last_page = page;
+	if (!text)
+		return;
+
+	chars = ev_text_index_normalize (text, &length);
+	for (i = 0; i + 2 < length; i++) {
+		guint32 trigram = trigram_hash (chars + i);
+		guint32 value = page;
+		GArray *pages;
+
+		pages = g_hash_table_lookup (index->postings, GUINT_TO_POINTER (trigram));
+		if (!pages) {
+			pages = g_array_new (FALSE, FALSE, sizeof (guint32));
+			g_hash_table_insert (index->postings, GUINT_TO_POINTER (trigram), pages);
+		} else if (g_array_index (pages, guint32, pages->len - 1) == value) {
+			continue;
+		}
+
+		g_array_append_val (pages, value);
+	}
+	g_free (chars);
+}
+
+/**
+ * ev_text_index_save:
+ * @index: an #EvTextIndex
+ * @uri: the URI of the document
+ * @size: the size of the document file
+ * @mtime: the modification time of the document file
+ * @error: (allow-none): return location for an error, or %NULL
+ *
+ * Saves @index in the user cache directory, from where
+ * ev_text_index_load() loads it for the same version of the file.
+ * Indexes that haven't been used for a long time are removed from the
+ * cache the first time an index is saved.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+ev_text_index_save (EvTextIndex *index,
+		    const gchar *uri,
+		    guint64      size,
+		    guint64      mtime,
+		    GError     **error)
+{
+	GByteArray *array;
+	gchar      *filename;
+	gchar      *dirname;
+	gboolean    retval;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (uri != NULL, FALSE);
+
+	ev_text_index_freeze (index);
+
+	/* The header with the file size and time, then the index as is */
+	array = g_byte_array_sized_new (g_bytes_get_size (index->bytes));
+	g_byte_array_append (array, g_bytes_get_data (index->bytes, NULL), 16);
+	append_le64 (array, size);
+	append_le64 (array, mtime);
+	g_byte_array_append (array,
+			     (const guint8 *)g_bytes_get_data (index->bytes, NULL) + 32,
+			     g_bytes_get_size (index->bytes) - 32);
+
+	filename = ev_text_index_get_filename (uri);
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+	g_free (dirname);
+
+	retval = g_file_set_contents (filename, (const gchar *)array->data, array->len, error);
+	g_free (filename);
+	g_byte_array_free (array, TRUE);
+
+	if (retval) {
+		static GOnce prune_once = G_ONCE_INIT;
+
+		g_once (&prune_once, ev_text_index_prune_cache, NULL);
+	}
+
+	return retval;
+}
+
+gint
+ev_text_index_get_n_pages (EvTextIndex *index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+
+	return index->n_pages;
+}
+
+static gboolean
+ev_text_index_mark_pages (EvTextIndex *index,
+			  guint32      trigram,
+			  guint8      *marks)
+{
+	guint32 lo = 0, hi = index->n_trigrams;
+	guint32 start, end;
+	guint32 page = 0;
+
+	while (lo < hi) {
+		guint32 mid = lo + (hi - lo) / 2;
+		guint32 value = read_le32 (index->entries + mid * EV_TEXT_INDEX_ENTRY_SIZE);
+
+		if (value < trigram)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == index->n_trigrams ||
+	    read_le32 (index->entries + lo * EV_TEXT_INDEX_ENTRY_SIZE) != trigram)
+		return FALSE;
+
+	start = read_le32 (index->entries + lo * EV_TEXT_INDEX_ENTRY_SIZE + 4);
+	end = lo + 1 < index->n_trigrams ?
+		read_le32 (index->entries + (lo + 1) * EV_TEXT_INDEX_ENTRY_SIZE + 4) :
+		index->data_length;
+	end = MIN (end, index->data_length);
+
+	while (start < end) {
+		guint32 delta = 0;
+		guint   shift = 0;
+		guint8  byte;
+
+		do {
+			byte = index->data[start++];
+			if (shift < 32)
+				delta |= (guint32)(byte & 0x7f) << shift;
+			shift += 7;
+		} while ((byte & 0x80) && start < end);
+
+		page += delta;
+		if (page < (guint32)index->n_pages)
+			marks[page] = 1;
+	}
+
+	return TRUE;
+}
+
+/**
+ * ev_text_index_find_pages:
+ * @index: an #EvTextIndex
+ * @text: the text to find
+ *
+ * Looks up the pages that might contain @text, whether the search is
+ * case sensitive or not.
+ *
+ * Returns: (transfer full): an array with an element per page which is
+ * %FALSE when the page doesn't contain @text, or %NULL when @text is too
+ * short for the index to tell.
+ */
+gboolean *
+ev_text_index_find_pages (EvTextIndex *index,
+			  const gchar *text)
+{
+	gunichar *chars;
+	glong     length, i;
+	gboolean *pages;
+	guint8   *marks;
+	gint      page;
+
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+
+	ev_text_index_freeze (index);
+
+	chars = ev_text_index_normalize (text, &length);
+	if (length < 3) {
+		g_free (chars);
+		return NULL;
+	}
+
+	pages = g_new (gboolean, index->n_pages);
+	for (page = 0; page < index->n_pages; page++)
+		pages[page] = TRUE;
+
+	marks = g_new (guint8, index->n_pages);
+	for (i = 0; i + 2 < length; i++) {
+		memset (marks, 0, index->n_pages);
+		ev_text_index_mark_pages (index, trigram_hash (chars + i), marks);
+
+		for (page = 0; page < index->n_pages; page++)
+			pages[page] &= marks[page];
+	}
+	g_free (marks);
+	g_free (chars);
+
+	return pages;
+}
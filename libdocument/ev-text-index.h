@@ -0,0 +1,57 @@
+/* ev-text-index.h
+ *  this file is part of atril, a mate document viewer
+ *
+ * Atril is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Atril is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_ATRIL_DOCUMENT_H_INSIDE__) && !defined (ATRIL_COMPILATION)
+#error "Only <atril-document.h> can be included directly."
+#endif
+
+#ifndef EV_TEXT_INDEX_H
+#define EV_TEXT_INDEX_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EvTextIndex EvTextIndex;
+
+#define        EV_TYPE_TEXT_INDEX         (ev_text_index_get_type())
+GType          ev_text_index_get_type     (void) G_GNUC_CONST;
+
+EvTextIndex   *ev_text_index_new          (gint         n_pages);
+EvTextIndex   *ev_text_index_load         (const gchar *uri,
+					   guint64      size,
+					   guint64      mtime,
+					   gint         n_pages);
+EvTextIndex   *ev_text_index_ref          (EvTextIndex *index);
+void           ev_text_index_unref        (EvTextIndex *index);
+
+void           ev_text_index_add_page     (EvTextIndex *index,
+					   gint         page,
+					   const gchar *text);
+gboolean       ev_text_index_save         (EvTextIndex *index,
+					   const gchar *uri,
+					   guint64      size,
+					   guint64      mtime,
+					   GError     **error);
+gint           ev_text_index_get_n_pages  (EvTextIndex *index);
+gboolean      *ev_text_index_find_pages   (EvTextIndex *index,
+					   const gchar *text);
+
+G_END_DECLS
+
+#endif /* EV_TEXT_INDEX_H */
@@ -30,13 +30,12 @@ typedef struct _EvSchedulerJob {
 G_LOCK_DEFINE_STATIC(job_list);
 static GSList *job_list = NULL;
 
-static volatile EvJob *running_job = NULL;
-
 static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 						   GCancellable   *cancellable);
 
 /* EvJobQueue */
+static GQueue queue_preview = G_QUEUE_INIT;
 static GQueue queue_urgent = G_QUEUE_INIT;
 static GQueue queue_high = G_QUEUE_INIT;
 static GQueue queue_low = G_QUEUE_INIT;
@@ -48,9 +47,25 @@ static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
 	&queue_urgent,
 	&queue_high,
 	&queue_low,
-	&queue_none
+	&queue_none,
+	&queue_preview
+};
+
+/* The order the queues are served in. EV_JOB_PRIORITY_PREVIEW was added
+ * after the others, to keep their values, but comes first */
+static const EvJobPriority job_queue_order[EV_JOB_N_PRIORITIES] = {
+	EV_JOB_PRIORITY_PREVIEW,
+	EV_JOB_PRIORITY_URGENT,
+	EV_JOB_PRIORITY_HIGH,
+	EV_JOB_PRIORITY_LOW,
+	EV_JOB_PRIORITY_NONE
 };
 
+/* Worker pool, protected by job_queue_mutex */
+static GSList *running_jobs = NULL;
+static guint   n_threads = 0;
+static guint   max_threads = 0;
+
 static void
 ev_job_queue_push (EvSchedulerJob *job,
 		   EvJobPriority   priority)
@@ -65,16 +80,58 @@ ev_job_queue_push (EvSchedulerJob *job,
 	g_mutex_unlock (&job_queue_mutex);
 }
 
+static gboolean
+ev_job_queue_document_is_busy_unlocked (EvDocument *document)
+{
+	GSList *l;
+
+	/* Backends that allow concurrent page operations do their own
+	 * locking, see ev_document_lock_shared() */
+	if (!document ||
+	    ev_document_get_concurrency (document) & EV_DOCUMENT_CONCURRENCY_PAGES)
+		return FALSE;
+
+	for (l = running_jobs; l; l = g_slist_next (l)) {
+		EvJob *job = (EvJob *)l->data;
+
+		/* Find, text index and page sizes jobs only lock the
+		 * document a few pages at a time and can take long,
+		 * don't make other jobs wait for them */
+		if (EV_IS_JOB_FIND (job) || EV_IS_JOB_TEXT_INDEX (job) ||
+		    EV_IS_JOB_PAGE_SIZES (job))
+			continue;
+
+		if (job->document == document)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
 {
 	gint i;
 	EvSchedulerJob *job = NULL;
 
-	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
+	/* Unless the backend allows concurrent page operations, jobs of
+	 * the same document are run one at a time, so that they don't pile
+	 * up on the document lock and keep their priority order.
+	 */
+	for (i = 0; i < EV_JOB_N_PRIORITIES && !job; i++) {
+		GQueue *queue = job_queue[job_queue_order[i]];
+		GList  *l;
+
+		for (l = g_queue_peek_head_link (queue); l; l = g_list_next (l)) {
+			EvSchedulerJob *s_job = (EvSchedulerJob *)l->data;
+
+			if (ev_job_queue_document_is_busy_unlocked (s_job->job->document))
+				continue;
+
+			g_queue_delete_link (queue, l);
+			job = s_job;
 			break;
+		}
 	}
 
 	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
@@ -82,10 +139,25 @@ ev_job_queue_get_next_unlocked (void)
 	return job;
 }
 
+static void
+ev_job_scheduler_spawn_threads_unlocked (void)
+{
+	while (n_threads < max_threads) {
+		g_thread_unref (g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL));
+		n_threads++;
+	}
+}
+
 static gpointer
 ev_job_scheduler_init (gpointer data)
 {
-	g_thread_new ("EvJobScheduler", ev_job_thread_proxy, NULL);
+	g_mutex_lock (&job_queue_mutex);
+
+	if (max_threads == 0)
+		max_threads = MAX (g_get_num_processors (), 1);
+	ev_job_scheduler_spawn_threads_unlocked ();
+
+	g_mutex_unlock (&job_queue_mutex);
 
 	return NULL;
 }
@@ -163,6 +235,7 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	if (list) {
 		g_queue_delete_link (job_queue[job->priority], list);
 		g_mutex_unlock (&job_queue_mutex);
+		ev_profiler_cancel (EV_PROFILE_JOBS, "%s (%p) queued", EV_GET_TYPE_NAME (job->job), job->job);
 		ev_scheduler_job_destroy (job);
 	} else {
 		g_mutex_unlock (&job_queue_mutex);
@@ -179,13 +252,9 @@ ev_job_thread (EvJob *job)
 	do {
 		if (g_cancellable_is_cancelled (job->cancellable))
 			result = FALSE;
-		else {
-                        g_atomic_pointer_set (&running_job, job);
+		else
 			result = ev_job_run (job);
-                }
 	} while (result);
-
-        g_atomic_pointer_set (&running_job, NULL);
 }
 
 static gboolean
@@ -206,15 +275,31 @@ ev_job_thread_proxy (gpointer data)
 		EvSchedulerJob *job;
 
 		g_mutex_lock (&job_queue_mutex);
+		if (n_threads > max_threads) {
+			/* The pool has been shrunk */
+			n_threads--;
+			g_mutex_unlock (&job_queue_mutex);
+			break;
+		}
+
 		job = ev_job_queue_get_next_unlocked ();
 		if (!job) {
 			g_cond_wait (&job_queue_cond, &job_queue_mutex);
 			g_mutex_unlock (&job_queue_mutex);
 			continue;
 		}
+		running_jobs = g_slist_prepend (running_jobs, job->job);
 		g_mutex_unlock (&job_queue_mutex);
 
+		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p) queued", EV_GET_TYPE_NAME (job->job), job->job);
 		ev_job_thread (job->job);
+
+		g_mutex_lock (&job_queue_mutex);
+		running_jobs = g_slist_remove (running_jobs, job->job);
+		/* Jobs of the same document might be waiting for this one */
+		g_cond_broadcast (&job_queue_cond);
+		g_mutex_unlock (&job_queue_mutex);
+
 		ev_scheduler_job_destroy (job);
 	}
 
@@ -243,6 +328,7 @@ ev_job_scheduler_push_job (EvJob         *job,
 		g_signal_connect_swapped (job->cancellable, "cancelled",
 					  G_CALLBACK (ev_scheduler_thread_job_cancelled),
 					  s_job);
+		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p) queued", EV_GET_TYPE_NAME (job), job);
 		ev_job_queue_push (s_job, priority);
 		break;
 	case EV_JOB_RUN_MAIN_LOOP:
@@ -310,10 +396,78 @@ ev_job_scheduler_update_job (EvJob         *job,
 /**
  * ev_job_scheduler_get_running_thread_job:
  *
+ * Since jobs are run by a pool of threads, more than one job might be
+ * running at the same time; this returns the one that was started most
+ * recently. Use ev_job_scheduler_is_job_running() to check a given job.
+ *
  * Returns: (transfer none): an #EvJob
  */
 EvJob *
 ev_job_scheduler_get_running_thread_job (void)
 {
-        return g_atomic_pointer_get (&running_job);
+	EvJob *job;
+
+	g_mutex_lock (&job_queue_mutex);
+	job = running_jobs ? (EvJob *)running_jobs->data : NULL;
+	g_mutex_unlock (&job_queue_mutex);
+
+	return job;
+}
+
+/**
+ * ev_job_scheduler_is_job_running:
+ * @job: an #EvJob
+ *
+ * Returns: %TRUE if @job is currently being run by a scheduler thread
+ */
+gboolean
+ev_job_scheduler_is_job_running (EvJob *job)
+{
+	gboolean retval;
+
+	g_mutex_lock (&job_queue_mutex);
+	retval = g_slist_find (running_jobs, job) != NULL;
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
+}
+
+/**
+ * ev_job_scheduler_set_max_threads:
+ * @threads: the number of threads, or 0 to use one per processor
+ *
+ * Sets the number of threads used to run #EV_JOB_RUN_THREAD jobs.
+ * Threads exceeding the new limit finish after their current job.
+ */
+void
+ev_job_scheduler_set_max_threads (guint threads)
+{
+	g_mutex_lock (&job_queue_mutex);
+
+	max_threads = threads > 0 ? threads : MAX (g_get_num_processors (), 1);
+	ev_debug_message (DEBUG_JOBS, "%u threads", max_threads);
+
+	/* Only grow the pool once it has been started */
+	if (n_threads > 0)
+		ev_job_scheduler_spawn_threads_unlocked ();
+	g_cond_broadcast (&job_queue_cond);
+
+	g_mutex_unlock (&job_queue_mutex);
+}
+
+/**
+ * ev_job_scheduler_get_max_threads:
+ *
+ * Returns: the number of threads used to run #EV_JOB_RUN_THREAD jobs
+ */
+guint
+ev_job_scheduler_get_max_threads (void)
+{
+	guint retval;
+
+	g_mutex_lock (&job_queue_mutex);
+	retval = max_threads > 0 ? max_threads : MAX (g_get_num_processors (), 1);
+	g_mutex_unlock (&job_queue_mutex);
+
+	return retval;
 }
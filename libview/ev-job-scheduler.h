@@ -35,14 +35,19 @@ typedef enum {
 	EV_JOB_PRIORITY_HIGH,   /* Rendering current thumbnail range */
 	EV_JOB_PRIORITY_LOW,    /* Rendering pages not in current range */
 	EV_JOB_PRIORITY_NONE,   /* Any other job: load, save, print, ... */
+	EV_JOB_PRIORITY_PREVIEW, /* Rendering placeholders for the current page range,
+				  * run before any other */
 	EV_JOB_N_PRIORITIES
 } EvJobPriority;
 
-void   ev_job_scheduler_push_job               (EvJob        *job,
-                                                EvJobPriority priority);
-void   ev_job_scheduler_update_job             (EvJob        *job,
-                                                EvJobPriority priority);
-EvJob *ev_job_scheduler_get_running_thread_job (void);
+void     ev_job_scheduler_push_job               (EvJob        *job,
+                                                  EvJobPriority priority);
+void     ev_job_scheduler_update_job             (EvJob        *job,
+                                                  EvJobPriority priority);
+EvJob   *ev_job_scheduler_get_running_thread_job (void);
+gboolean ev_job_scheduler_is_job_running         (EvJob        *job);
+void     ev_job_scheduler_set_max_threads        (guint         threads);
+guint    ev_job_scheduler_get_max_threads        (void);
 
 G_END_DECLS
 
@@ -25,6 +25,7 @@
 #include "ev-document-links.h"
 #include "ev-document-images.h"
 #include "ev-job-scheduler.h"
+#include "ev-page-cache.h"
 #include "ev-document-forms.h"
 #include "ev-file-exporter.h"
 #include "ev-document-factory.h"
@@ -45,6 +46,7 @@
 #include <webkit2/webkit2.h>
 #endif
 #include <errno.h>
+#include <string.h>
 #include <glib/gstdio.h>
 #include <glib/gi18n-lib.h>
 #include <unistd.h>
@@ -60,14 +62,26 @@ enum {
 	FONTS_LAST_SIGNAL
 };
 
+enum {
+	ANNOTS_UPDATED,
+	ANNOTS_LAST_SIGNAL
+};
+
 enum {
 	FIND_UPDATED,
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	PAGE_SIZES_UPDATED,
+	PAGE_SIZES_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_fonts_signals[FONTS_LAST_SIGNAL] = { 0 };
+static guint job_annots_signals[ANNOTS_LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_page_sizes_signals[PAGE_SIZES_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
@@ -78,8 +92,10 @@ G_DEFINE_TYPE (EvJobPageData, ev_job_page_data, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobThumbnail, ev_job_thumbnail, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFonts, ev_job_fonts, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoad, ev_job_load, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobPageSizes, ev_job_page_sizes, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobSave, ev_job_save, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFind, ev_job_find, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobTextIndex, ev_job_text_index, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLayers, ev_job_layers, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobExport, ev_job_export, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobPrint, ev_job_print, EV_TYPE_JOB)
@@ -361,9 +377,9 @@ ev_job_links_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_links->model = ev_document_links_get_links_model (EV_DOCUMENT_LINKS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	gtk_tree_model_foreach (job_links->model, (GtkTreeModelForeachFunc)fill_page_labels, job);
 
@@ -428,10 +444,10 @@ ev_job_attachments_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_attachments->attachments =
 		ev_document_attachments_get_attachments (EV_DOCUMENT_ATTACHMENTS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -486,31 +502,87 @@ ev_job_annots_dispose (GObject *object)
 	G_OBJECT_CLASS (ev_job_annots_parent_class)->dispose (object);
 }
 
+/* Pages whose annotations are fetched between two releases of the
+ * document lock, so that rendering isn't held up for long */
+#define EV_JOB_ANNOTS_CHUNK_SIZE 32
+
+typedef struct {
+	EvJobAnnots *job;
+	GList       *annots;
+} EvJobAnnotsUpdate;
+
+static void
+ev_job_annots_update_free (EvJobAnnotsUpdate *update)
+{
+	g_list_free_full (update->annots, (GDestroyNotify)ev_mapping_list_unref);
+	g_object_unref (update->job);
+	g_slice_free (EvJobAnnotsUpdate, update);
+}
+
+/* Results are stored from the main loop only, like the find results */
+static gboolean
+ev_job_annots_emit_updated (EvJobAnnotsUpdate *update)
+{
+	EvJobAnnots *job = update->job;
+	GList       *annots = update->annots;
+
+	if (g_cancellable_is_cancelled (EV_JOB (job)->cancellable))
+		return FALSE;
+
+	update->annots = NULL;
+	job->annots = g_list_concat (job->annots, annots);
+
+	g_signal_emit (job, job_annots_signals[ANNOTS_UPDATED], 0, annots);
+
+	return FALSE;
+}
+
 static gboolean
 ev_job_annots_run (EvJob *job)
 {
-	EvJobAnnots *job_annots = EV_JOB_ANNOTS (job);
-	gint         i;
+	gint n_pages;
+	gint i;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
-	for (i = 0; i < ev_document_get_n_pages (job->document); i++) {
-		EvMappingList *mapping_list;
-		EvPage        *page;
+	n_pages = ev_document_get_n_pages (job->document);
+	for (i = 0; i < n_pages && !g_cancellable_is_cancelled (job->cancellable); ) {
+		EvJobAnnotsUpdate *update;
+		gint               last;
 
-		page = ev_document_get_page (job->document, i);
-		mapping_list = ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
-									page);
-		g_object_unref (page);
+		update = g_slice_new0 (EvJobAnnotsUpdate);
+		update->job = g_object_ref (EV_JOB_ANNOTS (job));
 
-		if (mapping_list)
-			job_annots->annots = g_list_prepend (job_annots->annots, mapping_list);
-	}
-	ev_document_doc_mutex_unlock ();
+		last = MIN (i + EV_JOB_ANNOTS_CHUNK_SIZE, n_pages);
 
-	job_annots->annots = g_list_reverse (job_annots->annots);
+		/* Backends build and cache their annotation objects while
+		 * fetching them, so this can't share the document */
+		ev_document_lock (job->document);
+		for (; i < last; i++) {
+			EvMappingList *mapping_list;
+			EvPage        *page;
+
+			page = ev_document_get_page (job->document, i);
+			mapping_list = ev_page_cache_fetch_annot_mapping (job->document, page);
+			g_object_unref (page);
+
+			if (mapping_list)
+				update->annots = g_list_prepend (update->annots, mapping_list);
+		}
+		ev_document_unlock (job->document);
+
+		if (!update->annots) {
+			ev_job_annots_update_free (update);
+			continue;
+		}
+
+		update->annots = g_list_reverse (update->annots);
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_job_annots_emit_updated,
+				 update,
+				 (GDestroyNotify)ev_job_annots_update_free);
+	}
 
 	ev_job_succeeded (job);
 
@@ -525,8 +597,29 @@ ev_job_annots_class_init (EvJobAnnotsClass *class)
 
 	oclass->dispose = ev_job_annots_dispose;
 	job_class->run = ev_job_annots_run;
+
+	job_annots_signals[ANNOTS_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_ANNOTS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobAnnotsClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
 }
 
+/**
+ * ev_job_annots_new:
+ * @document: a #EvDocument implementing #EvDocumentAnnotations
+ *
+ * Creates a job getting the annotations of all the pages of @document.
+ * They are fetched a few pages at a time, and #EvJobAnnots::updated is
+ * emitted with the annotation mappings of every few pages found to
+ * have annotations, which are also appended to the annots field.
+ *
+ * Returns: (transfer full): a new #EvJobAnnots
+ */
 EvJob *
 ev_job_annots_new (EvDocument *document)
 {
@@ -584,11 +677,11 @@ ev_job_render_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock_shared (job->document);
 
 	ev_profiler_start (EV_PROFILE_JOBS, "Rendering page %d", job_render->page);
 
-	ev_document_fc_mutex_lock ();
+	ev_document_render_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_render->page);
 
@@ -597,24 +690,26 @@ ev_job_render_run (EvJob *job)
 		return TRUE;
 
 		if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_document_render_unlock (job->document);
+		ev_document_unlock_shared (job->document);
 		g_object_unref (rc);
 
 		return FALSE;
 		}
 
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_document_render_unlock (job->document);
+		ev_document_unlock_shared (job->document);
 		ev_job_succeeded (job);
 		return FALSE;
 	}
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
 	g_object_unref (ev_page);
+	if (job_render->has_clip)
+		ev_render_context_set_clip (rc, &job_render->clip);
 
 	if ((job_render->surface = ev_document_render (job->document, rc)) == NULL) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_document_render_unlock (job->document);
+		ev_document_unlock_shared (job->document);
 		g_object_unref (rc);
 		ev_job_failed (job,
 		               EV_DOCUMENT_ERROR,
@@ -624,12 +719,18 @@ ev_job_render_run (EvJob *job)
 		return FALSE;
 	}
 
+	/* Backends not honouring the clip render the whole page */
+	if (job_render->has_clip &&
+	    (cairo_image_surface_get_width (job_render->surface) != job_render->clip.width ||
+	     cairo_image_surface_get_height (job_render->surface) != job_render->clip.height))
+		job_render->has_clip = FALSE;
+
 	/* If job was cancelled during the page rendering,
 	 * we return now, so that the thread is finished ASAP
 	 */
 	if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
+		ev_document_render_unlock (job->document);
+		ev_document_unlock_shared (job->document);
 		g_object_unref (rc);
 
 		return FALSE;
@@ -652,8 +753,8 @@ ev_job_render_run (EvJob *job)
 
 	g_object_unref (rc);
 
-	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_document_render_unlock (job->document);
+	ev_document_unlock_shared (job->document);
 
 	ev_job_succeeded (job);
 
@@ -694,6 +795,24 @@ ev_job_render_new (EvDocument   *document,
 	return EV_JOB (job);
 }
 
+/**
+ * ev_job_render_set_clip:
+ * @job: an #EvJobRender
+ * @clip: (allow-none): the area of the page to render, in pixels of
+ *   the rendered page, or %NULL for the whole page
+ *
+ * Renders only @clip of the page, when the backend supports it. The
+ * has_clip field of @job is unset when it rendered the whole page.
+ */
+void
+ev_job_render_set_clip (EvJobRender                 *job,
+			const cairo_rectangle_int_t *clip)
+{
+	job->has_clip = clip != NULL;
+	if (clip)
+		job->clip = *clip;
+}
+
 void
 ev_job_render_set_selection_info (EvJobRender     *job,
 				  EvRectangle     *selection_points,
@@ -725,24 +844,32 @@ ev_job_page_data_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_pd->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	/* Text is extracted with a page lock, so that it can run alongside
+	 * rendering on backends that allow it */
+	ev_document_lock_shared (job->document);
 	ev_page = ev_document_get_page (job->document, job_pd->page);
 
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd->text_mapping =
-			ev_document_text_get_text_mapping (EV_DOCUMENT_TEXT (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd->text =
-			ev_document_text_get_text (EV_DOCUMENT_TEXT (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) && EV_IS_DOCUMENT_TEXT (job->document))
-		ev_document_text_get_text_layout (EV_DOCUMENT_TEXT (job->document),
-						  ev_page,
-						  &(job_pd->text_layout),
-						  &(job_pd->text_layout_length));
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) && EV_IS_DOCUMENT_TEXT (job->document))
-		job_pd ->text_attrs =
-			ev_document_text_get_text_attrs (EV_DOCUMENT_TEXT (job->document),
-							 ev_page);
+	/* All the text data is extracted at once, so that backends can
+	 * analyze the page text a single time */
+	if ((job_pd->flags & (EV_PAGE_DATA_INCLUDE_TEXT_MAPPING | EV_PAGE_DATA_INCLUDE_TEXT |
+			      EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT | EV_PAGE_DATA_INCLUDE_TEXT_ATTRS)) &&
+	    EV_IS_DOCUMENT_TEXT (job->document)) {
+		EvJobPageDataFlags flags = job_pd->flags;
+
+		ev_document_text_get_text_data (EV_DOCUMENT_TEXT (job->document),
+						ev_page,
+						(flags & EV_PAGE_DATA_INCLUDE_TEXT) ?
+						&(job_pd->text) : NULL,
+						(flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT) ?
+						&(job_pd->text_layout) : NULL,
+						&(job_pd->text_layout_length),
+						(flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING) ?
+						&(job_pd->text_mapping) : NULL,
+						(flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS) ?
+						&(job_pd->text_attrs) : NULL);
+	}
+	ev_document_unlock_shared (job->document);
+
         if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS) && job_pd->text) {
                 job_pd->text_log_attrs_length = g_utf8_strlen (job_pd->text, -1);
                 job_pd->text_log_attrs = g_new0 (PangoLogAttr, job_pd->text_log_attrs_length + 1);
@@ -750,23 +877,27 @@ ev_job_page_data_run (EvJob *job)
                 /* FIXME: We need API to get the language of the document */
                 pango_get_log_attrs (job_pd->text, -1, -1, NULL, job_pd->text_log_attrs, job_pd->text_log_attrs_length + 1);
         }
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_LINKS) && EV_IS_DOCUMENT_LINKS (job->document))
-		job_pd->link_mapping =
-			ev_document_links_get_links (EV_DOCUMENT_LINKS (job->document), ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_FORMS) && EV_IS_DOCUMENT_FORMS (job->document))
-		job_pd->form_field_mapping =
-			ev_document_forms_get_form_fields (EV_DOCUMENT_FORMS (job->document),
-							   ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_IMAGES) && EV_IS_DOCUMENT_IMAGES (job->document))
-		job_pd->image_mapping =
-			ev_document_images_get_image_mapping (EV_DOCUMENT_IMAGES (job->document),
-							      ev_page);
-	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_ANNOTS) && EV_IS_DOCUMENT_ANNOTATIONS (job->document))
-		job_pd->annot_mapping =
-			ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (job->document),
-								 ev_page);
+
+	if (job_pd->flags & (EV_PAGE_DATA_INCLUDE_LINKS | EV_PAGE_DATA_INCLUDE_FORMS |
+			     EV_PAGE_DATA_INCLUDE_IMAGES | EV_PAGE_DATA_INCLUDE_ANNOTS)) {
+		ev_document_lock (job->document);
+		if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_LINKS) && EV_IS_DOCUMENT_LINKS (job->document))
+			job_pd->link_mapping =
+				ev_document_links_get_links (EV_DOCUMENT_LINKS (job->document), ev_page);
+		if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_FORMS) && EV_IS_DOCUMENT_FORMS (job->document))
+			job_pd->form_field_mapping =
+				ev_document_forms_get_form_fields (EV_DOCUMENT_FORMS (job->document),
+								   ev_page);
+		if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_IMAGES) && EV_IS_DOCUMENT_IMAGES (job->document))
+			job_pd->image_mapping =
+				ev_document_images_get_image_mapping (EV_DOCUMENT_IMAGES (job->document),
+								      ev_page);
+		if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_ANNOTS) && EV_IS_DOCUMENT_ANNOTATIONS (job->document))
+			job_pd->annot_mapping =
+				ev_page_cache_fetch_annot_mapping (job->document, ev_page);
+		ev_document_unlock (job->document);
+	}
 	g_object_unref (ev_page);
-	ev_document_doc_mutex_unlock ();
 
 	ev_job_succeeded (job);
 
@@ -824,6 +955,226 @@ ev_job_thumbnail_dispose (GObject *object)
 }
 
 #if ENABLE_EPUB
+/*
+ * Setting up an offscreen web view is expensive, so a few of them are
+ * kept around and the thumbnail jobs of web documents take turns in
+ * them, loading their page and taking a snapshot of it. Views left
+ * idle for a while are destroyed.
+ */
+#define WEB_THUMBNAIL_N_VIEWS      2
+#define WEB_THUMBNAIL_IDLE_TIMEOUT 30
+
+static GQueue web_thumbnail_idle_views = G_QUEUE_INIT;
+static GQueue web_thumbnail_pending_jobs = G_QUEUE_INIT;
+static guint  web_thumbnail_n_views = 0;
+static guint  web_thumbnail_idle_id = 0;
+
+static void web_thumbnail_view_release (WebKitWebView *webview);
+
+/* The thumbnails of web documents are cached on disk, for the version
+ * of the document file they were taken from. The cache is read and
+ * written in threads, and the directories of documents that haven't
+ * been used for a long time are removed from it once per process.
+ */
+#define WEB_THUMBNAIL_CACHE_MAX_AGE  (60 * 24 * 60 * 60)
+#define WEB_THUMBNAIL_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+	gchar     *uri;
+	gchar     *cache_dir;
+	gchar     *basename;
+	GdkPixbuf *thumbnail;
+} WebThumbnailCacheData;
+
+static void web_thumbnail_render (EvJobThumbnail *job_thumb);
+
+static void
+web_thumbnail_cache_data_free (WebThumbnailCacheData *data)
+{
+	g_free (data->uri);
+	g_free (data->cache_dir);
+	g_free (data->basename);
+	if (data->thumbnail)
+		g_object_unref (data->thumbnail);
+	g_slice_free (WebThumbnailCacheData, data);
+}
+
+static WebThumbnailCacheData *
+web_thumbnail_cache_data_new (EvJobThumbnail *job_thumb)
+{
+	EvDocument            *document = EV_JOB (job_thumb)->document;
+	WebThumbnailCacheData *data;
+
+	data = g_slice_new0 (WebThumbnailCacheData);
+	data->uri = g_strdup (ev_document_get_uri (document));
+	data->cache_dir = g_strdup (g_object_get_data (G_OBJECT (document),
+						       "ev-web-thumbnail-cache-dir"));
+	data->basename = g_strdup_printf ("%d-%d.png", job_thumb->page,
+					  (gint)(job_thumb->scale * 1000 + 0.5));
+
+	return data;
+}
+
+static gchar *
+web_thumbnail_get_cache_root (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "atril", "thumbnails", NULL);
+}
+
+/* Called in a thread, since it queries the document file */
+static gchar *
+web_thumbnail_get_cache_dir (const gchar *uri)
+{
+	GFile     *file;
+	GFileInfo *info;
+	gchar     *key, *checksum;
+	gchar     *cache_root;
+	gchar     *cache_dir;
+
+	if (!uri)
+		return NULL;
+
+	file = g_file_new_for_uri (uri);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return NULL;
+
+	key = g_strdup_printf ("%s %" G_GINT64_FORMAT " %" G_GUINT64_FORMAT, uri,
+			       g_file_info_get_size (info),
+			       g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+	g_object_unref (info);
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+	g_free (key);
+
+	cache_root = web_thumbnail_get_cache_root ();
+	cache_dir = g_build_filename (cache_root, checksum, NULL);
+	g_free (cache_root);
+	g_free (checksum);
+
+	return cache_dir;
+}
+
+static void
+web_thumbnail_load_cached_thread (GTask                 *task,
+				  gpointer               source_object,
+				  WebThumbnailCacheData *data,
+				  GCancellable          *cancellable)
+{
+	gchar *filename;
+
+	if (!data->cache_dir)
+		data->cache_dir = web_thumbnail_get_cache_dir (data->uri);
+
+	if (data->cache_dir) {
+		filename = g_build_filename (data->cache_dir, data->basename, NULL);
+		data->thumbnail = gdk_pixbuf_new_from_file (filename, NULL);
+		g_free (filename);
+
+		/* The modification time tells the cache pruning when it was used */
+		if (data->thumbnail)
+			g_utime (data->cache_dir, NULL);
+	}
+
+	g_task_return_boolean (task, data->thumbnail != NULL);
+}
+
+static void
+web_thumbnail_load_cached_cb (EvJobThumbnail *job_thumb,
+			      GAsyncResult   *result,
+			      gpointer        user_data)
+{
+	WebThumbnailCacheData *data = g_task_get_task_data (G_TASK (result));
+	EvDocument            *document = EV_JOB (job_thumb)->document;
+
+	if (data->cache_dir &&
+	    !g_object_get_data (G_OBJECT (document), "ev-web-thumbnail-cache-dir")) {
+		g_object_set_data_full (G_OBJECT (document), "ev-web-thumbnail-cache-dir",
+					g_strdup (data->cache_dir), g_free);
+	}
+
+	if (g_cancellable_is_cancelled (EV_JOB (job_thumb)->cancellable))
+		return;
+
+	if (data->thumbnail) {
+		job_thumb->thumbnail = g_object_ref (data->thumbnail);
+		ev_job_succeeded (EV_JOB (job_thumb));
+		return;
+	}
+
+	web_thumbnail_render (job_thumb);
+}
+
+static void
+web_thumbnail_load_cached (EvJobThumbnail *job_thumb)
+{
+	GTask *task;
+
+	task = g_task_new (job_thumb, NULL,
+			   (GAsyncReadyCallback)web_thumbnail_load_cached_cb,
+			   NULL);
+	g_task_set_task_data (task, web_thumbnail_cache_data_new (job_thumb),
+			      (GDestroyNotify)web_thumbnail_cache_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)web_thumbnail_load_cached_thread);
+	g_object_unref (task);
+}
+
+static gpointer
+web_thumbnail_prune_cache (gpointer user_data)
+{
+	gchar *cache_root;
+
+	cache_root = web_thumbnail_get_cache_root ();
+	ev_cache_dir_prune (cache_root, WEB_THUMBNAIL_CACHE_MAX_AGE,
+			    WEB_THUMBNAIL_CACHE_MAX_SIZE);
+	g_free (cache_root);
+
+	return NULL;
+}
+
+static void
+web_thumbnail_save_cached_thread (GTask                 *task,
+				  gpointer               source_object,
+				  WebThumbnailCacheData *data,
+				  GCancellable          *cancellable)
+{
+	static GOnce prune_once = G_ONCE_INIT;
+	gchar       *filename;
+
+	if (g_mkdir_with_parents (data->cache_dir, 0700) == 0) {
+		filename = g_build_filename (data->cache_dir, data->basename, NULL);
+		gdk_pixbuf_save (data->thumbnail, filename, "png", NULL, NULL);
+		g_free (filename);
+	}
+
+	g_once (&prune_once, web_thumbnail_prune_cache, NULL);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+web_thumbnail_save_cached (EvJobThumbnail *job_thumb)
+{
+	WebThumbnailCacheData *data;
+	GTask                 *task;
+
+	data = web_thumbnail_cache_data_new (job_thumb);
+	if (!data->cache_dir) {
+		web_thumbnail_cache_data_free (data);
+		return;
+	}
+	data->thumbnail = g_object_ref (job_thumb->thumbnail);
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, data, (GDestroyNotify)web_thumbnail_cache_data_free);
+	g_task_run_in_thread (task, (GTaskThreadFunc)web_thumbnail_save_cached_thread);
+	g_object_unref (task);
+}
+
 static void
 snapshot_callback(WebKitWebView *webview,
                   GAsyncResult  *results,
@@ -831,41 +1182,63 @@ snapshot_callback(WebKitWebView *webview,
 {
 	GError *error = NULL;
 
-	ev_document_doc_mutex_lock ();
-
-	EvPage *page = ev_document_get_page (EV_JOB(job_thumb)->document, job_thumb->page);
 	job_thumb->surface = webkit_web_view_get_snapshot_finish (webview,
 	                                                          results,
 	                                                          &error);
 
 	if (error) {
 		g_warning ("Error retrieving a snapshot: %s", error->message);
-	}
+		if (!ev_job_is_finished (EV_JOB (job_thumb)))
+			ev_job_failed_from_error (EV_JOB (job_thumb), error);
+		g_error_free (error);
+	} else if (g_cancellable_is_cancelled (EV_JOB (job_thumb)->cancellable)) {
+		cairo_surface_destroy (job_thumb->surface);
+	} else {
+		ev_document_lock_shared (EV_JOB(job_thumb)->document);
 
-	EvRenderContext *rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
-	EvPage *screenshotpage;
-	screenshotpage = ev_page_new(job_thumb->page);
-	screenshotpage->backend_page = (EvBackendPage)job_thumb->surface;
-	screenshotpage->backend_destroy_func = (EvBackendPageDestroyFunc)cairo_surface_destroy;
-	ev_render_context_set_page(rc,screenshotpage);
+		EvPage *page = ev_document_get_page (EV_JOB(job_thumb)->document, job_thumb->page);
+		EvRenderContext *rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
+		EvPage *screenshotpage;
+		screenshotpage = ev_page_new(job_thumb->page);
+		screenshotpage->backend_page = (EvBackendPage)job_thumb->surface;
+		screenshotpage->backend_destroy_func = (EvBackendPageDestroyFunc)cairo_surface_destroy;
+		ev_render_context_set_page(rc,screenshotpage);
 
-	job_thumb->thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (EV_JOB(job_thumb)->document),
-	                                                             rc, TRUE);
-	g_object_unref(screenshotpage);
-	g_object_unref(rc);
+		job_thumb->thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (EV_JOB(job_thumb)->document),
+		                                                             rc, TRUE);
+		g_object_unref(screenshotpage);
+		g_object_unref(rc);
+		g_object_unref(page);
 
-	ev_document_doc_mutex_unlock ();
-	ev_job_succeeded (EV_JOB(job_thumb));
+		ev_document_unlock_shared (EV_JOB(job_thumb)->document);
+
+		if (job_thumb->thumbnail)
+			web_thumbnail_save_cached (job_thumb);
+		ev_job_succeeded (EV_JOB(job_thumb));
+	}
+	job_thumb->surface = NULL;
 
-	gtk_widget_destroy (gtk_widget_get_toplevel (GTK_WIDGET (webview)));
+	web_thumbnail_view_release (webview);
+	g_object_unref (job_thumb);
 }
 
 static void
 web_thumbnail_get_screenshot_cb (WebKitWebView  *webview,
                                  WebKitLoadEvent event,
-                                 EvJobThumbnail *job_thumb)
+                                 gpointer        user_data)
 {
-	if (event != WEBKIT_LOAD_FINISHED || ev_job_is_failed (EV_JOB(job_thumb))) {
+	EvJobThumbnail *job_thumb;
+
+	if (event != WEBKIT_LOAD_FINISHED)
+		return;
+
+	job_thumb = g_object_get_data (G_OBJECT (webview), "ev-job-thumbnail");
+	if (!job_thumb)
+		return;
+
+	/* Failed loads finish too, after load-failed */
+	if (ev_job_is_finished (EV_JOB (job_thumb)) || g_cancellable_is_cancelled (EV_JOB (job_thumb)->cancellable)) {
+		web_thumbnail_view_release (webview);
 		return;
 	}
 
@@ -882,16 +1255,123 @@ webview_load_failed_cb (WebKitWebView  *webview,
                         WebKitLoadEvent event,
                         gchar          *failing_uri,
                         gpointer        error,
-                        EvJobThumbnail *job_thumb)
+                        gpointer        user_data)
 {
+	EvJobThumbnail *job_thumb;
 	GError *e = (GError *) error;
+
+	job_thumb = g_object_get_data (G_OBJECT (webview), "ev-job-thumbnail");
+	if (!job_thumb || g_cancellable_is_cancelled (EV_JOB (job_thumb)->cancellable))
+		return TRUE;
+
 	g_warning ("Error loading data from %s: %s", failing_uri, e->message);
 	ev_job_failed_from_error (EV_JOB(job_thumb), e);
 
-	gtk_widget_destroy (gtk_widget_get_toplevel (GTK_WIDGET (webview)));
 	return TRUE;
 }
 
+static WebKitWebView *
+web_thumbnail_view_new (void)
+{
+	GtkWidget *webview;
+	GtkWidget *offscreenwindow;
+
+	webview = webkit_web_view_new ();
+	offscreenwindow = gtk_offscreen_window_new ();
+
+	gtk_container_add (GTK_CONTAINER(offscreenwindow), GTK_WIDGET (webview));
+	gtk_window_set_default_size (GTK_WINDOW(offscreenwindow), 800, 1080);
+	gtk_widget_show_all (offscreenwindow);
+
+	g_signal_connect (WEBKIT_WEB_VIEW (webview), "load-changed",
+	                  G_CALLBACK (web_thumbnail_get_screenshot_cb),
+	                  NULL);
+	g_signal_connect (WEBKIT_WEB_VIEW(webview), "load-failed",
+	                  G_CALLBACK(webview_load_failed_cb),
+	                  NULL);
+	web_thumbnail_n_views++;
+
+	return WEBKIT_WEB_VIEW (webview);
+}
+
+static gboolean
+web_thumbnail_idle_timeout_cb (gpointer user_data)
+{
+	WebKitWebView *webview;
+
+	while ((webview = g_queue_pop_head (&web_thumbnail_idle_views))) {
+		gtk_widget_destroy (gtk_widget_get_toplevel (GTK_WIDGET (webview)));
+		web_thumbnail_n_views--;
+	}
+	web_thumbnail_idle_id = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+web_thumbnail_view_load (WebKitWebView  *webview,
+                         EvJobThumbnail *job_thumb)
+{
+	EvDocument *document = EV_JOB (job_thumb)->document;
+	EvPage     *page;
+
+	if (web_thumbnail_idle_id > 0) {
+		g_source_remove (web_thumbnail_idle_id);
+		web_thumbnail_idle_id = 0;
+	}
+
+	g_object_set_data_full (G_OBJECT (webview), "ev-job-thumbnail",
+				g_object_ref (job_thumb),
+				(GDestroyNotify)g_object_unref);
+
+	ev_document_lock_shared (document);
+	page = ev_document_get_page (document, job_thumb->page);
+	ev_document_unlock_shared (document);
+
+	webkit_web_view_load_uri (webview, (gchar*) page->backend_page);
+	g_object_unref (page);
+}
+
+/* Hands @webview over to the next pending job, if any */
+static void
+web_thumbnail_view_release (WebKitWebView *webview)
+{
+	EvJobThumbnail *job_thumb;
+
+	g_object_set_data (G_OBJECT (webview), "ev-job-thumbnail", NULL);
+
+	while ((job_thumb = g_queue_pop_head (&web_thumbnail_pending_jobs))) {
+		if (!g_cancellable_is_cancelled (EV_JOB (job_thumb)->cancellable)) {
+			web_thumbnail_view_load (webview, job_thumb);
+			g_object_unref (job_thumb);
+			return;
+		}
+		g_object_unref (job_thumb);
+	}
+
+	g_queue_push_tail (&web_thumbnail_idle_views, webview);
+	if (web_thumbnail_idle_id == 0 &&
+	    g_queue_get_length (&web_thumbnail_idle_views) == web_thumbnail_n_views) {
+		web_thumbnail_idle_id = g_timeout_add_seconds (WEB_THUMBNAIL_IDLE_TIMEOUT,
+							       web_thumbnail_idle_timeout_cb,
+							       NULL);
+	}
+}
+
+static void
+web_thumbnail_render (EvJobThumbnail *job_thumb)
+{
+	WebKitWebView *webview;
+
+	webview = g_queue_pop_head (&web_thumbnail_idle_views);
+	if (!webview && web_thumbnail_n_views < WEB_THUMBNAIL_N_VIEWS)
+		webview = web_thumbnail_view_new ();
+
+	if (webview)
+		web_thumbnail_view_load (webview, job_thumb);
+	else
+		g_queue_push_tail (&web_thumbnail_pending_jobs, g_object_ref (job_thumb));
+}
 #endif  /* ENABLE_EPUB */
 
 static gboolean
@@ -905,52 +1385,38 @@ ev_job_thumbnail_run (EvJob *job)
 
 	if (job->document->iswebdocument) {
 		/* Do not block the main loop */
-		if (!ev_document_doc_mutex_trylock ())
+		if (!ev_document_trylock_shared (job->document))
 			return TRUE;
-	} else {
-		ev_document_doc_mutex_lock ();
+		ev_document_unlock_shared (job->document);
+
+#if ENABLE_EPUB
+		web_thumbnail_load_cached (job_thumb);
+#endif  /* ENABLE_EPUB */
+		return FALSE;
 	}
 
+	ev_document_lock_shared (job->document);
 	page = ev_document_get_page (job->document, job_thumb->page);
-	ev_document_doc_mutex_unlock ();
-
-	if (job->document->iswebdocument == TRUE ) {
-		rc = ev_render_context_new (page, 0, job_thumb->scale);
-	} else {
-		rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
-	}
+	rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
 	g_object_unref (page);
 
-#if ENABLE_EPUB
-	if (job->document->iswebdocument == TRUE) {
-		GtkWidget *webview;
-		GtkWidget *offscreenwindow;
-
-		webview = webkit_web_view_new ();
-		offscreenwindow = gtk_offscreen_window_new ();
-
-		gtk_container_add (GTK_CONTAINER(offscreenwindow), GTK_WIDGET (webview));
-		gtk_window_set_default_size (GTK_WINDOW(offscreenwindow), 800, 1080);
-		gtk_widget_show_all (offscreenwindow);
+	ev_document_render_lock (job->document);
+	job_thumb->thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (job->document),
+	                                                             rc, TRUE);
+	ev_document_render_unlock (job->document);
+	ev_document_unlock_shared (job->document);
+	g_object_unref (rc);
 
-		g_signal_connect (WEBKIT_WEB_VIEW (webview), "load-changed",
-		                  G_CALLBACK (web_thumbnail_get_screenshot_cb),
-		                  g_object_ref (job_thumb));
-		g_signal_connect (WEBKIT_WEB_VIEW(webview), "load-failed",
-		                  G_CALLBACK(webview_load_failed_cb),
-		                  g_object_ref (job_thumb));
-		webkit_web_view_load_uri (WEBKIT_WEB_VIEW (webview), (gchar*) rc->page->backend_page);
-	}
-	else
-#endif  /* ENABLE_EPUB */
-	{
-		ev_document_doc_mutex_lock ();
-		job_thumb->thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (job->document),
-		                                                             rc, TRUE);
-		ev_document_doc_mutex_unlock ();
-		ev_job_succeeded (job);
+	if (!job_thumb->thumbnail) {
+		ev_job_failed (job,
+			       EV_DOCUMENT_ERROR,
+			       EV_DOCUMENT_ERROR_INVALID,
+			       _("Failed to create thumbnail for page %d"),
+			       job_thumb->page);
+		return FALSE;
 	}
-	g_object_unref (rc);
+
+	ev_job_succeeded (job);
 
 	return FALSE;
 }
@@ -1001,11 +1467,11 @@ ev_job_fonts_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 
 	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
+	if (!ev_document_trylock (job->document))
 		return TRUE;
 
 	if (!ev_document_fc_mutex_trylock ()) {
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (job->document);
 		return TRUE;
 	}
 
@@ -1020,7 +1486,7 @@ ev_job_fonts_run (EvJob *job)
 		       ev_document_fonts_get_progress (fonts));
 
 	ev_document_fc_mutex_unlock ();
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	if (job_fonts->scan_completed)
 		ev_job_succeeded (job);
@@ -1095,6 +1561,8 @@ ev_job_load_run (EvJob *job)
 
 	ev_debug_message (DEBUG_JOBS, "%s", job_load->uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+	/* Stopped by EvView once the first page is drawn */
+	ev_profiler_start (EV_PROFILE_JOBS, "First paint %s", job_load->uri);
 
 	ev_document_fc_mutex_lock ();
 
@@ -1115,16 +1583,25 @@ ev_job_load_run (EvJob *job)
 
 		uncompressed_uri = g_object_get_data (G_OBJECT (job->document),
 						      "uri-uncompressed");
-		ev_document_load (job->document,
-				  uncompressed_uri ? uncompressed_uri : job_load->uri,
-				  &error);
+		ev_document_load_full (job->document,
+				       uncompressed_uri ? uncompressed_uri : job_load->uri,
+				       EV_DOCUMENT_LOAD_FLAG_INCREMENTAL,
+				       &error);
 	} else {
-		job->document = ev_document_factory_get_document (job_load->uri,
-								  &error);
+		job->document = ev_document_factory_get_document_full (job_load->uri,
+								       EV_DOCUMENT_LOAD_FLAG_INCREMENTAL,
+								       &error);
 	}
 
 	ev_document_fc_mutex_unlock ();
 
+	/* The document's own URI is the uncompressed copy for compressed
+	 * documents, keep the one the first paint timer was started with */
+	if (job->document) {
+		g_object_set_data_full (G_OBJECT (job->document), "first-paint-uri",
+					g_strdup (job_load->uri), g_free);
+	}
+
 	if (error) {
 		ev_job_failed_from_error (job, error);
 		g_error_free (error);
@@ -1178,6 +1655,128 @@ ev_job_load_set_password (EvJobLoad *job, const gchar *password)
 	job->password = password ? g_strdup (password) : NULL;
 }
 
+/* EvJobPageSizes */
+static void
+ev_job_page_sizes_init (EvJobPageSizes *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+/* Pages measured between two releases of the document lock */
+#define EV_JOB_PAGE_SIZES_CHUNK_SIZE 64
+
+typedef struct {
+	EvJobPageSizes *job;
+	gboolean        sizes_changed;
+	gboolean        scan_completed;
+	gdouble         progress;
+} EvJobPageSizesUpdate;
+
+static void
+ev_job_page_sizes_update_free (EvJobPageSizesUpdate *update)
+{
+	g_object_unref (update->job);
+	g_slice_free (EvJobPageSizesUpdate, update);
+}
+
+/* The view relayouts from the updated handler, emit it in the main loop */
+static gboolean
+ev_job_page_sizes_emit_updated (EvJobPageSizesUpdate *update)
+{
+	EvJobPageSizes *job = update->job;
+
+	if (g_cancellable_is_cancelled (EV_JOB (job)->cancellable))
+		return FALSE;
+
+	job->sizes_changed = update->sizes_changed;
+	job->scan_completed = update->scan_completed;
+	g_signal_emit (job, job_page_sizes_signals[PAGE_SIZES_UPDATED], 0,
+		       update->progress);
+
+	return FALSE;
+}
+
+static gboolean
+ev_job_page_sizes_run (EvJob *job)
+{
+	EvJobPageSizesUpdate *update;
+	gint                  n_pages;
+	gboolean              scan_completed;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	update = g_slice_new (EvJobPageSizesUpdate);
+	update->job = g_object_ref (EV_JOB_PAGE_SIZES (job));
+
+	ev_document_lock (job->document);
+	update->sizes_changed = ev_document_cache_pages (job->document,
+							 EV_JOB_PAGE_SIZES_CHUNK_SIZE);
+	ev_document_unlock (job->document);
+
+	n_pages = ev_document_get_n_pages (job->document);
+	scan_completed = ev_document_is_page_cache_complete (job->document);
+	update->scan_completed = scan_completed;
+	/* The last pages may have been measured by a caller of
+	 * ev_document_complete_page_cache() instead, relayout anyway */
+	if (scan_completed && !ev_document_is_page_size_uniform (job->document))
+		update->sizes_changed = TRUE;
+	update->progress = n_pages > 0 ?
+		(gdouble) ev_document_get_n_cached_pages (job->document) / n_pages : 1.0;
+
+	g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+			 (GSourceFunc)ev_job_page_sizes_emit_updated,
+			 update,
+			 (GDestroyNotify)ev_job_page_sizes_update_free);
+
+	if (!scan_completed)
+		return TRUE;
+
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_page_sizes_class_init (EvJobPageSizesClass *class)
+{
+	EvJobClass *job_class = EV_JOB_CLASS (class);
+
+	job_class->run = ev_job_page_sizes_run;
+
+	job_page_sizes_signals[PAGE_SIZES_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_PAGE_SIZES,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobPageSizesClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__DOUBLE,
+			      G_TYPE_NONE,
+			      1, G_TYPE_DOUBLE);
+}
+
+/**
+ * ev_job_page_sizes_new:
+ * @document: a #EvDocument loaded with %EV_DOCUMENT_LOAD_FLAG_INCREMENTAL
+ *
+ * Creates a job measuring the pages of @document that weren't measured
+ * while loading it, in a thread and a few pages at a time.
+ *
+ * Returns: (transfer full): a new #EvJobPageSizes
+ */
+EvJob *
+ev_job_page_sizes_new (EvDocument *document)
+{
+	EvJobPageSizes *job;
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	job = g_object_new (EV_TYPE_JOB_PAGE_SIZES, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+
+	return EV_JOB (job);
+}
+
 /* EvJobSave */
 static void
 ev_job_save_init (EvJobSave *job)
@@ -1225,7 +1824,7 @@ ev_job_save_run (EvJob *job)
 		return FALSE;
 	}
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	/* Save document to temp filename */
 	local_uri = g_filename_to_uri (tmp_filename, NULL, &error);
@@ -1235,7 +1834,7 @@ ev_job_save_run (EvJob *job)
 
 	close (fd);
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	if (error) {
 		g_free (local_uri);
@@ -1327,10 +1926,17 @@ ev_job_save_new (EvDocument  *document,
 }
 
 /* EvJobFind */
+typedef struct {
+	EvJobFind *job;
+	gint       page;
+	GList     *matches;
+	guint      n_hits;
+} EvJobFindUpdate;
+
 static void
 ev_job_find_init (EvJobFind *job)
 {
-	EV_JOB (job)->run_mode = EV_JOB_RUN_MAIN_LOOP;
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
 }
 
 static void
@@ -1359,65 +1965,119 @@ ev_job_find_dispose (GObject *object)
 
 	if (job->results) {
 		g_free(job->results);
+		job->results = NULL;
+	}
+
+	if (job->order) {
+		g_free (job->order);
+		job->order = NULL;
+	}
+
+	if (job->searched) {
+		g_free (job->searched);
+		job->searched = NULL;
+	}
+
+	if (job->index) {
+		ev_text_index_unref (job->index);
+		job->index = NULL;
 	}
 
 	(* G_OBJECT_CLASS (ev_job_find_parent_class)->dispose) (object);
 }
 
+static void
+ev_job_find_update_free (EvJobFindUpdate *update)
+{
+	g_list_free_full (update->matches, (GDestroyNotify)ev_rectangle_free);
+	g_object_unref (update->job);
+	g_slice_free (EvJobFindUpdate, update);
+}
+
+/* Results are stored from the main loop only, so that the views can
+ * read them at any time while the job is searching */
+static gboolean
+ev_job_find_emit_updated (EvJobFindUpdate *update)
+{
+	EvJobFind *job = update->job;
+
+	if (g_cancellable_is_cancelled (EV_JOB (job)->cancellable))
+		return FALSE;
+
+	if (EV_JOB (job)->document->iswebdocument) {
+		job->results[update->page] = update->n_hits;
+		job->has_results |= (update->n_hits > 0);
+	} else {
+		job->pages[update->page] = update->matches;
+		job->has_results |= (update->matches != NULL);
+		update->matches = NULL;
+	}
+
+	job->searched[update->page] = TRUE;
+	job->current_page = update->page;
+	job->pages_done++;
+
+	g_signal_emit (job, job_find_signals[FIND_UPDATED], 0, update->page);
+
+	return FALSE;
+}
+
+/* Pages are searched one after another, nearest to the start page
+ * first, taking the document lock page by page so that rendering isn't
+ * held up. None of the backends implementing find allows concurrent
+ * page operations on one document, so the search stays serial. */
 static gboolean
 ev_job_find_run (EvJob *job)
 {
 	EvJobFind      *job_find = EV_JOB_FIND (job);
 	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
-	EvPage         *ev_page;
-	GList          *matches;
+	gint            i;
+
 	ev_debug_message (DEBUG_JOBS, NULL);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	/* Do not block the main loop */
-	if (!ev_document_doc_mutex_trylock ())
-		return TRUE;
+	for (i = 0; i < job_find->n_candidates; i++) {
+		EvJobFindUpdate *update;
+		EvPage          *ev_page;
 
-#ifdef EV_ENABLE_DEBUG
-	/* We use the #ifdef in this case because of the if */
-	if (job_find->current_page == job_find->start_page)
-		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-#endif
+		if (g_cancellable_is_cancelled (job->cancellable))
+			break;
 
-	ev_page = ev_document_get_page (job->document, job_find->current_page);
+		update = g_slice_new0 (EvJobFindUpdate);
+		update->job = g_object_ref (job_find);
+		update->page = job_find->order[i];
 
-	if (job->document->iswebdocument) {
-		job_find->results[job_find->current_page] = ev_document_find_check_for_hits(find, ev_page, job_find->text,
-		                                                        job_find->case_sensitive);
-	}else {
-		matches = ev_document_find_find_text (find, ev_page, job_find->text,
-					      job_find->case_sensitive);
-	}
+		ev_document_lock_shared (job->document);
 
-	g_object_unref (ev_page);
+		ev_page = ev_document_get_page (job->document, update->page);
+		if (job->document->iswebdocument) {
+			update->n_hits = ev_document_find_check_for_hits (find, ev_page, job_find->text,
+									  job_find->case_sensitive);
+		} else {
+			update->matches = ev_document_find_find_text (find, ev_page, job_find->text,
+								      job_find->case_sensitive);
+		}
+		g_object_unref (ev_page);
 
-	ev_document_doc_mutex_unlock ();
+		ev_document_unlock_shared (job->document);
 
-	if (!job_find->has_results && !job->document->iswebdocument) {
-		job_find->has_results = (matches != NULL);
-	}
-	else if (!job_find->has_results && job->document->iswebdocument){
-		job_find->has_results = (job_find->results[job_find->current_page] > 0);
-	}
+		/* Don't hand over the results of a page that finished
+		 * after the job was cancelled */
+		if (g_cancellable_is_cancelled (job->cancellable)) {
+			ev_job_find_update_free (update);
+			break;
+		}
 
-	if (job->document->iswebdocument == FALSE) {
-		job_find->pages[job_find->current_page] = matches;
+		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+				 (GSourceFunc)ev_job_find_emit_updated,
+				 update,
+				 (GDestroyNotify)ev_job_find_update_free);
 	}
 
-	g_signal_emit (job_find, job_find_signals[FIND_UPDATED], 0, job_find->current_page);
-
-	job_find->current_page = (job_find->current_page + 1) % job_find->n_pages;
-	if (job_find->current_page == job_find->start_page) {
-		ev_job_succeeded (job);
-
-		return FALSE;
-	}
+	/* Emitted after all the updates, see ev_job_emit_finished() */
+	ev_job_succeeded (job);
 
-	return TRUE;
+	return FALSE;
 }
 
 static void
@@ -1448,6 +2108,7 @@ ev_job_find_new (EvDocument  *document,
 		 gboolean     case_sensitive)
 {
 	EvJobFind *job;
+	gint       i, distance;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 
@@ -1458,6 +2119,17 @@ ev_job_find_new (EvDocument  *document,
 	job->current_page = start_page;
 	job->n_pages = n_pages;
 
+	/* Search the pages closest to the start page first */
+	job->order = g_new (gint, n_pages);
+	for (i = 0, distance = 0; i < n_pages; distance++) {
+		if (start_page + distance < n_pages)
+			job->order[i++] = start_page + distance;
+		if (distance > 0 && start_page - distance >= 0)
+			job->order[i++] = start_page - distance;
+	}
+	job->n_candidates = n_pages;
+	job->searched = g_new0 (gboolean, n_pages);
+
 	if (document->iswebdocument) {
 		job->results = g_malloc0 (sizeof(guint) *n_pages);
 	}
@@ -1486,20 +2158,10 @@ ev_job_find_get_n_results (EvJobFind *job,
 gdouble
 ev_job_find_get_progress (EvJobFind *job)
 {
-	gint pages_done;
-
 	if (ev_job_is_finished (EV_JOB (job)))
 		return 1.0;
 
-	if (job->current_page > job->start_page) {
-		pages_done = job->current_page - job->start_page + 1;
-	} else if (job->current_page == job->start_page) {
-		pages_done = job->n_pages;
-	} else {
-		pages_done = job->n_pages - job->start_page + job->current_page;
-	}
-
-	return pages_done / (gdouble) job->n_pages;
+	return job->pages_done / (gdouble) job->n_pages;
 }
 
 gboolean
@@ -1520,6 +2182,278 @@ ev_job_find_get_results (EvJobFind *job)
 	return job->pages;
 }
 
+/* Only searches the pages in @candidates, the others are known to
+ * contain no results */
+static void
+ev_job_find_restrict (EvJobFind      *job,
+		      const gboolean *candidates)
+{
+	gint i, n;
+
+	/* Keep the nearest first order among the candidates */
+	for (i = 0, n = 0; i < job->n_candidates; i++) {
+		if (candidates[job->order[i]])
+			job->order[n++] = job->order[i];
+	}
+
+	for (i = 0; i < job->n_pages; i++) {
+		if (!candidates[i])
+			job->searched[i] = TRUE;
+	}
+
+	job->n_candidates = n;
+	job->pages_done = job->n_pages - n;
+}
+
+/**
+ * ev_job_find_set_text_index:
+ * @job: an #EvJobFind
+ * @index: the #EvTextIndex of the document
+ *
+ * Restricts the search to the pages that @index says might contain the
+ * text, the other pages are reported as searched without results. It
+ * must be called before the job is scheduled.
+ */
+void
+ev_job_find_set_text_index (EvJobFind   *job,
+			    EvTextIndex *index)
+{
+	gboolean *candidates;
+
+	g_return_if_fail (EV_IS_JOB_FIND (job));
+	g_return_if_fail (index != NULL);
+
+	if (ev_text_index_get_n_pages (index) != job->n_pages)
+		return;
+
+	candidates = ev_text_index_find_pages (index, job->text);
+	if (!candidates)
+		return;
+
+	if (job->index)
+		ev_text_index_unref (job->index);
+	job->index = ev_text_index_ref (index);
+
+	ev_job_find_restrict (job, candidates);
+	g_free (candidates);
+}
+
+/* Whether every match of @text contains a match of @previous_text */
+static gboolean
+ev_job_find_text_contains (const gchar *text,
+			   gboolean     case_sensitive,
+			   const gchar *previous_text,
+			   gboolean     previous_case_sensitive)
+{
+	gchar   *folded, *previous_folded;
+	gboolean retval;
+
+	if (previous_case_sensitive) {
+		return case_sensitive && strstr (text, previous_text) != NULL;
+	}
+
+	folded = g_utf8_casefold (text, -1);
+	previous_folded = g_utf8_casefold (previous_text, -1);
+	retval = strstr (folded, previous_folded) != NULL;
+	g_free (folded);
+	g_free (previous_folded);
+
+	return retval;
+}
+
+/**
+ * ev_job_find_set_previous:
+ * @job: an #EvJobFind
+ * @previous: the #EvJobFind of the previous search in the same document
+ *
+ * When the text of @job contains the text of @previous, as when the
+ * search string is being typed, restricts the search to the pages
+ * where @previous found the text or didn't get to search yet. It must
+ * be called before the job is scheduled, @previous may still be
+ * running or have been cancelled.
+ *
+ * Nothing is reused when the text of @job is shorter, as when
+ * characters are deleted: the shorter text can be found on pages where
+ * the longer one wasn't, and where both are found the match areas
+ * differ, so every page has to be searched again.
+ */
+void
+ev_job_find_set_previous (EvJobFind *job,
+			  EvJobFind *previous)
+{
+	gboolean *candidates;
+	gint      page;
+
+	g_return_if_fail (EV_IS_JOB_FIND (job));
+	g_return_if_fail (EV_IS_JOB_FIND (previous));
+
+	if (EV_JOB (previous)->document != EV_JOB (job)->document ||
+	    previous->n_pages != job->n_pages ||
+	    !ev_job_find_text_contains (job->text, job->case_sensitive,
+					previous->text, previous->case_sensitive))
+		return;
+
+	candidates = g_new (gboolean, job->n_pages);
+	for (page = 0; page < job->n_pages; page++) {
+		candidates[page] = !previous->searched[page] ||
+			ev_job_find_get_n_results (previous, page) > 0;
+	}
+
+	ev_job_find_restrict (job, candidates);
+	g_free (candidates);
+}
+
+/* EvJobTextIndex */
+static void
+ev_job_text_index_init (EvJobTextIndex *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+}
+
+static void
+ev_job_text_index_dispose (GObject *object)
+{
+	EvJobTextIndex *job = EV_JOB_TEXT_INDEX (object);
+
+	ev_debug_message (DEBUG_JOBS, NULL);
+
+	if (job->uri) {
+		g_free (job->uri);
+		job->uri = NULL;
+	}
+
+	if (job->index) {
+		ev_text_index_unref (job->index);
+		job->index = NULL;
+	}
+
+	(* G_OBJECT_CLASS (ev_job_text_index_parent_class)->dispose) (object);
+}
+
+static gboolean
+ev_job_text_index_run (EvJob *job)
+{
+	EvJobTextIndex *job_index = EV_JOB_TEXT_INDEX (job);
+	EvTextIndex    *index;
+	GFile          *file;
+	GFileInfo      *info;
+	guint64         size, mtime;
+	gint            n_pages, i;
+	GError         *error = NULL;
+
+	ev_debug_message (DEBUG_JOBS, "%s", job_index->uri);
+	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	file = g_file_new_for_uri (job_index->uri);
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				  G_FILE_QUERY_INFO_NONE,
+				  job->cancellable, &error);
+	g_object_unref (file);
+	if (!info) {
+		ev_job_failed_from_error (job, error);
+		g_error_free (error);
+
+		return FALSE;
+	}
+
+	size = g_file_info_get_size (info);
+	mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	g_object_unref (info);
+
+	n_pages = ev_document_get_n_pages (job->document);
+
+	index = ev_text_index_load (job_index->uri, size, mtime, n_pages);
+	if (index) {
+		job_index->index = index;
+		ev_job_succeeded (job);
+
+		return FALSE;
+	}
+
+	index = ev_text_index_new (n_pages);
+	for (i = 0; i < n_pages; i++) {
+		EvPage *ev_page;
+		gchar  *text;
+
+		if (g_cancellable_is_cancelled (job->cancellable)) {
+			ev_text_index_unref (index);
+
+			return FALSE;
+		}
+
+		ev_document_lock_shared (job->document);
+		ev_page = ev_document_get_page (job->document, i);
+		text = ev_document_text_get_text (EV_DOCUMENT_TEXT (job->document), ev_page);
+		g_object_unref (ev_page);
+		ev_document_unlock_shared (job->document);
+
+		ev_text_index_add_page (index, i, text);
+		g_free (text);
+	}
+
+	if (!ev_text_index_save (index, job_index->uri, size, mtime, &error)) {
+		g_warning ("Failed to save the text index: %s", error->message);
+		g_error_free (error);
+	}
+
+	job_index->index = index;
+	ev_job_succeeded (job);
+
+	return FALSE;
+}
+
+static void
+ev_job_text_index_class_init (EvJobTextIndexClass *class)
+{
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+	GObjectClass *gobject_class = G_OBJECT_CLASS (class);
+
+	job_class->run = ev_job_text_index_run;
+	gobject_class->dispose = ev_job_text_index_dispose;
+}
+
+/**
+ * ev_job_text_index_new:
+ * @document: an #EvDocument implementing #EvDocumentText
+ * @uri: the URI of the document
+ *
+ * Creates a job that loads the #EvTextIndex saved for @uri, or builds
+ * it from the text of every page and saves it.
+ *
+ * Returns: the new #EvJob
+ */
+EvJob *
+ev_job_text_index_new (EvDocument  *document,
+		       const gchar *uri)
+{
+	EvJobTextIndex *job;
+
+	ev_debug_message (DEBUG_JOBS, "%s", uri);
+
+	job = g_object_new (EV_TYPE_JOB_TEXT_INDEX, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+	job->uri = g_strdup (uri);
+
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_text_index_get_index:
+ * @job: a finished #EvJobTextIndex
+ *
+ * Returns: (transfer none): the #EvTextIndex, or %NULL if the job failed
+ */
+EvTextIndex *
+ev_job_text_index_get_index (EvJobTextIndex *job)
+{
+	g_return_val_if_fail (EV_IS_JOB_TEXT_INDEX (job), NULL);
+
+	return job->index;
+}
+
 /* EvJobLayers */
 static void
 ev_job_layers_init (EvJobLayers *job)
@@ -1552,9 +2486,9 @@ ev_job_layers_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 	job_layers->model = ev_document_layers_get_layers (EV_DOCUMENT_LAYERS (job->document));
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
 	ev_job_succeeded (job);
 
@@ -1590,6 +2524,7 @@ ev_job_export_init (EvJobExport *job)
 {
 	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
 	job->page = -1;
+	job->steps = g_array_new (FALSE, FALSE, sizeof (gint));
 }
 
 static void
@@ -1606,37 +2541,81 @@ ev_job_export_dispose (GObject *object)
 		job->rc = NULL;
 	}
 
+	if (job->steps) {
+		g_array_free (job->steps, TRUE);
+		job->steps = NULL;
+	}
+
 	(* G_OBJECT_CLASS (ev_job_export_parent_class)->dispose) (object);
 }
 
+/* Steps of an export job other than exporting a page */
+#define EXPORT_STEP_BEGIN_PAGE -1
+#define EXPORT_STEP_END_PAGE   -2
+#define EXPORT_STEP_END        -3
+
 static gboolean
 ev_job_export_run (EvJob *job)
 {
-	EvJobExport *job_export = EV_JOB_EXPORT (job);
-	EvPage      *ev_page;
+	EvJobExport    *job_export = EV_JOB_EXPORT (job);
+	EvFileExporter *exporter = EV_FILE_EXPORTER (job->document);
+	gint            last_page = -1;
+	guint           i;
 
-	g_assert (job_export->page != -1);
+	g_assert (job_export->steps->len > 0);
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
-
-	ev_page = ev_document_get_page (job->document, job_export->page);
 	if (job_export->rc) {
 		job->failed = FALSE;
 		job->finished = FALSE;
 		g_clear_error (&job->error);
-
-		ev_render_context_set_page (job_export->rc, ev_page);
-	} else {
-		job_export->rc = ev_render_context_new (ev_page, 0, 1.0);
 	}
-	g_object_unref (ev_page);
 
-	ev_file_exporter_do_page (EV_FILE_EXPORTER (job->document), job_export->rc);
+	for (i = 0; i < job_export->steps->len; i++) {
+		gint    step = g_array_index (job_export->steps, gint, i);
+		EvPage *ev_page;
+
+		/* The lock is taken for every step, so that other jobs of
+		 * the document and the cancellation aren't held up by a
+		 * whole batch. Cancelling leaves ending the exporter to the
+		 * caller, see ev_job_export_add_end() */
+		ev_document_lock (job->document);
+		if (g_cancellable_is_cancelled (job->cancellable)) {
+			ev_document_unlock (job->document);
+
+			return FALSE;
+		}
+
+		switch (step) {
+		case EXPORT_STEP_BEGIN_PAGE:
+			ev_file_exporter_begin_page (exporter);
+			break;
+		case EXPORT_STEP_END_PAGE:
+			ev_file_exporter_end_page (exporter);
+			break;
+		case EXPORT_STEP_END:
+			ev_file_exporter_end (exporter);
+			job_export->ended = TRUE;
+			break;
+		default:
+			/* Uncollated copies of a page follow each other */
+			if (step != last_page) {
+				ev_page = ev_document_get_page (job->document, step);
+				if (job_export->rc)
+					ev_render_context_set_page (job_export->rc, ev_page);
+				else
+					job_export->rc = ev_render_context_new (ev_page, 0, 1.0);
+				g_object_unref (ev_page);
+				last_page = step;
+			}
+
+			ev_file_exporter_do_page (exporter, job_export->rc);
+		}
 
-	ev_document_doc_mutex_unlock ();
+		ev_document_unlock (job->document);
+	}
 
 	ev_job_succeeded (job);
 
@@ -1671,6 +2650,72 @@ ev_job_export_set_page (EvJobExport *job,
 			gint         page)
 {
 	job->page = page;
+	g_array_set_size (job->steps, 0);
+	g_array_append_val (job->steps, page);
+}
+
+/**
+ * ev_job_export_add_page:
+ * @job: an #EvJobExport
+ * @page: the page to export
+ *
+ * Adds @page to the steps run by @job, after the ones already added,
+ * so that a single job can export several pages in a row.
+ */
+void
+ev_job_export_add_page (EvJobExport *job,
+			gint         page)
+{
+	g_return_if_fail (page >= 0);
+
+	job->page = page;
+	g_array_append_val (job->steps, page);
+}
+
+/**
+ * ev_job_export_add_begin_page:
+ * @job: an #EvJobExport
+ *
+ * Adds a call to ev_file_exporter_begin_page() to the steps run by @job.
+ */
+void
+ev_job_export_add_begin_page (EvJobExport *job)
+{
+	gint step = EXPORT_STEP_BEGIN_PAGE;
+
+	g_array_append_val (job->steps, step);
+}
+
+/**
+ * ev_job_export_add_end_page:
+ * @job: an #EvJobExport
+ *
+ * Adds a call to ev_file_exporter_end_page() to the steps run by @job.
+ */
+void
+ev_job_export_add_end_page (EvJobExport *job)
+{
+	gint step = EXPORT_STEP_END_PAGE;
+
+	g_array_append_val (job->steps, step);
+}
+
+/**
+ * ev_job_export_add_end:
+ * @job: an #EvJobExport
+ *
+ * Adds a call to ev_file_exporter_end() to the steps run by @job.
+ *
+ * When @job is cancelled, the steps left are skipped and the caller
+ * has to end the exporter unless @job ended it already. It must check
+ * the ended field while holding the document lock, see ev_document_lock().
+ */
+void
+ev_job_export_add_end (EvJobExport *job)
+{
+	gint step = EXPORT_STEP_END;
+
+	g_array_append_val (job->steps, step);
 }
 
 /* EvJobPrint */
@@ -1715,14 +2760,14 @@ ev_job_print_run (EvJob *job)
 	job->finished = FALSE;
 	g_clear_error (&job->error);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (job->document);
 
 	ev_page = ev_document_get_page (job->document, job_print->page);
 	ev_document_print_print_page (EV_DOCUMENT_PRINT (job->document),
 				      ev_page, job_print->cr);
 	g_object_unref (ev_page);
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (job->document);
 
         if (g_cancellable_is_cancelled (job->cancellable))
                 return FALSE;
@@ -63,12 +63,18 @@ typedef struct _EvJobFontsClass EvJobFontsClass;
 typedef struct _EvJobLoad EvJobLoad;
 typedef struct _EvJobLoadClass EvJobLoadClass;
 
+typedef struct _EvJobPageSizes EvJobPageSizes;
+typedef struct _EvJobPageSizesClass EvJobPageSizesClass;
+
 typedef struct _EvJobSave EvJobSave;
 typedef struct _EvJobSaveClass EvJobSaveClass;
 
 typedef struct _EvJobFind EvJobFind;
 typedef struct _EvJobFindClass EvJobFindClass;
 
+typedef struct _EvJobTextIndex EvJobTextIndex;
+typedef struct _EvJobTextIndexClass EvJobTextIndexClass;
+
 typedef struct _EvJobLayers EvJobLayers;
 typedef struct _EvJobLayersClass EvJobLayersClass;
 
@@ -129,6 +135,11 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_JOB_LOAD_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_LOAD, EvJobLoadClass))
 #define EV_IS_JOB_LOAD(object)		     (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_LOAD))
 
+#define EV_TYPE_JOB_PAGE_SIZES		     (ev_job_page_sizes_get_type())
+#define EV_JOB_PAGE_SIZES(object)	     (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_PAGE_SIZES, EvJobPageSizes))
+#define EV_JOB_PAGE_SIZES_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_PAGE_SIZES, EvJobPageSizesClass))
+#define EV_IS_JOB_PAGE_SIZES(object)	     (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_PAGE_SIZES))
+
 #define EV_TYPE_JOB_SAVE		     (ev_job_save_get_type())
 #define EV_JOB_SAVE(object)	     	     (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_SAVE, EvJobSave))
 #define EV_JOB_SAVE_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_SAVE, EvJobSaveClass))
@@ -139,6 +150,11 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_JOB_FIND_CLASS(klass)             (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_FIND, EvJobFindClass))
 #define EV_IS_JOB_FIND(object)               (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_FIND))
 
+#define EV_TYPE_JOB_TEXT_INDEX               (ev_job_text_index_get_type())
+#define EV_JOB_TEXT_INDEX(object)            (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_TEXT_INDEX, EvJobTextIndex))
+#define EV_JOB_TEXT_INDEX_CLASS(klass)       (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_TEXT_INDEX, EvJobTextIndexClass))
+#define EV_IS_JOB_TEXT_INDEX(object)         (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_TEXT_INDEX))
+
 #define EV_TYPE_JOB_LAYERS                   (ev_job_layers_get_type())
 #define EV_JOB_LAYERS(object)                (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_LAYERS, EvJobLayers))
 #define EV_JOB_LAYERS_CLASS(klass)           (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_LAYERS, EvJobLayersClass))
@@ -223,6 +239,10 @@ struct _EvJobAnnots
 struct _EvJobAnnotsClass
 {
 	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated)  (EvJobAnnots *job,
+			   GList       *annots);
 };
 
 struct _EvJobRender
@@ -334,6 +354,23 @@ struct _EvJobLoadClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobPageSizes
+{
+	EvJob parent;
+
+	gboolean sizes_changed;
+	gboolean scan_completed;
+};
+
+struct _EvJobPageSizesClass
+{
+	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated)  (EvJobPageSizes *job,
+			   gdouble         progress);
+};
+
 struct _EvJobSave
 {
 	EvJob parent;
@@ -359,6 +396,16 @@ struct _EvJobFind
 	gchar *text;
 	gboolean case_sensitive;
 	gboolean has_results;
+	gint pages_done;
+	/* Whether the results of each page are known, written from
+	 * the main loop like the results */
+	gboolean *searched;
+
+	/* Pages sorted by distance from start_page, searched in this
+	 * order. Only the first n_candidates can contain the text. */
+	gint *order;
+	gint n_candidates;
+	EvTextIndex *index;
 };
 
 struct _EvJobFindClass
@@ -370,6 +417,19 @@ struct _EvJobFindClass
 			   gint       page);
 };
 
+struct _EvJobTextIndex
+{
+	EvJob parent;
+
+	gchar *uri;
+	EvTextIndex *index;
+};
+
+struct _EvJobTextIndexClass
+{
+	EvJobClass parent_class;
+};
+
 struct _EvJobLayers
 {
 	EvJob parent;
@@ -388,6 +448,8 @@ struct _EvJobExport
 
 	gint page;
 	EvRenderContext *rc;
+	GArray *steps;
+	gboolean ended;
 };
 
 struct _EvJobExportClass
@@ -451,6 +513,8 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+void     ev_job_render_set_clip           (EvJobRender     *job,
+					   const cairo_rectangle_int_t *clip);
 /* EvJobPageData */
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_page_data_new      (EvDocument      *document,
@@ -476,6 +540,10 @@ void            ev_job_load_set_uri       (EvJobLoad       *load,
 void            ev_job_load_set_password  (EvJobLoad       *job,
 					   const gchar     *password);
 
+/* EvJobPageSizes */
+GType           ev_job_page_sizes_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_page_sizes_new      (EvDocument      *document);
+
 /* EvJobSave */
 GType           ev_job_save_get_type      (void) G_GNUC_CONST;
 EvJob          *ev_job_save_new           (EvDocument      *document,
@@ -493,6 +561,16 @@ gint            ev_job_find_get_n_results (EvJobFind       *job,
 gdouble         ev_job_find_get_progress  (EvJobFind       *job);
 gboolean        ev_job_find_has_results   (EvJobFind       *job);
 GList         **ev_job_find_get_results   (EvJobFind       *job);
+void            ev_job_find_set_text_index (EvJobFind      *job,
+					    EvTextIndex    *index);
+void            ev_job_find_set_previous   (EvJobFind      *job,
+					    EvJobFind      *previous);
+
+/* EvJobTextIndex */
+GType           ev_job_text_index_get_type (void) G_GNUC_CONST;
+EvJob          *ev_job_text_index_new      (EvDocument     *document,
+					    const gchar    *uri);
+EvTextIndex    *ev_job_text_index_get_index (EvJobTextIndex *job);
 
 /* EvJobLayers */
 GType           ev_job_layers_get_type    (void) G_GNUC_CONST;
@@ -503,6 +581,11 @@ GType           ev_job_export_get_type    (void) G_GNUC_CONST;
 EvJob          *ev_job_export_new         (EvDocument     *document);
 void            ev_job_export_set_page    (EvJobExport    *job,
 					   gint            page);
+void            ev_job_export_add_page    (EvJobExport    *job,
+					   gint            page);
+void            ev_job_export_add_begin_page (EvJobExport *job);
+void            ev_job_export_add_end_page   (EvJobExport *job);
+void            ev_job_export_add_end        (EvJobExport *job);
 /* EvJobPrint */
 GType           ev_job_print_get_type    (void) G_GNUC_CONST;
 EvJob          *ev_job_print_new         (EvDocument     *document);
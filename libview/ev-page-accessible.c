@@ -409,7 +409,7 @@ treat_as_soft_return (EvView       *view,
 	EvRectangle *next_line_start;
 	EvRectangle *next_line_end;
 	EvRectangle *next_word_end;
-	gint prev_offset, next_offset;
+	gint prev_offset, next_offset, line_end;
 
 	if (!log_attrs[offset].is_white)
 		return FALSE;
@@ -454,7 +454,7 @@ treat_as_soft_return (EvView       *view,
 	 * and hanging indents (e.g. in the works cited within an academic paper). So we'll
 	 * be somewhat tolerant here.
 	 */
-	for ( ; prev_offset > 0 && !log_attrs[prev_offset].is_mandatory_break; prev_offset--);
+	ev_page_cache_get_text_line_range (view->page_cache, page, prev_offset, &prev_offset, &line_end);
 	this_line_start = areas + prev_offset;
 	if (ABS (this_line_start->x1 - next_line_start->x1) > 20)
 		return FALSE;
@@ -479,22 +479,24 @@ ev_page_accessible_get_substring (AtkText *text,
 {
 	EvPageAccessible *self = EV_PAGE_ACCESSIBLE (text);
 	EvView *view = ev_page_accessible_get_view (self);
-	gchar *substring, *normalized;
-	const gchar* page_text;
+	const gchar *start, *end;
+	gint n_chars;
 
 	if (!view->page_cache)
 		return NULL;
 
-	page_text = ev_page_cache_get_text (view->page_cache, self->priv->page);
-	if (end_offset < 0 || end_offset > g_utf8_strlen (page_text, -1))
-		end_offset = strlen (page_text);
+	n_chars = ev_page_cache_get_text_length (view->page_cache, self->priv->page);
+	if (n_chars < 0)
+		return NULL;
+
+	if (end_offset < 0 || end_offset > n_chars)
+		end_offset = n_chars;
 	start_offset = CLAMP (start_offset, 0, end_offset);
 
-	substring = g_utf8_substring (page_text, start_offset, end_offset);
-	normalized = g_utf8_normalize (substring, -1, G_NORMALIZE_NFKC);
-	g_free (substring);
+	start = ev_page_cache_get_text_pointer (view->page_cache, self->priv->page, start_offset);
+	end = ev_page_cache_get_text_pointer (view->page_cache, self->priv->page, end_offset);
 
-	return normalized;
+	return g_utf8_normalize (start, end - start, G_NORMALIZE_NFKC);
 }
 
 static gchar *
@@ -513,6 +515,8 @@ ev_page_accessible_get_character_at_offset (AtkText *text,
 	gunichar unichar;
 
 	string = ev_page_accessible_get_substring (text, offset, offset + 1);
+	if (!string)
+		return 0;
 	unichar = g_utf8_get_char (string);
 	g_free(string);
 
@@ -549,8 +553,7 @@ ev_page_accessible_get_range_for_boundary (AtkText          *text,
 		end = offset + 1;
 		break;
 	case ATK_TEXT_BOUNDARY_WORD_START:
-		for (start = offset; start > 0 && !log_attrs[start].is_word_start; start--);
-		for (end = offset + 1; end < n_attrs && !log_attrs[end].is_word_start; end++);
+		ev_page_cache_get_text_word_range (view->page_cache, self->priv->page, offset, &start, &end);
 		break;
 	case ATK_TEXT_BOUNDARY_SENTENCE_START:
 		for (start = offset; start > 0; start--) {
@@ -567,8 +570,7 @@ ev_page_accessible_get_range_for_boundary (AtkText          *text,
 		}
 		break;
 	case ATK_TEXT_BOUNDARY_LINE_START:
-		for (start = offset; start > 0 && !log_attrs[start].is_mandatory_break; start--);
-		for (end = offset + 1; end < n_attrs && !log_attrs[end].is_mandatory_break; end++);
+		ev_page_cache_get_text_line_range (view->page_cache, self->priv->page, offset, &start, &end);
 		break;
 	default:
 		/* The "END" boundary types are deprecated */
@@ -635,9 +637,9 @@ ev_page_accessible_get_character_count (AtkText *text)
 	EvView *view = ev_page_accessible_get_view (self);
 	gint retval;
 
-	retval = g_utf8_strlen (ev_page_cache_get_text (view->page_cache, self->priv->page), -1);
+	retval = ev_page_cache_get_text_length (view->page_cache, self->priv->page);
 
-	return retval;
+	return MAX (retval, 0);
 }
 
 static gboolean
@@ -733,13 +735,13 @@ ev_page_accessible_get_selection (AtkText *text,
 
 			page = ev_document_get_page (view->document, selection->page);
 
-			ev_document_doc_mutex_lock ();
+			ev_document_lock (view->document);
 			selected_text = ev_selection_get_selected_text (EV_SELECTION (view->document),
 									page,
 									selection->style,
 									&(selection->rect));
 
-			ev_document_doc_mutex_unlock ();
+			ev_document_unlock (view->document);
 
 			g_object_unref (page);
 
@@ -773,7 +775,8 @@ add_attribute (AtkAttributeSet  *attr_set,
 
 static AtkAttributeSet *
 get_run_attributes (PangoAttrList   *attrs,
-		    const gchar     *text,
+		    EvPageCache     *page_cache,
+		    gint             page,
 		    gint             offset,
 		    gint            *start_offset,
 		    gint            *end_offset)
@@ -785,25 +788,28 @@ get_run_attributes (PangoAttrList   *attrs,
 	PangoAttrIterator *iter;
 	gint               i, start, end;
 	gboolean           has_attrs = FALSE;
-	glong              text_length;
+	gint               text_length;
+	const gchar       *text;
 	gchar             *attr_value;
 
-	text_length = g_utf8_strlen (text, -1);
+	text_length = ev_page_cache_get_text_length (page_cache, page);
 	if (offset < 0 || offset >= text_length)
 		return NULL;
 
 	/* Check if there are attributes for the offset,
 	 * and set the attributes range if positive */
 	iter = pango_attr_list_get_iterator (attrs);
-	i = g_utf8_offset_to_pointer (text, offset) - text;
+	text = ev_page_cache_get_text (page_cache, page);
+	i = ev_page_cache_get_text_pointer (page_cache, page, offset) - text;
 
 	do {
 		pango_attr_iterator_range (iter, &start, &end);
 		if (i >= start && i < end) {
-			*start_offset = g_utf8_pointer_to_offset (text, text + start);
+			*start_offset = ev_page_cache_get_text_offset (page_cache, page, start);
 			if (end == G_MAXINT) /* Last iterator */
-				end = text_length;
-			*end_offset = g_utf8_pointer_to_offset (text, text + end);
+				*end_offset = text_length;
+			else
+				*end_offset = ev_page_cache_get_text_offset (page_cache, page, end);
 			 has_attrs = TRUE;
 		}
 	} while (!has_attrs && pango_attr_iterator_next (iter));
@@ -873,7 +879,8 @@ ev_page_accessible_get_run_attributes (AtkText *text,
 	if (!attrs)
 		return NULL;
 
-	return get_run_attributes (attrs, page_text, offset, start_offset, end_offset);
+	return get_run_attributes (attrs, view->page_cache, self->priv->page,
+				   offset, start_offset, end_offset);
 }
 
 static AtkAttributeSet*
@@ -31,6 +31,25 @@
 #include "ev-document-text.h"
 #include "ev-page-cache.h"
 
+/* Every TEXT_INDEX_STEP characters of the page text, the index keeps
+ * their byte offset, so that a character is found by walking at most
+ * TEXT_INDEX_STEP - 1 characters from there */
+#define TEXT_INDEX_STEP 32
+
+typedef struct _EvPageCacheTextIndex {
+	/* Text and log attrs the index was built for */
+	const gchar  *text;
+	PangoLogAttr *log_attrs;
+
+	gint          n_chars;
+	gint          n_bytes;
+	gint         *byte_offsets;
+
+	/* Sorted offsets of the word starts and mandatory breaks */
+	GArray       *word_starts;
+	GArray       *line_starts;
+} EvPageCacheTextIndex;
+
 typedef struct _EvPageCacheData {
 	EvJob             *job;
 	gboolean           done : 1;
@@ -48,6 +67,7 @@ typedef struct _EvPageCacheData {
 	PangoAttrList     *text_attrs;
 	PangoLogAttr      *text_log_attrs;
 	gulong             text_log_attrs_length;
+	EvPageCacheTextIndex *text_index;
 } EvPageCacheData;
 
 struct _EvPageCache {
@@ -84,6 +104,133 @@ static void job_page_data_cancelled_cb (EvJob       *job,
 
 G_DEFINE_TYPE (EvPageCache, ev_page_cache, G_TYPE_OBJECT)
 
+/* The annotations of a page are fetched once, and shared by the page
+ * caches of the document and the annotations sidebar */
+typedef struct _EvPageCacheAnnots {
+	GMutex          lock;
+	gint            n_pages;
+	EvMappingList **mappings;
+	gboolean       *fetched;
+} EvPageCacheAnnots;
+
+G_LOCK_DEFINE_STATIC (ev_page_cache_annots);
+
+static void
+ev_page_cache_annots_free (EvPageCacheAnnots *annots)
+{
+	gint i;
+
+	for (i = 0; i < annots->n_pages; i++) {
+		if (annots->mappings[i])
+			ev_mapping_list_unref (annots->mappings[i]);
+	}
+	g_free (annots->mappings);
+	g_free (annots->fetched);
+	g_mutex_clear (&annots->lock);
+	g_slice_free (EvPageCacheAnnots, annots);
+}
+
+static EvPageCacheAnnots *
+ev_page_cache_annots_get (EvDocument *document)
+{
+	EvPageCacheAnnots *annots;
+
+	G_LOCK (ev_page_cache_annots);
+	annots = g_object_get_data (G_OBJECT (document), "ev-page-cache-annots");
+	if (!annots) {
+		annots = g_slice_new0 (EvPageCacheAnnots);
+		g_mutex_init (&annots->lock);
+		annots->n_pages = ev_document_get_n_pages (document);
+		annots->mappings = g_new0 (EvMappingList *, annots->n_pages);
+		annots->fetched = g_new0 (gboolean, annots->n_pages);
+		g_object_set_data_full (G_OBJECT (document), "ev-page-cache-annots",
+					annots, (GDestroyNotify)ev_page_cache_annots_free);
+	}
+	G_UNLOCK (ev_page_cache_annots);
+
+	return annots;
+}
+
+static void
+ev_page_cache_annots_invalidate (EvDocument *document,
+				 gint        page)
+{
+	EvPageCacheAnnots *annots;
+
+	annots = ev_page_cache_annots_get (document);
+	if (page < 0 || page >= annots->n_pages)
+		return;
+
+	g_mutex_lock (&annots->lock);
+	g_clear_pointer (&annots->mappings[page], ev_mapping_list_unref);
+	annots->fetched[page] = FALSE;
+	g_mutex_unlock (&annots->lock);
+}
+
+/**
+ * ev_page_cache_fetch_annot_mapping:
+ * @document: a #EvDocument implementing #EvDocumentAnnotations
+ * @page: the page
+ *
+ * Gets the annotations of @page, from the document the first time
+ * they are asked for. The document must be locked.
+ *
+ * Returns: (transfer full): the annotation mapping of @page, or %NULL
+ */
+EvMappingList *
+ev_page_cache_fetch_annot_mapping (EvDocument *document,
+				   EvPage     *page)
+{
+	EvPageCacheAnnots *annots;
+	EvMappingList     *mapping_list;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT_ANNOTATIONS (document), NULL);
+
+	annots = ev_page_cache_annots_get (document);
+	g_return_val_if_fail (page->index >= 0 && page->index < annots->n_pages, NULL);
+
+	g_mutex_lock (&annots->lock);
+	if (annots->fetched[page->index]) {
+		mapping_list = annots->mappings[page->index];
+		if (mapping_list)
+			ev_mapping_list_ref (mapping_list);
+		g_mutex_unlock (&annots->lock);
+
+		return mapping_list;
+	}
+	g_mutex_unlock (&annots->lock);
+
+	mapping_list = ev_document_annotations_get_annotations (EV_DOCUMENT_ANNOTATIONS (document),
+								page);
+
+	g_mutex_lock (&annots->lock);
+	if (annots->fetched[page->index]) {
+		/* Fetched by someone else meanwhile */
+		if (mapping_list)
+			ev_mapping_list_unref (mapping_list);
+		mapping_list = annots->mappings[page->index];
+	} else {
+		annots->mappings[page->index] = mapping_list;
+		annots->fetched[page->index] = TRUE;
+	}
+	if (mapping_list)
+		ev_mapping_list_ref (mapping_list);
+	g_mutex_unlock (&annots->lock);
+
+	return mapping_list;
+}
+
+static void
+ev_page_cache_text_index_free (EvPageCacheTextIndex *index)
+{
+	g_free (index->byte_offsets);
+	if (index->word_starts)
+		g_array_free (index->word_starts, TRUE);
+	if (index->line_starts)
+		g_array_free (index->line_starts, TRUE);
+	g_slice_free (EvPageCacheTextIndex, index);
+}
+
 static void
 ev_page_cache_data_free (EvPageCacheData *data)
 {
@@ -138,6 +285,8 @@ ev_page_cache_data_free (EvPageCacheData *data)
                 data->text_log_attrs = NULL;
                 data->text_log_attrs_length = 0;
         }
+
+	g_clear_pointer (&data->text_index, ev_page_cache_text_index_free);
 }
 
 static void
@@ -295,6 +444,8 @@ job_page_data_finished_cb (EvJob       *job,
 		data->text_layout = job_data->text_layout;
 		data->text_layout_length = job_data->text_layout_length;
 	}
+	if (job_data->flags & (EV_PAGE_DATA_INCLUDE_TEXT | EV_PAGE_DATA_INCLUDE_TEXT_LOG_ATTRS))
+		g_clear_pointer (&data->text_index, ev_page_cache_text_index_free);
 	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT)
 		data->text = job_data->text;
 	if (job_data->flags & EV_PAGE_DATA_INCLUDE_TEXT_ATTRS)
@@ -421,14 +572,18 @@ ev_page_cache_mark_dirty (EvPageCache       *cache,
 	if (flags & EV_PAGE_DATA_INCLUDE_FORMS)
                 g_clear_pointer (&data->form_field_mapping, ev_mapping_list_unref);
 
-	if (flags & EV_PAGE_DATA_INCLUDE_ANNOTS)
+	if (flags & EV_PAGE_DATA_INCLUDE_ANNOTS) {
                 g_clear_pointer (&data->annot_mapping, ev_mapping_list_unref);
+		ev_page_cache_annots_invalidate (cache->document, page);
+	}
 
 	if (flags & EV_PAGE_DATA_INCLUDE_TEXT_MAPPING)
                 g_clear_pointer (&data->text_mapping, cairo_region_destroy);
 
-	if (flags & EV_PAGE_DATA_INCLUDE_TEXT)
+	if (flags & EV_PAGE_DATA_INCLUDE_TEXT) {
                 g_clear_pointer (&data->text, g_free);
+		g_clear_pointer (&data->text_index, ev_page_cache_text_index_free);
+	}
 
 	if (flags & EV_PAGE_DATA_INCLUDE_TEXT_LAYOUT)
                 g_clear_pointer (&data->text_layout, g_free);
@@ -655,6 +810,273 @@ ev_page_cache_get_text_log_attrs (EvPageCache   *cache,
         return FALSE;
 }
 
+static EvPageCacheTextIndex *
+ev_page_cache_text_index_new (const gchar  *text,
+			      PangoLogAttr *log_attrs,
+			      gulong        n_attrs)
+{
+	EvPageCacheTextIndex *index;
+	const gchar          *p = text;
+	gint                  i;
+
+	index = g_slice_new0 (EvPageCacheTextIndex);
+	index->text = text;
+	index->log_attrs = log_attrs;
+	index->n_chars = g_utf8_strlen (text, -1);
+	index->byte_offsets = g_new (gint, index->n_chars / TEXT_INDEX_STEP + 1);
+
+	for (i = 0; i <= index->n_chars; i++) {
+		if (i % TEXT_INDEX_STEP == 0)
+			index->byte_offsets[i / TEXT_INDEX_STEP] = p - text;
+		if (i < index->n_chars)
+			p = g_utf8_next_char (p);
+	}
+	index->n_bytes = p - text;
+
+	if (log_attrs) {
+		index->word_starts = g_array_new (FALSE, FALSE, sizeof (gint));
+		index->line_starts = g_array_new (FALSE, FALSE, sizeof (gint));
+
+		for (i = 0; i < n_attrs; i++) {
+			if (log_attrs[i].is_word_start)
+				g_array_append_val (index->word_starts, i);
+			if (log_attrs[i].is_mandatory_break)
+				g_array_append_val (index->line_starts, i);
+		}
+	}
+
+	return index;
+}
+
+/* Builds the index of the page text the first time it is needed */
+static EvPageCacheTextIndex *
+ev_page_cache_get_text_index (EvPageCache *cache,
+			      gint         page)
+{
+	EvPageCacheData *data;
+	const gchar     *text;
+	PangoLogAttr    *log_attrs = NULL;
+	gulong           n_attrs = 0;
+
+	text = ev_page_cache_get_text (cache, page);
+	if (!text)
+		return NULL;
+
+	ev_page_cache_get_text_log_attrs (cache, page, &log_attrs, &n_attrs);
+
+	data = &cache->page_list[page];
+	if (data->text_index &&
+	    data->text_index->text == text &&
+	    data->text_index->log_attrs == log_attrs)
+		return data->text_index;
+
+	g_clear_pointer (&data->text_index, ev_page_cache_text_index_free);
+	data->text_index = ev_page_cache_text_index_new (text, log_attrs, n_attrs);
+
+	return data->text_index;
+}
+
+/**
+ * ev_page_cache_get_text_length:
+ * @cache: an #EvPageCache
+ * @page: the page
+ *
+ * Returns: the number of characters of the text of @page, or -1 if it
+ *   is not available
+ */
+gint
+ev_page_cache_get_text_length (EvPageCache *cache,
+			       gint         page)
+{
+	EvPageCacheTextIndex *index;
+
+	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), -1);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, -1);
+
+	index = ev_page_cache_get_text_index (cache, page);
+
+	return index ? index->n_chars : -1;
+}
+
+/**
+ * ev_page_cache_get_text_pointer:
+ * @cache: an #EvPageCache
+ * @page: the page
+ * @offset: a character offset in the text of @page
+ *
+ * Returns: a pointer to the character at @offset in the text of @page,
+ *   or to its end if @offset is past it
+ */
+const gchar *
+ev_page_cache_get_text_pointer (EvPageCache *cache,
+				gint         page,
+				gint         offset)
+{
+	EvPageCacheTextIndex *index;
+	const gchar          *p;
+	gint                  i;
+
+	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), NULL);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, NULL);
+
+	index = ev_page_cache_get_text_index (cache, page);
+	if (!index)
+		return NULL;
+
+	offset = CLAMP (offset, 0, index->n_chars);
+	p = index->text + index->byte_offsets[offset / TEXT_INDEX_STEP];
+	for (i = offset % TEXT_INDEX_STEP; i > 0; i--)
+		p = g_utf8_next_char (p);
+
+	return p;
+}
+
+/**
+ * ev_page_cache_get_text_offset:
+ * @cache: an #EvPageCache
+ * @page: the page
+ * @byte_index: a byte index in the text of @page
+ *
+ * Returns: the offset of the character at @byte_index in the text of
+ *   @page, or -1 if it is not available
+ */
+gint
+ev_page_cache_get_text_offset (EvPageCache *cache,
+			       gint         page,
+			       gint         byte_index)
+{
+	EvPageCacheTextIndex *index;
+	const gchar          *p, *end;
+	gint                  low, high;
+	gint                  offset;
+
+	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), -1);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, -1);
+
+	index = ev_page_cache_get_text_index (cache, page);
+	if (!index)
+		return -1;
+
+	byte_index = CLAMP (byte_index, 0, index->n_bytes);
+
+	/* Last step starting at or before byte_index */
+	low = 0;
+	high = index->n_chars / TEXT_INDEX_STEP;
+	while (low < high) {
+		gint mid = (low + high + 1) / 2;
+
+		if (index->byte_offsets[mid] <= byte_index)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	offset = low * TEXT_INDEX_STEP;
+	p = index->text + index->byte_offsets[low];
+	end = index->text + byte_index;
+	while (p < end) {
+		p = g_utf8_next_char (p);
+		offset++;
+	}
+
+	return offset;
+}
+
+/* Finds the last of @starts at or before @offset, and the first one
+ * after it, like walking @log_attrs both ways from @offset would */
+static void
+find_boundaries (GArray *starts,
+		 gint    offset,
+		 gint    n_attrs,
+		 gint   *start,
+		 gint   *end)
+{
+	gint low = 0;
+	gint high = starts->len;
+
+	/* First start after offset */
+	while (low < high) {
+		gint mid = (low + high) / 2;
+
+		if (g_array_index (starts, gint, mid) <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	*start = low > 0 ? g_array_index (starts, gint, low - 1) : 0;
+	*end = low < starts->len ? g_array_index (starts, gint, low) : n_attrs;
+}
+
+static gboolean
+ev_page_cache_get_text_range (EvPageCache *cache,
+			      gint         page,
+			      gint         offset,
+			      gboolean     lines,
+			      gint        *start,
+			      gint        *end)
+{
+	EvPageCacheTextIndex *index;
+	PangoLogAttr         *log_attrs = NULL;
+	gulong                n_attrs = 0;
+
+	g_return_val_if_fail (EV_IS_PAGE_CACHE (cache), FALSE);
+	g_return_val_if_fail (page >= 0 && page < cache->n_pages, FALSE);
+
+	index = ev_page_cache_get_text_index (cache, page);
+	if (!index || !index->log_attrs)
+		return FALSE;
+
+	ev_page_cache_get_text_log_attrs (cache, page, &log_attrs, &n_attrs);
+	if (offset < 0 || offset >= n_attrs)
+		return FALSE;
+
+	find_boundaries (lines ? index->line_starts : index->word_starts,
+			 offset, n_attrs, start, end);
+
+	return TRUE;
+}
+
+/**
+ * ev_page_cache_get_text_word_range:
+ * @cache: an #EvPageCache
+ * @page: the page
+ * @offset: a character offset in the text of @page
+ * @start: (out): return location for the start of the word
+ * @end: (out): return location for the start of the next word
+ *
+ * Returns: %TRUE if the word boundaries of @page are available
+ */
+gboolean
+ev_page_cache_get_text_word_range (EvPageCache *cache,
+				   gint         page,
+				   gint         offset,
+				   gint        *start,
+				   gint        *end)
+{
+	return ev_page_cache_get_text_range (cache, page, offset, FALSE, start, end);
+}
+
+/**
+ * ev_page_cache_get_text_line_range:
+ * @cache: an #EvPageCache
+ * @page: the page
+ * @offset: a character offset in the text of @page
+ * @start: (out): return location for the start of the line
+ * @end: (out): return location for the start of the next line
+ *
+ * Returns: %TRUE if the line boundaries of @page are available
+ */
+gboolean
+ev_page_cache_get_text_line_range (EvPageCache *cache,
+				   gint         page,
+				   gint         offset,
+				   gint        *start,
+				   gint        *end)
+{
+	return ev_page_cache_get_text_range (cache, page, offset, TRUE, start, end);
+}
+
 void
 ev_page_cache_ensure_page (EvPageCache *cache,
                            gint         page)
@@ -72,10 +72,30 @@ gboolean           ev_page_cache_get_text_log_attrs     (EvPageCache       *cach
                                                          gint               page,
                                                          PangoLogAttr     **log_attrs,
                                                          gulong            *n_attrs);
+gint               ev_page_cache_get_text_length        (EvPageCache       *cache,
+							 gint               page);
+const gchar       *ev_page_cache_get_text_pointer       (EvPageCache       *cache,
+							 gint               page,
+							 gint               offset);
+gint               ev_page_cache_get_text_offset        (EvPageCache       *cache,
+							 gint               page,
+							 gint               byte_index);
+gboolean           ev_page_cache_get_text_word_range    (EvPageCache       *cache,
+							 gint               page,
+							 gint               offset,
+							 gint              *start,
+							 gint              *end);
+gboolean           ev_page_cache_get_text_line_range    (EvPageCache       *cache,
+							 gint               page,
+							 gint               offset,
+							 gint              *start,
+							 gint              *end);
 void               ev_page_cache_ensure_page            (EvPageCache       *cache,
                                                          gint               page);
 gboolean           ev_page_cache_is_page_cached         (EvPageCache       *cache,
                                                          gint               page);
+EvMappingList     *ev_page_cache_fetch_annot_mapping    (EvDocument        *document,
+							 EvPage            *page);
 G_END_DECLS
 
 #endif /* EV_PAGE_CACHE_H */
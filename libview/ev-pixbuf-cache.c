@@ -2,6 +2,7 @@
 #include "ev-pixbuf-cache.h"
 #include "ev-job-scheduler.h"
 #include "ev-view-private.h"
+#include "ev-debug.h"
 
 typedef enum {
         SCROLL_DIRECTION_DOWN,
@@ -13,12 +14,25 @@ typedef struct _CacheJobInfo
 	EvJob *job;
 	gboolean page_ready;
 
+	/* Low resolution render shown until the page has a surface */
+	EvJob *preview_job;
+
+	/* Last time the surface was drawn, to pick the pages to evict */
+	gint64   last_used;
+
 	/* Region of the page that needs to be drawn */
 	cairo_region_t  *region;
 
 	/* Data we get from rendering */
 	cairo_surface_t *surface;
 
+	/* When only part of the page was rendered, the area the surface
+	 * shows, for a page of clip_page_width x clip_page_height */
+	gboolean         clipped;
+	GdkRectangle     clip;
+	gint             clip_page_width;
+	gint             clip_page_height;
+
 	/* Device scale factor of target widget */
 	int device_scale;
 
@@ -84,6 +98,9 @@ static void          ev_pixbuf_cache_finalize   (GObject            *object);
 static void          ev_pixbuf_cache_dispose    (GObject            *object);
 static void          job_finished_cb            (EvJob              *job,
 						 EvPixbufCache      *pixbuf_cache);
+static void          preview_job_finished_cb    (EvJob              *job,
+						 EvPixbufCache      *pixbuf_cache);
+static void          ev_pixbuf_cache_trim       (void);
 static CacheJobInfo *find_job_cache             (EvPixbufCache      *pixbuf_cache,
 						 int                 page);
 static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cache,
@@ -101,6 +118,21 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 
 #define MAX_PRELOADED_PAGES 3
 
+/* Pages whose surface would take more than this are only rendered
+ * around the area in view, aligned to tiles of TILE_SIZE pixels */
+#define TILED_PAGE_SIZE (32 * 1024 * 1024)
+#define TILE_SIZE 256
+
+/* Visible pages without a surface are first rendered at a fraction of
+ * the scale, unless the whole page takes less than PREVIEW_MIN_PAGE_SIZE */
+#define PREVIEW_SCALE_FACTOR 4
+#define PREVIEW_MIN_PAGE_SIZE (1024 * 1024)
+
+/* All the caches of the process share a single memory budget, the
+ * largest of their max sizes. The least recently drawn preloaded pages
+ * of any of them are evicted to stay within it. */
+static GList *caches = NULL;
+
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
 static void
@@ -166,11 +198,25 @@ end_job (CacheJobInfo *job_info,
 	g_signal_handlers_disconnect_by_func (job_info->job,
 					      G_CALLBACK (job_finished_cb),
 					      data);
+	ev_profiler_cancel (EV_PROFILE_JOBS, "Render latency page %d (%p)",
+			    EV_JOB_RENDER (job_info->job)->page, job_info->job);
 	ev_job_cancel (job_info->job);
 	g_object_unref (job_info->job);
 	job_info->job = NULL;
 }
 
+static void
+end_preview_job (CacheJobInfo *job_info,
+		 gpointer      data)
+{
+	g_signal_handlers_disconnect_by_func (job_info->preview_job,
+					      G_CALLBACK (preview_job_finished_cb),
+					      data);
+	ev_job_cancel (job_info->preview_job);
+	g_object_unref (job_info->preview_job);
+	job_info->preview_job = NULL;
+}
+
 static void
 dispose_cache_job_info (CacheJobInfo *job_info,
 			gpointer      data)
@@ -180,11 +226,14 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 
 	if (job_info->job)
 		end_job (job_info, data);
+	if (job_info->preview_job)
+		end_preview_job (job_info, data);
 
 	if (job_info->surface) {
 		cairo_surface_destroy (job_info->surface);
 		job_info->surface = NULL;
 	}
+	job_info->clipped = FALSE;
 	if (job_info->region) {
 		cairo_region_destroy (job_info->region);
 		job_info->region = NULL;
@@ -209,6 +258,8 @@ ev_pixbuf_cache_dispose (GObject *object)
 
 	pixbuf_cache = EV_PIXBUF_CACHE (object);
 
+	caches = g_list_remove (caches, pixbuf_cache);
+
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
 		dispose_cache_job_info (pixbuf_cache->prev_job + i, pixbuf_cache);
 		dispose_cache_job_info (pixbuf_cache->next_job + i, pixbuf_cache);
@@ -235,6 +286,8 @@ ev_pixbuf_cache_new (GtkWidget       *view,
 	pixbuf_cache->document = ev_document_model_get_document (model);
 	pixbuf_cache->max_size = max_size;
 
+	caches = g_list_prepend (caches, pixbuf_cache);
+
 	return pixbuf_cache;
 }
 
@@ -248,6 +301,156 @@ ev_pixbuf_cache_set_max_size (EvPixbufCache *pixbuf_cache,
 	if (pixbuf_cache->max_size > max_size)
 		ev_pixbuf_cache_clear (pixbuf_cache);
 	pixbuf_cache->max_size = max_size;
+
+	ev_pixbuf_cache_trim ();
+}
+
+static gsize
+get_surface_size (cairo_surface_t *surface)
+{
+	if (!surface)
+		return 0;
+
+	return (gsize) cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+}
+
+static gsize
+get_job_info_size (CacheJobInfo *job_info)
+{
+	return get_surface_size (job_info->surface) + get_surface_size (job_info->selection);
+}
+
+static gsize
+ev_pixbuf_cache_get_size (EvPixbufCache *pixbuf_cache)
+{
+	gsize size = 0;
+	gint  i;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		size += get_job_info_size (pixbuf_cache->prev_job + i);
+		size += get_job_info_size (pixbuf_cache->next_job + i);
+	}
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+		size += get_job_info_size (pixbuf_cache->job_list + i);
+	}
+
+	return size;
+}
+
+/* Number of bytes taken by the surfaces of all the caches */
+gsize
+ev_pixbuf_cache_get_memory_usage (void)
+{
+	GList *l;
+	gsize  size = 0;
+
+	for (l = caches; l; l = g_list_next (l))
+		size += ev_pixbuf_cache_get_size (EV_PIXBUF_CACHE (l->data));
+
+	return size;
+}
+
+/* Number of bytes all the caches are allowed to take together */
+gsize
+ev_pixbuf_cache_get_memory_budget (void)
+{
+	GList *l;
+	gsize  budget = 0;
+
+	for (l = caches; l; l = g_list_next (l))
+		budget = MAX (budget, EV_PIXBUF_CACHE (l->data)->max_size);
+
+	return budget;
+}
+
+/* The part of the budget @pixbuf_cache can count on, to size its
+ * preloaded range without pushing the pages of other caches out */
+static gsize
+ev_pixbuf_cache_get_memory_share (EvPixbufCache *pixbuf_cache)
+{
+	gsize share;
+
+	share = ev_pixbuf_cache_get_memory_budget () / MAX (g_list_length (caches), 1);
+
+	return MIN (share, pixbuf_cache->max_size);
+}
+
+static void
+evict_job_info (CacheJobInfo  *job_info,
+		EvPixbufCache *pixbuf_cache)
+{
+	if (job_info->job)
+		end_job (job_info, pixbuf_cache);
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
+
+	if (job_info->surface) {
+		cairo_surface_destroy (job_info->surface);
+		job_info->surface = NULL;
+	}
+	job_info->clipped = FALSE;
+	if (job_info->selection) {
+		cairo_surface_destroy (job_info->selection);
+		job_info->selection = NULL;
+	}
+
+	job_info->page_ready = FALSE;
+}
+
+static void
+find_lru_job_info (CacheJobInfo   *job_info,
+		   EvPixbufCache  *pixbuf_cache,
+		   CacheJobInfo  **lru,
+		   EvPixbufCache **lru_cache)
+{
+	if (!job_info->surface)
+		return;
+
+	if (*lru == NULL || job_info->last_used < (*lru)->last_used) {
+		*lru = job_info;
+		*lru_cache = pixbuf_cache;
+	}
+}
+
+/* Evicts the least recently drawn preloaded pages of all the caches
+ * until they fit in the budget. Visible pages are never evicted: their
+ * view wouldn't know it has to render them again, so the caches go over
+ * the budget instead. Evicted pages are rendered again when their
+ * cache's page range is next set. */
+static void
+ev_pixbuf_cache_trim (void)
+{
+	gsize budget = ev_pixbuf_cache_get_memory_budget ();
+	gsize size = ev_pixbuf_cache_get_memory_usage ();
+
+	while (size > budget) {
+		CacheJobInfo  *lru = NULL;
+		EvPixbufCache *lru_cache = NULL;
+		GList         *l;
+		gint           i;
+
+		for (l = caches; l; l = g_list_next (l)) {
+			EvPixbufCache *pixbuf_cache = EV_PIXBUF_CACHE (l->data);
+
+			for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+				find_lru_job_info (pixbuf_cache->prev_job + i, pixbuf_cache,
+						   &lru, &lru_cache);
+				find_lru_job_info (pixbuf_cache->next_job + i, pixbuf_cache,
+						   &lru, &lru_cache);
+			}
+		}
+
+		if (lru == NULL)
+			break;
+
+		size -= get_job_info_size (lru);
+		evict_job_info (lru, lru_cache);
+	}
+
+	ev_debug_message (DEBUG_JOBS, "%" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes used",
+			  size, budget);
 }
 
 static int
@@ -273,6 +476,16 @@ copy_job_to_job_info (EvJobRender   *job_render,
 	}
 	job_info->surface = cairo_surface_reference (job_render->surface);
 	set_device_scale_on_surface (job_info->surface, job_info->device_scale);
+
+	job_info->clipped = job_render->has_clip;
+	if (job_info->clipped) {
+		job_info->clip.x = job_render->clip.x / job_info->device_scale;
+		job_info->clip.y = job_render->clip.y / job_info->device_scale;
+		job_info->clip.width = job_render->clip.width / job_info->device_scale;
+		job_info->clip.height = job_render->clip.height / job_info->device_scale;
+		job_info->clip_page_width = job_render->target_width / job_info->device_scale;
+		job_info->clip_page_height = job_render->target_height / job_info->device_scale;
+	}
 	if (pixbuf_cache->inverted_colors) {
 		ev_document_misc_invert_surface (job_info->surface);
 	}
@@ -304,8 +517,11 @@ copy_job_to_job_info (EvJobRender   *job_render,
 
 	if (job_info->job)
 		end_job (job_info, pixbuf_cache);
+	if (job_info->preview_job)
+		end_preview_job (job_info, pixbuf_cache);
 
 	job_info->page_ready = TRUE;
+	job_info->last_used = g_get_monotonic_time ();
 }
 
 static void
@@ -315,6 +531,8 @@ job_finished_cb (EvJob         *job,
 	CacheJobInfo *job_info;
 	EvJobRender *job_render = EV_JOB_RENDER (job);
 
+	ev_profiler_stop (EV_PROFILE_JOBS, "Render latency page %d (%p)", job_render->page, job);
+
 	/* If the job is outside of our interest, we silently discard it */
 	if ((job_render->page < (pixbuf_cache->start_page - pixbuf_cache->preload_cache_size)) ||
 	    (job_render->page > (pixbuf_cache->end_page + pixbuf_cache->preload_cache_size))) {
@@ -331,9 +549,48 @@ job_finished_cb (EvJob         *job,
 	}
 
 	copy_job_to_job_info (job_render, job_info, pixbuf_cache);
+	ev_pixbuf_cache_trim ();
 	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
 }
 
+static void
+preview_job_finished_cb (EvJob         *job,
+			 EvPixbufCache *pixbuf_cache)
+{
+	CacheJobInfo *job_info;
+	EvJobRender  *job_render = EV_JOB_RENDER (job);
+	gint          width, height;
+
+	job_info = find_job_cache (pixbuf_cache, job_render->page);
+	if (job_info == NULL || job_info->preview_job != job)
+		return;
+
+	job_info->preview_job = NULL;
+
+	/* The full render may have been a fast one */
+	if (ev_job_is_failed (job) || job_info->surface) {
+		g_object_unref (job);
+		return;
+	}
+
+	/* Shown at the size of the page, like a full render */
+	_get_page_size_for_scale_and_rotation (job->document, job_render->page,
+					       job_render->scale * PREVIEW_SCALE_FACTOR,
+					       job_render->rotation,
+					       &width, &height);
+	job_info->surface = cairo_surface_reference (job_render->surface);
+	cairo_surface_set_device_scale (job_info->surface,
+					(gdouble) job_render->target_width / width,
+					(gdouble) job_render->target_height / height);
+	job_info->clipped = FALSE;
+	job_info->last_used = g_get_monotonic_time ();
+	if (pixbuf_cache->inverted_colors)
+		ev_document_misc_invert_surface (job_info->surface);
+	g_object_unref (job);
+
+	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+}
+
 /* This checks a job to see if the job would generate the right sized pixbuf
  * given a scale.  If it won't, it removes the job and clears it to NULL.
  */
@@ -347,6 +604,20 @@ check_job_size_and_unref (EvPixbufCache *pixbuf_cache,
 
 	g_assert (job_info);
 
+	/* A preview at another scale would be shown stretched on top of
+	 * the page until the new render arrives */
+	if (job_info->preview_job) {
+		EvJobRender *preview = EV_JOB_RENDER (job_info->preview_job);
+
+		_get_page_size_for_scale_and_rotation (job_info->preview_job->document,
+						       preview->page,
+						       scale / PREVIEW_SCALE_FACTOR,
+						       preview->rotation,
+						       &width, &height);
+		if (width != preview->target_width || height != preview->target_height)
+			end_preview_job (job_info, pixbuf_cache);
+	}
+
 	if (job_info->job == NULL)
 		return;
 
@@ -415,6 +686,7 @@ move_one_job (CacheJobInfo  *job_info,
 
 	*target_page = *job_info;
 	job_info->job = NULL;
+	job_info->preview_job = NULL;
 	job_info->region = NULL;
 	job_info->surface = NULL;
 
@@ -423,18 +695,84 @@ move_one_job (CacheJobInfo  *job_info,
 	}
 }
 
+/* Whether only part of @page is rendered at @scale, because the whole
+ * of it would take too much memory and the backend can render part of
+ * a page. @visible is set to the area of the page in view, and @area to
+ * the part to render, around it */
+static gboolean
+ev_pixbuf_cache_get_tile_area (EvPixbufCache *pixbuf_cache,
+			       gint           page,
+			       gdouble        scale,
+			       gint           rotation,
+			       GdkRectangle  *visible,
+			       GdkRectangle  *area)
+{
+	GdkRectangle page_area;
+	gint         width, height;
+	gint         x2, y2;
+
+	/* Other backends render whole pages, which are charged in full */
+	if (!ev_document_can_render_clip (pixbuf_cache->document))
+		return FALSE;
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, scale, rotation,
+					       &width, &height);
+	if ((gsize) height * cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width) <= TILED_PAGE_SIZE)
+		return FALSE;
+
+	if (!_ev_view_get_page_visible_area (EV_VIEW (pixbuf_cache->view), page, visible))
+		return FALSE;
+
+	/* The view could still be at another scale */
+	page_area.x = page_area.y = 0;
+	page_area.width = width;
+	page_area.height = height;
+	if (!gdk_rectangle_intersect (visible, &page_area, visible))
+		return FALSE;
+
+	/* One more tile around the visible ones */
+	area->x = MAX (0, (visible->x / TILE_SIZE - 1) * TILE_SIZE);
+	area->y = MAX (0, (visible->y / TILE_SIZE - 1) * TILE_SIZE);
+	x2 = MIN (width, ((visible->x + visible->width) / TILE_SIZE + 2) * TILE_SIZE);
+	y2 = MIN (height, ((visible->y + visible->height) / TILE_SIZE + 2) * TILE_SIZE);
+	area->width = x2 - area->x;
+	area->height = y2 - area->y;
+
+	return TRUE;
+}
+
+static gboolean
+rectangle_contains (const GdkRectangle *rect,
+		    const GdkRectangle *other)
+{
+	return other->x >= rect->x && other->y >= rect->y &&
+		other->x + other->width <= rect->x + rect->width &&
+		other->y + other->height <= rect->y + rect->height;
+}
+
 static gsize
 ev_pixbuf_cache_get_page_size (EvPixbufCache *pixbuf_cache,
 			       gint           page_index,
 			       gdouble        scale,
 			       gint           rotation)
 {
+	GdkRectangle visible, area;
+	gint device_scale = get_device_scale (pixbuf_cache);
 	gint width, height;
 
-	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
-					       page_index, scale, rotation,
-					       &width, &height);
-	return height * cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
+	if (ev_pixbuf_cache_get_tile_area (pixbuf_cache, page_index, scale, rotation,
+					   &visible, &area)) {
+		width = area.width;
+		height = area.height;
+	} else {
+		_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+						       page_index, scale, rotation,
+						       &width, &height);
+	}
+
+	return (gsize) height * device_scale *
+		cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width * device_scale);
 }
 
 static gint
@@ -445,6 +783,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 				  gint           rotation)
 {
 	gsize range_size = 0;
+	gsize max_size = ev_pixbuf_cache_get_memory_share (pixbuf_cache);
 	gint  new_preload_cache_size = 0;
 	gint  i;
 	guint n_pages = ev_document_get_n_pages (pixbuf_cache->document);
@@ -454,7 +793,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		range_size += ev_pixbuf_cache_get_page_size (pixbuf_cache, i, scale, rotation);
 	}
 
-	if (range_size >= pixbuf_cache->max_size)
+	if (range_size >= max_size)
 		return new_preload_cache_size;
 
 	i = 1;
@@ -466,7 +805,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		if (end_page + i < n_pages) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, end_page + i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				new_preload_cache_size++;
 				updated = TRUE;
@@ -478,7 +817,7 @@ ev_pixbuf_cache_get_preload_size (EvPixbufCache *pixbuf_cache,
 		if (start_page - i > 0) {
 			page_size = ev_pixbuf_cache_get_page_size (pixbuf_cache, start_page - i,
 								   scale, rotation);
-			if (page_size + range_size <= pixbuf_cache->max_size) {
+			if (page_size + range_size <= max_size) {
 				range_size += page_size;
 				if (!updated)
 					new_preload_cache_size++;
@@ -658,6 +997,7 @@ static void
 add_job (EvPixbufCache  *pixbuf_cache,
 	 CacheJobInfo   *job_info,
 	 cairo_region_t *region,
+	 GdkRectangle   *clip,
 	 gint            width,
 	 gint            height,
 	 gint            page,
@@ -681,7 +1021,16 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	                                   width * job_info->device_scale,
 	                                   height * job_info->device_scale);
 
-	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
+	if (clip) {
+		cairo_rectangle_int_t device_clip;
+
+		device_clip.x = clip->x * job_info->device_scale;
+		device_clip.y = clip->y * job_info->device_scale;
+		device_clip.width = clip->width * job_info->device_scale;
+		device_clip.height = clip->height * job_info->device_scale;
+		ev_job_render_set_clip (EV_JOB_RENDER (job_info->job), &device_clip);
+	} else if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
+		/* Selections of clipped pages are drawn from their region */
 		GdkColor text, base;
 
 		get_selection_colors (EV_VIEW (pixbuf_cache->view), &text, &base);
@@ -694,9 +1043,34 @@ add_job (EvPixbufCache  *pixbuf_cache,
 	g_signal_connect (job_info->job, "finished",
 			  G_CALLBACK (job_finished_cb),
 			  pixbuf_cache);
+	/* Time from the view asking for the page until its surface is ready */
+	ev_profiler_start (EV_PROFILE_JOBS, "Render latency page %d (%p)", page, job_info->job);
 	ev_job_scheduler_push_job (job_info->job, priority);
 }
 
+static void
+add_preview_job (EvPixbufCache *pixbuf_cache,
+		 CacheJobInfo  *job_info,
+		 gint           page,
+		 gint           rotation,
+		 gfloat         scale)
+{
+	gdouble preview_scale = scale / PREVIEW_SCALE_FACTOR;
+	gint    width, height;
+
+	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
+					       page, preview_scale, rotation,
+					       &width, &height);
+
+	job_info->preview_job = ev_job_render_new (pixbuf_cache->document,
+						   page, rotation, preview_scale,
+						   width, height);
+	g_signal_connect (job_info->preview_job, "finished",
+			  G_CALLBACK (preview_job_finished_cb),
+			  pixbuf_cache);
+	ev_job_scheduler_push_job (job_info->preview_job, EV_JOB_PRIORITY_PREVIEW);
+}
+
 static void
 add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		   CacheJobInfo  *job_info,
@@ -707,20 +1081,47 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 {
 	gint device_scale = get_device_scale (pixbuf_cache);
 	gint width, height;
+	GdkRectangle visible, area;
+	gboolean tiled;
 
-	if (job_info->job)
-		return;
+	tiled = ev_pixbuf_cache_get_tile_area (pixbuf_cache, page, scale, rotation,
+					       &visible, &area);
+
+	if (job_info->job) {
+		EvJobRender  *job_render = EV_JOB_RENDER (job_info->job);
+		GdkRectangle  job_area;
+
+		if (!tiled || !job_render->has_clip)
+			return;
+
+		/* Unless the part being rendered scrolled out of view */
+		job_area.x = job_render->clip.x / job_info->device_scale;
+		job_area.y = job_render->clip.y / job_info->device_scale;
+		job_area.width = job_render->clip.width / job_info->device_scale;
+		job_area.height = job_render->clip.height / job_info->device_scale;
+		if (rectangle_contains (&job_area, &visible))
+			return;
+
+		end_job (job_info, pixbuf_cache);
+	}
 
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
 
-	if (job_info->surface &&
+	if (job_info->surface && !job_info->clipped &&
 	    job_info->device_scale == device_scale &&
 	    cairo_image_surface_get_width (job_info->surface) == width * device_scale &&
 	    cairo_image_surface_get_height (job_info->surface) == height * device_scale)
 		return;
 
+	if (tiled && job_info->surface && job_info->clipped &&
+	    job_info->device_scale == device_scale &&
+	    job_info->clip_page_width == width &&
+	    job_info->clip_page_height == height &&
+	    rectangle_contains (&job_info->clip, &visible))
+		return;
+
 	/* Free old surfaces for non visible pages */
 	if (priority == EV_JOB_PRIORITY_LOW) {
 		if (job_info->surface) {
@@ -734,9 +1135,15 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 		}
 	}
 
-	add_job (pixbuf_cache, job_info, NULL,
+	add_job (pixbuf_cache, job_info, NULL, tiled ? &area : NULL,
 		 width, height, page, rotation, scale,
 		 priority);
+
+	/* Partially rendered pages are quick enough already */
+	if (priority == EV_JOB_PRIORITY_URGENT && !tiled &&
+	    !job_info->surface && !job_info->preview_job &&
+	    ev_pixbuf_cache_get_page_size (pixbuf_cache, page, scale, rotation) > PREVIEW_MIN_PAGE_SIZE)
+		add_preview_job (pixbuf_cache, job_info, page, rotation, scale);
 }
 
 static void
@@ -855,6 +1262,8 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	/* Finally, we add the new jobs for all the sizes that don't have a
 	 * pixbuf */
 	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
+
+	ev_pixbuf_cache_trim ();
 }
 
 void
@@ -899,6 +1308,8 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	if (job_info == NULL)
 		return NULL;
 
+	job_info->last_used = g_get_monotonic_time ();
+
 	if (job_info->page_ready)
 		return job_info->surface;
 
@@ -912,6 +1323,33 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	return job_info->surface;
 }
 
+/* Whether the surface of @page only shows @area of it, once scaled
+ * to @page_width x @page_height */
+gboolean
+ev_pixbuf_cache_get_surface_clip (EvPixbufCache *pixbuf_cache,
+				  gint           page,
+				  gint           page_width,
+				  gint           page_height,
+				  GdkRectangle  *area)
+{
+	CacheJobInfo *job_info;
+	gdouble       scale_x, scale_y;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL || !job_info->surface || !job_info->clipped)
+		return FALSE;
+
+	scale_x = (gdouble) page_width / job_info->clip_page_width;
+	scale_y = (gdouble) page_height / job_info->clip_page_height;
+
+	area->x = (gint) (job_info->clip.x * scale_x + 0.5);
+	area->y = (gint) (job_info->clip.y * scale_y + 0.5);
+	area->width = (gint) (job_info->clip.width * scale_x + 0.5);
+	area->height = (gint) (job_info->clip.height * scale_y + 0.5);
+
+	return TRUE;
+}
+
 static gboolean
 new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
 			      CacheJobInfo  *job_info,
@@ -1040,6 +1478,10 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 	if (!job_info->points_set)
 		return NULL;
 
+	/* It would be as large as the whole page, use the region instead */
+	if (job_info->clipped)
+		return NULL;
+
 	/* If we have a running job, we just return what we have under the
 	 * assumption that it'll be updated later and we can scale it as need
 	 * be */
@@ -1062,7 +1504,7 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 		EvPage *ev_page;
 
 		/* we need to get a new selection pixbuf */
-		ev_document_doc_mutex_lock ();
+		ev_document_lock_shared (pixbuf_cache->document);
 		if (job_info->selection_points.x1 < 0) {
 			g_assert (job_info->selection == NULL);
 			old_points = NULL;
@@ -1086,7 +1528,7 @@ ev_pixbuf_cache_get_selection_surface (EvPixbufCache   *pixbuf_cache,
 		job_info->selection_points = job_info->target_points;
 		job_info->selection_scale = scale * job_info->device_scale;
 		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock_shared (pixbuf_cache->document);
 	}
 	return job_info->selection;
 }
@@ -1128,7 +1570,7 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		EvRenderContext *rc;
 		EvPage *ev_page;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_lock_shared (pixbuf_cache->document);
 		ev_page = ev_document_get_page (pixbuf_cache->document, page);
 		rc = ev_render_context_new (ev_page, 0, scale);
 		g_object_unref (ev_page);
@@ -1142,7 +1584,7 @@ ev_pixbuf_cache_get_selection_region (EvPixbufCache *pixbuf_cache,
 		job_info->selection_region_points = job_info->target_points;
 		job_info->selection_region_scale = scale;
 		g_object_unref (rc);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock_shared (pixbuf_cache->document);
 	}
 	return job_info->selection_region && !cairo_region_is_empty(job_info->selection_region) ?
                 job_info->selection_region : NULL;
@@ -1338,15 +1780,19 @@ ev_pixbuf_cache_reload_page (EvPixbufCache  *pixbuf_cache,
 {
 	CacheJobInfo *job_info;
         gint width, height;
+	GdkRectangle visible, area;
+	gboolean tiled;
 
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return;
 
+	tiled = ev_pixbuf_cache_get_tile_area (pixbuf_cache, page, scale, rotation,
+					       &visible, &area);
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
-        add_job (pixbuf_cache, job_info, region,
+        add_job (pixbuf_cache, job_info, region, tiled ? &area : NULL,
 		 width, height, page, rotation, scale,
 		 EV_JOB_PRIORITY_URGENT);
 }
@@ -30,6 +30,7 @@
 
 #include "ev-jobs.h"
 #include "ev-job-scheduler.h"
+#include "ev-debug.h"
 
 enum {
 	PROP_0,
@@ -269,6 +270,9 @@ ev_print_operation_run (EvPrintOperation *op,
 
 	g_return_if_fail (EV_IS_PRINT_OPERATION (op));
 
+	/* Pages are oriented and scaled according to their size */
+	ev_document_complete_page_cache (op->document);
+
 	class->run (op, parent);
 }
 
@@ -369,6 +373,7 @@ static GType    ev_print_operation_export_get_type (void) G_GNUC_CONST;
 
 static void     ev_print_operation_export_begin    (EvPrintOperationExport *export);
 static gboolean export_print_page                  (EvPrintOperationExport *export);
+static EvJobExport *export_get_job                 (EvPrintOperationExport *export);
 static void     export_cancel                      (EvPrintOperationExport *export);
 
 struct _EvPrintOperationExport {
@@ -396,6 +401,12 @@ struct _EvPrintOperationExport {
 
 	guint idle_id;
 
+	/* Whether the job being run ends the document */
+	gboolean exporting_end;
+	/* Whether the exporter was begun and not ended yet */
+	gboolean exporter_open;
+	gint64 start_time;
+
 	/* Context */
 	EvFileExporterContext fc;
 	gint n_pages_to_print;
@@ -418,6 +429,10 @@ struct _EvPrintOperationExportClass {
 
 G_DEFINE_TYPE (EvPrintOperationExport, ev_print_operation_export, EV_TYPE_PRINT_OPERATION)
 
+/* Number of pages exported by each job, instead of a job and a main
+ * loop iteration per page */
+#define EXPORT_BATCH_SIZE 32
+
 /* Internal print queue */
 static GHashTable *print_queue = NULL;
 
@@ -718,9 +733,6 @@ export_print_inc_page (EvPrintOperationExport *export)
 				if (export->pages_per_sheet > 1 && export->collate == 1 &&
 				    (export->page_count - 1) % export->pages_per_sheet != 0) {
 
-					EvPrintOperation *op = EV_PRINT_OPERATION (export);
-					ev_document_doc_mutex_lock ();
-
 					/* keep track of all blanks but only actualise those
 					 * which are in the current odd / even sheet set */
 
@@ -728,9 +740,8 @@ export_print_inc_page (EvPrintOperationExport *export)
 					if (export->page_set == GTK_PAGE_SET_ALL ||
 						(export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 						(export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1) ) {
-						ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
+						ev_job_export_add_end_page (export_get_job (export));
 					}
-					ev_document_doc_mutex_unlock ();
 					export->sheet = 1 + (export->page_count - 1) / export->pages_per_sheet;
 				}
 
@@ -940,28 +951,63 @@ export_print_page_idle_finished (EvPrintOperationExport *export)
 	export->idle_id = 0;
 }
 
+static void
+update_progress (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+
+	ev_print_operation_update_status (op, export->total,
+					  export->n_pages_to_print,
+					  export->total / (gdouble)export->n_pages_to_print);
+}
+
+static void export_job_finished  (EvJobExport            *job,
+				  EvPrintOperationExport *export);
+static void export_job_cancelled (EvJobExport            *job,
+				  EvPrintOperationExport *export);
+
+static void
+export_clear_job (EvPrintOperationExport *export)
+{
+	if (!export->job_export)
+		return;
+
+	g_signal_handlers_disconnect_by_func (export->job_export,
+					      export_job_finished,
+					      export);
+	g_signal_handlers_disconnect_by_func (export->job_export,
+					      export_job_cancelled,
+					      export);
+	g_object_unref (export->job_export);
+	export->job_export = NULL;
+}
+
 static void
 export_job_finished (EvJobExport            *job,
 		     EvPrintOperationExport *export)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+	export_clear_job (export);
 
-	if (export->pages_per_sheet == 1 ||
-	   ( export->page_count % export->pages_per_sheet == 0 &&
-	   ( export->page_set == GTK_PAGE_SET_ALL ||
-	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
-	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
+	if (export->exporting_end) {
+		gdouble seconds;
 
-		ev_document_doc_mutex_lock ();
-		ev_file_exporter_end_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		export->exporter_open = FALSE;
+		close (export->fd);
+		export->fd = -1;
+
+		seconds = (g_get_monotonic_time () - export->start_time) / (gdouble) G_USEC_PER_SEC;
+		ev_debug_message (DEBUG_JOBS, "%d pages exported in %.2f s, %.1f pages/s",
+				  export->total, seconds,
+				  seconds > 0 ? export->total / seconds : 0);
+
+		update_progress (export);
+		export_print_done (export);
+
+		return;
 	}
 
-	/* Reschedule */
-	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-					   (GSourceFunc)export_print_page,
-					   export,
-					   (GDestroyNotify)export_print_page_idle_finished);
+	/* Queue the next pages right away, the backend is idle */
+	export_print_page (export);
 }
 
 static void
@@ -971,6 +1017,24 @@ export_job_cancelled (EvJobExport            *job,
 	export_cancel (export);
 }
 
+static EvJobExport *
+export_get_job (EvPrintOperationExport *export)
+{
+	EvPrintOperation *op = EV_PRINT_OPERATION (export);
+
+	if (!export->job_export) {
+		export->job_export = ev_job_export_new (op->document);
+		g_signal_connect (export->job_export, "finished",
+				  G_CALLBACK (export_job_finished),
+				  (gpointer)export);
+		g_signal_connect (export->job_export, "cancelled",
+				  G_CALLBACK (export_job_cancelled),
+				  (gpointer)export);
+	}
+
+	return EV_JOB_EXPORT (export->job_export);
+}
+
 static void
 export_cancel (EvPrintOperationExport *export)
 {
@@ -980,17 +1044,18 @@ export_cancel (EvPrintOperationExport *export)
 		g_source_remove (export->idle_id);
 	export->idle_id = 0;
 
-	if (export->job_export) {
-		g_signal_handlers_disconnect_by_func (export->job_export,
-						      export_job_finished,
-						      export);
-		g_signal_handlers_disconnect_by_func (export->job_export,
-						      export_job_cancelled,
-						      export);
-		g_object_unref (export->job_export);
-		export->job_export = NULL;
+	/* A cancelled job stops before its next step, and the exporter is
+	 * ended here unless the job got to end it */
+	if (export->exporter_open) {
+		ev_document_lock (op->document);
+		if (!export->job_export || !EV_JOB_EXPORT (export->job_export)->ended)
+			ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
+		ev_document_unlock (op->document);
+		export->exporter_open = FALSE;
 	}
 
+	export_clear_job (export);
+
 	if (export->fd != -1) {
 		close (export->fd);
 		export->fd = -1;
@@ -1003,23 +1068,12 @@ export_cancel (EvPrintOperationExport *export)
 	ev_print_operation_export_run_next (export);
 }
 
-static void
-update_progress (EvPrintOperationExport *export)
-{
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
-	ev_print_operation_update_status (op, export->total,
-					  export->n_pages_to_print,
-					  export->total / (gdouble)export->n_pages_to_print);
-}
-
+/* Adds the steps to export the next page to the current job. Returns
+ * %FALSE once the end of the document was added instead */
 static gboolean
-export_print_page (EvPrintOperationExport *export)
+export_queue_page (EvPrintOperationExport *export)
 {
-	EvPrintOperation *op = EV_PRINT_OPERATION (export);
-
-	if (!export->temp_file)
-		return FALSE; /* cancelled */
+	EvJobExport *job = export_get_job (export);
 
 	export->total++;
 	export->collated++;
@@ -1033,14 +1087,7 @@ export_print_page (EvPrintOperationExport *export)
 	if (export->collated == export->collated_copies) {
 		export->collated = 0;
 		if (!export_print_inc_page (export)) {
-			ev_document_doc_mutex_lock ();
-			ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-			ev_document_doc_mutex_unlock ();
-
-			close (export->fd);
-			export->fd = -1;
-			update_progress (export);
-			export_print_done (export);
+			ev_job_export_add_end (job);
 
 			return FALSE;
 		}
@@ -1060,16 +1107,8 @@ export_print_page (EvPrintOperationExport *export)
 				export->collated = 0;
 
 				if (!export_print_inc_page (export)) {
-					ev_document_doc_mutex_lock ();
-					ev_file_exporter_end (EV_FILE_EXPORTER (op->document));
-					ev_document_doc_mutex_unlock ();
-
-					close (export->fd);
-					export->fd = -1;
+					ev_job_export_add_end (job);
 
-					update_progress (export);
-
-					export_print_done (export);
 					return FALSE;
 				}
 			}
@@ -1084,22 +1123,33 @@ export_print_page (EvPrintOperationExport *export)
 	    (export->page_set == GTK_PAGE_SET_ALL ||
 	    (export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0) ||
 	    (export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1)))) {
-		ev_document_doc_mutex_lock ();
-		ev_file_exporter_begin_page (EV_FILE_EXPORTER (op->document));
-		ev_document_doc_mutex_unlock ();
+		ev_job_export_add_begin_page (job);
 	}
 
-	if (!export->job_export) {
-		export->job_export = ev_job_export_new (op->document);
-		g_signal_connect (export->job_export, "finished",
-				  G_CALLBACK (export_job_finished),
-				  (gpointer)export);
-		g_signal_connect (export->job_export, "cancelled",
-				  G_CALLBACK (export_job_cancelled),
-				  (gpointer)export);
+	ev_job_export_add_page (job, export->page);
+
+	if (export->pages_per_sheet == 1 ||
+	   ( export->page_count % export->pages_per_sheet == 0 &&
+	   ( export->page_set == GTK_PAGE_SET_ALL ||
+	   ( export->page_set == GTK_PAGE_SET_EVEN && export->sheet % 2 == 0 ) ||
+	   ( export->page_set == GTK_PAGE_SET_ODD && export->sheet % 2 == 1 ) ) ) ) {
+		ev_job_export_add_end_page (job);
 	}
 
-	ev_job_export_set_page (EV_JOB_EXPORT (export->job_export), export->page);
+	return TRUE;
+}
+
+static gboolean
+export_print_page (EvPrintOperationExport *export)
+{
+	gint i;
+
+	if (!export->temp_file)
+		return FALSE; /* cancelled */
+
+	for (i = 0; i < EXPORT_BATCH_SIZE && !export->exporting_end; i++)
+		export->exporting_end = !export_queue_page (export);
+
 	ev_job_scheduler_push_job (export->job_export, EV_JOB_PRIORITY_NONE);
 
 	update_progress (export);
@@ -1115,10 +1165,13 @@ ev_print_operation_export_begin (EvPrintOperationExport *export)
 	if (!export->temp_file)
 		return; /* cancelled */
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (op->document);
 	ev_file_exporter_begin (EV_FILE_EXPORTER (op->document), &export->fc);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (op->document);
 
+	export->exporter_open = TRUE;
+	export->exporting_end = FALSE;
+	export->start_time = g_get_monotonic_time ();
 	export->idle_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
 					   (GSourceFunc)export_print_page,
 					   export,
@@ -1717,7 +1770,7 @@ print_job_finished (EvJobPrint            *job,
 static gboolean
 draw_page_finish_idle (EvPrintOperationPrint *print)
 {
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        if (ev_job_scheduler_is_job_running (print->job_print))
                 return TRUE;
 
         gtk_print_operation_draw_page_finish (print->op);
@@ -1734,7 +1787,7 @@ print_job_cancelled (EvJobPrint            *job,
          * print operation. If the job is still
          * running, wait until it finishes.
          */
-        if (ev_job_scheduler_get_running_thread_job () == print->job_print)
+        if (ev_job_scheduler_is_job_running (print->job_print))
                 g_idle_add ((GSourceFunc)draw_page_finish_idle, print);
         else
                 gtk_print_operation_draw_page_finish (print->op);
@@ -1413,6 +1413,8 @@ ev_view_presentation_set_property (GObject      *object,
 	case PROP_DOCUMENT:
 		pview->document = g_value_dup_object (value);
 		pview->enable_animations = EV_IS_DOCUMENT_TRANSITION (pview->document);
+		/* Every page is scaled to fit according to its own size */
+		ev_document_complete_page_cache (pview->document);
 		break;
 	case PROP_CURRENT_PAGE:
 		ev_view_presentation_set_current_page (pview, g_value_get_uint (value));
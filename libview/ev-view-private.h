@@ -131,6 +131,8 @@ struct _EvView {
 	gsize pixbuf_cache_size;
 	EvPageCache *page_cache;
 	EvHeightToPageCache *height_to_page_cache;
+	EvJob *page_sizes_job;
+	gboolean first_paint_pending;
 	EvViewCursor cursor;
 	EvJobRender *current_job;
 
@@ -286,6 +288,9 @@ void _ev_view_transform_doc_rect_to_view_rect (EvView       *view,
 void _ev_view_get_selection_colors (EvView  *view,
                                     GdkRGBA *bg_color,
                                     GdkRGBA *fg_color);
+gboolean _ev_view_get_page_visible_area (EvView       *view,
+                                         gint          page,
+                                         GdkRectangle *area);
 gint _ev_view_get_caret_cursor_offset_at_doc_point (EvView *view,
                                                     gint    page,
                                                     gdouble doc_x,
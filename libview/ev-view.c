@@ -45,6 +45,8 @@
 #include "ev-view-accessible.h"
 #include "ev-view-private.h"
 #include "ev-view-type-builtins.h"
+#include "ev-job-scheduler.h"
+#include "ev-debug.h"
 
 enum {
 	SIGNAL_SCROLL,
@@ -114,6 +116,8 @@ static void       compute_border                             (EvView
 static void       get_page_y_offset                          (EvView             *view,
 							      int                 page,
 							      int                *y_offset);
+static gint       get_page_at_y_offset                       (EvView             *view,
+							      gint                y);
 static void       find_page_at_location                      (EvView             *view,
 							      gdouble             x,
 							      gdouble             y,
@@ -169,6 +173,7 @@ static gboolean   ev_view_leave_notify_event                 (GtkWidget
 							      GdkEventCrossing   *event);
 static void       ev_view_style_updated                      (GtkWidget          *widget);
 static void       ev_view_remove_all                         (EvView             *view);
+static void       ev_view_clear_page_sizes_job               (EvView             *view);
 
 static AtkObject *ev_view_get_accessible                     (GtkWidget *widget);
 
@@ -699,6 +704,7 @@ view_update_range_and_current_page (EvView *view)
 		gboolean found = FALSE;
 		gint area_max = -1, area;
 		gint best_current_page = -1;
+		gint n_pages;
 		int i, j = 0;
 
 		if (!(view->vadjustment && view->hadjustment))
@@ -709,10 +715,20 @@ view_update_range_and_current_page (EvView *view)
 		current_area.y = gtk_adjustment_get_value (view->vadjustment);
 		current_area.height = gtk_adjustment_get_page_size (view->vadjustment);
 
-		for (i = 0; i < ev_document_get_n_pages (view->document); i++) {
+		/* In dual mode the page found may be the right one of its row */
+		n_pages = ev_document_get_n_pages (view->document);
+		i = get_page_at_y_offset (view, current_area.y);
+		if (is_dual_page (view, NULL))
+			i = MAX (i - 1, 0);
+
+		for (; i < n_pages; i++) {
 
 			ev_view_get_page_extents (view, i, &page_area, &border);
 
+			/* Nothing below the visible area can be visible */
+			if (!found && page_area.y >= current_area.y + current_area.height)
+				break;
+
 			if (gdk_rectangle_intersect (&current_area, &page_area, &unused)) {
 				area = unused.width * unused.height;
 
@@ -910,11 +926,11 @@ compute_scroll_increment (EvView        *view,
 		doc_rect.x1 = doc_rect.x2 = rect.x + 0.5;
 		doc_rect.y1 = doc_rect.y2 = rect.y + 0.5;
 
-		ev_document_doc_mutex_lock ();
+		ev_document_lock (view->document);
 		sel_region = ev_selection_get_selection_region (EV_SELECTION (view->document),
 								rc, EV_SELECTION_STYLE_LINE,
 								&doc_rect);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (view->document);
 
 		g_object_unref (rc);
 
@@ -1171,6 +1187,35 @@ get_page_y_offset (EvView *view, int page, int *y_offset)
 	return;
 }
 
+/* Returns the last page whose top is at or above @y in continuous mode.
+ * Page offsets grow with the page index, so the page is found by
+ * bisecting them instead of walking the document from the first page.
+ */
+static gint
+get_page_at_y_offset (EvView *view,
+		      gint    y)
+{
+	gint low = 0;
+	gint high;
+
+	if (!view->height_to_page_cache)
+		return 0;
+
+	high = ev_document_get_n_pages (view->document) - 1;
+	while (low < high) {
+		gint mid = low + (high - low + 1) / 2;
+		gint offset;
+
+		get_page_y_offset (view, mid, &offset);
+		if (offset <= y)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	return low;
+}
+
 gboolean
 ev_view_get_page_extents (EvView       *view,
 			  gint          page,
@@ -1400,7 +1445,7 @@ find_page_at_location (EvView  *view,
 		       gint    *x_offset,
 		       gint    *y_offset)
 {
-	int i;
+	int i, last;
 
 	if (view->document == NULL)
 		return;
@@ -1409,7 +1454,17 @@ find_page_at_location (EvView  *view,
 	g_assert (x_offset);
 	g_assert (y_offset);
 
-	for (i = view->start_page; i >= 0 && i <= view->end_page; i++) {
+	i = view->start_page;
+	last = view->end_page;
+	if (view->continuous && i >= 0) {
+		gint p = get_page_at_y_offset (view, y);
+
+		/* The other page of a dual row shares its offset */
+		i = MAX (i, p - 1);
+		last = MIN (last, p + 1);
+	}
+
+	for (; i >= 0 && i <= last; i++) {
 		GdkRectangle page_area;
 		GtkBorder border;
 
@@ -2846,10 +2901,10 @@ ev_view_annotation_save_contents (EvView       *view,
 	if (!view->document)
 		return;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 	ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 						 annot, EV_ANNOTATIONS_SAVE_CONTENTS);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (view->document);
 }
 
 static GtkWidget *
@@ -3069,7 +3124,7 @@ ev_view_create_annotation (EvView          *view,
 	doc_rect.x2 = doc_rect.x1 + 24;
 	doc_rect.y2 = doc_rect.y1 + 24;
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 	page = ev_document_get_page (view->document, view->current_page);
 	switch (annot_type) {
 	case EV_ANNOTATION_TYPE_TEXT:
@@ -3078,7 +3133,7 @@ ev_view_create_annotation (EvView          *view,
 	case EV_ANNOTATION_TYPE_ATTACHMENT:
 		/* TODO */
 		g_object_unref (page);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (view->document);
 		return;
 	default:
 		g_assert_not_reached ();
@@ -3102,7 +3157,7 @@ ev_view_create_annotation (EvView          *view,
 	}
 	ev_document_annotations_add_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
 						annot, &doc_rect);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (view->document);
 
 	/* If the page didn't have annots, mark the cache as dirty */
 	if (!ev_page_cache_get_annot_mapping (view->page_cache, view->current_page))
@@ -3194,10 +3249,10 @@ ev_view_remove_annotation (EvView       *view,
         }
         _ev_view_set_focused_element (view, NULL, -1);
 
-        ev_document_doc_mutex_lock ();
+        ev_document_lock (view->document);
         ev_document_annotations_remove_annotation (EV_DOCUMENT_ANNOTATIONS (view->document),
                                                    annot);
-        ev_document_doc_mutex_unlock ();
+        ev_document_unlock (view->document);
 
         ev_page_cache_mark_dirty (view->page_cache, page, EV_PAGE_DATA_INCLUDE_ANNOTS);
 
@@ -4043,7 +4098,7 @@ ev_view_draw (GtkWidget      *widget,
 	EvView    *view = EV_VIEW (widget);
 	cairo_rectangle_int_t clip_rect;
 	GdkRectangle *area = &clip_rect;
-	gint       i;
+	gint       i, last;
 
 	gtk_render_background (gtk_widget_get_style_context (widget),
 			       cr,
@@ -4057,7 +4112,17 @@ ev_view_draw (GtkWidget      *widget,
 	if (!gdk_cairo_get_clip_rectangle (cr, &clip_rect))
 		return FALSE;
 
-	for (i = view->start_page; i >= 0 && i <= view->end_page; i++) {
+	/* Only draw the visible pages that intersect the clip area */
+	i = view->start_page;
+	last = view->end_page;
+	if (view->continuous && i >= 0) {
+		gint y = clip_rect.y + view->scroll_y;
+
+		i = MAX (i, get_page_at_y_offset (view, y) - 1);
+		last = MIN (last, get_page_at_y_offset (view, y + clip_rect.height) + 1);
+	}
+
+	for (; i >= 0 && i <= last; i++) {
 		GdkRectangle page_area;
 		GtkBorder border;
 		gboolean page_ready = TRUE;
@@ -4596,10 +4661,10 @@ ev_view_drag_data_get (GtkWidget        *widget,
 			if (view->image_dnd_info.image) {
 				GdkPixbuf *pixbuf;
 
-				ev_document_doc_mutex_lock ();
+				ev_document_lock (view->document);
 				pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (view->document),
 								       view->image_dnd_info.image);
-				ev_document_doc_mutex_unlock ();
+				ev_document_unlock (view->document);
 
 				gtk_selection_data_set_pixbuf (selection_data, pixbuf);
 				g_object_unref (pixbuf);
@@ -4611,10 +4676,10 @@ ev_view_drag_data_get (GtkWidget        *widget,
 				const gchar *tmp_uri;
 				gchar       *uris[2];
 
-				ev_document_doc_mutex_lock ();
+				ev_document_lock (view->document);
 				pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (view->document),
 								       view->image_dnd_info.image);
-				ev_document_doc_mutex_unlock ();
+				ev_document_unlock (view->document);
 
 				tmp_uri = ev_image_save_tmp (view->image_dnd_info.image, pixbuf);
 				g_object_unref (pixbuf);
@@ -5761,6 +5826,56 @@ _ev_view_get_selection_colors (EvView  *view,
 	gtk_style_context_restore (context);
 }
 
+/* The area of @page in view, in pixels of the page. For pages out of
+ * view, it's the area that comes into view first when scrolling to them */
+gboolean
+_ev_view_get_page_visible_area (EvView       *view,
+				gint          page,
+				GdkRectangle *area)
+{
+	GdkRectangle page_area;
+	GtkBorder    border;
+	gint         width, height;
+	gint         x, y, view_width, view_height;
+	gint         x1, x2, y1, y2;
+
+	if (!view->hadjustment || !view->vadjustment)
+		return FALSE;
+
+	ev_view_get_page_extents (view, page, &page_area, &border);
+	ev_view_get_page_size (view, page, &width, &height);
+
+	x = (gint) gtk_adjustment_get_value (view->hadjustment) - (page_area.x + border.left);
+	y = (gint) gtk_adjustment_get_value (view->vadjustment) - (page_area.y + border.top);
+	view_width = (gint) gtk_adjustment_get_page_size (view->hadjustment);
+	view_height = (gint) gtk_adjustment_get_page_size (view->vadjustment);
+
+	x1 = CLAMP (x, 0, width);
+	x2 = CLAMP (x + view_width, 0, width);
+	if (x1 == x2) {
+		x1 = 0;
+		x2 = MIN (width, view_width);
+	}
+
+	if (y + view_height <= 0) {
+		y1 = 0;
+		y2 = MIN (height, view_height);
+	} else if (y >= height) {
+		y1 = MAX (0, height - view_height);
+		y2 = height;
+	} else {
+		y1 = MAX (y, 0);
+		y2 = MIN (y + view_height, height);
+	}
+
+	area->x = x1;
+	area->y = y1;
+	area->width = x2 - x1;
+	area->height = y2 - y1;
+
+	return area->width > 0 && area->height > 0;
+}
+
 static void
 draw_selection_region (cairo_t        *cr,
                        cairo_region_t *region,
@@ -5830,6 +5945,8 @@ draw_one_page (EvView       *view,
 		cairo_surface_t *selection_surface = NULL;
 		gint offset_x, offset_y;
 		cairo_region_t *region = NULL;
+		GdkRectangle clip;
+		gboolean clipped;
 
 		page_surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
 
@@ -5849,7 +5966,30 @@ draw_one_page (EvView       *view,
 		offset_x = overlap.x - real_page_area.x;
 		offset_y = overlap.y - real_page_area.y;
 
-		draw_surface (cr, page_surface, overlap.x, overlap.y, offset_x, offset_y, width, height);
+		clipped = ev_pixbuf_cache_get_surface_clip (view->pixbuf_cache, page,
+							    width, height, &clip);
+		if (clipped) {
+			GdkRectangle clip_overlap;
+
+			/* Only part of the page was rendered */
+			clip.x += real_page_area.x;
+			clip.y += real_page_area.y;
+			if (gdk_rectangle_intersect (&clip, &overlap, &clip_overlap))
+				draw_surface (cr, page_surface, clip_overlap.x, clip_overlap.y,
+					      clip_overlap.x - clip.x, clip_overlap.y - clip.y,
+					      clip.width, clip.height);
+		} else {
+			draw_surface (cr, page_surface, overlap.x, overlap.y, offset_x, offset_y, width, height);
+		}
+
+		if (view->first_paint_pending) {
+			const gchar *uri;
+
+			uri = g_object_get_data (G_OBJECT (view->document), "first-paint-uri");
+			if (uri)
+				ev_profiler_stop (EV_PROFILE_JOBS, "First paint %s", uri);
+			view->first_paint_pending = FALSE;
+		}
 
 		/* Get the selection pixbuf iff we have something to draw */
 		if (!find_selection_for_page (view, page))
@@ -5872,13 +6012,18 @@ draw_one_page (EvView       *view,
 			GdkRGBA color;
 			double device_scale_x = 1, device_scale_y = 1;
 
-			scale_x = (gdouble)width / cairo_image_surface_get_width (page_surface);
-			scale_y = (gdouble)height / cairo_image_surface_get_height (page_surface);
+			if (clipped) {
+				/* The region is at the scale of the view */
+				scale_x = scale_y = 1.0;
+			} else {
+				scale_x = (gdouble)width / cairo_image_surface_get_width (page_surface);
+				scale_y = (gdouble)height / cairo_image_surface_get_height (page_surface);
 
-			cairo_surface_get_device_scale (page_surface, &device_scale_x, &device_scale_y);
+				cairo_surface_get_device_scale (page_surface, &device_scale_x, &device_scale_y);
 
-			scale_x *= device_scale_x;
-			scale_y *= device_scale_y;
+				scale_x *= device_scale_x;
+				scale_y *= device_scale_y;
+			}
 
 			_ev_view_get_selection_colors (view, &color, NULL);
 			draw_selection_region (cr, region, &color, real_page_area.x, real_page_area.y,
@@ -5939,6 +6084,8 @@ ev_view_dispose (GObject *object)
 		view->page_cache = NULL;
 	}
 
+	ev_view_clear_page_sizes_job (view);
+
 	ev_view_window_children_free (view);
 
 	if (view->selection_scroll_id) {
@@ -6635,6 +6782,79 @@ ev_view_new (void)
 	return view;
 }
 
+static void
+page_sizes_job_updated_cb (EvJobPageSizes *job,
+			   gdouble         progress,
+			   EvView         *view)
+{
+	GdkRectangle page_area;
+	GtkBorder    border;
+	gdouble      x, y, width, height;
+
+	if (!job->sizes_changed || !view->height_to_page_cache)
+		return;
+
+	/* Pages measured so far were laid out with an estimated size, keep
+	 * the point of the current page shown at the top left of the view.
+	 */
+	ev_view_get_page_extents (view, view->current_page, &page_area, &border);
+	get_doc_page_size (view, view->current_page, &width, &height);
+	x = MAX (view->scroll_x - page_area.x, 0) / view->scale;
+	y = MAX (view->scroll_y - page_area.y, 0) / view->scale;
+
+	switch (view->rotation) {
+	case 90:
+		view->pending_point.x = y;
+		view->pending_point.y = width - x;
+		break;
+	case 180:
+		view->pending_point.x = width - x;
+		view->pending_point.y = height - y;
+		break;
+	case 270:
+		view->pending_point.x = height - y;
+		view->pending_point.y = x;
+		break;
+	default:
+		view->pending_point.x = x;
+		view->pending_point.y = y;
+		break;
+	}
+
+	ev_view_build_height_to_page_cache (view, view->height_to_page_cache);
+	view->pending_scroll = SCROLL_TO_PAGE_POSITION;
+	gtk_widget_queue_resize (GTK_WIDGET (view));
+}
+
+static void
+ev_view_clear_page_sizes_job (EvView *view)
+{
+	if (!view->page_sizes_job)
+		return;
+
+	if (!ev_job_is_finished (view->page_sizes_job))
+		ev_job_cancel (view->page_sizes_job);
+
+	g_signal_handlers_disconnect_by_func (view->page_sizes_job,
+					      page_sizes_job_updated_cb,
+					      view);
+	g_object_unref (view->page_sizes_job);
+	view->page_sizes_job = NULL;
+}
+
+static void
+ev_view_ensure_page_sizes (EvView *view)
+{
+	if (ev_document_is_page_cache_complete (view->document))
+		return;
+
+	view->page_sizes_job = ev_job_page_sizes_new (view->document);
+	g_signal_connect (view->page_sizes_job, "updated",
+			  G_CALLBACK (page_sizes_job_updated_cb),
+			  view);
+	ev_job_scheduler_push_job (view->page_sizes_job, EV_JOB_PRIORITY_NONE);
+}
+
 static void
 setup_caches (EvView *view)
 {
@@ -6795,6 +7015,7 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 
 		ev_view_remove_all (view);
 		clear_caches (view);
+		ev_view_clear_page_sizes_job (view);
 
 		if (view->document) {
 			g_object_unref (view->document);
@@ -6810,6 +7031,8 @@ ev_view_document_changed_cb (EvDocumentModel *model,
 
 			ev_view_set_loading (view, FALSE);
 			setup_caches (view);
+			ev_view_ensure_page_sizes (view);
+			view->first_paint_pending = TRUE;
                 }
 
 		current_page = ev_document_model_get_page (model);
@@ -7920,7 +8143,7 @@ get_selected_text (EvView *view)
 
 	text = g_string_new (NULL);
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (view->document);
 
 	for (l = view->selection_info.selections; l != NULL; l = l->next) {
 		EvViewSelection *selection = (EvViewSelection *)l->data;
@@ -7936,7 +8159,7 @@ get_selected_text (EvView *view)
 		g_free (tmp);
 	}
 
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (view->document);
 
 	normalized_text = g_utf8_normalize (text->str, text->len, G_NORMALIZE_NFKC);
 	g_string_free (text, TRUE);
@@ -29,6 +29,10 @@ struct _EvMetadata {
 
 	GFile      *file;
 	GHashTable *items;
+
+	/* Keys changed since the last write */
+	GHashTable *dirty;
+	guint       flush_id;
 };
 
 struct _EvMetadataClass {
@@ -39,11 +43,24 @@ G_DEFINE_TYPE (EvMetadata, ev_metadata, G_TYPE_OBJECT)
 
 #define EV_METADATA_NAMESPACE "metadata::atril"
 
+/* Changes are written together once no other change was made for
+ * this long, in milliseconds */
+#define EV_METADATA_FLUSH_DELAY 500
+
+/* Number of changes that did not need a write of their own */
+static guint n_writes_saved = 0;
+
+static void ev_metadata_write (EvMetadata *metadata,
+			       gboolean    sync);
+
 static void
 ev_metadata_finalize (GObject *object)
 {
 	EvMetadata *metadata = EV_METADATA (object);
 
+	ev_metadata_write (metadata, TRUE);
+	g_hash_table_destroy (metadata->dirty);
+
 	if (metadata->items) {
 		g_hash_table_destroy (metadata->items);
 		metadata->items = NULL;
@@ -64,6 +81,10 @@ ev_metadata_init (EvMetadata *metadata)
 						 g_str_equal,
 						 g_free,
 						 g_free);
+	metadata->dirty = g_hash_table_new_full (g_str_hash,
+						 g_str_equal,
+						 g_free,
+						 NULL);
 }
 
 static void
@@ -172,38 +193,125 @@ metadata_set_callback (GObject      *file,
 	}
 }
 
+static void
+ev_metadata_write (EvMetadata *metadata,
+		   gboolean    sync)
+{
+	GFileInfo     *info;
+	GHashTableIter iter;
+	gpointer       key;
+	GError        *error = NULL;
+
+	if (metadata->flush_id > 0) {
+		g_source_remove (metadata->flush_id);
+		metadata->flush_id = 0;
+	}
+
+	if (g_hash_table_size (metadata->dirty) == 0)
+		return;
+
+	info = g_file_info_new ();
+
+	g_hash_table_iter_init (&iter, metadata->dirty);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		const gchar *value;
+		gchar       *gio_key;
+
+		value = g_hash_table_lookup (metadata->items, key);
+		gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
+		if (value) {
+			g_file_info_set_attribute_string (info, gio_key, value);
+		} else {
+			g_file_info_set_attribute (info, gio_key,
+						   G_FILE_ATTRIBUTE_TYPE_INVALID,
+						   NULL);
+		}
+		g_free (gio_key);
+	}
+	g_hash_table_remove_all (metadata->dirty);
+
+	if (sync) {
+		if (!g_file_set_attributes_from_info (metadata->file, info, 0, NULL, &error)) {
+			g_warning ("%s", error->message);
+			g_error_free (error);
+		}
+	} else {
+		g_file_set_attributes_async (metadata->file,
+					     info,
+					     0,
+					     G_PRIORITY_DEFAULT,
+					     NULL,
+					     (GAsyncReadyCallback)metadata_set_callback,
+					     metadata);
+	}
+	g_object_unref (info);
+}
+
+static gboolean
+ev_metadata_flush_timeout (EvMetadata *metadata)
+{
+	metadata->flush_id = 0;
+	ev_metadata_write (metadata, FALSE);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * ev_metadata_flush:
+ * @metadata: an #EvMetadata
+ *
+ * Writes the pending changes right away, instead of waiting for no
+ * other change to be made.
+ */
+void
+ev_metadata_flush (EvMetadata *metadata)
+{
+	g_return_if_fail (EV_IS_METADATA (metadata));
+
+	ev_metadata_write (metadata, TRUE);
+}
+
+/*
+ * ev_metadata_get_n_writes_saved:
+ *
+ * Returns: the number of changes, of all the #EvMetadata, that were
+ *   written together with other ones or not written at all, because
+ *   they did not change the value
+ */
+guint
+ev_metadata_get_n_writes_saved (void)
+{
+	return n_writes_saved;
+}
+
 gboolean
 ev_metadata_set_string (EvMetadata  *metadata,
 			const gchar *key,
 			const gchar *value)
 {
-	GFileInfo *info;
-	gchar     *gio_key;
+	if (!metadata->file) {
+		g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
+		return TRUE;
+	}
+
+	if (g_strcmp0 (g_hash_table_lookup (metadata->items, key), value) == 0 &&
+	    g_hash_table_contains (metadata->items, key)) {
+		n_writes_saved++;
+		return TRUE;
+	}
 
 	g_hash_table_insert (metadata->items, g_strdup (key), g_strdup (value));
-	if (!metadata->file)
-			return TRUE;
 
-	info = g_file_info_new ();
+	if (g_hash_table_size (metadata->dirty) > 0)
+		n_writes_saved++;
+	g_hash_table_add (metadata->dirty, g_strdup (key));
 
-	gio_key = g_strconcat (EV_METADATA_NAMESPACE"::", key, NULL);
-	if (value) {
-		g_file_info_set_attribute_string (info, gio_key, value);
-	} else {
-		g_file_info_set_attribute (info, gio_key,
-					   G_FILE_ATTRIBUTE_TYPE_INVALID,
-					   NULL);
-	}
-	g_free (gio_key);
-
-	g_file_set_attributes_async (metadata->file,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     (GAsyncReadyCallback)metadata_set_callback,
-				     metadata);
-	g_object_unref (info);
+	/* Wait for the changes to settle, like while scrolling or zooming */
+	if (metadata->flush_id > 0)
+		g_source_remove (metadata->flush_id);
+	metadata->flush_id = g_timeout_add (EV_METADATA_FLUSH_DELAY,
+					    (GSourceFunc)ev_metadata_flush_timeout,
+					    metadata);
 
 	return TRUE;
 }
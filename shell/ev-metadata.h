@@ -37,6 +37,8 @@ typedef struct _EvMetadataClass EvMetadataClass;
 GType       ev_metadata_get_type              (void) G_GNUC_CONST;
 EvMetadata *ev_metadata_new                   (GFile       *file);
 gboolean    ev_metadata_is_empty              (EvMetadata  *metadata);
+void        ev_metadata_flush                 (EvMetadata  *metadata);
+guint       ev_metadata_get_n_writes_saved    (void);
 
 gboolean    ev_metadata_get_string            (EvMetadata  *metadata,
 					       const gchar *key,
@@ -38,6 +38,7 @@ enum {
 	COLUMN_MARKUP,
 	COLUMN_ICON,
 	COLUMN_ANNOT_MAPPING,
+	COLUMN_MAPPING_LIST,
 	N_COLUMNS
 };
 
@@ -56,11 +57,13 @@ struct _EvSidebarAnnotationsPrivate {
 	GtkWidget *annot_text_item;
 
 	EvJob *job;
+	GtkTreeStore *model;
 	gulong selection_changed_id;
 };
 
 static void ev_sidebar_annotations_page_iface_init (EvSidebarPageInterface *iface);
 static void ev_sidebar_annotations_load            (EvSidebarAnnotations   *sidebar_annots);
+static void ev_sidebar_annotations_clear_job       (EvSidebarAnnotations   *sidebar_annots);
 
 static guint signals[N_SIGNALS] = { 0 };
 
@@ -78,6 +81,8 @@ ev_sidebar_annotations_dispose (GObject *object)
 	EvSidebarAnnotations *sidebar_annots = EV_SIDEBAR_ANNOTATIONS (object);
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+
 	if (priv->document) {
 		g_object_unref (priv->document);
 		priv->document = NULL;
@@ -97,7 +102,8 @@ ev_sidebar_annotations_create_simple_model (const gchar *message)
 	retval = (GtkTreeModel *)gtk_list_store_new (N_COLUMNS,
 						     G_TYPE_STRING,
 						     GDK_TYPE_PIXBUF,
-						     G_TYPE_POINTER);
+						     G_TYPE_POINTER,
+						     EV_TYPE_MAPPING_LIST);
 
 	gtk_list_store_append (GTK_LIST_STORE (retval), &iter);
 	markup = g_strdup_printf ("<span size=\"larger\" style=\"italic\">%s</span>",
@@ -324,8 +330,9 @@ selection_changed_cb (GtkTreeSelection     *selection,
 }
 
 static void
-job_finished_callback (EvJobAnnots          *job,
-		       EvSidebarAnnotations *sidebar_annots)
+job_updated_callback (EvJobAnnots          *job,
+		      GList                *annots,
+		      EvSidebarAnnotations *sidebar_annots)
 {
 	EvSidebarAnnotationsPrivate *priv;
 	GtkTreeStore *model;
@@ -335,35 +342,9 @@ job_finished_callback (EvJobAnnots          *job,
 	GdkPixbuf *attachment_icon = NULL;
 
 	priv = sidebar_annots->priv;
+	model = priv->model;
 
-	if (!job->annots) {
-		GtkTreeModel *list;
-
-		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
-		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
-		g_object_unref (list);
-
-		g_object_unref (job);
-		priv->job = NULL;
-
-		return;
-	}
-
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
-	gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
-	if (priv->selection_changed_id == 0) {
-		priv->selection_changed_id =
-			g_signal_connect (selection, "changed",
-					  G_CALLBACK (selection_changed_cb),
-					  sidebar_annots);
-	}
-
-	model = gtk_tree_store_new (N_COLUMNS,
-				    G_TYPE_STRING,
-				    GDK_TYPE_PIXBUF,
-				    G_TYPE_POINTER);
-
-	for (l = job->annots; l; l = g_list_next (l)) {
+	for (l = annots; l; l = g_list_next (l)) {
 		EvMappingList *mapping_list;
 		GList         *ll;
 		gchar         *page_label;
@@ -374,8 +355,10 @@ job_finished_callback (EvJobAnnots          *job,
 		page_label = g_strdup_printf (_("Page %d"),
 					      ev_mapping_list_get_page (mapping_list) + 1);
 		gtk_tree_store_append (model, &iter, NULL);
+		/* The rows of the page point to its mappings */
 		gtk_tree_store_set (model, &iter,
 				    COLUMN_MARKUP, page_label,
+				    COLUMN_MAPPING_LIST, mapping_list,
 				    -1);
 		g_free (page_label);
 
@@ -437,32 +420,80 @@ job_finished_callback (EvJobAnnots          *job,
 			gtk_tree_store_remove (model, &iter);
 	}
 
-	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
-				 GTK_TREE_MODEL (model));
-	g_object_unref (model);
-
 	if (text_icon)
 		g_object_unref (text_icon);
 	if (attachment_icon)
 		g_object_unref (attachment_icon);
 
-	g_object_unref (job);
-	priv->job = NULL;
+	/* Keep showing the previous annotations until there are new ones */
+	if (gtk_tree_view_get_model (GTK_TREE_VIEW (priv->tree_view)) == GTK_TREE_MODEL (model) ||
+	    gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), NULL) == 0)
+		return;
+
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
+	gtk_tree_selection_set_mode (selection, GTK_SELECTION_SINGLE);
+	if (priv->selection_changed_id == 0) {
+		priv->selection_changed_id =
+			g_signal_connect (selection, "changed",
+					  G_CALLBACK (selection_changed_cb),
+					  sidebar_annots);
+	}
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view),
+				 GTK_TREE_MODEL (model));
 }
 
 static void
-ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
+ev_sidebar_annotations_clear_job (EvSidebarAnnotations *sidebar_annots)
 {
 	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
 
 	if (priv->job) {
-		g_signal_handlers_disconnect_by_func (priv->job,
-						      job_finished_callback,
-						      sidebar_annots);
+		if (!ev_job_is_finished (priv->job))
+			ev_job_cancel (priv->job);
+
+		g_signal_handlers_disconnect_by_data (priv->job, sidebar_annots);
 		g_object_unref (priv->job);
+		priv->job = NULL;
 	}
 
+	g_clear_object (&priv->model);
+}
+
+static void
+job_finished_callback (EvJobAnnots          *job,
+		       EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	if (gtk_tree_model_iter_n_children (GTK_TREE_MODEL (priv->model), NULL) == 0) {
+		GtkTreeModel *list;
+
+		list = ev_sidebar_annotations_create_simple_model (_("Document contains no annotations"));
+		gtk_tree_view_set_model (GTK_TREE_VIEW (priv->tree_view), list);
+		g_object_unref (list);
+	}
+
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+}
+
+static void
+ev_sidebar_annotations_load (EvSidebarAnnotations *sidebar_annots)
+{
+	EvSidebarAnnotationsPrivate *priv = sidebar_annots->priv;
+
+	ev_sidebar_annotations_clear_job (sidebar_annots);
+
+	priv->model = gtk_tree_store_new (N_COLUMNS,
+					  G_TYPE_STRING,
+					  GDK_TYPE_PIXBUF,
+					  G_TYPE_POINTER,
+					  EV_TYPE_MAPPING_LIST);
+
 	priv->job = ev_job_annots_new (priv->document);
+	g_signal_connect (priv->job, "updated",
+			  G_CALLBACK (job_updated_callback),
+			  sidebar_annots);
 	g_signal_connect (priv->job, "finished",
 			  G_CALLBACK (job_finished_callback),
 			  sidebar_annots);
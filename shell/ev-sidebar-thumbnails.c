@@ -886,6 +886,17 @@ thumbnail_job_completed_callback (EvJobThumbnail      *job,
 	GtkTreeIter *iter;
 
 	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
+	if (ev_job_is_failed (EV_JOB (job))) {
+		/* Keep the loading icon rather than asking again */
+		g_warning ("%s", EV_JOB (job)->error->message);
+		gtk_list_store_set (priv->list_store,
+				    iter,
+				    COLUMN_THUMBNAIL_SET, TRUE,
+				    COLUMN_JOB, NULL,
+				    -1);
+		return;
+	}
+
 	if (priv->inverted_colors && priv->document->iswebdocument == FALSE)
 		ev_document_misc_invert_pixbuf (job->thumbnail);
 	gtk_list_store_set (priv->list_store,
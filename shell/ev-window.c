@@ -59,6 +59,7 @@
 #include "ev-document-links.h"
 #include "ev-document-thumbnails.h"
 #include "ev-document-annotations.h"
+#include "ev-document-text.h"
 #include "ev-document-type-builtins.h"
 #include "ev-document-misc.h"
 #include "ev-file-exporter.h"
@@ -222,6 +223,8 @@ struct _EvWindowPrivate {
 	EvJob            *thumbnail_job;
 	EvJob            *save_job;
 	EvJob            *find_job;
+	EvJob            *text_index_job;
+	EvTextIndex      *text_index;
 
 	/* Printing */
 	GQueue           *print_queue;
@@ -262,7 +265,9 @@ struct _EvWindowPrivate {
 #define GS_SCHEMA_NAME           "org.mate.Atril"
 #define GS_OVERRIDE_RESTRICTIONS "override-restrictions"
 #define GS_PAGE_CACHE_SIZE       "page-cache-size"
+#define GS_RENDER_THREADS        "render-threads"
 #define GS_AUTO_RELOAD           "auto-reload"
+#define GS_TEXT_INDEX            "text-index"
 #define GS_LAST_DOCUMENT_DIRECTORY "document-directory"
 #define GS_LAST_PICTURES_DIRECTORY "pictures-directory"
 
@@ -1416,6 +1421,7 @@ setup_document_from_metadata (EvWindow *window)
 		gint       monitor_width;
 		gint       monitor_height;
 
+		ev_document_complete_page_cache (window->priv->document);
 		ev_document_get_max_page_size (window->priv->document,
 					       &document_width, &document_height);
 
@@ -1527,6 +1533,14 @@ page_cache_size_changed (GSettings *settings,
 				     page_cache_mb * 1024 * 1024);
 }
 
+static void
+render_threads_changed (GSettings *settings,
+			gchar     *key,
+			EvWindow  *ev_window)
+{
+	ev_job_scheduler_set_max_threads (g_settings_get_uint (settings, GS_RENDER_THREADS));
+}
+
 static void
 ev_window_setup_default (EvWindow *ev_window)
 {
@@ -1668,6 +1682,10 @@ ev_window_ensure_settings (EvWindow *ev_window)
 			  "changed::"GS_PAGE_CACHE_SIZE,
 			  G_CALLBACK (page_cache_size_changed),
 			  ev_window);
+        g_signal_connect (priv->settings,
+			  "changed::"GS_RENDER_THREADS,
+			  G_CALLBACK (render_threads_changed),
+			  ev_window);
 
         return priv->settings;
 }
@@ -1680,6 +1698,59 @@ interface_changed (GSettings *settings,
 	ev_window_setup_toolbar_flags (ev_window);
 }
 
+static void
+ev_window_text_index_job_finished_cb (EvJobTextIndex *job,
+				      EvWindow       *ev_window)
+{
+	EvTextIndex *index = ev_job_text_index_get_index (job);
+
+	if (index)
+		ev_window->priv->text_index = ev_text_index_ref (index);
+}
+
+static void
+ev_window_clear_text_index_job (EvWindow *ev_window)
+{
+	if (ev_window->priv->text_index_job != NULL) {
+		if (!ev_job_is_finished (ev_window->priv->text_index_job))
+			ev_job_cancel (ev_window->priv->text_index_job);
+
+		g_signal_handlers_disconnect_by_func (ev_window->priv->text_index_job,
+						      ev_window_text_index_job_finished_cb,
+						      ev_window);
+		g_object_unref (ev_window->priv->text_index_job);
+		ev_window->priv->text_index_job = NULL;
+	}
+
+	if (ev_window->priv->text_index != NULL) {
+		ev_text_index_unref (ev_window->priv->text_index);
+		ev_window->priv->text_index = NULL;
+	}
+}
+
+/* Loads or builds the full-text index of the document, used to skip
+ * the pages that can't contain the search string */
+static void
+ev_window_setup_text_index (EvWindow *ev_window)
+{
+	EvDocument *document = ev_window->priv->document;
+
+	ev_window_clear_text_index_job (ev_window);
+
+	if (!ev_window->priv->uri ||
+	    document->iswebdocument ||
+	    !EV_IS_DOCUMENT_TEXT (document) ||
+	    !EV_IS_DOCUMENT_FIND (document) ||
+	    !g_settings_get_boolean (ev_window->priv->settings, GS_TEXT_INDEX))
+		return;
+
+	ev_window->priv->text_index_job = ev_job_text_index_new (document, ev_window->priv->uri);
+	g_signal_connect (ev_window->priv->text_index_job, "finished",
+			  G_CALLBACK (ev_window_text_index_job_finished_cb),
+			  ev_window);
+	ev_job_scheduler_push_job (ev_window->priv->text_index_job, EV_JOB_PRIORITY_NONE);
+}
+
 static gboolean
 ev_window_setup_document (EvWindow *ev_window)
 {
@@ -1728,6 +1799,8 @@ ev_window_setup_document (EvWindow *ev_window)
 	info = ev_document_get_info (document);
 	update_document_mode (ev_window, info->mode);
 
+	ev_window_setup_text_index (ev_window);
+
 	if (EV_IS_DOCUMENT_FIND (document)) {
 		if (ev_window->priv->search_string &&
 		    !EV_WINDOW_IS_PRESENTATION (ev_window)) {
@@ -2399,8 +2472,11 @@ ev_window_open_uri (EvWindow       *ev_window,
 		g_free (ev_window->priv->uri);
 	ev_window->priv->uri = g_strdup (uri);
 
-	if (ev_window->priv->metadata)
+	if (ev_window->priv->metadata) {
+		/* The new document may be the same file */
+		ev_metadata_flush (ev_window->priv->metadata);
 		g_object_unref (ev_window->priv->metadata);
+	}
 	if (ev_window->priv->bookmarks)
 		g_object_unref (ev_window->priv->bookmarks);
 
@@ -5880,12 +5956,17 @@ ev_window_search_start (EvWindow *ev_window)
 {
 	EggFindBar *find_bar = EGG_FIND_BAR (ev_window->priv->find_bar);
 	const char *search_string;
+	EvJob      *previous_job = NULL;
 
 	if (!ev_window->priv->document || !EV_IS_DOCUMENT_FIND (ev_window->priv->document))
 		return;
 
 	search_string = egg_find_bar_get_search_string (find_bar);
 
+	/* The pages where the previous search found nothing can be
+	 * skipped when the search string was only extended */
+	if (ev_window->priv->find_job)
+		previous_job = g_object_ref (ev_window->priv->find_job);
 	ev_window_clear_find_job (ev_window);
 
 	if (search_string && search_string[0]) {
@@ -5894,6 +5975,12 @@ ev_window_search_start (EvWindow *ev_window)
 							     ev_document_get_n_pages (ev_window->priv->document),
 							     search_string,
 							     egg_find_bar_get_case_sensitive (find_bar));
+		if (ev_window->priv->text_index)
+			ev_job_find_set_text_index (EV_JOB_FIND (ev_window->priv->find_job),
+						    ev_window->priv->text_index);
+		if (previous_job)
+			ev_job_find_set_previous (EV_JOB_FIND (ev_window->priv->find_job),
+						  EV_JOB_FIND (previous_job));
 
 		g_signal_connect (ev_window->priv->find_job, "finished",
 				  G_CALLBACK (ev_window_find_job_finished_cb),
@@ -5909,6 +5996,9 @@ ev_window_search_start (EvWindow *ev_window)
 			gtk_widget_queue_draw (GTK_WIDGET (ev_window->priv->view));
 		}
 	}
+
+	if (previous_job)
+		g_object_unref (previous_job);
 }
 
 static void
@@ -5972,6 +6062,7 @@ zoom_control_changed_cb (EphyZoomAction *action,
 	if (zoom == EPHY_ZOOM_EXPAND_WINDOW_TO_FIT) {
 		window = GTK_WINDOW (ev_window);
 
+		ev_document_complete_page_cache (ev_window->priv->document);
 		ev_document_get_max_page_size (ev_window->priv->document, &doc_width, &doc_height);
 		scale = ev_document_model_get_scale (ev_window->priv->model);
 
@@ -6186,6 +6277,7 @@ ev_window_dispose (GObject *object)
 	}
 
 	if (priv->metadata) {
+		ev_metadata_flush (priv->metadata);
 		g_object_unref (priv->metadata);
 		priv->metadata = NULL;
 	}
@@ -6313,6 +6405,8 @@ ev_window_dispose (GObject *object)
 		ev_window_clear_find_job (window);
 	}
 
+	ev_window_clear_text_index_job (window);
+
 	if (priv->local_uri) {
 		ev_window_clear_local_uri (window);
 		priv->local_uri = NULL;
@@ -6963,11 +7057,15 @@ window_configure_event_cb (EvWindow *window, GdkEventConfigure *event, gpointer
 
 	if (!(state & GDK_WINDOW_STATE_FULLSCREEN)) {
 		if (window->priv->document) {
-			ev_document_get_max_page_size (window->priv->document,
-						       &document_width, &document_height);
-			g_settings_set (window->priv->default_settings, "window-ratio", "(dd)",
-					(double)event->width / document_width,
-					(double)event->height / document_height);
+			/* Until every page is measured the largest size is only
+			 * an estimate, the ratio is saved on a later event */
+			if (ev_document_is_page_cache_complete (window->priv->document)) {
+				ev_document_get_max_page_size (window->priv->document,
+							       &document_width, &document_height);
+				g_settings_set (window->priv->default_settings, "window-ratio", "(dd)",
+						(double)event->width / document_width,
+						(double)event->height / document_height);
+			}
 
 			ev_metadata_set_int (window->priv->metadata, "window_x", event->x);
 			ev_metadata_set_int (window->priv->metadata, "window_y", event->y);
@@ -7297,10 +7395,10 @@ image_save_dialog_response_cb (GtkWidget *fc,
                         goto has_error;
 	}
 
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (ev_window->priv->document);
 	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (ev_window->priv->document),
 					       ev_window->priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (ev_window->priv->document);
 
 	file_format = gdk_pixbuf_format_get_name (format);
 	gdk_pixbuf_save (pixbuf, filename, file_format, &error, NULL);
@@ -7378,10 +7476,10 @@ ev_view_popup_cmd_copy_image (GtkAction *action, EvWindow *window)
 
 	clipboard = gtk_widget_get_clipboard (GTK_WIDGET (window),
 					      GDK_SELECTION_CLIPBOARD);
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (window->priv->document);
 	pixbuf = ev_document_images_get_image (EV_DOCUMENT_IMAGES (window->priv->document),
 					       window->priv->image);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (window->priv->document);
 
 	gtk_clipboard_set_image (clipboard, pixbuf);
 	g_object_unref (pixbuf);
@@ -7438,11 +7536,11 @@ ev_view_popup_cmd_annot_properties (GtkAction *action,
 	}
 
 	if (mask != EV_ANNOTATIONS_SAVE_NONE) {
-		ev_document_doc_mutex_lock ();
+		ev_document_lock (window->priv->document);
 		ev_document_annotations_save_annotation (EV_DOCUMENT_ANNOTATIONS (window->priv->document),
 							 window->priv->annot,
 							 mask);
-		ev_document_doc_mutex_unlock ();
+		ev_document_unlock (window->priv->document);
 
 		/* FIXME: update annot region only */
 		ev_view_reload (EV_VIEW (window->priv->view));
@@ -8108,6 +8206,8 @@ ev_window_init (EvWindow *ev_window)
 					     GS_PAGE_CACHE_SIZE);
 	ev_view_set_page_cache_size (EV_VIEW (ev_window->priv->view),
 				     page_cache_mb * 1024 * 1024);
+	ev_job_scheduler_set_max_threads (g_settings_get_uint (ev_window->priv->settings,
+							       GS_RENDER_THREADS));
 	ev_view_set_model (EV_VIEW (ev_window->priv->view), ev_window->priv->model);
 
 	ev_window->priv->password_view = ev_password_view_new (GTK_WINDOW (ev_window));
@@ -0,0 +1,78 @@
+#!/usr/bin/python3
+
+# Measures the time from the start of loading a document to the first page
+# being drawn, for generated PDF files with an increasing number of pages.
+#
+# Needs an atril built with --enable-debug and a display:
+#
+#   ./first-paint.py [atril] [pages...]
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+def generate_pdf(filename, n_pages):
+    # Every seventh page is landscape so the document isn't uniform,
+    # and the first pages have roman page labels.
+    # Objects 1-3 are the catalog, the page tree and the font, then
+    # every page is followed by its content stream.
+    objects = []
+    kids = ['%d 0 R' % (4 + 2 * i) for i in range(n_pages)]
+
+    objects.append('<< /Type /Catalog /Pages 2 0 R /PageLabels << /Nums [0 << /S /r >> 10 << /S /D >>] >> >>')
+    objects.append('<< /Type /Pages /Kids [%s] /Count %d >>' % (' '.join(kids), n_pages))
+    objects.append('<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>')
+
+    for i in range(n_pages):
+        media_box = '0 0 842 595' if i % 7 == 6 else '0 0 595 842'
+        stream = 'BT /F1 48 Tf 72 400 Td (Page %d) Tj ET' % (i + 1)
+        objects.append('<< /Type /Page /Parent 2 0 R /MediaBox [%s] '
+                       '/Resources << /Font << /F1 3 0 R >> >> /Contents %d 0 R >>' %
+                       (media_box, 5 + 2 * i))
+        objects.append('<< /Length %d >>\nstream\n%s\nendstream' % (len(stream), stream))
+
+    with open(filename, 'wb') as f:
+        offsets = []
+        f.write(b'%PDF-1.4\n')
+        for i, obj in enumerate(objects):
+            offsets.append(f.tell())
+            f.write(('%d 0 obj\n%s\nendobj\n' % (i + 1, obj)).encode('ascii'))
+        xref = f.tell()
+        f.write(('xref\n0 %d\n0000000000 65535 f \n' % (len(objects) + 1)).encode('ascii'))
+        for offset in offsets:
+            f.write(('%010d 00000 n \n' % offset).encode('ascii'))
+        f.write(('trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n' %
+                 (len(objects) + 1, xref)).encode('ascii'))
+
+def first_paint(atril, filename, timeout=120):
+    env = dict(os.environ, EV_PROFILE_JOBS='1', LANG='C')
+    proc = subprocess.Popen([atril, filename], env=env,
+                            stdout=subprocess.PIPE, universal_newlines=True)
+    deadline = time.time() + timeout
+    seconds = None
+    try:
+        for line in proc.stdout:
+            if line.startswith('[ First paint '):
+                seconds = float(line.split(']')[1].split()[0])
+                break
+            if time.time() > deadline:
+                break
+    finally:
+        proc.terminate()
+        proc.wait()
+    return seconds
+
+atril = sys.argv[1] if len(sys.argv) > 1 else 'atril'
+sizes = [int(n) for n in sys.argv[2:]] or [100, 1000, 10000, 20000]
+
+with tempfile.TemporaryDirectory() as tmpdir:
+    for n_pages in sizes:
+        filename = os.path.join(tmpdir, 'pages-%d.pdf' % n_pages)
+        generate_pdf(filename, n_pages)
+        seconds = first_paint(atril, filename)
+        if seconds is None:
+            print('%6d pages: no first paint reported' % n_pages)
+        else:
+            print('%6d pages: %f s to first paint' % (n_pages, seconds))
@@ -0,0 +1,132 @@
+#!/usr/bin/python3
+
+# Generates large synthetic documents for render-benchmark: a PDF with
+# thousands of text pages, a multipage TIFF with big stripped pages and
+# a CBZ of PNG pages.
+#
+#   ./generate-bench-inputs.py [directory] [pdf pages]
+
+import os
+import struct
+import sys
+import zipfile
+import zlib
+
+TEXT = 'The quick brown fox jumps over the lazy dog.'
+
+def generate_pdf(filename, n_pages):
+    # Objects 1-3 are the catalog, the page tree and the font, then
+    # every page is followed by its content stream.
+    objects = []
+    kids = ['%d 0 R' % (4 + 2 * i) for i in range(n_pages)]
+
+    objects.append('<< /Type /Catalog /Pages 2 0 R >>')
+    objects.append('<< /Type /Pages /Kids [%s] /Count %d >>' % (' '.join(kids), n_pages))
+    objects.append('<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>')
+
+    for i in range(n_pages):
+        lines = ['BT /F1 11 Tf 14 TL 72 770 Td (Page %d) Tj' % (i + 1)]
+        lines += ['T* (%s) Tj' % TEXT] * 48
+        lines.append('ET')
+        stream = '\n'.join(lines)
+        objects.append('<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] '
+                       '/Resources << /Font << /F1 3 0 R >> >> /Contents %d 0 R >>' %
+                       (5 + 2 * i))
+        objects.append('<< /Length %d >>\nstream\n%s\nendstream' % (len(stream), stream))
+
+    with open(filename, 'wb') as f:
+        offsets = []
+        f.write(b'%PDF-1.4\n')
+        for i, obj in enumerate(objects):
+            offsets.append(f.tell())
+            f.write(('%d 0 obj\n%s\nendobj\n' % (i + 1, obj)).encode('ascii'))
+        xref = f.tell()
+        f.write(('xref\n0 %d\n0000000000 65535 f \n' % (len(objects) + 1)).encode('ascii'))
+        for offset in offsets:
+            f.write(('%010d 00000 n \n' % offset).encode('ascii'))
+        f.write(('trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n' %
+                 (len(objects) + 1, xref)).encode('ascii'))
+
+def gradient_row(width, y, page):
+    # A diagonal RGB gradient that differs between pages
+    row = bytearray(width * 3)
+    for x in range(0, width, 64):
+        r, g, b = (x + page * 40) & 0xff, y & 0xff, (x + y) & 0xff
+        n = min(64, width - x)
+        row[x * 3:(x + n) * 3] = bytes((r, g, b)) * n
+    return bytes(row)
+
+def generate_tiff(filename, n_pages, width, height, rows_per_strip=64):
+    # Little endian, uncompressed RGB, one IFD per page written after
+    # the page's strips.
+    with open(filename, 'wb') as f:
+        f.write(b'II*\0\0\0\0\0')
+        next_ifd_offset = 4
+        for page in range(n_pages):
+            strip_offsets = []
+            strip_counts = []
+            for y0 in range(0, height, rows_per_strip):
+                rows = min(rows_per_strip, height - y0)
+                strip_offsets.append(f.tell())
+                strip_counts.append(rows * width * 3)
+                for y in range(y0, y0 + rows):
+                    f.write(gradient_row(width, y, page))
+
+            n_strips = len(strip_offsets)
+            arrays_offset = f.tell()
+            f.write(struct.pack('<%dI' % n_strips, *strip_offsets))
+            f.write(struct.pack('<%dI' % n_strips, *strip_counts))
+            bits_offset = f.tell()
+            f.write(struct.pack('<3H', 8, 8, 8))
+            if f.tell() % 2:
+                f.write(b'\0')
+
+            ifd_offset = f.tell()
+            f.seek(next_ifd_offset)
+            f.write(struct.pack('<I', ifd_offset))
+            f.seek(ifd_offset)
+
+            entries = [
+                (256, 4, 1, width),                   # ImageWidth
+                (257, 4, 1, height),                  # ImageLength
+                (258, 3, 3, bits_offset),             # BitsPerSample
+                (259, 3, 1, 1),                       # Compression: none
+                (262, 3, 1, 2),                       # Photometric: RGB
+                (273, 4, n_strips, arrays_offset),    # StripOffsets
+                (277, 3, 1, 3),                       # SamplesPerPixel
+                (278, 4, 1, rows_per_strip),          # RowsPerStrip
+                (279, 4, n_strips, arrays_offset + 4 * n_strips), # StripByteCounts
+                (284, 3, 1, 1),                       # PlanarConfig: contig
+            ]
+            f.write(struct.pack('<H', len(entries)))
+            for tag, type_, count, value in entries:
+                if type_ == 3 and count == 1:
+                    f.write(struct.pack('<HHIHH', tag, type_, count, value, 0))
+                else:
+                    f.write(struct.pack('<HHII', tag, type_, count, value))
+            next_ifd_offset = f.tell()
+            f.write(struct.pack('<I', 0))
+
+def png_chunk(kind, data):
+    chunk = kind + data
+    return struct.pack('>I', len(data)) + chunk + struct.pack('>I', zlib.crc32(chunk) & 0xffffffff)
+
+def generate_png(width, height, page):
+    raw = b''.join(b'\0' + gradient_row(width, y, page) for y in range(height))
+    return (b'\x89PNG\r\n\x1a\n' +
+            png_chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)) +
+            png_chunk(b'IDAT', zlib.compress(raw, 6)) +
+            png_chunk(b'IEND', b''))
+
+def generate_cbz(filename, n_pages, width, height):
+    with zipfile.ZipFile(filename, 'w', zipfile.ZIP_STORED) as cbz:
+        for page in range(n_pages):
+            cbz.writestr('page-%04d.png' % (page + 1), generate_png(width, height, page))
+
+directory = sys.argv[1] if len(sys.argv) > 1 else '.'
+pdf_pages = int(sys.argv[2]) if len(sys.argv) > 2 else 5000
+
+os.makedirs(directory, exist_ok=True)
+generate_pdf(os.path.join(directory, 'bench-%d-pages.pdf' % pdf_pages), pdf_pages)
+generate_tiff(os.path.join(directory, 'bench-large.tiff'), 3, 5000, 4000)
+generate_cbz(os.path.join(directory, 'bench-comic.cbz'), 200, 1600, 2400)
@@ -0,0 +1,130 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * Copyright (C) 2024 Atril Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Measures hit-testing in a page with many links, comparing
+ * ev_mapping_list_get() with a linear search of the list.
+ *
+ *   make -C test mapping-list-benchmark
+ *   ./test/mapping-list-benchmark [n-mappings] [n-queries]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include "ev-mapping-list.h"
+
+#define PAGE_WIDTH  612.0
+#define PAGE_HEIGHT 792.0
+
+static GList *
+create_mappings (guint n_mappings)
+{
+	GList *list = NULL;
+	guint  i;
+
+	/* Rows of words, like the links of a data sheet index */
+	for (i = 0; i < n_mappings; i++) {
+		EvMapping *mapping = g_new (EvMapping, 1);
+
+		mapping->area.x1 = g_random_double_range (0, PAGE_WIDTH - 60);
+		mapping->area.y1 = g_random_double_range (0, PAGE_HEIGHT - 10);
+		mapping->area.x2 = mapping->area.x1 + g_random_double_range (5, 60);
+		mapping->area.y2 = mapping->area.y1 + g_random_double_range (5, 10);
+		mapping->data = g_strdup_printf ("link %u", i);
+
+		list = g_list_prepend (list, mapping);
+	}
+
+	return g_list_reverse (list);
+}
+
+static EvMapping *
+linear_get (GList  *list,
+	    gdouble x,
+	    gdouble y)
+{
+	for (; list; list = list->next) {
+		EvMapping *mapping = list->data;
+
+		if (x >= mapping->area.x1 && y >= mapping->area.y1 &&
+		    x <= mapping->area.x2 && y <= mapping->area.y2)
+			return mapping;
+	}
+
+	return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+	EvMappingList *mapping_list;
+	EvPoint       *points;
+	GTimer        *timer;
+	guint          n_mappings = argc > 1 ? atoi (argv[1]) : 10000;
+	guint          n_queries = argc > 2 ? atoi (argv[2]) : 100000;
+	guint          i, n_hits = 0;
+	gdouble        build_time, indexed_time, linear_time;
+
+	g_random_set_seed (1);
+
+	points = g_new (EvPoint, n_queries);
+	for (i = 0; i < n_queries; i++) {
+		points[i].x = g_random_double_range (0, PAGE_WIDTH);
+		points[i].y = g_random_double_range (0, PAGE_HEIGHT);
+	}
+
+	timer = g_timer_new ();
+	mapping_list = ev_mapping_list_new (0, create_mappings (n_mappings), g_free);
+	g_timer_start (timer);
+	ev_mapping_list_build_index (mapping_list);
+	build_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (i = 0; i < n_queries; i++) {
+		if (ev_mapping_list_get (mapping_list, points[i].x, points[i].y))
+			n_hits++;
+	}
+	indexed_time = g_timer_elapsed (timer, NULL);
+
+	g_timer_start (timer);
+	for (i = 0; i < n_queries; i++)
+		linear_get (ev_mapping_list_get_list (mapping_list), points[i].x, points[i].y);
+	linear_time = g_timer_elapsed (timer, NULL);
+
+	/* Both must find the first mapping of the list at every point */
+	for (i = 0; i < n_queries; i++) {
+		if (linear_get (ev_mapping_list_get_list (mapping_list), points[i].x, points[i].y) !=
+		    ev_mapping_list_get (mapping_list, points[i].x, points[i].y)) {
+			g_printerr ("Different mappings found at %f, %f\n", points[i].x, points[i].y);
+			return 1;
+		}
+	}
+
+	g_print ("%u mappings, %u queries, %u hits\n", n_mappings, n_queries, n_hits);
+	g_print ("  index build:  %f ms\n", build_time * 1000);
+	g_print ("  indexed get:  %f us/query\n", indexed_time * 1e6 / n_queries);
+	g_print ("  linear get:   %f us/query\n", linear_time * 1e6 / n_queries);
+
+	g_timer_destroy (timer);
+	g_free (points);
+	ev_mapping_list_unref (mapping_list);
+
+	return 0;
+}
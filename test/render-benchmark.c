@@ -0,0 +1,405 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * Copyright (C) 2024 Atril Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Headless benchmark of the document backends. For every document it
+ * times loading, rendering pages at several scales and rotations,
+ * thumbnails, text extraction and find, and prints one JSON object per
+ * document with percentiles of each measure, in milliseconds, and the
+ * peak resident set size. Every document is measured in a child process
+ * so that its peak isn't hidden by the ones of the documents before it.
+ *
+ *   make -C test render-benchmark
+ *   ./test/generate-bench-inputs.py /tmp/bench
+ *   ./test/render-benchmark /tmp/bench/*
+ *
+ * The backends are loaded from the installed backends directory.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "ev-backends-manager.h"
+#include "ev-document-factory.h"
+#include "ev-document-find.h"
+#include "ev-document-text.h"
+#include "ev-document-thumbnails.h"
+#include "ev-init.h"
+#include "ev-render-context.h"
+
+#define THUMBNAIL_WIDTH 100
+
+static gchar   *scales_str = NULL;
+static gchar   *rotations_str = NULL;
+static gchar   *find_text = NULL;
+static gint     max_pages = 20;
+static gint     repeat = 3;
+static gchar  **files = NULL;
+
+static const GOptionEntry options[] = {
+	{ "scales", 's', 0, G_OPTION_ARG_STRING, &scales_str,
+	  "Comma separated scales to render at (default: 0.25,1,2)", "SCALES" },
+	{ "rotations", 'r', 0, G_OPTION_ARG_STRING, &rotations_str,
+	  "Comma separated rotations to render with (default: 0,90)", "ROTATIONS" },
+	{ "max-pages", 'n', 0, G_OPTION_ARG_INT, &max_pages,
+	  "Number of pages, evenly spread over the document, to measure (default: 20)", "N" },
+	{ "repeat", 'R', 0, G_OPTION_ARG_INT, &repeat,
+	  "Number of times every page is measured (default: 3)", "N" },
+	{ "find", 'f', 0, G_OPTION_ARG_STRING, &find_text,
+	  "Text to find (default: the)", "TEXT" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL, "FILE…" },
+	{ NULL }
+};
+
+static glong
+get_peak_rss (void)
+{
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return -1;
+
+	/* Kilobytes on Linux */
+	return usage.ru_maxrss;
+}
+
+static gint
+compare_doubles (gconstpointer a,
+		 gconstpointer b)
+{
+	gdouble da = *(const gdouble *) a;
+	gdouble db = *(const gdouble *) b;
+
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static gdouble
+percentile (GArray *samples,
+	    gdouble p)
+{
+	guint i;
+
+	i = (guint) (p / 100.0 * (samples->len - 1) + 0.5);
+
+	return g_array_index (samples, gdouble, i);
+}
+
+/* Appends "name": { percentiles } to @json and frees @samples */
+static void
+append_stats (GString     *json,
+	      const gchar *name,
+	      GArray      *samples)
+{
+	if (samples->len == 0) {
+		g_array_free (samples, TRUE);
+		return;
+	}
+
+	g_array_sort (samples, compare_doubles);
+	g_string_append_printf (json,
+				", \"%s\": { \"n\": %u, \"p50\": %.3f, \"p90\": %.3f, "
+				"\"p99\": %.3f, \"max\": %.3f }",
+				name, samples->len,
+				percentile (samples, 50),
+				percentile (samples, 90),
+				percentile (samples, 99),
+				g_array_index (samples, gdouble, samples->len - 1));
+	g_array_free (samples, TRUE);
+}
+
+static void
+add_sample (GArray *samples,
+	    GTimer *timer)
+{
+	gdouble ms = g_timer_elapsed (timer, NULL) * 1000;
+
+	g_array_append_val (samples, ms);
+}
+
+static GArray *
+parse_list (const gchar *str)
+{
+	GArray *values = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	gchar **items;
+	gint    i;
+
+	items = g_strsplit (str, ",", -1);
+	for (i = 0; items[i]; i++) {
+		gdouble value = g_ascii_strtod (items[i], NULL);
+
+		g_array_append_val (values, value);
+	}
+	g_strfreev (items);
+
+	return values;
+}
+
+static void
+benchmark_render (EvDocument *document,
+		  GList      *pages,
+		  GArray     *scales,
+		  GArray     *rotations,
+		  GString    *json)
+{
+	GTimer *timer = g_timer_new ();
+	guint   i, j;
+
+	for (i = 0; i < scales->len; i++) {
+		for (j = 0; j < rotations->len; j++) {
+			gdouble scale = g_array_index (scales, gdouble, i);
+			gint    rotation = g_array_index (rotations, gdouble, j);
+			GArray *samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+			gchar  *name;
+			GList  *l;
+			gint    n;
+
+			for (l = pages; l; l = g_list_next (l)) {
+				EvRenderContext *rc;
+
+				rc = ev_render_context_new (l->data, rotation, scale);
+				for (n = 0; n < repeat; n++) {
+					cairo_surface_t *surface;
+
+					g_timer_start (timer);
+					surface = ev_document_render (document, rc);
+					add_sample (samples, timer);
+					if (surface)
+						cairo_surface_destroy (surface);
+				}
+				g_object_unref (rc);
+			}
+
+			name = g_strdup_printf ("render scale=%g rotation=%d", scale, rotation);
+			append_stats (json, name, samples);
+			g_free (name);
+		}
+	}
+
+	g_timer_destroy (timer);
+}
+
+static void
+benchmark_thumbnails (EvDocument *document,
+		      GList      *pages,
+		      GString    *json)
+{
+	GTimer *timer = g_timer_new ();
+	GArray *samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	GList  *l;
+	gint    n;
+
+	for (l = pages; l; l = g_list_next (l)) {
+		EvPage          *page = l->data;
+		EvRenderContext *rc;
+		gdouble          width;
+
+		ev_document_get_page_size (document, page->index, &width, NULL);
+		rc = ev_render_context_new (page, 0, THUMBNAIL_WIDTH / MAX (width, 1));
+		for (n = 0; n < repeat; n++) {
+			GdkPixbuf *pixbuf;
+
+			g_timer_start (timer);
+			pixbuf = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (document),
+								       rc, TRUE);
+			add_sample (samples, timer);
+			if (pixbuf)
+				g_object_unref (pixbuf);
+		}
+		g_object_unref (rc);
+	}
+
+	append_stats (json, "thumbnail", samples);
+	g_timer_destroy (timer);
+}
+
+static void
+benchmark_text (EvDocument *document,
+		GList      *pages,
+		GString    *json)
+{
+	GTimer *timer = g_timer_new ();
+	GArray *text_samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	GArray *find_samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	GList  *l;
+	gint    n;
+
+	for (l = pages; l; l = g_list_next (l)) {
+		EvPage *page = l->data;
+
+		for (n = 0; n < repeat; n++) {
+			if (EV_IS_DOCUMENT_TEXT (document)) {
+				gchar *text;
+
+				g_timer_start (timer);
+				text = ev_document_text_get_text (EV_DOCUMENT_TEXT (document), page);
+				add_sample (text_samples, timer);
+				g_free (text);
+			}
+
+			if (EV_IS_DOCUMENT_FIND (document)) {
+				GList *matches;
+
+				g_timer_start (timer);
+				matches = ev_document_find_find_text (EV_DOCUMENT_FIND (document),
+								      page, find_text, FALSE);
+				add_sample (find_samples, timer);
+				g_list_free_full (matches, (GDestroyNotify) ev_rectangle_free);
+			}
+		}
+	}
+
+	append_stats (json, "text", text_samples);
+	append_stats (json, "find", find_samples);
+	g_timer_destroy (timer);
+}
+
+static gboolean
+benchmark_file (const gchar *filename,
+		GArray      *scales,
+		GArray      *rotations)
+{
+	EvDocument *document;
+	GFile      *file;
+	gchar      *uri;
+	gchar      *escaped;
+	GTimer     *timer;
+	GError     *error = NULL;
+	GString    *json;
+	GList      *pages = NULL;
+	gdouble     load_time;
+	gint        n_pages, n, i;
+
+	file = g_file_new_for_commandline_arg (filename);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	timer = g_timer_new ();
+	document = ev_document_factory_get_document (uri, &error);
+	load_time = g_timer_elapsed (timer, NULL) * 1000;
+	g_timer_destroy (timer);
+	g_free (uri);
+
+	if (!document) {
+		g_printerr ("Error loading %s: %s\n", filename, error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	n_pages = ev_document_get_n_pages (document);
+	n = MIN (n_pages, MAX (max_pages, 1));
+	for (i = 0; i < n; i++)
+		pages = g_list_prepend (pages,
+					ev_document_get_page (document,
+							      (gint64) i * n_pages / n));
+	pages = g_list_reverse (pages);
+
+	escaped = g_strescape (filename, NULL);
+	json = g_string_new (NULL);
+	g_string_append_printf (json, "{ \"file\": \"%s\", \"backend\": \"%s\", "
+				"\"pages\": %d, \"load\": %.3f",
+				escaped, G_OBJECT_TYPE_NAME (document),
+				n_pages, load_time);
+	g_free (escaped);
+
+	benchmark_render (document, pages, scales, rotations, json);
+	if (EV_IS_DOCUMENT_THUMBNAILS (document))
+		benchmark_thumbnails (document, pages, json);
+	benchmark_text (document, pages, json);
+
+	g_string_append_printf (json, ", \"peak_rss_kb\": %ld }", get_peak_rss ());
+	g_print ("%s\n", json->str);
+	g_string_free (json, TRUE);
+
+	g_list_free_full (pages, g_object_unref);
+	g_object_unref (document);
+
+	return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	GArray         *scales, *rotations;
+	gint            i;
+	gboolean        retval = TRUE;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return 1;
+	}
+	g_option_context_free (context);
+
+	if (!files) {
+		g_printerr ("Usage: %s [OPTION…] FILE…\n", argv[0]);
+		return 1;
+	}
+
+	if (!ev_init ()) {
+		g_printerr ("No document backends found in %s\n",
+			    ev_backends_manager_get_backends_dir ());
+		return 1;
+	}
+
+	scales = parse_list (scales_str ? scales_str : "0.25,1,2");
+	rotations = parse_list (rotations_str ? rotations_str : "0,90");
+	if (!find_text)
+		find_text = g_strdup ("the");
+
+	for (i = 0; files[i]; i++) {
+		pid_t pid;
+		gint  status;
+
+		pid = fork ();
+		if (pid == 0) {
+			gboolean success;
+
+			success = benchmark_file (files[i], scales, rotations);
+			fflush (stdout);
+			_exit (success ? 0 : 1);
+		}
+
+		if (pid < 0 || waitpid (pid, &status, 0) != pid ||
+		    !WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+			if (pid < 0)
+				g_printerr ("Failed to start a process for %s\n", files[i]);
+			retval = FALSE;
+		}
+	}
+
+	g_array_free (scales, TRUE);
+	g_array_free (rotations, TRUE);
+	g_strfreev (files);
+	ev_shutdown ();
+
+	return retval ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8; c-indent-level: 8 -*- */
+/*
+ * Copyright (C) 2024 Atril Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Scrolls an EvView through a document in continuous mode, one step per
+ * frame, then jumps to random offsets, and prints one JSON object with
+ * percentiles, in milliseconds, of the time taken to update the view
+ * for every scroll step and jump, and of the intervals between frames.
+ * Meant for documents of a thousand pages or more, see
+ * generate-bench-inputs.py.
+ *
+ *   make -C test scroll-benchmark
+ *   ./test/generate-bench-inputs.py /tmp/bench 5000
+ *   ./test/scroll-benchmark /tmp/bench/bench-5000-pages.pdf
+ *
+ * Needs a display. The backends are loaded from the installed backends
+ * directory.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include <gtk/gtk.h>
+
+#include "ev-backends-manager.h"
+#include "ev-document-factory.h"
+#include "ev-document-model.h"
+#include "ev-init.h"
+#include "ev-view.h"
+
+#define MIN_PAGES 1000
+
+static gint      n_steps = 2000;
+static gdouble   step_pages = 0.25;
+static gint      n_jumps = 200;
+static gchar   **files = NULL;
+
+static const GOptionEntry options[] = {
+	{ "steps", 's', 0, G_OPTION_ARG_INT, &n_steps,
+	  "Number of frames scrolled (default: 2000)", "N" },
+	{ "step", 'p', 0, G_OPTION_ARG_DOUBLE, &step_pages,
+	  "Distance scrolled every frame, in pages (default: 0.25)", "PAGES" },
+	{ "jumps", 'j', 0, G_OPTION_ARG_INT, &n_jumps,
+	  "Number of jumps to random offsets (default: 200)", "N" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, NULL, "FILE" },
+	{ NULL }
+};
+
+typedef struct {
+	GtkWidget     *view;
+	GtkAdjustment *vadjustment;
+	GMainLoop     *loop;
+	GRand         *rand;
+	GTimer        *timer;
+	gint           n_pages;
+	gdouble        page_height;
+	gint           step;
+	gint           jump;
+	gint64         last_frame_time;
+	GArray        *scroll_samples;
+	GArray        *jump_samples;
+	GArray        *frame_samples;
+} ScrollBenchmark;
+
+static gint
+compare_doubles (gconstpointer a,
+		 gconstpointer b)
+{
+	gdouble da = *(const gdouble *) a;
+	gdouble db = *(const gdouble *) b;
+
+	return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static gdouble
+percentile (GArray *samples,
+	    gdouble p)
+{
+	guint i;
+
+	i = (guint) (p / 100.0 * (samples->len - 1) + 0.5);
+
+	return g_array_index (samples, gdouble, i);
+}
+
+/* Appends "name": { percentiles } to @json */
+static void
+append_stats (GString     *json,
+	      const gchar *name,
+	      GArray      *samples)
+{
+	if (samples->len == 0)
+		return;
+
+	g_array_sort (samples, compare_doubles);
+	g_string_append_printf (json,
+				", \"%s\": { \"n\": %u, \"p50\": %.3f, \"p90\": %.3f, "
+				"\"p99\": %.3f, \"max\": %.3f }",
+				name, samples->len,
+				percentile (samples, 50),
+				percentile (samples, 90),
+				percentile (samples, 99),
+				g_array_index (samples, gdouble, samples->len - 1));
+}
+
+/* Moves the view and times the update it does synchronously: finding
+ * the visible pages and requesting their renders.
+ */
+static void
+scroll_to (ScrollBenchmark *bench,
+	   gdouble          value,
+	   GArray          *samples)
+{
+	gdouble ms;
+
+	g_timer_start (bench->timer);
+	gtk_adjustment_set_value (bench->vadjustment, value);
+	ms = g_timer_elapsed (bench->timer, NULL) * 1000;
+	g_array_append_val (samples, ms);
+}
+
+static gboolean
+scroll_tick_cb (GtkWidget       *widget,
+		GdkFrameClock   *frame_clock,
+		ScrollBenchmark *bench)
+{
+	gint64  frame_time = gdk_frame_clock_get_frame_time (frame_clock);
+	gdouble upper, page_size;
+
+	if (bench->last_frame_time > 0) {
+		gdouble ms = (frame_time - bench->last_frame_time) / 1000.0;
+
+		g_array_append_val (bench->frame_samples, ms);
+	}
+	bench->last_frame_time = frame_time;
+
+	upper = gtk_adjustment_get_upper (bench->vadjustment);
+	page_size = gtk_adjustment_get_page_size (bench->vadjustment);
+
+	if (bench->step < n_steps) {
+		gdouble value;
+
+		value = gtk_adjustment_get_value (bench->vadjustment) +
+			step_pages * bench->page_height;
+		if (value > upper - page_size)
+			value = 0;
+
+		scroll_to (bench, value, bench->scroll_samples);
+		bench->step++;
+
+		return G_SOURCE_CONTINUE;
+	}
+
+	if (bench->jump < n_jumps) {
+		scroll_to (bench,
+			   g_rand_double_range (bench->rand, 0, MAX (upper - page_size, 1)),
+			   bench->jump_samples);
+		bench->jump++;
+
+		return G_SOURCE_CONTINUE;
+	}
+
+	g_main_loop_quit (bench->loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+start_scrolling (ScrollBenchmark *bench)
+{
+	bench->page_height = gtk_adjustment_get_upper (bench->vadjustment) / MAX (bench->n_pages, 1);
+	gtk_widget_add_tick_callback (bench->view,
+				      (GtkTickCallback) scroll_tick_cb,
+				      bench, NULL);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+benchmark_file (const gchar *filename)
+{
+	ScrollBenchmark  bench = { 0 };
+	EvDocument      *document;
+	EvDocumentModel *model;
+	GtkWidget       *window, *scrolled_window;
+	GFile           *file;
+	gchar           *uri;
+	gchar           *escaped;
+	GString         *json;
+	GError          *error = NULL;
+
+	file = g_file_new_for_commandline_arg (filename);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	document = ev_document_factory_get_document (uri, &error);
+	g_free (uri);
+	if (!document) {
+		g_printerr ("Error loading %s: %s\n", filename, error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	bench.n_pages = ev_document_get_n_pages (document);
+	if (bench.n_pages < MIN_PAGES)
+		g_printerr ("%s has only %d pages, scrolling cost is only visible "
+			    "with %d pages or more\n", filename, bench.n_pages, MIN_PAGES);
+
+	model = ev_document_model_new_with_document (document);
+	ev_document_model_set_continuous (model, TRUE);
+	ev_document_model_set_sizing_mode (model, EV_SIZING_FIT_WIDTH);
+
+	window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_default_size (GTK_WINDOW (window), 800, 1000);
+	scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+	bench.view = ev_view_new ();
+	ev_view_set_model (EV_VIEW (bench.view), model);
+	gtk_container_add (GTK_CONTAINER (scrolled_window), bench.view);
+	gtk_container_add (GTK_CONTAINER (window), scrolled_window);
+	gtk_widget_show_all (window);
+
+	bench.vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (bench.view));
+	bench.loop = g_main_loop_new (NULL, FALSE);
+	bench.rand = g_rand_new_with_seed (0);
+	bench.timer = g_timer_new ();
+	bench.scroll_samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	bench.jump_samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	bench.frame_samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	/* Let the view lay the document out first */
+	g_timeout_add_seconds (1, (GSourceFunc) start_scrolling, &bench);
+	g_main_loop_run (bench.loop);
+
+	escaped = g_strescape (filename, NULL);
+	json = g_string_new (NULL);
+	g_string_append_printf (json, "{ \"file\": \"%s\", \"backend\": \"%s\", \"pages\": %d",
+				escaped, G_OBJECT_TYPE_NAME (document), bench.n_pages);
+	g_free (escaped);
+
+	append_stats (json, "scroll_update", bench.scroll_samples);
+	append_stats (json, "jump_update", bench.jump_samples);
+	append_stats (json, "frame_interval", bench.frame_samples);
+	g_string_append (json, " }");
+	g_print ("%s\n", json->str);
+	g_string_free (json, TRUE);
+
+	g_array_free (bench.scroll_samples, TRUE);
+	g_array_free (bench.jump_samples, TRUE);
+	g_array_free (bench.frame_samples, TRUE);
+	g_timer_destroy (bench.timer);
+	g_rand_free (bench.rand);
+	g_main_loop_unref (bench.loop);
+	gtk_widget_destroy (window);
+	g_object_unref (model);
+	g_object_unref (document);
+
+	return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError         *error = NULL;
+	gboolean        retval;
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_add_group (context, gtk_get_option_group (TRUE));
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return 1;
+	}
+	g_option_context_free (context);
+
+	if (!files || g_strv_length (files) != 1) {
+		g_printerr ("Usage: %s [OPTION…] FILE\n", argv[0]);
+		return 1;
+	}
+
+	if (!ev_init ()) {
+		g_printerr ("No document backends found in %s\n",
+			    ev_backends_manager_get_backends_dir ());
+		return 1;
+	}
+
+	retval = benchmark_file (files[0]);
+
+	g_strfreev (files);
+	ev_shutdown ();
+
+	return retval ? 0 : 1;
+}
@@ -32,11 +32,15 @@ static gboolean finished = TRUE;
 
 static gint size = THUMBNAIL_SIZE;
 static gboolean time_limit = TRUE;
+static char *batch_file = NULL;
+static gint n_jobs = 0;
 static char **file_arguments = NULL;
 
 static const GOptionEntry goption_options[] = {
 	{ "size", 's', 0, G_OPTION_ARG_INT, &size, NULL, "SIZE" },
         { "no-limit", 'l', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &time_limit, "Don't limit the thumbnailing time to 15 seconds", NULL },
+	{ "batch", 'b', 0, G_OPTION_ARG_FILENAME, &batch_file, "Read <input> <output> pairs, one per line, from FILE (- for the standard input)", "FILE" },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of files thumbnailed at the same time in batch mode", "N" },
 	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <output>" },
 	{ NULL }
 };
@@ -48,6 +52,34 @@ struct AsyncData {
 	gboolean     success;
 };
 
+/* Batch mode: worker threads take items from a shared queue. A worker
+ * that exceeds the time limit can't be stopped, so it is abandoned and
+ * replaced by a new one; it exits by itself if it ever finishes.
+ */
+typedef struct {
+	gchar *input;
+	gchar *output;
+} BatchItem;
+
+typedef struct {
+	GMutex  mutex;
+	GCond   cond;
+	GQueue *items;
+	GList  *workers;
+	gint    n_failed;
+	gint    n_abandoned;
+} Batch;
+
+typedef struct {
+	Batch     *batch;
+	BatchItem *item;
+	gint64     start_time;
+	/* Time spent waiting for the document locks, held by other workers */
+	gint64     wait_start;
+	gint64     wait_time;
+	gboolean   abandoned;
+} BatchWorker;
+
 /* Time monitor: copied from totem */
 G_GNUC_NORETURN static gpointer
 time_monitor (gpointer data)
@@ -90,8 +122,75 @@ delete_temp_file (GFile *file)
 	g_object_unref (file);
 }
 
+static void
+batch_worker_wait_begin (BatchWorker *worker)
+{
+	g_mutex_lock (&worker->batch->mutex);
+	worker->wait_start = g_get_monotonic_time ();
+	g_mutex_unlock (&worker->batch->mutex);
+}
+
+static void
+batch_worker_wait_end (BatchWorker *worker)
+{
+	g_mutex_lock (&worker->batch->mutex);
+	worker->wait_time += g_get_monotonic_time () - worker->wait_start;
+	worker->wait_start = 0;
+	g_mutex_unlock (&worker->batch->mutex);
+}
+
+/* Backends that don't declare they can load documents concurrently are
+ * loaded under the global document mutex, and the ones using fontconfig
+ * under the fontconfig mutex, like EvJobLoad does. In batch mode the
+ * wait for these locks isn't counted against the time limit. */
 static EvDocument *
-atril_thumbnailer_get_document (GFile *file)
+atril_thumbnailer_load_document (const gchar *uri,
+				 gboolean     fast,
+				 BatchWorker *worker,
+				 GError     **error)
+{
+	EvDocument           *document;
+	EvDocumentConcurrency concurrency;
+	const gchar          *uri_unc;
+	gboolean              result;
+
+	document = ev_document_factory_new_document (uri, fast, error);
+	if (!document)
+		return NULL;
+
+	concurrency = ev_document_get_concurrency (document);
+	uri_unc = g_object_get_data (G_OBJECT (document), "uri-uncompressed");
+
+	if (worker)
+		batch_worker_wait_begin (worker);
+	if (!(concurrency & EV_DOCUMENT_CONCURRENCY_DOCUMENTS))
+		ev_document_doc_mutex_lock ();
+	if (!(concurrency & EV_DOCUMENT_CONCURRENCY_FONTCONFIG))
+		ev_document_fc_mutex_lock ();
+	if (worker)
+		batch_worker_wait_end (worker);
+
+	/* Only the first page is thumbnailed, don't measure the others */
+	result = ev_document_load_full (document, uri_unc ? uri_unc : uri,
+					EV_DOCUMENT_LOAD_FLAG_INCREMENTAL,
+					error);
+
+	if (!(concurrency & EV_DOCUMENT_CONCURRENCY_FONTCONFIG))
+		ev_document_fc_mutex_unlock ();
+	if (!(concurrency & EV_DOCUMENT_CONCURRENCY_DOCUMENTS))
+		ev_document_doc_mutex_unlock ();
+
+	if (!result) {
+		g_object_unref (document);
+		return NULL;
+	}
+
+	return document;
+}
+
+static EvDocument *
+atril_thumbnailer_get_document (GFile       *file,
+				BatchWorker *worker)
 {
 	EvDocument *document = NULL;
 	gchar      *uri;
@@ -128,7 +227,13 @@ atril_thumbnailer_get_document (GFile *file)
 		uri = g_file_get_uri (file);
 	}
 
-	document = ev_document_factory_get_document (uri, &error);
+	document = atril_thumbnailer_load_document (uri, TRUE, worker, &error);
+	if (!document &&
+	    !g_error_matches (error, EV_DOCUMENT_ERROR, EV_DOCUMENT_ERROR_ENCRYPTED)) {
+		/* Try again with slow mime detection */
+		g_clear_error (&error);
+		document = atril_thumbnailer_load_document (uri, FALSE, worker, &error);
+	}
 	if (tmp_file) {
 		if (document) {
 			g_object_weak_ref (G_OBJECT (document),
@@ -152,6 +257,9 @@ atril_thumbnailer_get_document (GFile *file)
 		return NULL;
 	}
 
+	if (!document)
+		g_printerr ("Error loading document\n");
+
 	return document;
 }
 
@@ -188,17 +296,274 @@ atril_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int siz
 static gpointer
 atril_thumbnail_pngenc_get_async (struct AsyncData *data)
 {
-	ev_document_doc_mutex_lock ();
+	ev_document_lock (data->document);
 	data->success = atril_thumbnail_pngenc_get (data->document,
 						     data->output,
 						     data->size);
-	ev_document_doc_mutex_unlock ();
+	ev_document_unlock (data->document);
 
 	g_idle_add ((GSourceFunc)gtk_main_quit, NULL);
 
 	return NULL;
 }
 
+static void
+batch_item_free (BatchItem *item)
+{
+	g_free (item->input);
+	g_free (item->output);
+	g_slice_free (BatchItem, item);
+}
+
+static gboolean
+atril_thumbnailer_batch_thumbnail (BatchWorker *worker)
+{
+	BatchItem  *item = worker->item;
+	EvDocument *document;
+	GFile      *file;
+	gboolean    success = FALSE;
+
+	file = g_file_new_for_commandline_arg (item->input);
+	document = atril_thumbnailer_get_document (file, worker);
+	g_object_unref (file);
+
+	if (!document)
+		return FALSE;
+
+	if (EV_IS_DOCUMENT_THUMBNAILS (document)) {
+		/* The render lock only takes the fontconfig mutex for the
+		 * backends that don't declare they can do without it */
+		batch_worker_wait_begin (worker);
+		ev_document_lock (document);
+		ev_document_render_lock (document);
+		batch_worker_wait_end (worker);
+		success = atril_thumbnail_pngenc_get (document, item->output, size);
+		ev_document_render_unlock (document);
+		ev_document_unlock (document);
+	}
+
+	g_object_unref (document);
+
+	return success;
+}
+
+static gpointer
+batch_worker_run (BatchWorker *worker)
+{
+	Batch     *batch = worker->batch;
+	BatchItem *item;
+
+	g_mutex_lock (&batch->mutex);
+
+	while ((item = g_queue_pop_head (batch->items))) {
+		gboolean success;
+
+		worker->item = item;
+		worker->start_time = g_get_monotonic_time ();
+		worker->wait_time = 0;
+		g_mutex_unlock (&batch->mutex);
+
+		success = atril_thumbnailer_batch_thumbnail (worker);
+
+		g_mutex_lock (&batch->mutex);
+		if (worker->abandoned) {
+			/* Already reported and replaced */
+			g_mutex_unlock (&batch->mutex);
+			batch_item_free (item);
+			g_slice_free (BatchWorker, worker);
+
+			return NULL;
+		}
+
+		if (!success) {
+			g_printerr ("%s couldn't process file: '%s'\n",
+				    g_get_prgname (), item->input);
+			batch->n_failed++;
+		}
+
+		worker->item = NULL;
+		batch_item_free (item);
+	}
+
+	batch->workers = g_list_remove (batch->workers, worker);
+	g_slice_free (BatchWorker, worker);
+	g_cond_signal (&batch->cond);
+	g_mutex_unlock (&batch->mutex);
+
+	return NULL;
+}
+
+/* Must be called with the batch mutex held */
+static void
+batch_start_worker (Batch *batch)
+{
+	BatchWorker *worker;
+
+	worker = g_slice_new0 (BatchWorker);
+	worker->batch = batch;
+	batch->workers = g_list_prepend (batch->workers, worker);
+
+	g_thread_unref (g_thread_new ("EvThumbnailerBatchWorker",
+				      (GThreadFunc) batch_worker_run,
+				      worker));
+}
+
+/* Must be called with the batch mutex held */
+static void
+batch_abandon_timed_out_workers (Batch *batch)
+{
+	GList *l = batch->workers;
+	gint64 now = g_get_monotonic_time ();
+
+	while (l) {
+		BatchWorker *worker = (BatchWorker *) l->data;
+		GList       *next = g_list_next (l);
+		gint64       elapsed = now - worker->start_time;
+
+		/* Waiting for another worker to render isn't counted, unless
+		 * one was abandoned and may never release the locks */
+		if (batch->n_abandoned == 0) {
+			elapsed -= worker->wait_time;
+			if (worker->wait_start > 0)
+				elapsed -= now - worker->wait_start;
+		}
+
+		if (worker->item && elapsed > DEFAULT_SLEEP_TIME) {
+			g_printerr ("%s couldn't process file: '%s'\n"
+				    "Reason: Took too much time to process.\n",
+				    g_get_prgname (), worker->item->input);
+
+			worker->abandoned = TRUE;
+			batch->workers = g_list_delete_link (batch->workers, l);
+			batch->n_failed++;
+			batch->n_abandoned++;
+
+			if (!g_queue_is_empty (batch->items))
+				batch_start_worker (batch);
+		}
+
+		l = next;
+	}
+}
+
+static gboolean
+batch_read_items (Batch       *batch,
+		  const gchar *filename)
+{
+	GIOChannel *channel;
+	GIOStatus   status;
+	gchar      *line;
+	gsize       terminator;
+	gint        n_line = 0;
+	GError     *error = NULL;
+
+	if (g_strcmp0 (filename, "-") == 0) {
+		channel = g_io_channel_unix_new (0);
+	} else {
+		channel = g_io_channel_new_file (filename, "r", &error);
+		if (!channel) {
+			g_printerr ("Error opening batch file: %s\n", error->message);
+			g_error_free (error);
+
+			return FALSE;
+		}
+	}
+
+	/* File names don't have to be UTF-8 */
+	g_io_channel_set_encoding (channel, NULL, NULL);
+
+	while ((status = g_io_channel_read_line (channel, &line, NULL, &terminator, &error)) == G_IO_STATUS_NORMAL) {
+		gchar **argv = NULL;
+		gint    argc;
+
+		n_line++;
+		line[terminator] = '\0';
+
+		/* Each line is quoted like a command line, so names may contain spaces */
+		if (g_strstrip (line)[0] == '\0') {
+			g_free (line);
+			continue;
+		}
+
+		if (g_shell_parse_argv (line, &argc, &argv, NULL) && argc == 2) {
+			BatchItem *item = g_slice_new (BatchItem);
+
+			item->input = g_strdup (argv[0]);
+			item->output = g_strdup (argv[1]);
+			g_queue_push_tail (batch->items, item);
+		} else {
+			g_printerr ("Ignoring line %d of batch file: expected <input> <output>\n", n_line);
+			batch->n_failed++;
+		}
+
+		g_strfreev (argv);
+		g_free (line);
+	}
+
+	g_io_channel_unref (channel);
+
+	if (status == G_IO_STATUS_ERROR) {
+		g_printerr ("Error reading batch file: %s\n", error->message);
+		g_error_free (error);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int
+atril_thumbnailer_batch (const gchar *filename)
+{
+	Batch batch;
+	gint  i, n_workers;
+	int   retval;
+
+	g_mutex_init (&batch.mutex);
+	g_cond_init (&batch.cond);
+	batch.items = g_queue_new ();
+	batch.workers = NULL;
+	batch.n_failed = 0;
+	batch.n_abandoned = 0;
+
+	if (!batch_read_items (&batch, filename)) {
+		g_queue_free_full (batch.items, (GDestroyNotify) batch_item_free);
+		ev_shutdown ();
+
+		return -1;
+	}
+
+	n_workers = MIN (n_jobs > 0 ? n_jobs : (gint) g_get_num_processors (),
+			 (gint) g_queue_get_length (batch.items));
+
+	g_mutex_lock (&batch.mutex);
+	for (i = 0; i < n_workers; i++)
+		batch_start_worker (&batch);
+
+	while (batch.workers) {
+		g_cond_wait_until (&batch.cond, &batch.mutex,
+				   g_get_monotonic_time () + G_USEC_PER_SEC);
+		if (time_limit)
+			batch_abandon_timed_out_workers (&batch);
+	}
+	g_mutex_unlock (&batch.mutex);
+
+	retval = batch.n_failed > 0 ? -2 : 0;
+
+	/* Abandoned workers may still be using their documents and the
+	 * batch, exit without tearing anything down, like time_monitor().
+	 */
+	if (batch.n_abandoned > 0)
+		exit (retval);
+
+	g_queue_free (batch.items);
+	g_cond_clear (&batch.cond);
+	g_mutex_clear (&batch.mutex);
+	ev_shutdown ();
+
+	return retval;
+}
+
 static void
 print_usage (GOptionContext *context)
 {
@@ -229,15 +594,18 @@ main (int argc, char *argv[])
 		g_option_context_free (context);
 		if (file_arguments)
 			g_strfreev (file_arguments);
+		g_free (batch_file);
 
 		return -1;
 	}
 
-	if (file_arguments == NULL || g_strv_length (file_arguments) != 2) {
+	if (batch_file ? file_arguments != NULL :
+	    (file_arguments == NULL || g_strv_length (file_arguments) != 2)) {
 		print_usage (context);
 		g_option_context_free (context);
 		if (file_arguments)
 			g_strfreev (file_arguments);
+		g_free (batch_file);
 
 		return -1;
 	}
@@ -247,10 +615,25 @@ main (int argc, char *argv[])
 	if (size < 1) {
 		g_printerr ("Size cannot be smaller than 1 pixel\n");
 		g_strfreev (file_arguments);
+		g_free (batch_file);
 
 		return -1;
 	}
 
+	if (batch_file) {
+		int retval;
+
+		if (!ev_init ()) {
+			g_free (batch_file);
+			return -1;
+		}
+
+		retval = atril_thumbnailer_batch (batch_file);
+		g_free (batch_file);
+
+		return retval;
+	}
+
 	input = file_arguments[0];
 	output = file_arguments[1];
 
@@ -260,7 +643,7 @@ main (int argc, char *argv[])
 	}
 
 	file = g_file_new_for_commandline_arg (input);
-	document = atril_thumbnailer_get_document (file);
+	document = atril_thumbnailer_get_document (file, NULL);
 	g_object_unref (file);
 
 	if (!document) {